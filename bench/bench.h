@@ -0,0 +1,71 @@
+/**
+ * @header	bench.h
+ * @abstract	Time measurement and reporting functions shared by the benchmarks.
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+/** @const BENCH_REPEAT	Number of executions of a measure (the best time is kept). */
+#define BENCH_REPEAT	3
+
+/**
+ * @function	bench_now
+ * @abstract	Returns the current time of the monotonic clock.
+ * @return	The time, in seconds.
+ */
+static inline double bench_now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((double)ts.tv_sec + (double)ts.tv_nsec / 1e9);
+}
+/**
+ * @function	bench_min
+ * @abstract	Returns the smallest of two durations.
+ * @param	a	First duration.
+ * @param	b	Second duration.
+ * @return	The smallest duration.
+ */
+static inline double bench_min(double a, double b) {
+	return ((a < b) ? a : b);
+}
+/**
+ * @function	bench_report_rate
+ * @abstract	Print the duration and the throughput of a measure.
+ * @param	name		Name of the measure.
+ * @param	bytes		Number of processed bytes.
+ * @param	seconds		Duration of the measure.
+ */
+static inline void bench_report_rate(const char *name, uint64_t bytes, double seconds) {
+	printf("%-28s %10.3f s %10.1f MiB/s\n", name, seconds,
+	       seconds > 0 ? ((double)bytes / (1024.0 * 1024.0)) / seconds : 0.0);
+}
+/**
+ * @function	bench_report_ops
+ * @abstract	Print the duration and the number of operations per second of a measure.
+ * @param	name		Name of the measure.
+ * @param	ops		Number of operations.
+ * @param	seconds		Duration of the measure.
+ */
+static inline void bench_report_ops(const char *name, uint64_t ops, double seconds) {
+	printf("%-28s %10.3f s %10.1f ops/s\n", name, seconds, seconds > 0 ? (double)ops / seconds : 0.0);
+}
+/**
+ * @function	bench_arg_size
+ * @abstract	Read a numeric command-line argument.
+ * @param	argc	Number of arguments.
+ * @param	argv	Arguments.
+ * @param	index	Index of the argument.
+ * @param	def	Default value.
+ * @return	The value of the argument, or the default value.
+ */
+static inline uint64_t bench_arg_size(int argc, char **argv, int index, uint64_t def) {
+	if (argc <= index || !argv[index][0])
+		return (def);
+	return ((uint64_t)strtoull(argv[index], NULL, 10));
+}
@@ -0,0 +1,218 @@
+/**
+ * Benchmark of the SHA-512 checksums: sha512sum sub-program (previous
+ * checksum stage) against the in-process implementation of the ylib.
+ * Command line:
+ * ./bench_sha512 [size in MiB] [number of small files] [directory] [path to sha512sum]
+ *
+ * A file of the given size (1024 MiB by default) is written in the directory
+ * (/tmp by default), then hashed by both methods. The file is read once
+ * before the measures, so they are done with a warm page cache; each measure
+ * is done 3 times, the best time is kept. The digests must be identical.
+ * The hash of the same data already in memory is also measured: it is the
+ * cost of the checksum when it is computed while the archive is streamed,
+ * without reading it again.
+ *
+ * Then small files (1000 files of 64 KiB by default) are hashed by both
+ * methods, to measure the cost of the sub-programs' executions.
+ *
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ * @copyright	© 2019-2024, Amaury Bouchard
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "yarray.h"
+#include "ybin.h"
+#include "yexec.h"
+#include "yhash.h"
+#include "bench.h"
+
+/** @const BENCH_BUFFER_SIZE	Size of the buffer used to write the test file. */
+#define BENCH_BUFFER_SIZE	(1024 * 1024)
+/** @const BENCH_SMALL_SIZE	Size of the small files. */
+#define BENCH_SMALL_SIZE	(64 * 1024)
+
+/* *** declaration of private functions *** */
+static int bench_write_file(const char *path, uint64_t size);
+static int bench_small_files(const char *dir, uint64_t nbr_files, const char *sha512sum);
+
+int main(int argc, char **argv) {
+	uint64_t size = bench_arg_size(argc, argv, 1, 1024) * 1024 * 1024;
+	uint64_t nbr_small = bench_arg_size(argc, argv, 2, 1000);
+	const char *dir = (argc > 3 && argv[3][0]) ? argv[3] : "/tmp";
+	const char *sha512sum = (argc > 4) ? argv[4] : "/usr/bin/sha512sum";
+	yhash_sha512_t ctx;
+	uint8_t *data = NULL;
+	uint64_t offset;
+	char path[4096];
+	char hex[YHASH_SHA512_HEX_SIZE + 1];
+	uint8_t digest[YHASH_SHA512_SIZE];
+	yarray_t args = NULL;
+	ybin_t out = {0};
+	double start, exec_time = 1e9, native_time = 1e9, memory_time = 1e9;
+	int ret = 1;
+
+	snprintf(path, sizeof(path), "%s/bench_sha512-%d.dat", dir, (int)getpid());
+	printf("Test file: %s (%llu MiB)\n", path, (unsigned long long)(size / (1024 * 1024)));
+	if (bench_write_file(path, size)) {
+		fprintf(stderr, "Unable to write the test file.\n");
+		return (1);
+	}
+	// the file is read once, so both measures use the page cache
+	if (yhash_sha512_file(path, digest) != YENOERR) {
+		fprintf(stderr, "Unable to read the test file.\n");
+		goto cleanup;
+	}
+	// previous checksum stage: sha512sum is executed, its output is captured
+	if (!(args = yarray_create(1)) || yarray_push(&args, path) != YENOERR) {
+		fprintf(stderr, "Memory allocation error.\n");
+		goto cleanup;
+	}
+	// each measure is repeated, the best time is kept
+	for (int i = 0; i < BENCH_REPEAT; ++i) {
+		ybin_delete_data(&out);
+		start = bench_now();
+		if (yexec(sha512sum, args, NULL, &out, NULL) != YENOERR || !out.data ||
+		    out.bytesize < YHASH_SHA512_HEX_SIZE) {
+			fprintf(stderr, "Unable to execute %s.\n", sha512sum);
+			goto cleanup;
+		}
+		exec_time = bench_min(exec_time, bench_now() - start);
+	}
+	// in-process computation
+	for (int i = 0; i < BENCH_REPEAT; ++i) {
+		start = bench_now();
+		if (yhash_sha512_file(path, digest) != YENOERR) {
+			fprintf(stderr, "Unable to read the test file.\n");
+			goto cleanup;
+		}
+		native_time = bench_min(native_time, bench_now() - start);
+	}
+	yhash_sha512_hex(digest, hex);
+	// both digests must be the same
+	if (memcmp(out.data, hex, YHASH_SHA512_HEX_SIZE)) {
+		fprintf(stderr, "The digests are different.\n");
+		goto cleanup;
+	}
+	// streamed computation: the data are already in memory, hashed by chunks of 64 KiB
+	if (!(data = malloc(BENCH_BUFFER_SIZE))) {
+		fprintf(stderr, "Memory allocation error.\n");
+		goto cleanup;
+	}
+	memset(data, 0x5a, BENCH_BUFFER_SIZE);
+	for (int i = 0; i < BENCH_REPEAT; ++i) {
+		start = bench_now();
+		yhash_sha512_init(&ctx);
+		for (offset = 0; offset < size; offset += 65536)
+			yhash_sha512_update(&ctx, data + (offset % BENCH_BUFFER_SIZE), 65536);
+		yhash_sha512_final(&ctx, digest);
+		memory_time = bench_min(memory_time, bench_now() - start);
+	}
+	bench_report_rate("sha512sum (sub-program)", size, exec_time);
+	bench_report_rate("yhash_sha512_file", size, native_time);
+	bench_report_rate("yhash_sha512_update (memory)", size, memory_time);
+	printf("Digests are identical.\n\n");
+	unlink(path);
+	path[0] = '\0';
+	ret = bench_small_files(dir, nbr_small, sha512sum);
+cleanup:
+	if (path[0])
+		unlink(path);
+	free(data);
+	ybin_delete_data(&out);
+	yarray_free(args);
+	return (ret);
+}
+
+/* ********** PRIVATE FUNCTIONS ********** */
+
+/* Hash small files with both methods. */
+static int bench_small_files(const char *dir, uint64_t nbr_files, const char *sha512sum) {
+	char path[4096];
+	char hex[YHASH_SHA512_HEX_SIZE + 1];
+	uint8_t digest[YHASH_SHA512_SIZE];
+	yarray_t args = NULL;
+	ybin_t out = {0};
+	double start, exec_time, native_time;
+	uint64_t i;
+	int ret = 1;
+
+	if (!nbr_files)
+		return (0);
+	printf("Small files: %llu files of %d KiB\n", (unsigned long long)nbr_files, BENCH_SMALL_SIZE / 1024);
+	snprintf(path, sizeof(path), "%s/bench_sha512-%d.small", dir, (int)getpid());
+	if (bench_write_file(path, BENCH_SMALL_SIZE) || yhash_sha512_file(path, digest) != YENOERR) {
+		fprintf(stderr, "Unable to write the test file.\n");
+		goto cleanup;
+	}
+	// the same file is hashed for each item, only the execution cost is measured
+	if (!(args = yarray_create(1)) || yarray_push(&args, path) != YENOERR) {
+		fprintf(stderr, "Memory allocation error.\n");
+		goto cleanup;
+	}
+	start = bench_now();
+	for (i = 0; i < nbr_files; ++i) {
+		ybin_delete_data(&out);
+		if (yexec(sha512sum, args, NULL, &out, NULL) != YENOERR) {
+			fprintf(stderr, "Unable to execute %s.\n", sha512sum);
+			goto cleanup;
+		}
+	}
+	exec_time = bench_now() - start;
+	start = bench_now();
+	for (i = 0; i < nbr_files; ++i) {
+		if (yhash_sha512_file(path, digest) != YENOERR) {
+			fprintf(stderr, "Unable to read the test file.\n");
+			goto cleanup;
+		}
+	}
+	native_time = bench_now() - start;
+	yhash_sha512_hex(digest, hex);
+	if (!out.data || out.bytesize < YHASH_SHA512_HEX_SIZE || memcmp(out.data, hex, YHASH_SHA512_HEX_SIZE)) {
+		fprintf(stderr, "The digests are different.\n");
+		goto cleanup;
+	}
+	bench_report_ops("sha512sum (sub-program)", nbr_files, exec_time);
+	bench_report_ops("yhash_sha512_file", nbr_files, native_time);
+	printf("Speedup: %.2fx\n", native_time > 0 ? exec_time / native_time : 0.0);
+	ret = 0;
+cleanup:
+	unlink(path);
+	ybin_delete_data(&out);
+	yarray_free(args);
+	return (ret);
+}
+
+/* Write a file of pseudo-random data. */
+static int bench_write_file(const char *path, uint64_t size) {
+	uint64_t *buffer = NULL;
+	uint64_t state = 0x9e3779b97f4a7c15ULL;
+	int fd = -1;
+	int ret = 1;
+
+	if (!(buffer = malloc(BENCH_BUFFER_SIZE)) ||
+	    (fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) < 0)
+		goto cleanup;
+	while (size) {
+		size_t len = (size < BENCH_BUFFER_SIZE) ? (size_t)size : BENCH_BUFFER_SIZE;
+		// xorshift64, so the data can't be compressed nor deduplicated by the filesystem
+		for (size_t i = 0; i < BENCH_BUFFER_SIZE / sizeof(uint64_t); ++i) {
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			buffer[i] = state;
+		}
+		if (write(fd, buffer, len) != (ssize_t)len)
+			goto cleanup;
+		size -= len;
+	}
+	ret = 0;
+cleanup:
+	if (fd >= 0)
+		close(fd);
+	free(buffer);
+	return (ret);
+}
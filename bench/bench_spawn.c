@@ -0,0 +1,143 @@
+/**
+ * Benchmark of the execution of sub-programs: fork() and execv() (previous
+ * yexec code) against yexec_spawn() (posix_spawn) and yproc_run()
+ * (concurrent sub-programs).
+ * Command line:
+ * ./bench_spawn [number of sub-programs] [memory size in MiB] [concurrency] [path to true]
+ *
+ * The process allocates and writes the given quantity of memory (1024 MiB by
+ * default), so fork() has to copy its page tables, like the agent when it
+ * processes big archives. Then it executes the given number of short
+ * sub-programs (2000 by default), one after the other, with each method;
+ * yproc_run() executes them with the given concurrency (8 by default).
+ *
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ * @copyright	© 2019-2024, Amaury Bouchard
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include "yarray.h"
+#include "yexec.h"
+#include "yproc.h"
+#include "bench.h"
+
+/* *** declaration of private functions *** */
+static int bench_fork(const char *command, uint64_t nbr_procs, int null_fd);
+static int bench_spawn(const yexec_cmd_t *cmd, uint64_t nbr_procs, int null_fd);
+static void bench_done(size_t index, ystatus_t status, int exit_code, const ybin_t *out, const ybin_t *err,
+                       void *user_data);
+
+int main(int argc, char **argv) {
+	uint64_t nbr_procs = bench_arg_size(argc, argv, 1, 2000);
+	uint64_t memory = bench_arg_size(argc, argv, 2, 1024) * 1024 * 1024;
+	uint64_t concurrency = bench_arg_size(argc, argv, 3, 8);
+	const char *command = (argc > 4) ? argv[4] : "/bin/true";
+	yexec_cmd_t *cmds = NULL;
+	uint64_t nbr_failed = 0;
+	uint8_t *ballast = NULL;
+	double start, times[3];
+	char name[64];
+	int null_fd = -1;
+	int ret = 1;
+
+	if (!nbr_procs || !concurrency)
+		return (1);
+	// the memory is written, so its pages are mapped
+	if (memory && !(ballast = malloc(memory))) {
+		fprintf(stderr, "Memory allocation error.\n");
+		return (1);
+	}
+	if (ballast)
+		memset(ballast, 0xa5, memory);
+	if ((null_fd = open("/dev/null", O_RDWR | O_CLOEXEC)) < 0 ||
+	    !(cmds = calloc(nbr_procs, sizeof(yexec_cmd_t)))) {
+		fprintf(stderr, "Initialization error.\n");
+		goto cleanup;
+	}
+	for (uint64_t i = 0; i < nbr_procs; ++i)
+		cmds[i].command = command;
+	printf("%llu executions of %s, %llu MiB of memory\n", (unsigned long long)nbr_procs, command,
+	       (unsigned long long)(memory / (1024 * 1024)));
+	// previous code: fork() and execv()
+	start = bench_now();
+	if (bench_fork(command, nbr_procs, null_fd))
+		goto cleanup;
+	times[0] = bench_now() - start;
+	// posix_spawn()
+	start = bench_now();
+	if (bench_spawn(&cmds[0], nbr_procs, null_fd))
+		goto cleanup;
+	times[1] = bench_now() - start;
+	// concurrent sub-programs
+	start = bench_now();
+	if (yproc_run(cmds, nbr_procs, concurrency, false, bench_done, &nbr_failed) != YENOERR || nbr_failed) {
+		fprintf(stderr, "yproc_run error (%llu failures).\n", (unsigned long long)nbr_failed);
+		goto cleanup;
+	}
+	times[2] = bench_now() - start;
+	bench_report_ops("fork + execv", nbr_procs, times[0]);
+	bench_report_ops("yexec_spawn (posix_spawn)", nbr_procs, times[1]);
+	printf("Speedup: %.2fx\n", times[1] > 0 ? times[0] / times[1] : 0.0);
+	snprintf(name, sizeof(name), "yproc_run (%llu concurrent)", (unsigned long long)concurrency);
+	bench_report_ops(name, nbr_procs, times[2]);
+	ret = 0;
+cleanup:
+	if (null_fd != -1)
+		close(null_fd);
+	free(cmds);
+	free(ballast);
+	return (ret);
+}
+
+/* ********** PRIVATE FUNCTIONS ********** */
+
+/* Execute sub-programs one after the other, with fork() and execv() (previous yexec code). */
+static int bench_fork(const char *command, uint64_t nbr_procs, int null_fd) {
+	char *args[] = {(char*)command, NULL};
+	int wstatus;
+	pid_t pid;
+
+	for (uint64_t i = 0; i < nbr_procs; ++i) {
+		if ((pid = fork()) < 0) {
+			fprintf(stderr, "fork error.\n");
+			return (1);
+		}
+		if (!pid) {
+			dup2(null_fd, STDIN_FILENO);
+			dup2(null_fd, STDOUT_FILENO);
+			dup2(null_fd, STDERR_FILENO);
+			execv(command, args);
+			_exit(127);
+		}
+		if (waitpid(pid, &wstatus, 0) != pid || !WIFEXITED(wstatus) || WEXITSTATUS(wstatus)) {
+			fprintf(stderr, "Unable to execute %s.\n", command);
+			return (1);
+		}
+	}
+	return (0);
+}
+/* Execute sub-programs one after the other, with yexec_spawn(). */
+static int bench_spawn(const yexec_cmd_t *cmd, uint64_t nbr_procs, int null_fd) {
+	int wstatus;
+	pid_t pid;
+
+	for (uint64_t i = 0; i < nbr_procs; ++i) {
+		if (yexec_spawn(cmd, null_fd, null_fd, null_fd, &pid) != YENOERR ||
+		    waitpid(pid, &wstatus, 0) != pid || !WIFEXITED(wstatus) || WEXITSTATUS(wstatus)) {
+			fprintf(stderr, "Unable to execute %s.\n", cmd->command);
+			return (1);
+		}
+	}
+	return (0);
+}
+/* Count the failed sub-programs. */
+static void bench_done(size_t index, ystatus_t status, int exit_code, const ybin_t *out, const ybin_t *err,
+                       void *user_data) {
+	if (status != YENOERR)
+		++*(uint64_t*)user_data;
+}
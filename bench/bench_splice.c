@@ -0,0 +1,153 @@
+/**
+ * Benchmark of the transfer of a sub-program's output to a file: relay
+ * through a 4 KiB buffer and fwrite() (previous yexec_stdin() code) against
+ * yexec_pipeline(), which moves the data with splice() (and tee() when the
+ * data are also given to a function).
+ * Command line:
+ * ./bench_splice [size in MiB] [directory] [path to dd]
+ *
+ * The sub-program (dd) writes the given quantity of data (4096 MiB by
+ * default) to its standard output, which is written to a file in the
+ * directory (/tmp by default). Each measure is done 3 times, the best time
+ * is kept. The file is removed after each measure.
+ *
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ * @copyright	© 2019-2024, Amaury Bouchard
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include "yarray.h"
+#include "yexec.h"
+#include "yfile.h"
+#include "bench.h"
+
+/* *** declaration of private functions *** */
+static int bench_relay(const yexec_cmd_t *cmd, const char *path, bool count);
+static void bench_count(const void *data, size_t len, void *user_data);
+
+int main(int argc, char **argv) {
+	uint64_t size_mb = bench_arg_size(argc, argv, 1, 4096);
+	const char *dir = (argc > 2 && argv[2][0]) ? argv[2] : "/tmp";
+	const char *dd = (argc > 3) ? argv[3] : "/bin/dd";
+	uint64_t size = size_mb * 1024 * 1024;
+	char path[4096], count_opt[32];
+	double start, times[4] = {1e9, 1e9, 1e9, 1e9};
+	uint64_t counted = 0;
+	yarray_t args = NULL;
+	int ret = 1;
+
+	snprintf(path, sizeof(path), "%s/bench_splice-%d.dat", dir, (int)getpid());
+	snprintf(count_opt, sizeof(count_opt), "count=%llu", (unsigned long long)size_mb);
+	if (!(args = yarray_create(4)) ||
+	    yarray_push_multi(&args, 4, "if=/dev/zero", "bs=1M", count_opt, "status=none") != YENOERR) {
+		fprintf(stderr, "Memory allocation error.\n");
+		return (1);
+	}
+	yexec_cmd_t cmd = {
+		.command = dd,
+		.args = args,
+	};
+	printf("Output file: %s (%llu MiB)\n", path, (unsigned long long)size_mb);
+	for (int i = 0; i < BENCH_REPEAT; ++i) {
+		// previous code: relay through a 4 KiB buffer
+		start = bench_now();
+		if (bench_relay(&cmd, path, false))
+			goto cleanup;
+		times[0] = bench_min(times[0], bench_now() - start);
+		unlink(path);
+		// pipeline: the output is spliced into the file
+		start = bench_now();
+		if (yexec_pipeline(&cmd, 1, NULL, path, NULL, NULL) != YENOERR || yfile_get_size(path) != size) {
+			fprintf(stderr, "Pipeline error.\n");
+			goto cleanup;
+		}
+		times[1] = bench_min(times[1], bench_now() - start);
+		unlink(path);
+		// previous code, the data being also given to a function
+		start = bench_now();
+		if (bench_relay(&cmd, path, true))
+			goto cleanup;
+		times[2] = bench_min(times[2], bench_now() - start);
+		unlink(path);
+		// pipeline: the output is duplicated by tee(), spliced into the file, and read
+		counted = 0;
+		start = bench_now();
+		if (yexec_pipeline(&cmd, 1, NULL, path, bench_count, &counted) != YENOERR ||
+		    yfile_get_size(path) != size || counted != size) {
+			fprintf(stderr, "Pipeline error.\n");
+			goto cleanup;
+		}
+		times[3] = bench_min(times[3], bench_now() - start);
+		unlink(path);
+	}
+	bench_report_rate("relay 4 KiB + fwrite", size, times[0]);
+	bench_report_rate("yexec_pipeline (splice)", size, times[1]);
+	printf("Speedup: %.2fx\n", times[1] > 0 ? times[0] / times[1] : 0.0);
+	bench_report_rate("relay 4 KiB + fwrite + func", size, times[2]);
+	bench_report_rate("yexec_pipeline (tee + func)", size, times[3]);
+	printf("Speedup: %.2fx\n", times[3] > 0 ? times[2] / times[3] : 0.0);
+	ret = 0;
+cleanup:
+	unlink(path);
+	yarray_free(args);
+	return (ret);
+}
+
+/* ********** PRIVATE FUNCTIONS ********** */
+
+/* Relay the output of a sub-program to a file, through a 4 KiB buffer (previous yexec_stdin() code). */
+static int bench_relay(const yexec_cmd_t *cmd, const char *path, bool count) {
+	char buffer[4096];
+	uint64_t counted = 0;
+	ssize_t len;
+	FILE *file = NULL;
+	int fds[2] = {-1, -1};
+	int null_fd = -1;
+	int wstatus = 0;
+	pid_t pid;
+	int ret = 1;
+
+	if (!(file = fopen(path, "we")) || pipe2(fds, O_CLOEXEC) ||
+	    (null_fd = open("/dev/null", O_RDWR | O_CLOEXEC)) < 0 ||
+	    yexec_spawn(cmd, null_fd, fds[1], null_fd, &pid) != YENOERR) {
+		fprintf(stderr, "Unable to execute %s.\n", cmd->command);
+		goto cleanup;
+	}
+	close(fds[1]);
+	fds[1] = -1;
+	while ((len = read(fds[0], buffer, sizeof(buffer))) != 0) {
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0)
+			break;
+		fwrite(buffer, 1, (size_t)len, file);
+		if (count)
+			bench_count(buffer, (size_t)len, &counted);
+	}
+	waitpid(pid, &wstatus, 0);
+	if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus)) {
+		fprintf(stderr, "Sub-program error.\n");
+		goto cleanup;
+	}
+	ret = 0;
+cleanup:
+	if (file)
+		fclose(file);
+	if (fds[0] != -1)
+		close(fds[0]);
+	if (fds[1] != -1)
+		close(fds[1]);
+	if (null_fd != -1)
+		close(null_fd);
+	return (ret);
+}
+/* Count the bytes given by the pipeline (sink of the data, like a checksum function). */
+static void bench_count(const void *data, size_t len, void *user_data) {
+	*(uint64_t*)user_data += len;
+}
@@ -24,13 +24,18 @@ extern "C" {
 #include "ybase64.h"
 #include "yexception.h"
 #include "yhash.h"
+#include "ycrypt.h"
+#include "ycdc.h"
 #include "yhashmap.h"
 #include "yhashtable.h"
 #include "yini.h"
 #include "ylist.h"
 #include "ylock.h"
 #include "ylog.h"
+#include "ypool.h"
+#include "yproc.h"
 #include "ytable.h"
+#include "ytar.h"
 #include "ytimer.h"
 #include "yurl.h"
 #include "yvalue.h"
@@ -0,0 +1,148 @@
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "ycdc.h"
+
+/** @const _YCDC_GEAR_SEED	Seed of the gear table. Must never change, or chunk boundaries would move. */
+#define _YCDC_GEAR_SEED		0x61726b69762d6364ULL
+
+/* Gear table, generated once. */
+static uint64_t _ycdc_gear[256];
+/* Gear table's initialization control. */
+static pthread_once_t _ycdc_gear_once = PTHREAD_ONCE_INIT;
+
+/*
+ * _ycdc_gear_init()
+ * Generate the gear table, using the splitmix64 generator.
+ */
+static void _ycdc_gear_init(void) {
+	uint64_t state = _YCDC_GEAR_SEED;
+
+	for (int i = 0; i < 256; ++i) {
+		uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		_ycdc_gear[i] = z ^ (z >> 31);
+	}
+}
+/*
+ * _ycdc_mask()
+ * Create a mask with the given number of most significant bits set. The
+ * gear hash is shifted left, so its high bits depend on the last 64 bytes
+ * while its low bits depend only on the last few bytes.
+ */
+static uint64_t _ycdc_mask(unsigned int bits) {
+	if (!bits)
+		return (0);
+	if (bits >= 64)
+		return (UINT64_MAX);
+	return (UINT64_MAX << (64 - bits));
+}
+/*
+ * _ycdc_scan()
+ * Search a chunk boundary in some data, which follow the data of the current
+ * chunk. Returns the number of bytes which belong to the current chunk; the
+ * boolean is set to true if the chunk ends there.
+ */
+static size_t _ycdc_scan(ycdc_t *cdc, const uint8_t *data, size_t len, bool *cut) {
+	size_t pos = cdc->len;
+	size_t i = 0;
+	uint64_t hash = cdc->hash;
+
+	*cut = false;
+	// the first bytes of a chunk are not hashed
+	if (pos < cdc->min_size) {
+		i = cdc->min_size - pos;
+		if (i >= len)
+			return (len);
+	}
+	// before the average size, a boundary is harder to find
+	for (; i < len && pos + i < cdc->avg_size; ++i) {
+		hash = (hash << 1) + _ycdc_gear[data[i]];
+		if (!(hash & cdc->mask_s)) {
+			*cut = true;
+			return (i + 1);
+		}
+	}
+	// after the average size, a boundary is easier to find
+	for (; i < len; ++i) {
+		hash = (hash << 1) + _ycdc_gear[data[i]];
+		if (!(hash & cdc->mask_l) || pos + i + 1 >= cdc->max_size) {
+			*cut = true;
+			return (i + 1);
+		}
+	}
+	cdc->hash = hash;
+	return (len);
+}
+
+/* Create a chunker. */
+ycdc_t *ycdc_new(size_t min_size, size_t avg_size, size_t max_size, ycdc_function_t func, void *user_data) {
+	ycdc_t *cdc;
+	unsigned int bits = 0;
+
+	if (!func || !min_size || min_size >= avg_size || avg_size >= max_size ||
+	    (avg_size & (avg_size - 1)))
+		return (NULL);
+	while (((size_t)1 << bits) < avg_size)
+		bits++;
+	if (bits < 3)
+		return (NULL);
+	pthread_once(&_ycdc_gear_once, _ycdc_gear_init);
+	if (!(cdc = malloc0(sizeof(ycdc_t))))
+		return (NULL);
+	if (!(cdc->buffer = malloc0(max_size))) {
+		free0(cdc);
+		return (NULL);
+	}
+	cdc->min_size = min_size;
+	cdc->avg_size = avg_size;
+	cdc->max_size = max_size;
+	// normalized chunking (level 2)
+	cdc->mask_s = _ycdc_mask(bits + 2);
+	cdc->mask_l = _ycdc_mask(bits - 2);
+	cdc->func = func;
+	cdc->user_data = user_data;
+	return (cdc);
+}
+/* Free a chunker. */
+void ycdc_free(ycdc_t *cdc) {
+	if (!cdc)
+		return;
+	free0(cdc->buffer);
+	free0(cdc);
+}
+/* Add data to the stream. */
+void ycdc_write(const void *data, size_t len, void *user_data) {
+	ycdc_t *cdc = user_data;
+	const uint8_t *ptr = data;
+	size_t n;
+	bool cut;
+
+	while (len) {
+		n = _ycdc_scan(cdc, ptr, len, &cut);
+		if (cut && !cdc->len) {
+			// the whole chunk is in the given data, it is not copied
+			cdc->func(ptr, n, cdc->user_data);
+		} else {
+			memcpy(cdc->buffer + cdc->len, ptr, n);
+			cdc->len += n;
+			if (cut) {
+				cdc->func(cdc->buffer, cdc->len, cdc->user_data);
+				cdc->len = 0;
+			}
+		}
+		if (cut)
+			cdc->hash = 0;
+		ptr += n;
+		len -= n;
+	}
+}
+/* End the stream. */
+void ycdc_end(ycdc_t *cdc) {
+	if (cdc->len)
+		cdc->func(cdc->buffer, cdc->len, cdc->user_data);
+	cdc->len = 0;
+	cdc->hash = 0;
+}
+
@@ -0,0 +1,101 @@
+/**
+ * @header	ycdc.h
+ * @abstract	Content-defined chunking of data streams.
+ * @discussion	Data are cut into variable-size chunks, whose boundaries depend
+ *		only on the content (FastCDC algorithm, using a gear rolling
+ *		hash and normalized chunking). An insertion or a deletion in a
+ *		stream only changes the chunks around the modification, so
+ *		two versions of a stream share most of their chunks.
+ *
+ *		The gear table is generated from a fixed seed: the same data
+ *		are always cut at the same offsets, whatever the execution.
+ * @link	https://www.usenix.org/conference/atc16/technical-sessions/presentation/xia
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ */
+#pragma once
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif /* __cplusplus || c_plusplus */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ystatus.h"
+#include "ymemory.h"
+
+/**
+ * @typedef	ycdc_function_t
+ * @abstract	Function called with each chunk.
+ * @param	data		Pointer to the chunk's data.
+ * @param	len		Size of the chunk.
+ * @param	user_data	Pointer to user data.
+ */
+typedef void (*ycdc_function_t)(const void *data, size_t len, void *user_data);
+
+/**
+ * @typedef	ycdc_t
+ * @abstract	Chunker of a data stream.
+ * @field	min_size	Minimum size of a chunk.
+ * @field	avg_size	Expected average size of a chunk.
+ * @field	max_size	Maximum size of a chunk.
+ * @field	mask_s		Mask used before the average size (harder to match).
+ * @field	mask_l		Mask used after the average size (easier to match).
+ * @field	hash		Current value of the rolling hash.
+ * @field	buffer		Data of the current chunk.
+ * @field	len		Size of the current chunk.
+ * @field	func		Function called with each chunk.
+ * @field	user_data	Pointer given to the function.
+ */
+typedef struct {
+	size_t min_size;
+	size_t avg_size;
+	size_t max_size;
+	uint64_t mask_s;
+	uint64_t mask_l;
+	uint64_t hash;
+	uint8_t *buffer;
+	size_t len;
+	ycdc_function_t func;
+	void *user_data;
+} ycdc_t;
+
+/**
+ * @function	ycdc_new
+ *		Create a chunker.
+ * @param	min_size	Minimum size of a chunk.
+ * @param	avg_size	Expected average size of a chunk (must be a power of 2).
+ * @param	max_size	Maximum size of a chunk.
+ * @param	func		Function called with each chunk.
+ * @param	user_data	Pointer given to the function.
+ * @return	A pointer to the allocated chunker, or NULL if the sizes are not
+ *		valid (min_size < avg_size < max_size) or if an error occurred.
+ */
+ycdc_t *ycdc_new(size_t min_size, size_t avg_size, size_t max_size, ycdc_function_t func, void *user_data);
+/**
+ * @function	ycdc_free
+ *		Free a chunker. Pending data are not given to the function.
+ * @param	cdc	Pointer to the chunker.
+ */
+void ycdc_free(ycdc_t *cdc);
+/**
+ * @function	ycdc_write
+ *		Add data to the stream. The function is called with each chunk
+ *		ended by these data. Could be used as an output function of
+ *		yexec_pipeline().
+ * @param	data		Pointer to the data.
+ * @param	len		Size of the data.
+ * @param	user_data	Pointer to the chunker.
+ */
+void ycdc_write(const void *data, size_t len, void *user_data);
+/**
+ * @function	ycdc_end
+ *		End the stream. The function is called with the last chunk, if
+ *		there are pending data.
+ * @param	cdc	Pointer to the chunker.
+ */
+void ycdc_end(ycdc_t *cdc);
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}
+#endif /* __cplusplus || c_plusplus */
+
@@ -0,0 +1,577 @@
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "ycrypt.h"
+
+/* ********** CHACHA20 ********** */
+
+/** @define _YCRYPT_ROTL32	Left rotation of a 32-bits word. */
+#define _YCRYPT_ROTL32(v, n)	(((v) << (n)) | ((v) >> (32 - (n))))
+/** @define _YCRYPT_QR	ChaCha20 quarter round. */
+#define _YCRYPT_QR(a, b, c, d) \
+	do { \
+		a += b; d ^= a; d = _YCRYPT_ROTL32(d, 16); \
+		c += d; b ^= c; b = _YCRYPT_ROTL32(b, 12); \
+		a += b; d ^= a; d = _YCRYPT_ROTL32(d, 8); \
+		c += d; b ^= c; b = _YCRYPT_ROTL32(b, 7); \
+	} while (0)
+
+/* Read a little-endian 32-bits integer. */
+static inline uint32_t _ycrypt_load32(const uint8_t *p) {
+	return ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+/* Write a little-endian 32-bits integer. */
+static inline void _ycrypt_store32(uint8_t *p, uint32_t v) {
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+	p[3] = (uint8_t)(v >> 24);
+}
+/* Write a little-endian 64-bits integer. */
+static inline void _ycrypt_store64(uint8_t *p, uint64_t v) {
+	_ycrypt_store32(p, (uint32_t)v);
+	_ycrypt_store32(p + 4, (uint32_t)(v >> 32));
+}
+/*
+ * _ycrypt_chacha20_block()
+ * Compute a 64-bytes block of ChaCha20 key stream.
+ */
+static void _ycrypt_chacha20_block(const uint32_t input[16], uint8_t out[64]) {
+	uint32_t x0 = input[0], x1 = input[1], x2 = input[2], x3 = input[3];
+	uint32_t x4 = input[4], x5 = input[5], x6 = input[6], x7 = input[7];
+	uint32_t x8 = input[8], x9 = input[9], x10 = input[10], x11 = input[11];
+	uint32_t x12 = input[12], x13 = input[13], x14 = input[14], x15 = input[15];
+
+	for (int i = 0; i < 10; ++i) {
+		// column rounds
+		_YCRYPT_QR(x0, x4, x8, x12);
+		_YCRYPT_QR(x1, x5, x9, x13);
+		_YCRYPT_QR(x2, x6, x10, x14);
+		_YCRYPT_QR(x3, x7, x11, x15);
+		// diagonal rounds
+		_YCRYPT_QR(x0, x5, x10, x15);
+		_YCRYPT_QR(x1, x6, x11, x12);
+		_YCRYPT_QR(x2, x7, x8, x13);
+		_YCRYPT_QR(x3, x4, x9, x14);
+	}
+	_ycrypt_store32(out + 0, x0 + input[0]);
+	_ycrypt_store32(out + 4, x1 + input[1]);
+	_ycrypt_store32(out + 8, x2 + input[2]);
+	_ycrypt_store32(out + 12, x3 + input[3]);
+	_ycrypt_store32(out + 16, x4 + input[4]);
+	_ycrypt_store32(out + 20, x5 + input[5]);
+	_ycrypt_store32(out + 24, x6 + input[6]);
+	_ycrypt_store32(out + 28, x7 + input[7]);
+	_ycrypt_store32(out + 32, x8 + input[8]);
+	_ycrypt_store32(out + 36, x9 + input[9]);
+	_ycrypt_store32(out + 40, x10 + input[10]);
+	_ycrypt_store32(out + 44, x11 + input[11]);
+	_ycrypt_store32(out + 48, x12 + input[12]);
+	_ycrypt_store32(out + 52, x13 + input[13]);
+	_ycrypt_store32(out + 56, x14 + input[14]);
+	_ycrypt_store32(out + 60, x15 + input[15]);
+}
+/*
+ * _ycrypt_chacha20_init()
+ * Initialize the ChaCha20 state (RFC 8439, section 2.3).
+ */
+static void _ycrypt_chacha20_init(uint32_t input[16], const uint8_t key[YCRYPT_KEY_SIZE],
+                                  uint32_t counter, const uint8_t nonce[YCRYPT_NONCE_SIZE]) {
+	// "expand 32-byte k"
+	input[0] = 0x61707865;
+	input[1] = 0x3320646e;
+	input[2] = 0x79622d32;
+	input[3] = 0x6b206574;
+	for (int i = 0; i < 8; ++i)
+		input[4 + i] = _ycrypt_load32(key + i * 4);
+	input[12] = counter;
+	input[13] = _ycrypt_load32(nonce);
+	input[14] = _ycrypt_load32(nonce + 4);
+	input[15] = _ycrypt_load32(nonce + 8);
+}
+#if defined(__GNUC__) || defined(__clang__)
+/** @typedef _ycrypt_u32x4_t	Vector of four 32-bits words (GCC/Clang extension, mapped to SIMD registers). */
+typedef uint32_t _ycrypt_u32x4_t __attribute__((vector_size(16)));
+/** @define _YCRYPT_ROTL32X4	Left rotation of four 32-bits words. */
+#define _YCRYPT_ROTL32X4(v, n)	(((v) << (n)) | ((v) >> (32 - (n))))
+/** @define _YCRYPT_QR4	ChaCha20 quarter round on four blocks. */
+#define _YCRYPT_QR4(a, b, c, d) \
+	do { \
+		a += b; d ^= a; d = _YCRYPT_ROTL32X4(d, 16); \
+		c += d; b ^= c; b = _YCRYPT_ROTL32X4(b, 12); \
+		a += b; d ^= a; d = _YCRYPT_ROTL32X4(d, 8); \
+		c += d; b ^= c; b = _YCRYPT_ROTL32X4(b, 7); \
+	} while (0)
+/*
+ * _ycrypt_chacha20_blocks4()
+ * Compute four consecutive 64-bytes blocks of ChaCha20 key stream. The four
+ * blocks are processed side by side, in SIMD registers (SSE2, NEON...),
+ * without any architecture-specific code.
+ */
+static void _ycrypt_chacha20_blocks4(const uint32_t input[16], uint8_t out[256]) {
+	_ycrypt_u32x4_t x[16], orig[16];
+
+	for (int i = 0; i < 16; ++i)
+		orig[i] = (_ycrypt_u32x4_t){input[i], input[i], input[i], input[i]};
+	orig[12] += (_ycrypt_u32x4_t){0, 1, 2, 3};
+	for (int i = 0; i < 16; ++i)
+		x[i] = orig[i];
+	for (int r = 0; r < 10; ++r) {
+		// column rounds
+		_YCRYPT_QR4(x[0], x[4], x[8], x[12]);
+		_YCRYPT_QR4(x[1], x[5], x[9], x[13]);
+		_YCRYPT_QR4(x[2], x[6], x[10], x[14]);
+		_YCRYPT_QR4(x[3], x[7], x[11], x[15]);
+		// diagonal rounds
+		_YCRYPT_QR4(x[0], x[5], x[10], x[15]);
+		_YCRYPT_QR4(x[1], x[6], x[11], x[12]);
+		_YCRYPT_QR4(x[2], x[7], x[8], x[13]);
+		_YCRYPT_QR4(x[3], x[4], x[9], x[14]);
+	}
+	for (int i = 0; i < 16; ++i) {
+		x[i] += orig[i];
+		for (int j = 0; j < 4; ++j)
+			_ycrypt_store32(out + j * 64 + i * 4, x[i][j]);
+	}
+}
+#endif /* __GNUC__ || __clang__ */
+/*
+ * _ycrypt_chacha20_xor()
+ * Encrypt or decrypt data by xoring it with the ChaCha20 key stream.
+ */
+static void _ycrypt_chacha20_xor(uint32_t input[16], const uint8_t *in, uint8_t *out, size_t len) {
+	uint8_t block[256];
+
+#if defined(__GNUC__) || defined(__clang__)
+	// four blocks at once
+	while (len >= 256) {
+		_ycrypt_chacha20_blocks4(input, block);
+		input[12] += 4;
+		for (size_t i = 0; i < 256; i += 8) {
+			uint64_t a, b;
+			memcpy(&a, in + i, 8);
+			memcpy(&b, block + i, 8);
+			a ^= b;
+			memcpy(out + i, &a, 8);
+		}
+		in += 256;
+		out += 256;
+		len -= 256;
+	}
+#endif /* __GNUC__ || __clang__ */
+	// remaining blocks
+	while (len) {
+		size_t n = (len < 64) ? len : 64;
+		_ycrypt_chacha20_block(input, block);
+		++input[12];
+		for (size_t i = 0; i < n; ++i)
+			out[i] = in[i] ^ block[i];
+		in += n;
+		out += n;
+		len -= n;
+	}
+	ycrypt_wipe(block, sizeof(block));
+}
+
+/* ********** POLY1305 ********** */
+
+/**
+ * @typedef	_ycrypt_poly1305_t
+ *		Context of a Poly1305 computation, with 26-bits limbs.
+ * @field	r		Multiplier (clamped first half of the key).
+ * @field	h		Accumulator.
+ * @field	pad		Second half of the key.
+ * @field	buffer		Pending data (incomplete block).
+ * @field	buffer_len	Number of bytes in the buffer.
+ */
+typedef struct {
+	uint32_t r[5];
+	uint32_t h[5];
+	uint32_t pad[4];
+	uint8_t buffer[16];
+	size_t buffer_len;
+} _ycrypt_poly1305_t;
+
+/*
+ * _ycrypt_poly1305_init()
+ * Initialize a Poly1305 computation.
+ */
+static void _ycrypt_poly1305_init(_ycrypt_poly1305_t *ctx, const uint8_t key[32]) {
+	// r &= 0xffffffc0ffffffc0ffffffc0fffffff
+	ctx->r[0] = (_ycrypt_load32(key + 0)) & 0x3ffffff;
+	ctx->r[1] = (_ycrypt_load32(key + 3) >> 2) & 0x3ffff03;
+	ctx->r[2] = (_ycrypt_load32(key + 6) >> 4) & 0x3ffc0ff;
+	ctx->r[3] = (_ycrypt_load32(key + 9) >> 6) & 0x3f03fff;
+	ctx->r[4] = (_ycrypt_load32(key + 12) >> 8) & 0x00fffff;
+	memset(ctx->h, 0, sizeof(ctx->h));
+	for (int i = 0; i < 4; ++i)
+		ctx->pad[i] = _ycrypt_load32(key + 16 + i * 4);
+	ctx->buffer_len = 0;
+}
+/*
+ * _ycrypt_poly1305_blocks()
+ * Process complete 16-bytes blocks. The high bit is 2^128 for complete
+ * blocks, and zero for the padded last block.
+ */
+static void _ycrypt_poly1305_blocks(_ycrypt_poly1305_t *ctx, const uint8_t *m, size_t len, uint32_t hibit) {
+	const uint32_t r0 = ctx->r[0], r1 = ctx->r[1], r2 = ctx->r[2], r3 = ctx->r[3], r4 = ctx->r[4];
+	const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+	uint32_t h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2], h3 = ctx->h[3], h4 = ctx->h[4];
+	uint64_t d0, d1, d2, d3, d4;
+	uint32_t c;
+
+	while (len >= 16) {
+		// h += m[i]
+		h0 += (_ycrypt_load32(m + 0)) & 0x3ffffff;
+		h1 += (_ycrypt_load32(m + 3) >> 2) & 0x3ffffff;
+		h2 += (_ycrypt_load32(m + 6) >> 4) & 0x3ffffff;
+		h3 += (_ycrypt_load32(m + 9) >> 6) & 0x3ffffff;
+		h4 += (_ycrypt_load32(m + 12) >> 8) | hibit;
+		// h *= r
+		d0 = ((uint64_t)h0 * r0) + ((uint64_t)h1 * s4) + ((uint64_t)h2 * s3) + ((uint64_t)h3 * s2) + ((uint64_t)h4 * s1);
+		d1 = ((uint64_t)h0 * r1) + ((uint64_t)h1 * r0) + ((uint64_t)h2 * s4) + ((uint64_t)h3 * s3) + ((uint64_t)h4 * s2);
+		d2 = ((uint64_t)h0 * r2) + ((uint64_t)h1 * r1) + ((uint64_t)h2 * r0) + ((uint64_t)h3 * s4) + ((uint64_t)h4 * s3);
+		d3 = ((uint64_t)h0 * r3) + ((uint64_t)h1 * r2) + ((uint64_t)h2 * r1) + ((uint64_t)h3 * r0) + ((uint64_t)h4 * s4);
+		d4 = ((uint64_t)h0 * r4) + ((uint64_t)h1 * r3) + ((uint64_t)h2 * r2) + ((uint64_t)h3 * r1) + ((uint64_t)h4 * r0);
+		// (partial) h %= p
+		c = (uint32_t)(d0 >> 26); h0 = (uint32_t)d0 & 0x3ffffff;
+		d1 += c; c = (uint32_t)(d1 >> 26); h1 = (uint32_t)d1 & 0x3ffffff;
+		d2 += c; c = (uint32_t)(d2 >> 26); h2 = (uint32_t)d2 & 0x3ffffff;
+		d3 += c; c = (uint32_t)(d3 >> 26); h3 = (uint32_t)d3 & 0x3ffffff;
+		d4 += c; c = (uint32_t)(d4 >> 26); h4 = (uint32_t)d4 & 0x3ffffff;
+		h0 += c * 5; c = (h0 >> 26); h0 &= 0x3ffffff;
+		h1 += c;
+		m += 16;
+		len -= 16;
+	}
+	ctx->h[0] = h0;
+	ctx->h[1] = h1;
+	ctx->h[2] = h2;
+	ctx->h[3] = h3;
+	ctx->h[4] = h4;
+}
+/*
+ * _ycrypt_poly1305_update()
+ * Add data to a Poly1305 computation.
+ */
+static void _ycrypt_poly1305_update(_ycrypt_poly1305_t *ctx, const uint8_t *m, size_t len) {
+	// complete the pending block
+	if (ctx->buffer_len) {
+		size_t n = 16 - ctx->buffer_len;
+		if (n > len)
+			n = len;
+		memcpy(ctx->buffer + ctx->buffer_len, m, n);
+		ctx->buffer_len += n;
+		m += n;
+		len -= n;
+		if (ctx->buffer_len < 16)
+			return;
+		_ycrypt_poly1305_blocks(ctx, ctx->buffer, 16, (1 << 24));
+		ctx->buffer_len = 0;
+	}
+	// process complete blocks directly from the given memory
+	if (len >= 16) {
+		size_t n = len & ~(size_t)15;
+		_ycrypt_poly1305_blocks(ctx, m, n, (1 << 24));
+		m += n;
+		len -= n;
+	}
+	// keep the remaining bytes
+	if (len) {
+		memcpy(ctx->buffer, m, len);
+		ctx->buffer_len = len;
+	}
+}
+/*
+ * _ycrypt_poly1305_pad()
+ * Add zeros to a Poly1305 computation, up to a 16 bytes boundary.
+ */
+static void _ycrypt_poly1305_pad(_ycrypt_poly1305_t *ctx) {
+	static const uint8_t zeros[16] = {0};
+
+	if (ctx->buffer_len)
+		_ycrypt_poly1305_update(ctx, zeros, 16 - ctx->buffer_len);
+}
+/*
+ * _ycrypt_poly1305_final()
+ * End a Poly1305 computation.
+ */
+static void _ycrypt_poly1305_final(_ycrypt_poly1305_t *ctx, uint8_t tag[YCRYPT_TAG_SIZE]) {
+	uint32_t h0, h1, h2, h3, h4, c;
+	uint32_t g0, g1, g2, g3, g4, mask;
+	uint64_t f;
+
+	// process the last (incomplete) block
+	if (ctx->buffer_len) {
+		ctx->buffer[ctx->buffer_len] = 1;
+		memset(ctx->buffer + ctx->buffer_len + 1, 0, 16 - ctx->buffer_len - 1);
+		_ycrypt_poly1305_blocks(ctx, ctx->buffer, 16, 0);
+	}
+	// fully carry h
+	h0 = ctx->h[0];
+	h1 = ctx->h[1];
+	h2 = ctx->h[2];
+	h3 = ctx->h[3];
+	h4 = ctx->h[4];
+	c = h1 >> 26; h1 &= 0x3ffffff;
+	h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+	h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+	h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+	h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+	h1 += c;
+	// compute h + -p
+	g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+	g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+	g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+	g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+	g4 = h4 + c - (1UL << 26);
+	// select h if h < p, or h + -p if h >= p (without branch)
+	mask = (g4 >> 31) - 1;
+	g0 &= mask;
+	g1 &= mask;
+	g2 &= mask;
+	g3 &= mask;
+	g4 &= mask;
+	mask = ~mask;
+	h0 = (h0 & mask) | g0;
+	h1 = (h1 & mask) | g1;
+	h2 = (h2 & mask) | g2;
+	h3 = (h3 & mask) | g3;
+	h4 = (h4 & mask) | g4;
+	// h = h % 2^128
+	h0 = (h0) | (h1 << 26);
+	h1 = (h1 >> 6) | (h2 << 20);
+	h2 = (h2 >> 12) | (h3 << 14);
+	h3 = (h3 >> 18) | (h4 << 8);
+	// tag = (h + pad) % 2^128
+	f = (uint64_t)h0 + ctx->pad[0]; h0 = (uint32_t)f;
+	f = (uint64_t)h1 + ctx->pad[1] + (f >> 32); h1 = (uint32_t)f;
+	f = (uint64_t)h2 + ctx->pad[2] + (f >> 32); h2 = (uint32_t)f;
+	f = (uint64_t)h3 + ctx->pad[3] + (f >> 32); h3 = (uint32_t)f;
+	_ycrypt_store32(tag + 0, h0);
+	_ycrypt_store32(tag + 4, h1);
+	_ycrypt_store32(tag + 8, h2);
+	_ycrypt_store32(tag + 12, h3);
+	// clear the context
+	ycrypt_wipe(ctx, sizeof(_ycrypt_poly1305_t));
+}
+
+/* ********** AEAD ********** */
+
+/*
+ * _ycrypt_aead_tag()
+ * Compute the Poly1305 tag of an AEAD message (RFC 8439, section 2.8).
+ */
+static void _ycrypt_aead_tag(const uint8_t key[YCRYPT_KEY_SIZE], const uint8_t nonce[YCRYPT_NONCE_SIZE],
+                             const void *aad, size_t aad_len, const void *cipher, size_t len,
+                             uint8_t tag[YCRYPT_TAG_SIZE]) {
+	uint32_t input[16];
+	uint8_t block[64];
+	uint8_t lengths[16];
+	_ycrypt_poly1305_t poly;
+
+	// the one-time Poly1305 key is the first key stream block
+	_ycrypt_chacha20_init(input, key, 0, nonce);
+	_ycrypt_chacha20_block(input, block);
+	_ycrypt_poly1305_init(&poly, block);
+	// aad || pad16 || cipher text || pad16 || len(aad) || len(cipher text)
+	if (aad && aad_len) {
+		_ycrypt_poly1305_update(&poly, aad, aad_len);
+		_ycrypt_poly1305_pad(&poly);
+	}
+	_ycrypt_poly1305_update(&poly, cipher, len);
+	_ycrypt_poly1305_pad(&poly);
+	_ycrypt_store64(lengths, (uint64_t)aad_len);
+	_ycrypt_store64(lengths + 8, (uint64_t)len);
+	_ycrypt_poly1305_update(&poly, lengths, sizeof(lengths));
+	_ycrypt_poly1305_final(&poly, tag);
+	ycrypt_wipe(input, sizeof(input));
+	ycrypt_wipe(block, sizeof(block));
+}
+/*
+ * ycrypt_aead_encrypt()
+ * Encrypt data using ChaCha20-Poly1305.
+ */
+void ycrypt_aead_encrypt(const uint8_t key[YCRYPT_KEY_SIZE], const uint8_t nonce[YCRYPT_NONCE_SIZE],
+                         const void *aad, size_t aad_len, const void *in, size_t len,
+                         void *out, uint8_t tag[YCRYPT_TAG_SIZE]) {
+	uint32_t input[16];
+
+	_ycrypt_chacha20_init(input, key, 1, nonce);
+	_ycrypt_chacha20_xor(input, in, out, len);
+	ycrypt_wipe(input, sizeof(input));
+	_ycrypt_aead_tag(key, nonce, aad, aad_len, out, len, tag);
+}
+/*
+ * ycrypt_aead_decrypt()
+ * Check the authentication tag of some data encrypted using
+ * ChaCha20-Poly1305, and decrypt them.
+ */
+ystatus_t ycrypt_aead_decrypt(const uint8_t key[YCRYPT_KEY_SIZE], const uint8_t nonce[YCRYPT_NONCE_SIZE],
+                              const void *aad, size_t aad_len, const void *in, size_t len,
+                              const uint8_t tag[YCRYPT_TAG_SIZE], void *out) {
+	uint32_t input[16];
+	uint8_t computed[YCRYPT_TAG_SIZE];
+	uint8_t diff = 0;
+
+	// constant-time comparison of the tags
+	_ycrypt_aead_tag(key, nonce, aad, aad_len, in, len, computed);
+	for (int i = 0; i < YCRYPT_TAG_SIZE; ++i)
+		diff |= computed[i] ^ tag[i];
+	if (diff)
+		return (YEBADMSG);
+	_ycrypt_chacha20_init(input, key, 1, nonce);
+	_ycrypt_chacha20_xor(input, in, out, len);
+	ycrypt_wipe(input, sizeof(input));
+	return (YENOERR);
+}
+
+/* ********** KEY DERIVATION ********** */
+
+/**
+ * @typedef	_ycrypt_hmac_t
+ *		Context of a HMAC-SHA512 computation.
+ * @field	inner	Hash of the inner padded key.
+ * @field	outer	Hash of the outer padded key.
+ */
+typedef struct {
+	yhash_sha512_t inner;
+	yhash_sha512_t outer;
+} _ycrypt_hmac_t;
+
+/*
+ * _ycrypt_hmac_init()
+ * Initialize a HMAC-SHA512 computation. The context could be copied and
+ * reused for several messages with the same key.
+ */
+static void _ycrypt_hmac_init(_ycrypt_hmac_t *ctx, const void *key, size_t key_len) {
+	uint8_t pad[YHASH_SHA512_BLOCK_SIZE];
+	uint8_t key_hash[YHASH_SHA512_SIZE];
+
+	// keys longer than a block are hashed
+	if (key_len > YHASH_SHA512_BLOCK_SIZE) {
+		yhash_sha512_init(&ctx->inner);
+		yhash_sha512_update(&ctx->inner, key, key_len);
+		yhash_sha512_final(&ctx->inner, key_hash);
+		key = key_hash;
+		key_len = YHASH_SHA512_SIZE;
+	}
+	memset(pad, 0x36, sizeof(pad));
+	for (size_t i = 0; i < key_len; ++i)
+		pad[i] ^= ((const uint8_t*)key)[i];
+	yhash_sha512_init(&ctx->inner);
+	yhash_sha512_update(&ctx->inner, pad, sizeof(pad));
+	for (size_t i = 0; i < sizeof(pad); ++i)
+		pad[i] ^= (0x36 ^ 0x5c);
+	yhash_sha512_init(&ctx->outer);
+	yhash_sha512_update(&ctx->outer, pad, sizeof(pad));
+	ycrypt_wipe(pad, sizeof(pad));
+	ycrypt_wipe(key_hash, sizeof(key_hash));
+}
+/*
+ * _ycrypt_hmac_final()
+ * End a HMAC-SHA512 computation.
+ */
+static void _ycrypt_hmac_final(_ycrypt_hmac_t *ctx, uint8_t mac[YCRYPT_HMAC_SIZE]) {
+	uint8_t inner_hash[YHASH_SHA512_SIZE];
+
+	yhash_sha512_final(&ctx->inner, inner_hash);
+	yhash_sha512_update(&ctx->outer, inner_hash, sizeof(inner_hash));
+	yhash_sha512_final(&ctx->outer, mac);
+	ycrypt_wipe(inner_hash, sizeof(inner_hash));
+}
+/*
+ * ycrypt_hmac_sha512()
+ * Compute the HMAC-SHA512 of some data.
+ */
+void ycrypt_hmac_sha512(const void *key, size_t key_len, const void *data, size_t len,
+                        uint8_t mac[YCRYPT_HMAC_SIZE]) {
+	_ycrypt_hmac_t ctx;
+
+	_ycrypt_hmac_init(&ctx, key, key_len);
+	yhash_sha512_update(&ctx.inner, data, len);
+	_ycrypt_hmac_final(&ctx, mac);
+}
+/*
+ * ycrypt_pbkdf2_sha512()
+ * Derive a key from a password, using PBKDF2-HMAC-SHA512. The padded
+ * password is hashed once; each iteration then only costs two SHA-512
+ * blocks.
+ */
+void ycrypt_pbkdf2_sha512(const void *pwd, size_t pwd_len, const void *salt, size_t salt_len,
+                          uint32_t iterations, uint8_t *out, size_t out_len) {
+	_ycrypt_hmac_t base, ctx;
+	uint8_t u[YHASH_SHA512_SIZE];
+	uint8_t t[YHASH_SHA512_SIZE];
+	uint8_t index[4];
+
+	_ycrypt_hmac_init(&base, pwd, pwd_len);
+	for (uint32_t block = 1; out_len; ++block) {
+		size_t n = (out_len < YHASH_SHA512_SIZE) ? out_len : YHASH_SHA512_SIZE;
+		// U1 = HMAC(password, salt || INT_BE(block))
+		index[0] = (uint8_t)(block >> 24);
+		index[1] = (uint8_t)(block >> 16);
+		index[2] = (uint8_t)(block >> 8);
+		index[3] = (uint8_t)block;
+		ctx = base;
+		yhash_sha512_update(&ctx.inner, salt, salt_len);
+		yhash_sha512_update(&ctx.inner, index, sizeof(index));
+		_ycrypt_hmac_final(&ctx, u);
+		memcpy(t, u, sizeof(t));
+		// Un = HMAC(password, Un-1)
+		for (uint32_t i = 1; i < iterations; ++i) {
+			ctx = base;
+			yhash_sha512_update(&ctx.inner, u, sizeof(u));
+			_ycrypt_hmac_final(&ctx, u);
+			for (int j = 0; j < YHASH_SHA512_SIZE; ++j)
+				t[j] ^= u[j];
+		}
+		memcpy(out, t, n);
+		out += n;
+		out_len -= n;
+	}
+	ycrypt_wipe(&base, sizeof(base));
+	ycrypt_wipe(&ctx, sizeof(ctx));
+	ycrypt_wipe(u, sizeof(u));
+	ycrypt_wipe(t, sizeof(t));
+}
+
+/* ********** UTILITIES ********** */
+
+/*
+ * ycrypt_random()
+ * Fill a buffer with random bytes from /dev/urandom (available on Linux
+ * and macOS, unlike getrandom()).
+ */
+ystatus_t ycrypt_random(void *buffer, size_t len) {
+	uint8_t *ptr = buffer;
+	int fd;
+
+	if ((fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC)) == -1)
+		return (YEIO);
+	while (len) {
+		ssize_t n = read(fd, ptr, len);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			close(fd);
+			return (YEIO);
+		}
+		ptr += n;
+		len -= (size_t)n;
+	}
+	close(fd);
+	return (YENOERR);
+}
+/*
+ * ycrypt_wipe()
+ * Erase sensitive data from memory, through a volatile pointer.
+ */
+void ycrypt_wipe(void *buffer, size_t len) {
+	volatile uint8_t *ptr = buffer;
+
+	while (len--)
+		*ptr++ = 0;
+}
+
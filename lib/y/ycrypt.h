@@ -0,0 +1,109 @@
+/**
+ * @header	ycrypt.h
+ * @abstract	Authenticated encryption and key derivation.
+ * @discussion	ChaCha20-Poly1305 AEAD (RFC 8439), HMAC-SHA512 (RFC 2104) and
+ *		PBKDF2-HMAC-SHA512 (RFC 8018), written in portable C. ChaCha20
+ *		runs in constant time without any dedicated CPU instruction,
+ *		which is not the case of table-based AES implementations.
+ * @link	https://www.rfc-editor.org/rfc/rfc8439
+ * @link	https://www.rfc-editor.org/rfc/rfc8018
+ * @link	Poly1305 implementation: https://github.com/floodyberry/poly1305-donna
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ */
+#pragma once
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif /* __cplusplus || c_plusplus */
+
+#include "y.h"
+
+/** @const YCRYPT_KEY_SIZE	Size of a ChaCha20-Poly1305 key, in bytes. */
+#define YCRYPT_KEY_SIZE		32
+/** @const YCRYPT_NONCE_SIZE	Size of a ChaCha20-Poly1305 nonce, in bytes. */
+#define YCRYPT_NONCE_SIZE	12
+/** @const YCRYPT_TAG_SIZE	Size of a Poly1305 authentication tag, in bytes. */
+#define YCRYPT_TAG_SIZE		16
+/** @const YCRYPT_HMAC_SIZE	Size of a HMAC-SHA512 result, in bytes. */
+#define YCRYPT_HMAC_SIZE	64
+
+/**
+ * @function	ycrypt_aead_encrypt
+ *		Encrypt data using ChaCha20-Poly1305. The input and output
+ *		buffers may be the same (in-place encryption).
+ * @param	key	Pointer to the 32 bytes key.
+ * @param	nonce	Pointer to the 12 bytes nonce. Must never be used twice with the same key.
+ * @param	aad	Pointer to additional authenticated data (could be NULL).
+ * @param	aad_len	Size of the additional authenticated data.
+ * @param	in	Pointer to the plain text.
+ * @param	len	Size of the plain text.
+ * @param	out	Pointer to the output buffer (same size than the input).
+ * @param	tag	Pointer to a 16 bytes buffer where the authentication tag will be written.
+ */
+void ycrypt_aead_encrypt(const uint8_t key[YCRYPT_KEY_SIZE], const uint8_t nonce[YCRYPT_NONCE_SIZE],
+                         const void *aad, size_t aad_len, const void *in, size_t len,
+                         void *out, uint8_t tag[YCRYPT_TAG_SIZE]);
+/**
+ * @function	ycrypt_aead_decrypt
+ *		Check the authentication tag of some data encrypted using
+ *		ChaCha20-Poly1305, and decrypt them. Nothing is written if the
+ *		data can't be authenticated.
+ * @param	key	Pointer to the 32 bytes key.
+ * @param	nonce	Pointer to the 12 bytes nonce.
+ * @param	aad	Pointer to additional authenticated data (could be NULL).
+ * @param	aad_len	Size of the additional authenticated data.
+ * @param	in	Pointer to the cipher text.
+ * @param	len	Size of the cipher text.
+ * @param	tag	Pointer to the 16 bytes authentication tag.
+ * @param	out	Pointer to the output buffer (same size than the input).
+ * @return	YENOERR if OK, YEBADMSG if the data can't be authenticated.
+ */
+ystatus_t ycrypt_aead_decrypt(const uint8_t key[YCRYPT_KEY_SIZE], const uint8_t nonce[YCRYPT_NONCE_SIZE],
+                              const void *aad, size_t aad_len, const void *in, size_t len,
+                              const uint8_t tag[YCRYPT_TAG_SIZE], void *out);
+/**
+ * @function	ycrypt_hmac_sha512
+ *		Compute the HMAC-SHA512 of some data.
+ * @param	key	Pointer to the key.
+ * @param	key_len	Size of the key.
+ * @param	data	Pointer to the data.
+ * @param	len	Size of the data.
+ * @param	mac	Pointer to a buffer where the 64 bytes of the MAC will be written.
+ */
+void ycrypt_hmac_sha512(const void *key, size_t key_len, const void *data, size_t len,
+                        uint8_t mac[YCRYPT_HMAC_SIZE]);
+/**
+ * @function	ycrypt_pbkdf2_sha512
+ *		Derive a key from a password, using PBKDF2-HMAC-SHA512.
+ * @param	pwd		Pointer to the password.
+ * @param	pwd_len		Size of the password.
+ * @param	salt		Pointer to the salt.
+ * @param	salt_len	Size of the salt.
+ * @param	iterations	Number of iterations.
+ * @param	out		Pointer to the output buffer.
+ * @param	out_len		Size of the key to generate.
+ */
+void ycrypt_pbkdf2_sha512(const void *pwd, size_t pwd_len, const void *salt, size_t salt_len,
+                          uint32_t iterations, uint8_t *out, size_t out_len);
+/**
+ * @function	ycrypt_random
+ *		Fill a buffer with cryptographically secure random bytes,
+ *		read from the kernel's generator.
+ * @param	buffer	Pointer to the buffer.
+ * @param	len	Size of the buffer.
+ * @return	YENOERR if OK, YEIO if the random generator is not available.
+ */
+ystatus_t ycrypt_random(void *buffer, size_t len);
+/**
+ * @function	ycrypt_wipe
+ *		Erase sensitive data from memory. The compiler can't remove
+ *		this operation, even if the memory is not used afterwards.
+ * @param	buffer	Pointer to the memory.
+ * @param	len	Size of the memory.
+ */
+void ycrypt_wipe(void *buffer, size_t len);
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}
+#endif /* __cplusplus || c_plusplus */
+
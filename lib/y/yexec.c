@@ -1,182 +1,529 @@
+#include <signal.h>
+#include <spawn.h>
 #include "yexec.h"
 
-/** @const Default buffer size. */
-#define READ_BUFFER_SIZE	4096
+/** @const Size of the buffer used to read the output of a pipeline. */
+#define PIPELINE_BUFFER_SIZE	65536
+/** @const Size of the pipes connected to the agent (data moved by a splice() call). */
+#define PIPELINE_PIPE_SIZE	1048576
 
+/**
+ * @typedef	_yexec_input_t
+ *		Input of a pipeline, written by a thread.
+ * @field	thread	Thread identifier.
+ * @field	func	Input function.
+ * @field	data	Pointer given to the input function.
+ * @field	fd	Writing end of the pipe.
+ * @field	status	Status returned by the input function.
+ */
+typedef struct {
+	pthread_t thread;
+	yexec_input_function_t func;
+	void *data;
+	int fd;
+	ystatus_t status;
+} _yexec_input_t;
+/**
+ * @typedef	_yexec_error_t
+ *		Standard errors of a pipeline, read by a thread.
+ * @field	thread	Thread identifier.
+ * @field	fd	Reading end of the pipe.
+ * @field	err	Pointer to the buffer of the kept data.
+ */
+typedef struct {
+	pthread_t thread;
+	int fd;
+	ybin_t *err;
+} _yexec_error_t;
+/**
+ * @typedef	_yexec_stdin_t
+ *		Data sent to the standard input of a sub-program.
+ * @field	data	Pointer to the data.
+ * @field	len	Size of the data.
+ * @field	file	Path to the file to send (used if data is null).
+ */
+typedef struct {
+	const void *data;
+	size_t len;
+	const char *file;
+} _yexec_stdin_t;
+
+/*
+ * Create a pipe which file descriptors are closed on exec. Thus they are not
+ * inherited by other sub-programs (in a pipeline or started by another thread).
+ */
+static int _yexec_pipe(int fds[2]) {
+#ifdef __linux__
+	// atomic creation, a concurrent spawn can't inherit the descriptors
+	return (pipe2(fds, O_CLOEXEC));
+#else /* __linux__ */
+	if (pipe(fds) == -1)
+		return (-1);
+	if (fcntl(fds[0], F_SETFD, FD_CLOEXEC) == -1 ||
+	    fcntl(fds[1], F_SETFD, FD_CLOEXEC) == -1) {
+		close(fds[0]);
+		close(fds[1]);
+		return (-1);
+	}
+	return (0);
+#endif /* __linux__ */
+}
+/*
+ * _yexec_input_thread()
+ * Call the input function of a pipeline, and close the pipe once it is done.
+ * SIGPIPE is blocked, so if the reader stops, the writing fails with EPIPE
+ * instead of killing the process.
+ */
+static void *_yexec_input_thread(void *data) {
+	_yexec_input_t *input = data;
+	sigset_t set;
+
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+	input->status = input->func(input->fd, input->data);
+	close(input->fd);
+	return (NULL);
+}
+/*
+ * _yexec_error_thread()
+ * Read the standard errors of a pipeline until all its sub-programs closed
+ * them. The beginning is kept, the rest is discarded.
+ */
+static void *_yexec_error_thread(void *data) {
+	_yexec_error_t *error = data;
+	char buffer[4096];
+	ssize_t len;
+
+	for (; ; ) {
+		len = read(error->fd, buffer, sizeof(buffer));
+		if (len == -1 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			break;
+		if (error->err->bytesize < YEXEC_STDERR_MAX) {
+			size_t kept = YEXEC_STDERR_MAX - error->err->bytesize;
+			ybin_append(error->err, buffer, (((size_t)len < kept) ? (size_t)len : kept));
+		}
+	}
+	return (NULL);
+}
+/* Create a null-terminated list of strings from a yarray. */
+static char **_yexec_list(const char *first, yarray_t array) {
+	size_t len = (array ? yarray_length(array) : 0);
+	size_t offset = (first ? 1 : 0);
+	char **list = malloc0(sizeof(char*) * (len + offset + 1));
+
+	if (!list)
+		return (NULL);
+	if (first)
+		list[0] = (char*)first;
+	for (size_t i = 0; i < len; ++i)
+		list[i + offset] = array[i];
+	list[len + offset] = NULL;
+	return (list);
+}
+/*
+ * _yexec_write()
+ * Write a buffer to a file descriptor, retrying on short writes.
+ * Returns 0 if OK, -1 on error.
+ */
+static int _yexec_write(int fd, const void *data, size_t len) {
+	while (len) {
+		ssize_t written = write(fd, data, len);
+		if (written == -1 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return (-1);
+		data += written;
+		len -= (size_t)written;
+	}
+	return (0);
+}
+#ifdef __linux__
+/*
+ * _yexec_splice()
+ * Move a given amount of data from a pipe to a file descriptor, without
+ * copying it to user space. Returns 0 if OK, -1 on error.
+ */
+static int _yexec_splice(int in_fd, int out_fd, size_t len) {
+	while (len) {
+		ssize_t moved = splice(in_fd, NULL, out_fd, NULL, len, SPLICE_F_MOVE | SPLICE_F_MORE);
+		if (moved == -1 && errno == EINTR)
+			continue;
+		if (moved <= 0)
+			return (-1);
+		len -= (size_t)moved;
+	}
+	return (0);
+}
+#endif /* __linux__ */
+/*
+ * _yexec_relay()
+ * Read the output of a pipeline, and give it to the outputs.
+ * On Linux, if the output goes to a file only, the data are moved from the
+ * pipe to the file by splice(), without being copied to user space. If they
+ * are also needed by a function or in memory, they are duplicated by tee()
+ * into a second pipe, spliced into the file, and the first pipe is read for
+ * the other outputs. If the file doesn't support splice(), the data are
+ * copied through a buffer.
+ */
+static ystatus_t _yexec_relay(int fd, ybin_t *out_memory, int file_fd,
+                              yexec_output_function_t out_func, void *out_data) {
+	char buffer[PIPELINE_BUFFER_SIZE];
+	ystatus_t status = YENOERR;
+	ssize_t len;
+
+#ifdef __linux__
+	int tee_fds[2] = {-1, -1};
+	bool moved = false;
+
+	if (file_fd != -1 && (!(out_memory || out_func) || _yexec_pipe(tee_fds) != -1)) {
+		if (tee_fds[1] != -1)
+			fcntl(tee_fds[1], F_SETPIPE_SZ, PIPELINE_PIPE_SIZE);
+		for (;;) {
+			if (tee_fds[1] == -1)
+				len = splice(fd, NULL, file_fd, NULL, PIPELINE_PIPE_SIZE, SPLICE_F_MOVE | SPLICE_F_MORE);
+			else
+				len = tee(fd, tee_fds[1], sizeof(buffer), 0);
+			if (len == -1 && errno == EINTR)
+				continue;
+			if (!len)
+				break;
+			// the duplicated data are written to the file before being consumed from the first pipe
+			if (len > 0 && tee_fds[1] != -1 && _yexec_splice(tee_fds[0], file_fd, (size_t)len) == -1)
+				len = -1;
+			if (len == -1) {
+				// nothing was consumed yet: the data are copied instead
+				if (!moved && errno == EINVAL)
+					break;
+				status = YEIO;
+				break;
+			}
+			moved = true;
+			if (tee_fds[1] == -1)
+				continue;
+			for (size_t remaining = (size_t)len; remaining; ) {
+				ssize_t chunk = read(fd, buffer, (remaining < sizeof(buffer)) ? remaining : sizeof(buffer));
+				if (chunk == -1 && errno == EINTR)
+					continue;
+				if (chunk <= 0) {
+					status = YEPIPE;
+					break;
+				}
+				if (out_memory)
+					ybin_append(out_memory, buffer, chunk);
+				if (out_func)
+					out_func(buffer, (size_t)chunk, out_data);
+				remaining -= (size_t)chunk;
+			}
+			if (status != YENOERR)
+				break;
+		}
+		if (tee_fds[0] != -1) {
+			close(tee_fds[0]);
+			close(tee_fds[1]);
+		}
+		if (moved || status != YENOERR || !len)
+			return (status);
+	}
+#endif /* __linux__ */
+	for (;;) {
+		len = read(fd, buffer, sizeof(buffer));
+		if (len == -1 && errno == EINTR) {
+			continue;
+		} else if (len == -1) {
+			status = YEPIPE;
+			break;
+		} else if (!len) {
+			break;
+		}
+		if (out_memory)
+			ybin_append(out_memory, buffer, len);
+		if (file_fd != -1 && _yexec_write(file_fd, buffer, (size_t)len) == -1) {
+			status = YEIO;
+			break;
+		}
+		if (out_func)
+			out_func(buffer, (size_t)len, out_data);
+	}
+	return (status);
+}
+/*
+ * _yexec_stdin_write()
+ * Write the standard input of a sub-program. A file is moved to the pipe by
+ * splice() when possible.
+ */
+static ystatus_t _yexec_stdin_write(int fd, void *user_data) {
+	_yexec_stdin_t *input = user_data;
+	char buffer[PIPELINE_BUFFER_SIZE];
+	ystatus_t status = YENOERR;
+	ssize_t len;
+	int file_fd;
+
+	if (input->data)
+		return (_yexec_write(fd, input->data, input->len) ? YEPIPE : YENOERR);
+	if ((file_fd = open(input->file, O_RDONLY | O_CLOEXEC)) == -1)
+		return (YEIO);
+#ifdef __linux__
+	bool moved = false;
+
+	for (;;) {
+		len = splice(file_fd, NULL, fd, NULL, PIPELINE_PIPE_SIZE, SPLICE_F_MOVE | SPLICE_F_MORE);
+		if (len == -1 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			break;
+		moved = true;
+	}
+	// if the file doesn't support splice(), it is copied
+	if (!len || moved || errno != EINVAL) {
+		close(file_fd);
+		return (len ? YEPIPE : YENOERR);
+	}
+#endif /* __linux__ */
+	for (;;) {
+		len = read(file_fd, buffer, sizeof(buffer));
+		if (len == -1 && errno == EINTR)
+			continue;
+		if (len == -1)
+			status = YEIO;
+		else if (len && _yexec_write(fd, buffer, (size_t)len) == -1)
+			status = YEPIPE;
+		if (len <= 0 || status != YENOERR)
+			break;
+	}
+	close(file_fd);
+	return (status);
+}
+/*
+ * Start a sub-program without waiting for its termination. posix_spawn() doesn't
+ * copy the memory mappings of the calling process (unlike fork()), so it stays
+ * fast when the process is big.
+ */
+ystatus_t yexec_spawn(const yexec_cmd_t *cmd, int in_fd, int out_fd, int err_fd, pid_t *pid) {
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attr;
+	sigset_t set;
+	char **arg_list = NULL, **env_list = NULL;
+	char *empty_env[] = {NULL};
+	ystatus_t status = YENOERR;
+
+	if (!cmd || !cmd->command)
+		return (YENOEXEC);
+	arg_list = _yexec_list(cmd->command, cmd->args);
+	if (cmd->env)
+		env_list = _yexec_list(NULL, cmd->env);
+	if (!arg_list || (cmd->env && !env_list)) {
+		status = YENOMEM;
+		goto cleanup;
+	}
+	if (posix_spawn_file_actions_init(&actions)) {
+		status = YENOMEM;
+		goto cleanup;
+	}
+	if (posix_spawnattr_init(&attr)) {
+		posix_spawn_file_actions_destroy(&actions);
+		status = YENOMEM;
+		goto cleanup;
+	}
+	// the sub-program gets a clean signal state (the calling thread may block SIGPIPE)
+	sigemptyset(&set);
+	posix_spawnattr_setsigmask(&attr, &set);
+	sigaddset(&set, SIGPIPE);
+	posix_spawnattr_setsigdefault(&attr, &set);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+	// plug standard streams (the other descriptors are closed on exec)
+	posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, err_fd, STDERR_FILENO);
+	if (posix_spawn(pid, cmd->command, &actions, &attr, arg_list, (env_list ? env_list : empty_env)))
+		status = YENOEXEC;
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&actions);
+cleanup:
+	free0(arg_list);
+	free0(env_list);
+	return (status);
+}
 /* Execute a sub-program and wait for its termination. */
 ystatus_t yexec(const char *command, yarray_t args, yarray_t env,
                 ybin_t *out_memory, const char *out_file) {
 	return yexec_stdin(command, args, env, NULL, NULL, NULL, out_memory, out_file);
 }
 /*
- * Execute a sub-program and wait for its termination.
- * See: https://wiki.sei.cmu.edu/confluence/pages/viewpage.action?pageId=87152177
+ * Execute a sub-program, sending data to its stdin, and wait for its termination.
+ * It is a pipeline of one sub-program, whose input is written by a thread (so
+ * the sub-program can't be blocked on its output while its input is written).
  */
 ystatus_t yexec_stdin(const char *command, yarray_t args, yarray_t env,
                       const char *stdin_str, ybin_t *stdin_bin, const char *stdin_file,
                       ybin_t *out_memory, const char *out_file) {
-	ystatus_t status = YENOERR;
-	pid_t pid;
-	bool has_stdin = false;
-	int pipe_stdin[2], pipe_stdout[2], pipe_stderr[2];
-	FILE *file = NULL;
-	char **arg_list = NULL, **env_list = NULL;
-	size_t i;
+	yexec_cmd_t cmd = {.command = command, .args = args, .env = env};
+	_yexec_stdin_t input = {0};
 
 	if (!command)
 		return (YENOEXEC);
-	// open output file if needed
-	if (out_file && !(file = fopen(out_file, "w"))) {
-		return (YEIO);
-	}
 	// check stdin parameters
-	if (stdin_str && !stdin_str[0])
-		stdin_str = NULL;
-	if (stdin_str) {
-		stdin_bin = NULL;
-		stdin_file = NULL;
-	}
-	if (stdin_bin && ybin_empty(stdin_bin))
-		stdin_bin = NULL;
-	if (stdin_bin)
-		stdin_file = NULL;
-	if (stdin_file && !yfile_is_readable(stdin_file))
-		stdin_file = NULL;
-	if (stdin_str || stdin_bin || stdin_file)
-		has_stdin = true;
-	// create pipes for communication
-	if (pipe(pipe_stdout) == -1 || pipe(pipe_stderr) == -1 ||
-	    (has_stdin && pipe(pipe_stdin) == -1)) {
-		//YLOG_ADD(YLOG_ERR, "Unable to create pipe.");
-		return (YEPIPE);
-	}
-	// manage arguments
-	size_t nbr_args = (args ? yarray_length(args) : 0) + 2;
-	arg_list = malloc0(sizeof(char*) * nbr_args);
-	if (!arg_list) {
+	if (stdin_str && stdin_str[0]) {
+		input.data = stdin_str;
+		input.len = strlen(stdin_str);
+	} else if (stdin_bin && !ybin_empty(stdin_bin)) {
+		input.data = stdin_bin->data;
+		input.len = stdin_bin->bytesize;
+	} else if (stdin_file && yfile_is_readable(stdin_file)) {
+		input.file = stdin_file;
+	}
+	return (yexec_pipeline_input(&cmd, 1, ((input.data || input.file) ? _yexec_stdin_write : NULL), &input,
+	                             out_memory, out_file, NULL, NULL, NULL));
+}
+/* Execute a list of sub-programs connected by pipes, and wait for their termination. */
+ystatus_t yexec_pipeline(const yexec_cmd_t *cmds, size_t nbr_cmds,
+                         ybin_t *out_memory, const char *out_file,
+                         yexec_output_function_t out_func, void *out_data) {
+	return (yexec_pipeline_input(cmds, nbr_cmds, NULL, NULL, out_memory, out_file, out_func, out_data, NULL));
+}
+/* Execute a pipeline of sub-programs, whose input is written by a function. */
+ystatus_t yexec_pipeline_input(const yexec_cmd_t *cmds, size_t nbr_cmds,
+                               yexec_input_function_t in_func, void *in_data,
+                               ybin_t *out_memory, const char *out_file,
+                               yexec_output_function_t out_func, void *out_data, ybin_t *err_memory) {
+	ystatus_t status = YENOERR;
+	pid_t *pids = NULL;
+	size_t nbr_pids = 0;
+	int prev_fd = -1, null_fd = -1, file_fd = -1, err_fd = -1;
+	_yexec_input_t input = {.func = in_func, .data = in_data, .fd = -1, .status = YENOERR};
+	_yexec_error_t error = {.fd = -1, .err = err_memory};
+	bool input_started = false, error_started = false;
+
+	if ((!cmds || !nbr_cmds) && !in_func)
+		return (YENOEXEC);
+	if (out_file && (file_fd = open(out_file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666)) == -1)
+		return (YEIO);
+	if (!(pids = malloc0(sizeof(pid_t) * (nbr_cmds + 1)))) {
 		status = YENOMEM;
 		goto cleanup;
 	}
-	arg_list[0] = (char*)command;
-	i = 0;
-	for (i = 0; args && i < yarray_length(args); ++i) {
-		arg_list[i + 1] = args[i];
-	}
-	arg_list[i + 1] = NULL;
-	// manage environment variables
-	if (env) {
-		size_t nbr_args = yarray_length(env) + 1;
-		env_list = malloc0(sizeof(char*) * nbr_args);
-		for (i = 0; i < yarray_length(env); ++i) {
-			env_list[i] = env[i];
+	if ((null_fd = open("/dev/null", O_RDWR | O_CLOEXEC)) == -1) {
+		status = YEIO;
+		goto cleanup;
+	}
+	// the input function writes into a pipe, read by the first sub-program
+	// (or directly by this function if there is no sub-program)
+	if (in_func) {
+		int pipe_fds[2];
+		if (_yexec_pipe(pipe_fds) == -1) {
+			status = YEPIPE;
+			goto cleanup;
 		}
-		env_list[i] = NULL;
+		prev_fd = pipe_fds[0];
+		input.fd = pipe_fds[1];
 	}
-	// create a sub-process
-	if ((pid = fork()) < 0) {
-		// fork error
-		//YLOG_ADD(YLOG_ERR, "Unable to fork.");
-		status = YENOEXEC;
-		goto cleanup;
-	} else if (!pid) {
-		// child process: execute sub-program
-		if (has_stdin) {
-			while (dup2(pipe_stdin[0], STDIN_FILENO) == -1 && errno == EINTR)
-				;
-			close(pipe_stdin[0]);
-			close(pipe_stdin[1]);
+	// the standard errors of all the sub-programs are written into the same pipe, read by a thread
+	if (err_memory && nbr_cmds) {
+		int pipe_fds[2];
+		if (_yexec_pipe(pipe_fds) == -1) {
+			status = YEPIPE;
+			goto wait;
 		}
-		while (dup2(pipe_stdout[1], STDOUT_FILENO) == -1 && errno == EINTR)
-			;
-		while (dup2(pipe_stderr[1], STDERR_FILENO) == -1 && errno == EINTR)
-			;
-		close(pipe_stdout[0]);
-		close(pipe_stdout[1]);
-		close(pipe_stderr[0]);
-		close(pipe_stderr[1]);
-		close(0);
-		execve(command, arg_list, env_list);
-		exit(127);
-	}
-	/* parent process */
-	// write data to sub-program's stdin
-	if (has_stdin) {
-		close(pipe_stdin[0]);
-		if (stdin_str || stdin_bin) {
-			size_t stdin_data_len = stdin_str ? strlen(stdin_str) : stdin_bin->bytesize;
-			size_t written = 0;
-			while (written < stdin_data_len) {
-				const void *ptr = (stdin_str ? stdin_str : stdin_bin->data) + written;
-				ssize_t result = write(pipe_stdin[1], ptr, stdin_data_len - written);
-				if (result == -1) {
-					if (errno == EINTR)
-						continue;
-					break;
-				}
-				written += result;
-			}
-			close(pipe_stdin[1]);
-		} else {
-			int fd = open(stdin_file, O_RDONLY);
-			if (fd) {
-				char buffer[READ_BUFFER_SIZE];
-				ssize_t read_size;
-				while ((read_size = read(fd, buffer, sizeof(buffer))) > 0) {
-					size_t written = 0;
-					while (written < sizeof(buffer)) {
-						void *ptr = buffer + written;
-						ssize_t result = write(pipe_stdin[1], ptr, sizeof(buffer) - written);
-						if (result == -1) {
-							if (errno == EINTR)
-								continue;
-							break;
-						}
-						written += result;
-					}
-				}
-				close(pipe_stdin[1]);
-				close(fd);
-			}
+		error.fd = pipe_fds[0];
+		err_fd = pipe_fds[1];
+		if (pthread_create(&error.thread, NULL, _yexec_error_thread, &error)) {
+			status = YENOEXEC;
+			goto wait;
 		}
+		error_started = true;
 	}
-	// get child output
-	if (out_memory || out_file) {
-		close(pipe_stdout[1]);
-		//close(pipe_stderr[1]);
-		char buffer[4096];
-		for (;;) {
-			ssize_t len = read(pipe_stdout[0], buffer, sizeof(buffer));
-			if (len == -1 && errno == EINTR) {
-				continue;
-			} else if (len == -1) {
-				status = YEPIPE;
-				break;
-			} else if (!len) {
-				break;
-			} else {
-				if (out_memory)
-					ybin_append(out_memory, buffer, len);
-				if (out_file)
-					fwrite(buffer, 1, len, file);
+	// create sub-processes
+	for (size_t i = 0; i < nbr_cmds; ++i) {
+		bool last = (i == nbr_cmds - 1);
+		int pipe_fds[2] = {-1, -1};
+		pid_t pid;
+
+		// the output of the last sub-program is read only if needed
+		if ((!last || out_memory || out_file || out_func) && _yexec_pipe(pipe_fds) == -1) {
+			status = YEPIPE;
+			goto wait;
+		}
+#ifdef __linux__
+		// a bigger pipe means fewer context switches and bigger splice() moves
+		if (last && pipe_fds[0] != -1)
+			fcntl(pipe_fds[0], F_SETPIPE_SZ, PIPELINE_PIPE_SIZE);
+#endif /* __linux__ */
+		status = yexec_spawn(&cmds[i], ((prev_fd != -1) ? prev_fd : null_fd),
+		                     ((pipe_fds[1] != -1) ? pipe_fds[1] : null_fd),
+		                     ((err_fd != -1) ? err_fd : null_fd), &pid);
+		if (status != YENOERR) {
+			if (pipe_fds[0] != -1) {
+				close(pipe_fds[0]);
+				close(pipe_fds[1]);
 			}
+			goto wait;
+		}
+		pids[nbr_pids++] = pid;
+		if (prev_fd != -1)
+			close(prev_fd);
+		if (pipe_fds[1] != -1)
+			close(pipe_fds[1]);
+		prev_fd = pipe_fds[0];
+	}
+	// the writing end of the errors' pipe is only held by the sub-programs
+	if (err_fd != -1) {
+		close(err_fd);
+		err_fd = -1;
+	}
+	// start the writing of the input (after the sub-programs' creation, so the
+	// writing end of the pipe is only held by the writing thread)
+	if (in_func) {
+		if (pthread_create(&input.thread, NULL, _yexec_input_thread, &input)) {
+			close(input.fd);
+			input.fd = -1;
+			status = YENOEXEC;
+			goto wait;
 		}
-		close(pipe_stdout[0]);
-		close(pipe_stderr[0]);
-	}
-	// wait for child termination
-	int exec_status = 0;
-	int res = waitpid(pid, &exec_status, 0);
-	if (res == -1 || !WIFEXITED(exec_status) || WEXITSTATUS(exec_status) ||
-	    WIFSIGNALED(exec_status)) {
-		//YLOG_ADD(YLOG_WARN, "Unexpected end of process '%s' (%d).", command,
-		//         WEXITSTATUS(exec_status));
-		status = YEFAULT;
+		input_started = true;
 	}
+	// get the output of the last sub-program
+	if (prev_fd != -1)
+		status = _yexec_relay(prev_fd, out_memory, file_fd, out_func, out_data);
+wait:
+	// close the remaining pipe, so a running sub-program can't block on it
+	if (prev_fd != -1) {
+		close(prev_fd);
+		prev_fd = -1;
+	}
+	if (err_fd != -1)
+		close(err_fd);
+	// wait for the end of the input
+	if (input_started) {
+		pthread_join(input.thread, NULL);
+		if (input.status != YENOERR && status == YENOERR)
+			status = input.status;
+	} else if (input.fd != -1) {
+		close(input.fd);
+	}
+	// wait for sub-processes termination
+	for (size_t i = 0; i < nbr_pids; ++i) {
+		int exec_status = 0;
+		int res;
+		while ((res = waitpid(pids[i], &exec_status, 0)) == -1 && errno == EINTR)
+			;
+		if (res == -1 || !WIFEXITED(exec_status) || WEXITSTATUS(exec_status)) {
+			if (status == YENOERR)
+				status = YEFAULT;
+		}
+	}
+	// the standard errors are complete once all the sub-programs are terminated
+	if (error_started)
+		pthread_join(error.thread, NULL);
+	if (error.fd != -1)
+		close(error.fd);
 cleanup:
-	if (file)
-		fclose(file);
-	free0(arg_list);
-	free0(env_list);
+	if (null_fd != -1)
+		close(null_fd);
+	if (file_fd != -1)
+		close(file_fd);
+	free0(pids);
 	return (status);
 }
 
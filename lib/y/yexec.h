@@ -1,6 +1,18 @@
 /**
  * @header	utils_exec.h
  * @abstract	Execution of external programs.
+ * @discussion	Sub-programs are connected by plain pipes. On Linux, the
+ *		output written to a file is moved from the last pipe to the
+ *		file with splice(), without being copied through the agent's
+ *		memory; if a function (e.g. a hash computation) also needs the
+ *		data, the pipe is duplicated with tee(), so only the function's
+ *		copy goes through user space. A file given as standard input
+ *		is moved to the pipe the same way.
+ *
+ *		The standard errors of a pipeline's sub-programs are discarded,
+ *		unless they are requested: they are then read by a thread (so
+ *		a sub-program can't be blocked on them), and their beginning is
+ *		kept in memory.
  * @author	Amaury Bouchard <amaury@amaury.net>
  */
 #pragma once
@@ -12,12 +24,60 @@
 #include <sys/wait.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <pthread.h>
 #include "ymemory.h"
 #include "yarray.h"
 #include "ystatus.h"
 #include "ybin.h"
 #include "yfile.h"
 
+/** @const YEXEC_STDERR_MAX	Maximum size of the kept standard errors of a pipeline. */
+#define YEXEC_STDERR_MAX	65536
+
+/**
+ * @typedef	yexec_cmd_t
+ * @abstract	Definition of a sub-program in a pipeline.
+ * @field	command	Path to the sub-program to execute.
+ * @field	args	List of arguments.
+ * @field	env	List of environment variables.
+ */
+typedef struct {
+	const char *command;
+	yarray_t args;
+	yarray_t env;
+} yexec_cmd_t;
+/**
+ * @typedef	yexec_output_function_t
+ * @abstract	Function called with each chunk of data read from a sub-program's output.
+ * @param	data		Pointer to the data.
+ * @param	len		Size of the data.
+ * @param	user_data	Pointer to user data.
+ */
+typedef void (*yexec_output_function_t)(const void *data, size_t len, void *user_data);
+/**
+ * @typedef	yexec_input_function_t
+ * @abstract	Function writing the input of a pipeline. It is executed by a
+ *		dedicated thread; the file descriptor is closed when it returns.
+ * @param	fd		File descriptor to write to.
+ * @param	user_data	Pointer to user data.
+ * @return	YENOERR if all the data were written.
+ */
+typedef ystatus_t (*yexec_input_function_t)(int fd, void *user_data);
+
+/**
+ * @function	yexec_spawn
+ * @abstract	Start a sub-program, without waiting for its termination. It is
+ *		created by posix_spawn(), which is fast even if the calling process
+ *		uses a lot of memory. The file descriptors which are not plugged on
+ *		its standard streams must be closed on exec.
+ * @param	cmd	Pointer to the command.
+ * @param	in_fd	File descriptor plugged on the standard input.
+ * @param	out_fd	File descriptor plugged on the standard output.
+ * @param	err_fd	File descriptor plugged on the standard error.
+ * @param	pid	Pointer to a variable set with the sub-program's process identifier.
+ * @return	YENOERR if OK, YENOEXEC if the sub-program couldn't be executed.
+ */
+ystatus_t yexec_spawn(const yexec_cmd_t *cmd, int in_fd, int out_fd, int err_fd, pid_t *pid);
 /**
  * @function	yexec
  * @abstract	Execute a sub-program and wait for its termination.
@@ -36,6 +96,7 @@ ystatus_t yexec(const char *command, yarray_t args, yarray_t env,
 /**
  * @function	yexec_stdin
  * @abstract	Execute a sub-program, sending data to its stdin, and wait for its termination.
+ *		The input is written by a dedicated thread; standard error is discarded.
  * @param	command		Path to the sub-program to execute.
  * @param	args		List of arguments.
  * @param	env		List of environment variables.
@@ -55,4 +116,48 @@ ystatus_t yexec(const char *command, yarray_t args, yarray_t env,
 ystatus_t yexec_stdin(const char *command, yarray_t args, yarray_t env,
                       const char *stdin_str, ybin_t *stdin_bin, const char *stdin_file,
                       ybin_t *out_memory, const char *out_file);
+/**
+ * @function	yexec_pipeline
+ * @abstract	Execute a list of sub-programs, the standard output of each one
+ *		connected to the standard input of the next one, and wait for their
+ *		termination. Standard errors are discarded.
+ * @param	cmds		Array of commands.
+ * @param	nbr_cmds	Number of commands in the array.
+ * @param	out_memory	Pointer to a ybin_t that will be filled with the
+ *				standard output of the last sub-program. The string
+ *				is allocated, thus must be freed. Could be set to NULL.
+ * @param	out_file	Path to a file where the standard output of the last
+ *				sub-program will be written (moved with splice() when
+ *				possible). Could be null.
+ * @param	out_func	Function called with each chunk of the standard output
+ *				of the last sub-program. Could be null.
+ * @param	out_data	Pointer given to the out_func function.
+ * @return	YENOERR if all sub-programs exited successfully.
+ */
+ystatus_t yexec_pipeline(const yexec_cmd_t *cmds, size_t nbr_cmds,
+                         ybin_t *out_memory, const char *out_file,
+                         yexec_output_function_t out_func, void *out_data);
+/**
+ * @function	yexec_pipeline_input
+ * @abstract	Same as yexec_pipeline(), but the standard input of the first
+ *		sub-program is written by a function. If there is no sub-program,
+ *		the data written by the function are directly given to the outputs.
+ * @param	cmds		Array of commands. Could be null if nbr_cmds is 0.
+ * @param	nbr_cmds	Number of commands in the array.
+ * @param	in_func		Function writing the input. Could be null.
+ * @param	in_data		Pointer given to the in_func function.
+ * @param	out_memory	Pointer to a ybin_t filled with the output. Could be null.
+ * @param	out_file	Path to a file where the output will be written. Could be null.
+ * @param	out_func	Function called with each chunk of the output. Could be null.
+ * @param	out_data	Pointer given to the out_func function.
+ * @param	err_memory	Pointer to a ybin_t filled with the beginning of the
+ *				standard errors of all the sub-programs (up to
+ *				YEXEC_STDERR_MAX bytes). The data is allocated, thus must
+ *				be freed. Could be null (the standard errors are discarded).
+ * @return	YENOERR if the input function and all sub-programs succeeded.
+ */
+ystatus_t yexec_pipeline_input(const yexec_cmd_t *cmds, size_t nbr_cmds,
+                               yexec_input_function_t in_func, void *in_data,
+                               ybin_t *out_memory, const char *out_file,
+                               yexec_output_function_t out_func, void *out_data, ybin_t *err_memory);
 
@@ -174,7 +174,8 @@ ystr_t yfile_get_string_contents(const char *path) {
 	char buffer[65535];
 	size_t read_size;
 	while ((read_size = fread(buffer, 1, 65535, file))) {
-		if (ys_append(&ys, buffer) != YENOERR) {
+		if (ys_nappend(&ys, buffer, read_size) != YENOERR) {
+			fclose(file);
 			ys_free(ys);
 			return (NULL);
 		}
@@ -1,3 +1,7 @@
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 #include "yhash.h"
 
 /*
@@ -12,3 +16,230 @@ yhash_value_t yhash_compute(const char *key) {
 	return (hash_value);
 }
 
+
+/* ********** SHA-512 ********** */
+
+/** @const _YHASH_SHA512_K	Round constants. */
+static const uint64_t _YHASH_SHA512_K[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+	0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+	0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+	0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+	0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+	0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+	0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+	0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+	0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+	0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+	0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+	0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+/* 64-bit right rotation. */
+#define _YHASH_ROTR64(x, n)	(((x) >> (n)) | ((x) << (64 - (n))))
+/* SHA-512 functions. */
+#define _YHASH_CH(x, y, z)	(((x) & ((y) ^ (z))) ^ (z))
+#define _YHASH_MAJ(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+#define _YHASH_S0(x)		(_YHASH_ROTR64(x, 28) ^ _YHASH_ROTR64(x, 34) ^ _YHASH_ROTR64(x, 39))
+#define _YHASH_S1(x)		(_YHASH_ROTR64(x, 14) ^ _YHASH_ROTR64(x, 18) ^ _YHASH_ROTR64(x, 41))
+#define _YHASH_G0(x)		(_YHASH_ROTR64(x, 1) ^ _YHASH_ROTR64(x, 8) ^ ((x) >> 7))
+#define _YHASH_G1(x)		(_YHASH_ROTR64(x, 19) ^ _YHASH_ROTR64(x, 61) ^ ((x) >> 6))
+/* One round. Variables are not moved, their roles are rotated between rounds. */
+#define _YHASH_ROUND(a, b, c, d, e, f, g, h, i) do { \
+		uint64_t _t1 = h + _YHASH_S1(e) + _YHASH_CH(e, f, g) + _YHASH_SHA512_K[i] + w[(i) & 15]; \
+		uint64_t _t2 = _YHASH_S0(a) + _YHASH_MAJ(a, b, c); \
+		d += _t1; \
+		h = _t1 + _t2; \
+	} while (0)
+/* Compute the next word of the message schedule, in a 16-words circular buffer. */
+#define _YHASH_SCHEDULE(i)	(w[(i) & 15] += _YHASH_G1(w[((i) - 2) & 15]) + w[((i) - 7) & 15] + _YHASH_G0(w[((i) - 15) & 15]))
+/* Eight rounds, the message schedule being computed if needed. */
+#define _YHASH_8ROUNDS(i) do { \
+		if ((i) >= 16) { \
+			_YHASH_SCHEDULE(i); _YHASH_SCHEDULE((i) + 1); _YHASH_SCHEDULE((i) + 2); _YHASH_SCHEDULE((i) + 3); \
+			_YHASH_SCHEDULE((i) + 4); _YHASH_SCHEDULE((i) + 5); _YHASH_SCHEDULE((i) + 6); _YHASH_SCHEDULE((i) + 7); \
+		} \
+		_YHASH_ROUND(a, b, c, d, e, f, g, h, (i)); \
+		_YHASH_ROUND(h, a, b, c, d, e, f, g, (i) + 1); \
+		_YHASH_ROUND(g, h, a, b, c, d, e, f, (i) + 2); \
+		_YHASH_ROUND(f, g, h, a, b, c, d, e, (i) + 3); \
+		_YHASH_ROUND(e, f, g, h, a, b, c, d, (i) + 4); \
+		_YHASH_ROUND(d, e, f, g, h, a, b, c, (i) + 5); \
+		_YHASH_ROUND(c, d, e, f, g, h, a, b, (i) + 6); \
+		_YHASH_ROUND(b, c, d, e, f, g, h, a, (i) + 7); \
+	} while (0)
+
+/* Read a big-endian 64-bits integer (compilers generate a single load and byte swap). */
+static inline uint64_t _yhash_load64(const uint8_t *p) {
+	return (((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) | ((uint64_t)p[2] << 40) |
+	        ((uint64_t)p[3] << 32) | ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) |
+	        ((uint64_t)p[6] << 8) | (uint64_t)p[7]);
+}
+/* Write a big-endian 64-bits integer. */
+static inline void _yhash_store64(uint8_t *p, uint64_t v) {
+	for (int i = 7; i >= 0; --i) {
+		p[i] = (uint8_t)v;
+		v >>= 8;
+	}
+}
+/*
+ * _yhash_sha512_blocks()
+ * Hash a list of complete 128-bytes blocks. The message schedule is computed
+ * on the fly in a 16-words circular buffer, and the 80 rounds are fully
+ * unrolled so the working variables stay in registers.
+ */
+static void _yhash_sha512_blocks(uint64_t state[8], const uint8_t *data, size_t nbr_blocks) {
+	uint64_t w[16];
+
+	for (; nbr_blocks; --nbr_blocks, data += YHASH_SHA512_BLOCK_SIZE) {
+		uint64_t a = state[0], b = state[1], c = state[2], d = state[3];
+		uint64_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+		for (int i = 0; i < 16; ++i)
+			w[i] = _yhash_load64(data + i * 8);
+		_YHASH_8ROUNDS(0);
+		_YHASH_8ROUNDS(8);
+		_YHASH_8ROUNDS(16);
+		_YHASH_8ROUNDS(24);
+		_YHASH_8ROUNDS(32);
+		_YHASH_8ROUNDS(40);
+		_YHASH_8ROUNDS(48);
+		_YHASH_8ROUNDS(56);
+		_YHASH_8ROUNDS(64);
+		_YHASH_8ROUNDS(72);
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+	}
+}
+/*
+ * yhash_sha512_init()
+ * Initialize a SHA-512 computation.
+ */
+void yhash_sha512_init(yhash_sha512_t *ctx) {
+	static const uint64_t init_state[8] = {
+		0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+		0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+	};
+
+	memcpy(ctx->state, init_state, sizeof(init_state));
+	ctx->length = 0;
+	ctx->buffer_len = 0;
+}
+/*
+ * yhash_sha512_update()
+ * Add data to a SHA-512 computation.
+ */
+void yhash_sha512_update(yhash_sha512_t *ctx, const void *data, size_t len) {
+	const uint8_t *ptr = data;
+
+	ctx->length += len;
+	// complete the pending block
+	if (ctx->buffer_len) {
+		size_t chunk = YHASH_SHA512_BLOCK_SIZE - ctx->buffer_len;
+		if (chunk > len)
+			chunk = len;
+		memcpy(ctx->buffer + ctx->buffer_len, ptr, chunk);
+		ctx->buffer_len += chunk;
+		ptr += chunk;
+		len -= chunk;
+		if (ctx->buffer_len < YHASH_SHA512_BLOCK_SIZE)
+			return;
+		_yhash_sha512_blocks(ctx->state, ctx->buffer, 1);
+		ctx->buffer_len = 0;
+	}
+	// hash complete blocks directly
+	if (len >= YHASH_SHA512_BLOCK_SIZE) {
+		size_t nbr_blocks = len / YHASH_SHA512_BLOCK_SIZE;
+		_yhash_sha512_blocks(ctx->state, ptr, nbr_blocks);
+		ptr += nbr_blocks * YHASH_SHA512_BLOCK_SIZE;
+		len -= nbr_blocks * YHASH_SHA512_BLOCK_SIZE;
+	}
+	// keep the remaining data
+	if (len) {
+		memcpy(ctx->buffer, ptr, len);
+		ctx->buffer_len = len;
+	}
+}
+/*
+ * yhash_sha512_update_multi()
+ * Add several buffers to a SHA-512 computation.
+ */
+void yhash_sha512_update_multi(yhash_sha512_t *ctx, const yhash_buffer_t *buffers, size_t nbr_buffers) {
+	for (size_t i = 0; i < nbr_buffers; ++i)
+		yhash_sha512_update(ctx, buffers[i].data, buffers[i].len);
+}
+/*
+ * yhash_sha512_final()
+ * End a SHA-512 computation.
+ */
+void yhash_sha512_final(yhash_sha512_t *ctx, uint8_t digest[YHASH_SHA512_SIZE]) {
+	// padding: 0x80, zeros, and the 128-bits length in bits
+	ctx->buffer[ctx->buffer_len++] = 0x80;
+	if (ctx->buffer_len > YHASH_SHA512_BLOCK_SIZE - 16) {
+		memset(ctx->buffer + ctx->buffer_len, 0, YHASH_SHA512_BLOCK_SIZE - ctx->buffer_len);
+		_yhash_sha512_blocks(ctx->state, ctx->buffer, 1);
+		ctx->buffer_len = 0;
+	}
+	memset(ctx->buffer + ctx->buffer_len, 0, YHASH_SHA512_BLOCK_SIZE - 16 - ctx->buffer_len);
+	_yhash_store64(ctx->buffer + YHASH_SHA512_BLOCK_SIZE - 16, ctx->length >> 61);
+	_yhash_store64(ctx->buffer + YHASH_SHA512_BLOCK_SIZE - 8, ctx->length << 3);
+	_yhash_sha512_blocks(ctx->state, ctx->buffer, 1);
+	for (int i = 0; i < 8; ++i)
+		_yhash_store64(digest + i * 8, ctx->state[i]);
+	// clear the context
+	memset(ctx, 0, sizeof(yhash_sha512_t));
+}
+/*
+ * yhash_sha512_hex()
+ * Write the hexadecimal representation of a SHA-512 digest.
+ */
+void yhash_sha512_hex(const uint8_t digest[YHASH_SHA512_SIZE], char hex[YHASH_SHA512_HEX_SIZE + 1]) {
+	static const char *hex_chars = "0123456789abcdef";
+
+	for (int i = 0; i < YHASH_SHA512_SIZE; ++i) {
+		hex[i * 2] = hex_chars[digest[i] >> 4];
+		hex[i * 2 + 1] = hex_chars[digest[i] & 0x0f];
+	}
+	hex[YHASH_SHA512_HEX_SIZE] = '\0';
+}
+/*
+ * yhash_sha512_file()
+ * Compute the SHA-512 digest of a file's content.
+ */
+ystatus_t yhash_sha512_file(const char *path, uint8_t digest[YHASH_SHA512_SIZE]) {
+	yhash_sha512_t ctx;
+	uint8_t buffer[65536];
+	ssize_t len;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return (YEACCES);
+	yhash_sha512_init(&ctx);
+	for (; ; ) {
+		len = read(fd, buffer, sizeof(buffer));
+		if (len == -1 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			break;
+		yhash_sha512_update(&ctx, buffer, (size_t)len);
+	}
+	close(fd);
+	if (len == -1)
+		return (YEIO);
+	yhash_sha512_final(&ctx, digest);
+	return (YENOERR);
+}
@@ -31,6 +31,39 @@ extern "C" {
 /** @typedef yhash_value_t	Type of a hash result. */
 typedef uint32_t yhash_value_t;
 
+/** @const YHASH_SHA512_SIZE		Size of a SHA-512 digest, in bytes. */
+#define YHASH_SHA512_SIZE		64
+/** @const YHASH_SHA512_HEX_SIZE	Size of the hexadecimal representation of a SHA-512 digest. */
+#define YHASH_SHA512_HEX_SIZE		128
+/** @const YHASH_SHA512_BLOCK_SIZE	Size of a SHA-512 block, in bytes. */
+#define YHASH_SHA512_BLOCK_SIZE		128
+
+/**
+ * @typedef	yhash_sha512_t
+ *		Context of an incremental SHA-512 computation.
+ * @field	state		Intermediate hash state.
+ * @field	length		Number of bytes already hashed.
+ * @field	buffer		Pending data (incomplete block).
+ * @field	buffer_len	Number of bytes in the buffer.
+ */
+typedef struct {
+	uint64_t state[8];
+	uint64_t length;
+	uint8_t buffer[YHASH_SHA512_BLOCK_SIZE];
+	size_t buffer_len;
+} yhash_sha512_t;
+
+/**
+ * @typedef	yhash_buffer_t
+ *		Buffer given to yhash_sha512_update_multi().
+ * @field	data	Pointer to the data.
+ * @field	len	Size of the data.
+ */
+typedef struct {
+	const void *data;
+	size_t len;
+} yhash_buffer_t;
+
 /**
  * @function	yhash_compute
  *		Compute the hash value of a string, using the SDBM algorithm.
@@ -40,6 +73,53 @@ typedef uint32_t yhash_value_t;
  * @return	The computed hash value.
  */
 yhash_value_t yhash_compute(const char *key);
+/**
+ * @function	yhash_sha512_init
+ *		Initialize a SHA-512 computation.
+ * @param	ctx	Pointer to the context.
+ */
+void yhash_sha512_init(yhash_sha512_t *ctx);
+/**
+ * @function	yhash_sha512_update
+ *		Add data to a SHA-512 computation. Complete blocks are hashed
+ *		directly from the given memory, without copy.
+ * @param	ctx	Pointer to the context.
+ * @param	data	Pointer to the data.
+ * @param	len	Size of the data.
+ */
+void yhash_sha512_update(yhash_sha512_t *ctx, const void *data, size_t len);
+/**
+ * @function	yhash_sha512_update_multi
+ *		Add several buffers to a SHA-512 computation, as if they were
+ *		contiguous.
+ * @param	ctx		Pointer to the context.
+ * @param	buffers		Array of buffers.
+ * @param	nbr_buffers	Number of buffers.
+ */
+void yhash_sha512_update_multi(yhash_sha512_t *ctx, const yhash_buffer_t *buffers, size_t nbr_buffers);
+/**
+ * @function	yhash_sha512_final
+ *		End a SHA-512 computation.
+ * @param	ctx	Pointer to the context.
+ * @param	digest	Pointer to a buffer where the 64 bytes of the digest will be written.
+ */
+void yhash_sha512_final(yhash_sha512_t *ctx, uint8_t digest[YHASH_SHA512_SIZE]);
+/**
+ * @function	yhash_sha512_hex
+ *		Write the hexadecimal representation of a SHA-512 digest, as
+ *		written by the sha512sum program.
+ * @param	digest	Pointer to the digest.
+ * @param	hex	Pointer to a buffer of 129 bytes. A null character is added.
+ */
+void yhash_sha512_hex(const uint8_t digest[YHASH_SHA512_SIZE], char hex[YHASH_SHA512_HEX_SIZE + 1]);
+/**
+ * @function	yhash_sha512_file
+ *		Compute the SHA-512 digest of a file's content.
+ * @param	path	Path to the file.
+ * @param	digest	Pointer to a buffer where the 64 bytes of the digest will be written.
+ * @return	YENOERR if OK, YEACCES if the file can't be opened, YEIO if a read error occurred.
+ */
+ystatus_t yhash_sha512_file(const char *path, uint8_t digest[YHASH_SHA512_SIZE]);
 
 #if defined(__cplusplus) || defined(c_plusplus)
 }
@@ -0,0 +1,100 @@
+#include "ypool.h"
+
+/**
+ * @typedef	_ypool_t
+ * @abstract	Shared state of a running pool.
+ * @field	mutex		Mutex protecting the other fields.
+ * @field	nbr_jobs	Number of jobs.
+ * @field	next_job	Index of the next job to process.
+ * @field	next_done	Index of the next job to give to the completion function.
+ * @field	finished	Array of flags, set when a job is finished.
+ * @field	job_func	Function called to process a job.
+ * @field	done_func	Function called when a job is completed.
+ * @field	user_data	Pointer to user data.
+ */
+typedef struct {
+	pthread_mutex_t mutex;
+	size_t nbr_jobs;
+	size_t next_job;
+	size_t next_done;
+	bool *finished;
+	ypool_function_t job_func;
+	ypool_function_t done_func;
+	void *user_data;
+} _ypool_t;
+
+/* Worker loop: process jobs until there is no more job to process. */
+static void *_ypool_worker(void *data) {
+	_ypool_t *pool = data;
+
+	for (; ; ) {
+		size_t index;
+
+		// get the next job
+		pthread_mutex_lock(&pool->mutex);
+		if (pool->next_job >= pool->nbr_jobs) {
+			pthread_mutex_unlock(&pool->mutex);
+			break;
+		}
+		index = pool->next_job++;
+		pthread_mutex_unlock(&pool->mutex);
+		// process it
+		pool->job_func(index, pool->user_data);
+		// call the completion function for all finished jobs, in order
+		pthread_mutex_lock(&pool->mutex);
+		pool->finished[index] = true;
+		while (pool->next_done < pool->nbr_jobs && pool->finished[pool->next_done]) {
+			if (pool->done_func)
+				pool->done_func(pool->next_done, pool->user_data);
+			pool->next_done++;
+		}
+		pthread_mutex_unlock(&pool->mutex);
+	}
+	return (NULL);
+}
+/* Process a list of jobs using a bounded number of threads. */
+ystatus_t ypool_run(size_t nbr_jobs, size_t nbr_threads, ypool_function_t job_func,
+                    ypool_function_t done_func, void *user_data) {
+	pthread_t *threads = NULL;
+	size_t nbr_started = 0;
+	_ypool_t pool = {
+		.nbr_jobs = nbr_jobs,
+		.job_func = job_func,
+		.done_func = done_func,
+		.user_data = user_data,
+	};
+
+	if (!job_func)
+		return (YEINVAL);
+	if (!nbr_jobs)
+		return (YENOERR);
+	if (nbr_threads > nbr_jobs)
+		nbr_threads = nbr_jobs;
+	// sequential processing (also used if memory allocation failed)
+	if (nbr_threads < 2 || !(pool.finished = calloc0(nbr_jobs, sizeof(bool)))) {
+		for (size_t i = 0; i < nbr_jobs; ++i) {
+			job_func(i, user_data);
+			if (done_func)
+				done_func(i, user_data);
+		}
+		return (YENOERR);
+	}
+	pthread_mutex_init(&pool.mutex, NULL);
+	// start threads (the current thread is one of the workers)
+	if ((threads = malloc0(sizeof(pthread_t) * (nbr_threads - 1)))) {
+		for (size_t i = 0; i < nbr_threads - 1; ++i) {
+			if (pthread_create(&threads[nbr_started], NULL, _ypool_worker, &pool))
+				break;
+			nbr_started++;
+		}
+	}
+	_ypool_worker(&pool);
+	// wait for threads termination
+	for (size_t i = 0; i < nbr_started; ++i)
+		pthread_join(threads[i], NULL);
+	pthread_mutex_destroy(&pool.mutex);
+	free0(threads);
+	free0(pool.finished);
+	return (YENOERR);
+}
+
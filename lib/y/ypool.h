@@ -0,0 +1,49 @@
+/**
+ * @header	ypool.h
+ * @abstract	Bounded pool of worker threads.
+ * @discussion	A given number of jobs are processed by a bounded number of
+ *		threads. Each job is identified by its index. An optional
+ *		completion function is called for each job, in the order of the
+ *		jobs' indexes, whatever the order in which they ended.
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ */
+#pragma once
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif /* __cplusplus || c_plusplus */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "ystatus.h"
+#include "ymemory.h"
+
+/**
+ * @typedef	ypool_function_t
+ * @abstract	Function called to process a job, or when a job is completed.
+ * @param	index		Index of the job.
+ * @param	user_data	Pointer to user data.
+ */
+typedef void (*ypool_function_t)(size_t index, void *user_data);
+
+/**
+ * @function	ypool_run
+ * @abstract	Process a list of jobs using a bounded number of threads, and
+ *		wait for their termination. The calling thread processes jobs too.
+ * @param	nbr_jobs	Number of jobs to process.
+ * @param	nbr_threads	Maximum number of concurrent jobs. If it is lower
+ *				than 2, the jobs are processed sequentially.
+ * @param	job_func	Function called to process each job.
+ * @param	done_func	Function called when a job is completed. Calls are
+ *				serialized and done in the jobs' order. Could be NULL.
+ * @param	user_data	Pointer to user data, given to the functions.
+ * @return	YENOERR if OK, YEINVAL if a parameter is invalid.
+ */
+ystatus_t ypool_run(size_t nbr_jobs, size_t nbr_threads, ypool_function_t job_func,
+                    ypool_function_t done_func, void *user_data);
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}
+#endif /* __cplusplus || c_plusplus */
+
@@ -0,0 +1,391 @@
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/wait.h>
+#ifdef __linux__
+# include <sys/epoll.h>
+# include <sys/syscall.h>
+#endif /* __linux__ */
+#include "ymemory.h"
+#include "yproc.h"
+
+/** @const Size of the buffer used to read the outputs of the sub-programs. */
+#define YPROC_BUFFER_SIZE	65536
+/** @const Delay between two checks of the terminations, when they can't be watched (in ms). */
+#define YPROC_CHECK_DELAY	10
+/** @const Maximum number of events read at once. */
+#define YPROC_MAX_EVENTS	64
+
+/** @const Sources of events: standard output, standard error, termination. */
+enum {
+	_YPROC_OUT = 0,
+	_YPROC_ERR,
+	_YPROC_PID
+};
+
+/**
+ * @typedef	_yproc_child_t
+ *		Running sub-program.
+ * @field	index		Index of the command.
+ * @field	pid		Process identifier (0 if the slot is free).
+ * @field	pidfd		File descriptor of the process (-1 if not used).
+ * @field	fds		Reading ends of the standard output and error pipes
+ *				(-1 once closed).
+ * @field	exited		True if the sub-program was reaped.
+ * @field	wait_status	Status returned by waitpid().
+ * @field	out		Standard output.
+ * @field	err		Standard error.
+ */
+typedef struct {
+	size_t index;
+	pid_t pid;
+	int pidfd;
+	int fds[2];
+	bool exited;
+	int wait_status;
+	ybin_t out;
+	ybin_t err;
+} _yproc_child_t;
+/**
+ * @typedef	_yproc_t
+ *		State of a running list of sub-programs.
+ * @field	cmds		Array of commands.
+ * @field	nbr_cmds	Number of commands.
+ * @field	next_cmd	Index of the next command to start.
+ * @field	children	Array of slots.
+ * @field	nbr_slots	Number of slots.
+ * @field	nbr_running	Number of used slots.
+ * @field	keep_output	True if the standard outputs are kept.
+ * @field	null_fd		File descriptor on /dev/null.
+ * @field	epoll_fd	Epoll instance (-1 if not used).
+ * @field	status		Global status.
+ * @field	done_func	Function called when a sub-program is terminated.
+ * @field	user_data	Pointer given to the function.
+ * @field	buffer		Reading buffer.
+ */
+typedef struct {
+	const yexec_cmd_t *cmds;
+	size_t nbr_cmds;
+	size_t next_cmd;
+	_yproc_child_t *children;
+	size_t nbr_slots;
+	size_t nbr_running;
+	bool keep_output;
+	int null_fd;
+	int epoll_fd;
+	ystatus_t status;
+	yproc_done_function_t done_func;
+	void *user_data;
+	char buffer[YPROC_BUFFER_SIZE];
+} _yproc_t;
+
+/*
+ * _yproc_pipe()
+ * Create a pipe which file descriptors are closed on exec, and which reading
+ * end is non-blocking.
+ */
+static int _yproc_pipe(int fds[2]) {
+#ifdef __linux__
+	if (pipe2(fds, O_CLOEXEC) == -1)
+		return (-1);
+#else /* __linux__ */
+	if (pipe(fds) == -1)
+		return (-1);
+	if (fcntl(fds[0], F_SETFD, FD_CLOEXEC) == -1 ||
+	    fcntl(fds[1], F_SETFD, FD_CLOEXEC) == -1) {
+		close(fds[0]);
+		close(fds[1]);
+		return (-1);
+	}
+#endif /* __linux__ */
+	if (fcntl(fds[0], F_SETFL, O_NONBLOCK) == -1) {
+		close(fds[0]);
+		close(fds[1]);
+		return (-1);
+	}
+	return (0);
+}
+#ifdef __linux__
+/*
+ * _yproc_watch()
+ * Add a file descriptor to the epoll instance. The event's data identify the
+ * slot and the source.
+ */
+static int _yproc_watch(_yproc_t *proc, int fd, size_t slot, int source) {
+	struct epoll_event event = {
+		.events = EPOLLIN,
+		.data.u64 = ((uint64_t)slot << 2) | (uint64_t)source,
+	};
+
+	return (epoll_ctl(proc->epoll_fd, EPOLL_CTL_ADD, fd, &event));
+}
+#endif /* __linux__ */
+/*
+ * _yproc_close()
+ * Remove a file descriptor from the epoll instance, and close it.
+ */
+static void _yproc_close(_yproc_t *proc, int *fd) {
+	if (*fd == -1)
+		return;
+#ifdef __linux__
+	epoll_ctl(proc->epoll_fd, EPOLL_CTL_DEL, *fd, NULL);
+#endif /* __linux__ */
+	close(*fd);
+	*fd = -1;
+}
+/*
+ * _yproc_finish()
+ * Give the result of a terminated sub-program to the completion function, and
+ * free its slot.
+ */
+static void _yproc_finish(_yproc_t *proc, _yproc_child_t *child, ystatus_t status) {
+	int exit_code = -1;
+
+	if (status == YENOERR) {
+		if (WIFEXITED(child->wait_status))
+			exit_code = WEXITSTATUS(child->wait_status);
+		if (exit_code)
+			status = YEFAULT;
+	}
+	if (status != YENOERR)
+		proc->status = YEFAULT;
+	if (proc->done_func)
+		proc->done_func(child->index, status, exit_code, &child->out, &child->err, proc->user_data);
+	ybin_delete_data(&child->out);
+	ybin_delete_data(&child->err);
+	child->pid = 0;
+	proc->nbr_running--;
+}
+/*
+ * _yproc_start()
+ * Start the next sub-program in a free slot. If it can't be started, its
+ * completion function is called at once.
+ */
+static ystatus_t _yproc_start(_yproc_t *proc, size_t slot) {
+	_yproc_child_t *child = &proc->children[slot];
+	int out_pipe[2] = {-1, -1}, err_pipe[2] = {-1, -1};
+	ystatus_t status;
+
+	*child = (_yproc_child_t){
+		.index = proc->next_cmd++,
+		.pidfd = -1,
+		.fds = {-1, -1},
+	};
+	if (_yproc_pipe(out_pipe) == -1 || _yproc_pipe(err_pipe) == -1) {
+		if (out_pipe[0] != -1) {
+			close(out_pipe[0]);
+			close(out_pipe[1]);
+		}
+		return (YEPIPE);
+	}
+	status = yexec_spawn(&proc->cmds[child->index], proc->null_fd, out_pipe[1], err_pipe[1], &child->pid);
+	close(out_pipe[1]);
+	close(err_pipe[1]);
+	child->fds[_YPROC_OUT] = out_pipe[0];
+	child->fds[_YPROC_ERR] = err_pipe[0];
+	proc->nbr_running++;
+	if (status != YENOERR) {
+		_yproc_close(proc, &child->fds[_YPROC_OUT]);
+		_yproc_close(proc, &child->fds[_YPROC_ERR]);
+		_yproc_finish(proc, child, YENOEXEC);
+		return (YENOERR);
+	}
+#ifdef __linux__
+	if (_yproc_watch(proc, child->fds[_YPROC_OUT], slot, _YPROC_OUT) ||
+	    _yproc_watch(proc, child->fds[_YPROC_ERR], slot, _YPROC_ERR))
+		return (YEPIPE);
+# ifdef SYS_pidfd_open
+	// the termination is watched too (otherwise it is checked regularly)
+	if ((child->pidfd = (int)syscall(SYS_pidfd_open, child->pid, 0)) != -1) {
+		fcntl(child->pidfd, F_SETFD, FD_CLOEXEC);
+		if (_yproc_watch(proc, child->pidfd, slot, _YPROC_PID))
+			_yproc_close(proc, &child->pidfd);
+	}
+# endif /* SYS_pidfd_open */
+#endif /* __linux__ */
+	return (YENOERR);
+}
+/*
+ * _yproc_read()
+ * Read the available data of a sub-program's output. The pipe is closed at
+ * the end of the data.
+ */
+static void _yproc_read(_yproc_t *proc, _yproc_child_t *child, int source) {
+	for (; ; ) {
+		ssize_t len = read(child->fds[source], proc->buffer, sizeof(proc->buffer));
+		if (len == -1 && errno == EINTR)
+			continue;
+		if (len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+		if (len <= 0)
+			break;
+		if (source == _YPROC_OUT && proc->keep_output) {
+			ybin_append(&child->out, proc->buffer, (size_t)len);
+		} else if (source == _YPROC_ERR && child->err.bytesize < YPROC_STDERR_MAX) {
+			size_t kept = YPROC_STDERR_MAX - child->err.bytesize;
+			ybin_append(&child->err, proc->buffer, (((size_t)len < kept) ? (size_t)len : kept));
+		}
+	}
+	_yproc_close(proc, &child->fds[source]);
+}
+/*
+ * _yproc_reap()
+ * Check if a sub-program is terminated.
+ */
+static void _yproc_reap(_yproc_t *proc, _yproc_child_t *child) {
+	pid_t res;
+
+	while ((res = waitpid(child->pid, &child->wait_status, WNOHANG)) == -1 && errno == EINTR)
+		;
+	if (!res)
+		return;
+	if (res == -1)
+		child->wait_status = -1;
+	child->exited = true;
+	_yproc_close(proc, &child->pidfd);
+}
+/*
+ * _yproc_wait()
+ * Wait for events on the running sub-programs, and process them.
+ */
+static ystatus_t _yproc_wait(_yproc_t *proc) {
+	bool check = false;
+
+	// terminations are checked regularly if they are not watched
+	for (size_t i = 0; i < proc->nbr_slots; ++i) {
+		if (proc->children[i].pid && !proc->children[i].exited && proc->children[i].pidfd == -1)
+			check = true;
+	}
+#ifdef __linux__
+	struct epoll_event events[YPROC_MAX_EVENTS];
+	int nbr_events = epoll_wait(proc->epoll_fd, events, YPROC_MAX_EVENTS, (check ? YPROC_CHECK_DELAY : -1));
+
+	if (nbr_events == -1 && errno != EINTR)
+		return (YEPIPE);
+	for (int i = 0; i < nbr_events; ++i) {
+		_yproc_child_t *child = &proc->children[events[i].data.u64 >> 2];
+		int source = (int)(events[i].data.u64 & 3);
+
+		if (source == _YPROC_PID)
+			_yproc_reap(proc, child);
+		else if (child->fds[source] != -1)
+			_yproc_read(proc, child, source);
+	}
+#else /* __linux__ */
+	struct pollfd *fds = malloc0(sizeof(struct pollfd) * proc->nbr_slots * 2);
+	size_t nbr_fds = 0;
+
+	if (!fds)
+		return (YENOMEM);
+	for (size_t i = 0; i < proc->nbr_slots; ++i) {
+		for (int source = _YPROC_OUT; proc->children[i].pid && source <= _YPROC_ERR; ++source) {
+			if (proc->children[i].fds[source] == -1)
+				continue;
+			fds[nbr_fds].fd = proc->children[i].fds[source];
+			fds[nbr_fds].events = POLLIN;
+			nbr_fds++;
+		}
+	}
+	if (poll(fds, nbr_fds, (check ? YPROC_CHECK_DELAY : -1)) == -1 && errno != EINTR) {
+		free0(fds);
+		return (YEPIPE);
+	}
+	for (size_t i = 0, n = 0; i < proc->nbr_slots; ++i) {
+		for (int source = _YPROC_OUT; proc->children[i].pid && source <= _YPROC_ERR; ++source) {
+			if (proc->children[i].fds[source] == -1)
+				continue;
+			if (fds[n++].revents)
+				_yproc_read(proc, &proc->children[i], source);
+		}
+	}
+	free0(fds);
+#endif /* __linux__ */
+	if (check) {
+		for (size_t i = 0; i < proc->nbr_slots; ++i) {
+			if (proc->children[i].pid && !proc->children[i].exited && proc->children[i].pidfd == -1)
+				_yproc_reap(proc, &proc->children[i]);
+		}
+	}
+	return (YENOERR);
+}
+/* Execute a list of sub-programs, a bounded number of them at the same time. */
+ystatus_t yproc_run(const yexec_cmd_t *cmds, size_t nbr_cmds, size_t nbr_running, bool keep_output,
+                    yproc_done_function_t done_func, void *user_data) {
+	_yproc_t *proc;
+	ystatus_t status = YENOERR;
+
+	if (!nbr_cmds)
+		return (YENOERR);
+	if (!cmds || !nbr_running)
+		return (YEINVAL);
+	if (!(proc = malloc0(sizeof(_yproc_t))))
+		return (YENOMEM);
+	proc->cmds = cmds;
+	proc->nbr_cmds = nbr_cmds;
+	proc->nbr_slots = (nbr_running < nbr_cmds) ? nbr_running : nbr_cmds;
+	proc->keep_output = keep_output;
+	proc->null_fd = -1;
+	proc->epoll_fd = -1;
+	proc->status = YENOERR;
+	proc->done_func = done_func;
+	proc->user_data = user_data;
+	if (!(proc->children = malloc0(sizeof(_yproc_child_t) * proc->nbr_slots))) {
+		status = YENOMEM;
+		goto cleanup;
+	}
+	if ((proc->null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC)) == -1) {
+		status = YEIO;
+		goto cleanup;
+	}
+#ifdef __linux__
+	if ((proc->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+		status = YENOMEM;
+		goto cleanup;
+	}
+#endif /* __linux__ */
+	for (; ; ) {
+		// fill the free slots
+		for (size_t i = 0; i < proc->nbr_slots && proc->next_cmd < proc->nbr_cmds; ++i) {
+			if (!proc->children[i].pid && (status = _yproc_start(proc, i)) != YENOERR)
+				goto stop;
+		}
+		if (!proc->nbr_running)
+			break;
+		if ((status = _yproc_wait(proc)) != YENOERR)
+			goto stop;
+		// a sub-program is done when it is terminated and its outputs are closed
+		for (size_t i = 0; i < proc->nbr_slots; ++i) {
+			_yproc_child_t *child = &proc->children[i];
+
+			if (child->pid && child->exited && child->fds[_YPROC_OUT] == -1 && child->fds[_YPROC_ERR] == -1)
+				_yproc_finish(proc, child, ((child->wait_status == -1) ? YEFAULT : YENOERR));
+		}
+	}
+	status = proc->status;
+stop:
+	// on internal error, the running sub-programs are waited for
+	for (size_t i = 0; i < proc->nbr_slots; ++i) {
+		_yproc_child_t *child = &proc->children[i];
+
+		if (!child->pid)
+			continue;
+		_yproc_close(proc, &child->fds[_YPROC_OUT]);
+		_yproc_close(proc, &child->fds[_YPROC_ERR]);
+		_yproc_close(proc, &child->pidfd);
+		while (!child->exited && waitpid(child->pid, &child->wait_status, 0) == -1 && errno == EINTR)
+			;
+		ybin_delete_data(&child->out);
+		ybin_delete_data(&child->err);
+	}
+cleanup:
+	if (proc->epoll_fd != -1)
+		close(proc->epoll_fd);
+	if (proc->null_fd != -1)
+		close(proc->null_fd);
+	free0(proc->children);
+	free0(proc);
+	return (status);
+}
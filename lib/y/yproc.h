@@ -0,0 +1,68 @@
+/**
+ * @header	yproc.h
+ * @abstract	Concurrent execution of sub-programs.
+ * @discussion	A list of sub-programs is executed, a bounded number of them
+ *		running at the same time, and the calling thread waits for all
+ *		of them. Sub-programs are started by yexec_spawn(). Their
+ *		standard outputs and errors are read as soon as data are
+ *		available (so a sub-program can't be blocked on a full pipe),
+ *		and their terminations are detected without blocking on one of
+ *		them.
+ *
+ *		On Linux, the pipes and the sub-programs (through pidfds) are
+ *		watched by epoll; if pidfds are not supported by the kernel,
+ *		terminations are checked regularly. On other systems, poll()
+ *		is used.
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ */
+#pragma once
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif /* __cplusplus || c_plusplus */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "ystatus.h"
+#include "ybin.h"
+#include "yexec.h"
+
+/** @const YPROC_STDERR_MAX	Maximum size of the kept standard error of a sub-program. */
+#define YPROC_STDERR_MAX	65536
+
+/**
+ * @typedef	yproc_done_function_t
+ * @abstract	Function called when a sub-program is terminated.
+ * @param	index		Index of the sub-program in the list.
+ * @param	status		YENOERR if the sub-program exited with a zero status,
+ *				YEFAULT if it failed, YENOEXEC if it couldn't be executed.
+ * @param	exit_code	Exit code of the sub-program (-1 if it was killed or not
+ *				executed).
+ * @param	out		Standard output of the sub-program (empty if not kept).
+ * @param	err		Beginning of the standard error of the sub-program.
+ * @param	user_data	Pointer to user data.
+ */
+typedef void (*yproc_done_function_t)(size_t index, ystatus_t status, int exit_code,
+                                      const ybin_t *out, const ybin_t *err, void *user_data);
+
+/**
+ * @function	yproc_run
+ * @abstract	Execute a list of sub-programs, a bounded number of them at the
+ *		same time, and wait for their termination.
+ * @param	cmds		Array of commands.
+ * @param	nbr_cmds	Number of commands in the array.
+ * @param	nbr_running	Maximum number of concurrent sub-programs (at least 1).
+ * @param	keep_output	True to keep the standard outputs in memory. Otherwise
+ *				they are read and discarded.
+ * @param	done_func	Function called by the calling thread when a sub-program
+ *				is terminated, in the order of the terminations. Could be NULL.
+ * @param	user_data	Pointer to user data, given to the function.
+ * @return	YENOERR if all the sub-programs succeeded, YEFAULT if at least one of
+ *		them failed, YENOMEM or YEPIPE on internal error.
+ */
+ystatus_t yproc_run(const yexec_cmd_t *cmds, size_t nbr_cmds, size_t nbr_running, bool keep_output,
+                    yproc_done_function_t done_func, void *user_data);
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}
+#endif /* __cplusplus || c_plusplus */
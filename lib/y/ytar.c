@@ -0,0 +1,1469 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <pwd.h>
+#include <grp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef __linux__
+# include <sys/syscall.h>
+# include <sys/sysmacros.h>
+#endif /* __linux__ */
+#include "ytar.h"
+
+/** @const _YTAR_BUFFER_SIZE	Size of the output buffer (multiple of the block size). */
+#define _YTAR_BUFFER_SIZE	(1024 * 1024)
+/** @const _YTAR_DENTS_SIZE	Size of the buffer used to read directory entries. */
+#define _YTAR_DENTS_SIZE	32768
+/** @const _YTAR_MAX_BUFFERED	Maximum number of entries read ahead of the writer. */
+#define _YTAR_MAX_BUFFERED	262144
+/** @const _YTAR_USTAR_MAX_SIZE	Maximum value of a 12-byte octal field. */
+#define _YTAR_USTAR_MAX_SIZE	077777777777ULL
+/** @const _YTAR_USTAR_MAX_ID	Maximum value of an 8-byte octal field. */
+#define _YTAR_USTAR_MAX_ID	07777777ULL
+/** @const _YTAR_NAMES_CACHE_SIZE	Number of cached user and group names. */
+#define _YTAR_NAMES_CACHE_SIZE	16
+
+/** @const Directory states. */
+enum {
+	_YTAR_DIR_QUEUED = 0,
+	_YTAR_DIR_READING,
+	_YTAR_DIR_READY
+};
+
+/**
+ * @typedef	_ytar_header_t
+ *		Ustar header block.
+ */
+typedef struct {
+	char name[100];
+	char mode[8];
+	char uid[8];
+	char gid[8];
+	char size[12];
+	char mtime[12];
+	char chksum[8];
+	char typeflag;
+	char linkname[100];
+	char magic[6];
+	char version[2];
+	char uname[32];
+	char gname[32];
+	char devmajor[8];
+	char devminor[8];
+	char prefix[155];
+	char pad[12];
+} _ytar_header_t;
+
+/* Directory being archived. */
+typedef struct _ytar_dir_s _ytar_dir_t;
+
+/**
+ * @typedef	_ytar_entry_t
+ *		Entry of a directory.
+ * @field	name	Name of the entry.
+ * @field	st	Metadata of the entry.
+ * @field	link	Target of a symbolic link.
+ * @field	dir	Pointer to the subdirectory's node, if its content is archived.
+ * @field	error	Error number, if the entry's metadata couldn't be read.
+ */
+typedef struct {
+	char *name;
+	struct stat st;
+	char *link;
+	_ytar_dir_t *dir;
+	int error;
+} _ytar_entry_t;
+
+/**
+ * @typedef	_ytar_dir_s
+ *		Directory being archived.
+ * @field	path		Member path of the directory (without trailing slash).
+ * @field	parent		Pointer to the parent directory (NULL for the root).
+ * @field	patterns	Exclusion patterns defined in the directory.
+ * @field	nbr_patterns	Number of patterns.
+ * @field	entries		Sorted list of entries.
+ * @field	nbr_entries	Number of entries.
+ * @field	nbr_excluded	Number of excluded entries.
+ * @field	state		Reading state (queued, being read, ready).
+ * @field	error		Error number, if the directory couldn't be read.
+ * @field	pushed		True if the directory was added to a thread's list.
+ * @field	next		Pointer to the next node kept until the end of the walk.
+ */
+struct _ytar_dir_s {
+	char *path;
+	_ytar_dir_t *parent;
+	char **patterns;
+	size_t nbr_patterns;
+	_ytar_entry_t *entries;
+	size_t nbr_entries;
+	size_t nbr_excluded;
+	int state;
+	int error;
+	bool pushed;
+	_ytar_dir_t *next;
+};
+
+/**
+ * @typedef	_ytar_deque_t
+ *		List of directories to read, owned by a thread. The owner takes
+ *		directories from the bottom, other threads steal from the top.
+ * @field	mutex	Mutex protecting the list.
+ * @field	items	Array of directories.
+ * @field	top	Index of the first directory.
+ * @field	bottom	Index after the last directory.
+ * @field	size	Allocated size of the array.
+ */
+typedef struct {
+	pthread_mutex_t mutex;
+	_ytar_dir_t **items;
+	size_t top;
+	size_t bottom;
+	size_t size;
+} _ytar_deque_t;
+
+/**
+ * @typedef	_ytar_walk_t
+ *		Shared state of a directory tree's reading.
+ * @field	base		Base directory.
+ * @field	options		Pointer to the options.
+ * @field	deques		Lists of directories to read (one per thread, plus the writer's one).
+ * @field	nbr_deques	Number of lists.
+ * @field	mutex		Mutex protecting the counters.
+ * @field	cond		Condition signaled when a directory is queued or read, or
+ *				when the walk is over.
+ * @field	nbr_queued	Number of directories waiting to be read.
+ * @field	nbr_buffered	Number of entries read but not yet written.
+ * @field	end		True when the threads must stop.
+ * @field	status		Status of the first fatal error.
+ * @field	graveyard	List of written nodes kept until the end of the walk.
+ */
+typedef struct {
+	const char *base;
+	const ytar_options_t *options;
+	_ytar_deque_t *deques;
+	size_t nbr_deques;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	size_t nbr_queued;
+	size_t nbr_buffered;
+	bool end;
+	ystatus_t status;
+	_ytar_dir_t *graveyard;
+} _ytar_walk_t;
+
+/**
+ * @typedef	_ytar_worker_t
+ *		Thread reading directories.
+ * @field	thread	Thread identifier.
+ * @field	walk	Pointer to the shared state.
+ * @field	index	Index of the thread's list of directories.
+ */
+typedef struct {
+	pthread_t thread;
+	_ytar_walk_t *walk;
+	size_t index;
+} _ytar_worker_t;
+
+/**
+ * @typedef	_ytar_link_t
+ *		Hard-linked file already archived.
+ * @field	dev	Device number.
+ * @field	ino	Inode number.
+ * @field	name	Member name of the first link.
+ */
+typedef struct {
+	dev_t dev;
+	ino_t ino;
+	char *name;
+} _ytar_link_t;
+
+/**
+ * @typedef	_ytar_name_t
+ *		Cached user or group name.
+ * @field	id	User or group identifier.
+ * @field	name	Name (empty if unknown).
+ */
+typedef struct {
+	unsigned long id;
+	char name[32];
+} _ytar_name_t;
+
+/**
+ * @typedef	_ytar_sparse_t
+ *		Data regions of a sparse file.
+ * @field	regions		Offset and size of each data region.
+ * @field	nbr_regions	Number of data regions.
+ * @field	data_size	Size of the data regions.
+ * @field	map		Sparse map, written at the beginning of the member.
+ * @field	map_len		Size of the sparse map.
+ */
+typedef struct {
+	uint64_t (*regions)[2];
+	size_t nbr_regions;
+	uint64_t data_size;
+	char *map;
+	size_t map_len;
+} _ytar_sparse_t;
+
+/**
+ * @typedef	_ytar_writer_t
+ *		Writer of an archive.
+ * @field	walk		Pointer to the shared state.
+ * @field	func		Output function.
+ * @field	user_data	Pointer given to the output function.
+ * @field	buffer		Output buffer.
+ * @field	len		Size of the data in the output buffer.
+ * @field	links		Hash table of hard-linked files.
+ * @field	links_size	Number of slots of the hash table.
+ * @field	nbr_links	Number of used slots.
+ * @field	users		Cache of user names.
+ * @field	nbr_users	Number of cached user names.
+ * @field	groups		Cache of group names.
+ * @field	nbr_groups	Number of cached group names.
+ * @field	stats		Statistics.
+ */
+typedef struct {
+	_ytar_walk_t *walk;
+	ytar_output_function_t func;
+	void *user_data;
+	uint8_t *buffer;
+	size_t len;
+	_ytar_link_t *links;
+	size_t links_size;
+	size_t nbr_links;
+	_ytar_name_t users[_YTAR_NAMES_CACHE_SIZE];
+	size_t nbr_users;
+	_ytar_name_t groups[_YTAR_NAMES_CACHE_SIZE];
+	size_t nbr_groups;
+	ytar_stats_t stats;
+} _ytar_writer_t;
+
+/* ********** DIRECTORIES' LISTS ********** */
+
+/*
+ * _ytar_deque_push()
+ * Add a directory at the bottom of a list.
+ */
+static ystatus_t _ytar_deque_push(_ytar_deque_t *deque, _ytar_dir_t *dir) {
+	ystatus_t status = YENOERR;
+
+	pthread_mutex_lock(&deque->mutex);
+	if (deque->bottom == deque->size) {
+		if (deque->top) {
+			// reuse the space freed by stolen directories
+			memmove(deque->items, deque->items + deque->top, (deque->bottom - deque->top) * sizeof(_ytar_dir_t*));
+			deque->bottom -= deque->top;
+			deque->top = 0;
+		} else {
+			size_t size = deque->size ? (deque->size * 2) : 64;
+			_ytar_dir_t **items = realloc(deque->items, size * sizeof(_ytar_dir_t*));
+			if (!items) {
+				status = YENOMEM;
+				goto end;
+			}
+			deque->items = items;
+			deque->size = size;
+		}
+	}
+	deque->items[deque->bottom++] = dir;
+end:
+	pthread_mutex_unlock(&deque->mutex);
+	return (status);
+}
+/*
+ * _ytar_deque_take()
+ * Take a queued directory from a list: from the bottom for its owner, from
+ * the top for the other threads. Directories already taken by the writer are
+ * discarded. Returns NULL if the list is empty.
+ */
+static _ytar_dir_t *_ytar_deque_take(_ytar_walk_t *walk, _ytar_deque_t *deque, bool owner) {
+	_ytar_dir_t *dir = NULL;
+	int expected;
+
+	pthread_mutex_lock(&deque->mutex);
+	while (deque->top < deque->bottom) {
+		dir = owner ? deque->items[--deque->bottom] : deque->items[deque->top++];
+		expected = _YTAR_DIR_QUEUED;
+		if (__atomic_compare_exchange_n(&dir->state, &expected, _YTAR_DIR_READING, false,
+		                                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			break;
+		dir = NULL;
+	}
+	if (deque->top == deque->bottom)
+		deque->top = deque->bottom = 0;
+	pthread_mutex_unlock(&deque->mutex);
+	if (dir) {
+		pthread_mutex_lock(&walk->mutex);
+		walk->nbr_queued--;
+		pthread_mutex_unlock(&walk->mutex);
+	}
+	return (dir);
+}
+
+/* ********** DIRECTORIES' READING ********** */
+
+/*
+ * _ytar_full_path()
+ * Create the path of a member on the filesystem.
+ */
+static char *_ytar_full_path(const char *base, const char *path) {
+	size_t base_len = strlen(base);
+	size_t len = base_len + strlen(path) + 2;
+	char *full = malloc0(len);
+
+	if (!full)
+		return (NULL);
+	if (!base_len)
+		snprintf(full, len, "%s", path);
+	else if (base[base_len - 1] == '/')
+		snprintf(full, len, "%s%s", base, path);
+	else
+		snprintf(full, len, "%s/%s", base, path);
+	return (full);
+}
+/*
+ * _ytar_read_names()
+ * Read the names of a directory's entries. Returns an allocated array of
+ * allocated strings, or NULL on error (errno is set).
+ */
+static char **_ytar_read_names(int fd, size_t *nbr_names) {
+	char **names = NULL;
+	size_t size = 0;
+	*nbr_names = 0;
+#ifdef __linux__
+	char buffer[_YTAR_DENTS_SIZE] __attribute__((aligned(8)));
+	struct _ytar_dirent64 {
+		uint64_t d_ino;
+		int64_t d_off;
+		unsigned short d_reclen;
+		unsigned char d_type;
+		char d_name[];
+	} *de;
+	long nread;
+
+	for (; ; ) {
+		nread = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+		if (nread == -1 && errno == EINTR)
+			continue;
+		if (nread <= 0)
+			break;
+		for (long offset = 0; offset < nread; offset += de->d_reclen) {
+			de = (struct _ytar_dirent64*)(buffer + offset);
+			const char *name = de->d_name;
+#else
+	DIR *d;
+	struct dirent *de;
+	int dup_fd;
+
+	if ((dup_fd = dup(fd)) == -1)
+		return (NULL);
+	if (!(d = fdopendir(dup_fd))) {
+		close(dup_fd);
+		return (NULL);
+	}
+	long nread = 0;
+	for (; ; ) {
+		errno = 0;
+		if (!(de = readdir(d))) {
+			nread = errno ? -1 : 0;
+			break;
+		}
+		{
+			const char *name = de->d_name;
+#endif /* __linux__ */
+			if (!strcmp(name, ".") || !strcmp(name, ".."))
+				continue;
+			if (*nbr_names == size) {
+				size_t new_size = size ? (size * 2) : 32;
+				char **new_names = realloc(names, new_size * sizeof(char*));
+				if (!new_names)
+					goto error;
+				names = new_names;
+				size = new_size;
+			}
+			if (!(names[*nbr_names] = strdup(name)))
+				goto error;
+			(*nbr_names)++;
+		}
+	}
+#ifndef __linux__
+	closedir(d);
+#endif /* __linux__ */
+	if (nread == -1)
+		goto error_errno;
+	if (!names && !(names = malloc0(sizeof(char*))))
+		goto error_errno;
+	return (names);
+error:
+	errno = ENOMEM;
+#ifndef __linux__
+	closedir(d);
+#endif /* __linux__ */
+error_errno:
+	{
+		int err = errno;
+		for (size_t i = 0; i < *nbr_names; ++i)
+			free(names[i]);
+		free(names);
+		*nbr_names = 0;
+		errno = err;
+	}
+	return (NULL);
+}
+/*
+ * _ytar_read_patterns()
+ * Read the exclusion patterns of a file (one per line, empty lines ignored),
+ * and add them to a list.
+ */
+static void _ytar_read_patterns(int dirfd, const char *name, char ***patterns, size_t *nbr_patterns) {
+	char *content = NULL;
+	size_t size = 0, len = 0;
+	ssize_t nread;
+	int fd;
+
+	if ((fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC | O_NOFOLLOW)) == -1)
+		return;
+	for (; ; ) {
+		if (len + 4096 + 1 > size) {
+			char *new_content = realloc(content, size + 8192);
+			if (!new_content)
+				break;
+			content = new_content;
+			size += 8192;
+		}
+		nread = read(fd, content + len, 4096);
+		if (nread == -1 && errno == EINTR)
+			continue;
+		if (nread <= 0)
+			break;
+		len += nread;
+	}
+	close(fd);
+	if (!content)
+		return;
+	content[len] = '\0';
+	for (char *line = content, *next; line && *line; line = next) {
+		if ((next = strchr(line, '\n')))
+			*next++ = '\0';
+		size_t line_len = strlen(line);
+		if (line_len && line[line_len - 1] == '\r')
+			line[--line_len] = '\0';
+		if (!line_len)
+			continue;
+		char **new_patterns = realloc(*patterns, (*nbr_patterns + 1) * sizeof(char*));
+		if (!new_patterns)
+			break;
+		*patterns = new_patterns;
+		if (!((*patterns)[*nbr_patterns] = strdup(line)))
+			break;
+		(*nbr_patterns)++;
+	}
+	free(content);
+}
+/*
+ * _ytar_is_excluded()
+ * Check if an entry's name matches the patterns of its directory, or of one
+ * of its ancestors.
+ */
+static bool _ytar_is_excluded(const _ytar_dir_t *dir, const char *name) {
+	for (const _ytar_dir_t *d = dir; d; d = d->parent)
+		for (size_t i = 0; i < d->nbr_patterns; ++i)
+			if (!fnmatch(d->patterns[i], name, 0))
+				return (true);
+	return (false);
+}
+/*
+ * _ytar_is_cachedir_tag()
+ * Check if a file is a valid cache directory tag.
+ */
+static bool _ytar_is_cachedir_tag(int dirfd, const char *name) {
+	char buffer[sizeof(YTAR_CACHEDIR_SIGNATURE) - 1];
+	ssize_t nread;
+	int fd;
+
+	if ((fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC | O_NOFOLLOW)) == -1)
+		return (false);
+	while ((nread = read(fd, buffer, sizeof(buffer))) == -1 && errno == EINTR)
+		;
+	close(fd);
+	return ((nread == (ssize_t)sizeof(buffer) && !memcmp(buffer, YTAR_CACHEDIR_SIGNATURE, sizeof(buffer))) ?
+	        true : false);
+}
+/*
+ * _ytar_compare_entries()
+ * Compare two entries by name.
+ */
+static int _ytar_compare_entries(const void *a, const void *b) {
+	return (strcmp(((const _ytar_entry_t*)a)->name, ((const _ytar_entry_t*)b)->name));
+}
+/*
+ * _ytar_free_dir_content()
+ * Free the content of a directory node (but not its subdirectories).
+ */
+static void _ytar_free_dir_content(_ytar_dir_t *dir) {
+	for (size_t i = 0; i < dir->nbr_entries; ++i) {
+		free0(dir->entries[i].name);
+		free0(dir->entries[i].link);
+	}
+	for (size_t i = 0; i < dir->nbr_patterns; ++i)
+		free0(dir->patterns[i]);
+	free0(dir->patterns);
+	free0(dir->entries);
+	free0(dir->path);
+	dir->nbr_entries = 0;
+	dir->nbr_patterns = 0;
+}
+/*
+ * _ytar_new_dir()
+ * Create a directory node.
+ */
+static _ytar_dir_t *_ytar_new_dir(const char *path, const char *name, _ytar_dir_t *parent) {
+	_ytar_dir_t *dir;
+	size_t len = strlen(path) + (name ? (strlen(name) + 1) : 0) + 1;
+
+	if (!(dir = malloc0(sizeof(_ytar_dir_t))))
+		return (NULL);
+	if (!(dir->path = malloc0(len))) {
+		free0(dir);
+		return (NULL);
+	}
+	if (name)
+		snprintf(dir->path, len, "%s/%s", path, name);
+	else
+		snprintf(dir->path, len, "%s", path);
+	dir->parent = parent;
+	dir->state = _YTAR_DIR_QUEUED;
+	return (dir);
+}
+/*
+ * _ytar_read_dir()
+ * Read a directory: list its entries, apply the exclusion rules, fetch the
+ * entries' metadata, and queue its subdirectories in the given list.
+ * Returns YENOMEM on memory allocation error; other errors are stored in the
+ * directory node.
+ */
+static ystatus_t _ytar_read_dir(_ytar_walk_t *walk, _ytar_dir_t *dir, size_t deque_index) {
+	ystatus_t status = YENOERR;
+	const ytar_options_t *options = walk->options;
+	char *full = NULL;
+	char **names = NULL;
+	size_t nbr_names = 0;
+	const char *tag = NULL, *cache_tag = NULL;
+	int fd = -1;
+
+	if (!(full = _ytar_full_path(walk->base, dir->path))) {
+		status = YENOMEM;
+		goto end;
+	}
+	if ((fd = open(full, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)) == -1 ||
+	    !(names = _ytar_read_names(fd, &nbr_names))) {
+		dir->error = errno;
+		goto end;
+	}
+	// tag files: the directory's content is excluded, except the tag files
+	for (size_t i = 0; i < nbr_names; ++i) {
+		if (options->exclude_tag && !strcmp(names[i], options->exclude_tag))
+			tag = names[i];
+		else if (options->exclude_caches && !strcmp(names[i], YTAR_CACHEDIR_TAG) &&
+		         _ytar_is_cachedir_tag(fd, names[i]))
+			cache_tag = names[i];
+	}
+	// exclusion patterns
+	if (!tag && !cache_tag) {
+		if (options->exclude_ignore)
+			_ytar_read_patterns(fd, options->exclude_ignore, &dir->patterns, &dir->nbr_patterns);
+		if (options->exclude_ignore_recursive)
+			_ytar_read_patterns(fd, options->exclude_ignore_recursive, &dir->patterns, &dir->nbr_patterns);
+	}
+	if (nbr_names && !(dir->entries = calloc0(nbr_names, sizeof(_ytar_entry_t)))) {
+		status = YENOMEM;
+		goto end;
+	}
+	for (size_t i = 0; i < nbr_names; ++i) {
+		_ytar_entry_t *entry = &dir->entries[dir->nbr_entries];
+
+		if (((tag || cache_tag) && names[i] != tag && names[i] != cache_tag) ||
+		    _ytar_is_excluded(dir, names[i])) {
+			dir->nbr_excluded++;
+			continue;
+		}
+		if (fstatat(fd, names[i], &entry->st, AT_SYMLINK_NOFOLLOW)) {
+			// a file removed since the directory was read is ignored
+			if (errno == ENOENT)
+				continue;
+			entry->error = errno;
+		} else if (S_ISSOCK(entry->st.st_mode)) {
+			// sockets are ignored, like GNU tar does
+			continue;
+		} else if (S_ISLNK(entry->st.st_mode)) {
+			size_t size = (entry->st.st_size > 0 ? (size_t)entry->st.st_size : 255) + 1;
+			ssize_t len;
+			if (!(entry->link = malloc0(size))) {
+				status = YENOMEM;
+				goto end;
+			}
+			if ((len = readlinkat(fd, names[i], entry->link, size - 1)) == -1)
+				entry->error = errno;
+			else
+				entry->link[len] = '\0';
+		}
+		entry->name = names[i];
+		names[i] = NULL;
+		dir->nbr_entries++;
+	}
+	if (dir->nbr_entries)
+		qsort(dir->entries, dir->nbr_entries, sizeof(_ytar_entry_t), _ytar_compare_entries);
+	// create the subdirectories' nodes
+	for (size_t i = 0; i < dir->nbr_entries; ++i) {
+		_ytar_entry_t *entry = &dir->entries[i];
+		if (entry->error || !S_ISDIR(entry->st.st_mode))
+			continue;
+		if (!(entry->dir = _ytar_new_dir(dir->path, entry->name, dir))) {
+			status = YENOMEM;
+			goto end;
+		}
+	}
+	// queue them in reverse order, so the first one is taken first by the list's owner
+	for (size_t i = dir->nbr_entries; i > 0; --i) {
+		_ytar_entry_t *entry = &dir->entries[i - 1];
+		if (!entry->dir)
+			continue;
+		entry->dir->pushed = true;
+		if ((status = _ytar_deque_push(&walk->deques[deque_index], entry->dir)) != YENOERR)
+			goto end;
+		pthread_mutex_lock(&walk->mutex);
+		walk->nbr_queued++;
+		pthread_cond_broadcast(&walk->cond);
+		pthread_mutex_unlock(&walk->mutex);
+	}
+end:
+	if (fd != -1)
+		close(fd);
+	for (size_t i = 0; names && i < nbr_names; ++i)
+		free0(names[i]);
+	free0(names);
+	free0(full);
+	// the directory is ready to be written
+	pthread_mutex_lock(&walk->mutex);
+	__atomic_store_n(&dir->state, _YTAR_DIR_READY, __ATOMIC_RELEASE);
+	walk->nbr_buffered += dir->nbr_entries;
+	if (status != YENOERR && walk->status == YENOERR) {
+		walk->status = status;
+		walk->end = true;
+	}
+	pthread_cond_broadcast(&walk->cond);
+	pthread_mutex_unlock(&walk->mutex);
+	return (status);
+}
+/*
+ * _ytar_worker()
+ * Main function of a thread reading directories.
+ */
+static void *_ytar_worker(void *data) {
+	_ytar_worker_t *worker = data;
+	_ytar_walk_t *walk = worker->walk;
+	_ytar_dir_t *dir;
+
+	for (; ; ) {
+		// wait for a directory to read
+		pthread_mutex_lock(&walk->mutex);
+		while (!walk->end && (!walk->nbr_queued || walk->nbr_buffered >= _YTAR_MAX_BUFFERED))
+			pthread_cond_wait(&walk->cond, &walk->mutex);
+		if (walk->end) {
+			pthread_mutex_unlock(&walk->mutex);
+			break;
+		}
+		pthread_mutex_unlock(&walk->mutex);
+		// own list first, then the other ones
+		dir = NULL;
+		for (size_t i = 0; i < walk->nbr_deques && !dir; ++i) {
+			size_t index = (worker->index + i) % walk->nbr_deques;
+			dir = _ytar_deque_take(walk, &walk->deques[index], (i == 0));
+		}
+		if (dir)
+			_ytar_read_dir(walk, dir, worker->index);
+		else
+			sched_yield();
+	}
+	return (NULL);
+}
+
+/* ********** ARCHIVE'S WRITING ********** */
+
+/*
+ * _ytar_flush()
+ * Give the output buffer to the output function.
+ */
+static ystatus_t _ytar_flush(_ytar_writer_t *writer) {
+	ystatus_t status = YENOERR;
+
+	if (writer->len)
+		status = writer->func(writer->buffer, writer->len, writer->user_data);
+	writer->stats.archive_size += writer->len;
+	writer->len = 0;
+	return (status);
+}
+/*
+ * _ytar_output()
+ * Add data to the output buffer (NULL data are zeros).
+ */
+static ystatus_t _ytar_output(_ytar_writer_t *writer, const void *data, size_t len) {
+	ystatus_t status;
+	const uint8_t *ptr = data;
+
+	while (len) {
+		size_t n = _YTAR_BUFFER_SIZE - writer->len;
+		if (n > len)
+			n = len;
+		if (ptr) {
+			memcpy(writer->buffer + writer->len, ptr, n);
+			ptr += n;
+		} else {
+			memset(writer->buffer + writer->len, 0, n);
+		}
+		writer->len += n;
+		len -= n;
+		if (writer->len == _YTAR_BUFFER_SIZE && (status = _ytar_flush(writer)) != YENOERR)
+			return (status);
+	}
+	return (YENOERR);
+}
+/*
+ * _ytar_pad()
+ * Add zeros up to the end of the current block.
+ */
+static ystatus_t _ytar_pad(_ytar_writer_t *writer, uint64_t size) {
+	size_t rest = (size_t)(size % YTAR_BLOCK_SIZE);
+
+	return (rest ? _ytar_output(writer, NULL, YTAR_BLOCK_SIZE - rest) : YENOERR);
+}
+/*
+ * _ytar_octal()
+ * Write a number in an octal field (with a trailing NUL character).
+ */
+static void _ytar_octal(char *field, size_t len, uint64_t value) {
+	char buffer[32];
+
+	snprintf(buffer, sizeof(buffer), "%0*llo", (int)(len - 1), (unsigned long long)value);
+	memcpy(field, buffer, len);
+}
+/*
+ * _ytar_pax_add()
+ * Add a record to a pax extended header ("<length> <key>=<value>\n", the
+ * length including itself).
+ */
+static ystatus_t _ytar_pax_add(char **pax, size_t *pax_len, const char *key, const char *value) {
+	size_t len = strlen(key) + strlen(value) + 3;
+	size_t total = len + 1;
+	char digits[24];
+
+	// the length's number of digits is part of the length
+	while ((size_t)snprintf(digits, sizeof(digits), "%zu", total) + len > total)
+		total++;
+	char *new_pax = realloc(*pax, *pax_len + total + 1);
+	if (!new_pax)
+		return (YENOMEM);
+	*pax = new_pax;
+	snprintf(*pax + *pax_len, total + 1, "%zu %s=%s\n", total, key, value);
+	*pax_len += total;
+	return (YENOERR);
+}
+/*
+ * _ytar_pax_add_number()
+ * Add a numeric record to a pax extended header.
+ */
+static ystatus_t _ytar_pax_add_number(char **pax, size_t *pax_len, const char *key, uint64_t value) {
+	char buffer[24];
+
+	snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long)value);
+	return (_ytar_pax_add(pax, pax_len, key, buffer));
+}
+/*
+ * _ytar_user_name()
+ * Get the name of a user, using a small cache.
+ */
+static const char *_ytar_user_name(_ytar_writer_t *writer, uid_t uid) {
+	struct passwd pwd, *result = NULL;
+	char buffer[1024];
+	_ytar_name_t *entry;
+
+	for (size_t i = 0; i < writer->nbr_users; ++i)
+		if (writer->users[i].id == (unsigned long)uid)
+			return (writer->users[i].name);
+	entry = &writer->users[(writer->nbr_users < _YTAR_NAMES_CACHE_SIZE) ? writer->nbr_users++ :
+	                       (uid % _YTAR_NAMES_CACHE_SIZE)];
+	entry->id = (unsigned long)uid;
+	entry->name[0] = '\0';
+	if (!getpwuid_r(uid, &pwd, buffer, sizeof(buffer), &result) && result)
+		snprintf(entry->name, sizeof(entry->name), "%s", result->pw_name);
+	return (entry->name);
+}
+/*
+ * _ytar_group_name()
+ * Get the name of a group, using a small cache.
+ */
+static const char *_ytar_group_name(_ytar_writer_t *writer, gid_t gid) {
+	struct group grp, *result = NULL;
+	char buffer[4096];
+	_ytar_name_t *entry;
+
+	for (size_t i = 0; i < writer->nbr_groups; ++i)
+		if (writer->groups[i].id == (unsigned long)gid)
+			return (writer->groups[i].name);
+	entry = &writer->groups[(writer->nbr_groups < _YTAR_NAMES_CACHE_SIZE) ? writer->nbr_groups++ :
+	                        (gid % _YTAR_NAMES_CACHE_SIZE)];
+	entry->id = (unsigned long)gid;
+	entry->name[0] = '\0';
+	if (!getgrgid_r(gid, &grp, buffer, sizeof(buffer), &result) && result)
+		snprintf(entry->name, sizeof(entry->name), "%s", result->gr_name);
+	return (entry->name);
+}
+/*
+ * _ytar_checksum()
+ * Compute and write the checksum of a header.
+ */
+static void _ytar_checksum(_ytar_header_t *header) {
+	const uint8_t *ptr = (const uint8_t*)header;
+	unsigned int sum = 0;
+	char buffer[16];
+
+	memset(header->chksum, ' ', sizeof(header->chksum));
+	for (size_t i = 0; i < sizeof(_ytar_header_t); ++i)
+		sum += ptr[i];
+	snprintf(buffer, sizeof(buffer), "%06o", sum);
+	memcpy(header->chksum, buffer, 7);
+	header->chksum[7] = ' ';
+}
+/*
+ * _ytar_write_header()
+ * Write the header of a member, preceded by a pax extended header if some
+ * values don't fit in the ustar fields. If a real size is given, the member
+ * is a sparse file (pax format 1.0): the header's name is a placeholder, and
+ * the real name and size are in the extended header.
+ */
+static ystatus_t _ytar_write_header(_ytar_writer_t *writer, const char *name, const struct stat *st,
+                                    char type, const char *link, uint64_t size, uint64_t real_size) {
+	ystatus_t status = YENOERR;
+	_ytar_header_t header;
+	char *pax = NULL;
+	size_t pax_len = 0;
+	char *sparse_name = NULL;
+	const char *uname = _ytar_user_name(writer, st->st_uid);
+	const char *gname = _ytar_group_name(writer, st->st_gid);
+	uint64_t mtime = (st->st_mtime > 0) ? (uint64_t)st->st_mtime : 0;
+
+	if (real_size) {
+		// placeholder name, like GNU tar ("<dir>/GNUSparseFile.0/<file>")
+		const char *slash = strrchr(name, '/');
+		int dir_len = slash ? (int)(slash - name + 1) : 0;
+		size_t len = strlen(name) + sizeof("GNUSparseFile.0/");
+
+		if (!(sparse_name = malloc0(len)))
+			return (YENOMEM);
+		snprintf(sparse_name, len, "%.*sGNUSparseFile.0/%s", dir_len, name, name + dir_len);
+		if ((status = _ytar_pax_add_number(&pax, &pax_len, "GNU.sparse.major", 1)) != YENOERR ||
+		    (status = _ytar_pax_add_number(&pax, &pax_len, "GNU.sparse.minor", 0)) != YENOERR ||
+		    (status = _ytar_pax_add(&pax, &pax_len, "GNU.sparse.name", name)) != YENOERR ||
+		    (status = _ytar_pax_add_number(&pax, &pax_len, "GNU.sparse.realsize", real_size)) != YENOERR)
+			goto end;
+		name = sparse_name;
+	}
+	size_t name_len = strlen(name);
+	memset(&header, 0, sizeof(header));
+	// name, split in prefix and name if needed
+	if (name_len <= sizeof(header.name)) {
+		memcpy(header.name, name, name_len);
+	} else {
+		const char *split = NULL;
+		for (const char *s = name + name_len - 1; s > name; --s) {
+			if (*s != '/' || s == name + name_len - 1)
+				continue;
+			if ((size_t)(s - name) <= sizeof(header.prefix) && strlen(s + 1) <= sizeof(header.name)) {
+				split = s;
+				break;
+			}
+		}
+		if (split) {
+			memcpy(header.prefix, name, split - name);
+			memcpy(header.name, split + 1, strlen(split + 1));
+		} else {
+			memcpy(header.name, name, sizeof(header.name));
+			// the real name of a sparse file is already in the extended header
+			if (!real_size)
+				status = _ytar_pax_add(&pax, &pax_len, "path", name);
+		}
+	}
+	if (link) {
+		size_t link_len = strlen(link);
+		memcpy(header.linkname, link, (link_len <= sizeof(header.linkname)) ? link_len : sizeof(header.linkname));
+		if (link_len > sizeof(header.linkname) && status == YENOERR)
+			status = _ytar_pax_add(&pax, &pax_len, "linkpath", link);
+	}
+	_ytar_octal(header.mode, sizeof(header.mode), st->st_mode & 07777);
+	_ytar_octal(header.uid, sizeof(header.uid), (st->st_uid <= _YTAR_USTAR_MAX_ID) ? st->st_uid : 0);
+	_ytar_octal(header.gid, sizeof(header.gid), (st->st_gid <= _YTAR_USTAR_MAX_ID) ? st->st_gid : 0);
+	_ytar_octal(header.size, sizeof(header.size), (size <= _YTAR_USTAR_MAX_SIZE) ? size : 0);
+	_ytar_octal(header.mtime, sizeof(header.mtime), (mtime <= _YTAR_USTAR_MAX_SIZE) ? mtime : 0);
+	if (status == YENOERR && st->st_uid > _YTAR_USTAR_MAX_ID)
+		status = _ytar_pax_add_number(&pax, &pax_len, "uid", st->st_uid);
+	if (status == YENOERR && st->st_gid > _YTAR_USTAR_MAX_ID)
+		status = _ytar_pax_add_number(&pax, &pax_len, "gid", st->st_gid);
+	if (status == YENOERR && size > _YTAR_USTAR_MAX_SIZE)
+		status = _ytar_pax_add_number(&pax, &pax_len, "size", size);
+	if (status == YENOERR && mtime > _YTAR_USTAR_MAX_SIZE)
+		status = _ytar_pax_add_number(&pax, &pax_len, "mtime", mtime);
+	if (status != YENOERR)
+		goto end;
+	header.typeflag = type;
+	memcpy(header.magic, "ustar", 6);
+	memcpy(header.version, "00", 2);
+	snprintf(header.uname, sizeof(header.uname), "%s", uname);
+	snprintf(header.gname, sizeof(header.gname), "%s", gname);
+	if (type == '3' || type == '4') {
+		_ytar_octal(header.devmajor, sizeof(header.devmajor), major(st->st_rdev));
+		_ytar_octal(header.devminor, sizeof(header.devminor), minor(st->st_rdev));
+	}
+	// pax extended header
+	if (pax) {
+		_ytar_header_t pax_header;
+		const char *base = strrchr(name, '/');
+		base = (base && base[1]) ? (base + 1) : name;
+
+		memset(&pax_header, 0, sizeof(pax_header));
+		snprintf(pax_header.name, sizeof(pax_header.name), "PaxHeaders/%.88s", base);
+		_ytar_octal(pax_header.mode, sizeof(pax_header.mode), 0644);
+		_ytar_octal(pax_header.uid, sizeof(pax_header.uid), 0);
+		_ytar_octal(pax_header.gid, sizeof(pax_header.gid), 0);
+		_ytar_octal(pax_header.size, sizeof(pax_header.size), pax_len);
+		_ytar_octal(pax_header.mtime, sizeof(pax_header.mtime), (mtime <= _YTAR_USTAR_MAX_SIZE) ? mtime : 0);
+		pax_header.typeflag = 'x';
+		memcpy(pax_header.magic, "ustar", 6);
+		memcpy(pax_header.version, "00", 2);
+		_ytar_checksum(&pax_header);
+		if ((status = _ytar_output(writer, &pax_header, sizeof(pax_header))) != YENOERR ||
+		    (status = _ytar_output(writer, pax, pax_len)) != YENOERR ||
+		    (status = _ytar_pad(writer, pax_len)) != YENOERR)
+			goto end;
+	}
+	_ytar_checksum(&header);
+	status = _ytar_output(writer, &header, sizeof(header));
+end:
+	free(pax);
+	free0(sparse_name);
+	return (status);
+}
+/*
+ * _ytar_link_find()
+ * Search a hard-linked file in the table of archived files. Returns the
+ * slot of the file, or the empty slot where it could be added.
+ */
+static _ytar_link_t *_ytar_link_find(_ytar_writer_t *writer, dev_t dev, ino_t ino) {
+	uint64_t hash = ((uint64_t)ino * 0x9e3779b97f4a7c15ULL) ^ (uint64_t)dev;
+	size_t mask = writer->links_size - 1;
+
+	for (size_t i = (size_t)(hash & mask); ; i = (i + 1) & mask) {
+		_ytar_link_t *link = &writer->links[i];
+		if (!link->name || (link->dev == dev && link->ino == ino))
+			return (link);
+	}
+}
+/*
+ * _ytar_link_add()
+ * Add a hard-linked file to the table of archived files.
+ */
+static ystatus_t _ytar_link_add(_ytar_writer_t *writer, dev_t dev, ino_t ino, const char *name) {
+	_ytar_link_t *link;
+
+	// the load factor is kept under 50%
+	if ((writer->nbr_links + 1) * 2 > writer->links_size) {
+		_ytar_link_t *old = writer->links;
+		size_t old_size = writer->links_size;
+		size_t size = old_size ? (old_size * 2) : 256;
+
+		if (!(writer->links = calloc0(size, sizeof(_ytar_link_t)))) {
+			writer->links = old;
+			return (YENOMEM);
+		}
+		writer->links_size = size;
+		for (size_t i = 0; i < old_size; ++i)
+			if (old[i].name)
+				*_ytar_link_find(writer, old[i].dev, old[i].ino) = old[i];
+		free0(old);
+	}
+	link = _ytar_link_find(writer, dev, ino);
+	if (!(link->name = strdup(name)))
+		return (YENOMEM);
+	link->dev = dev;
+	link->ino = ino;
+	writer->nbr_links++;
+	return (YENOERR);
+}
+/*
+ * _ytar_read_data()
+ * Copy data from a file to the archive. If the file is shorter than
+ * expected, the missing data are replaced by zeros.
+ */
+static ystatus_t _ytar_read_data(_ytar_writer_t *writer, int fd, uint64_t remaining, bool *changed) {
+	ystatus_t status = YENOERR;
+
+	while (remaining) {
+		size_t n = _YTAR_BUFFER_SIZE - writer->len;
+		ssize_t nread;
+
+		if (n > remaining)
+			n = (size_t)remaining;
+		nread = read(fd, writer->buffer + writer->len, n);
+		if (nread == -1 && errno == EINTR)
+			continue;
+		if (nread <= 0) {
+			// read error, or the file shrank
+			*changed = true;
+			return (_ytar_output(writer, NULL, remaining));
+		}
+		writer->len += (size_t)nread;
+		remaining -= (uint64_t)nread;
+		if (writer->len == _YTAR_BUFFER_SIZE && (status = _ytar_flush(writer)) != YENOERR)
+			return (status);
+	}
+	return (status);
+}
+/*
+ * _ytar_write_file_data()
+ * Write the content of a regular file. If the file shrank, the member is
+ * padded with zeros; if it grew, only its initial size is written. For a
+ * sparse file, the map is written, followed by the data regions.
+ */
+static ystatus_t _ytar_write_file_data(_ytar_writer_t *writer, int fd, const struct stat *st,
+                                       const _ytar_sparse_t *sparse, bool *changed) {
+	ystatus_t status = YENOERR;
+	struct stat st_after;
+
+	*changed = false;
+	if (!sparse) {
+		status = _ytar_read_data(writer, fd, (uint64_t)st->st_size, changed);
+	} else if ((status = _ytar_output(writer, sparse->map, sparse->map_len)) == YENOERR &&
+	           (status = _ytar_pad(writer, sparse->map_len)) == YENOERR) {
+		for (size_t i = 0; i < sparse->nbr_regions && status == YENOERR; ++i) {
+			if (lseek(fd, (off_t)sparse->regions[i][0], SEEK_SET) == -1) {
+				*changed = true;
+				status = _ytar_output(writer, NULL, sparse->regions[i][1]);
+			} else {
+				status = _ytar_read_data(writer, fd, sparse->regions[i][1], changed);
+			}
+		}
+	}
+	if (status == YENOERR && !fstat(fd, &st_after) &&
+	    (st_after.st_size != st->st_size || st_after.st_mtime != st->st_mtime))
+		*changed = true;
+	return (status);
+}
+/*
+ * _ytar_sparse_map()
+ * Find the data regions of a file with holes. Returns false if the file is
+ * not sparse (or if the filesystem can't tell), true if the sparse structure
+ * was filled.
+ */
+static bool _ytar_sparse_map(int fd, const struct stat *st, _ytar_sparse_t *sparse) {
+	memset(sparse, 0, sizeof(_ytar_sparse_t));
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+	uint64_t size = (uint64_t)st->st_size;
+	uint64_t offset = 0;
+	size_t allocated = 0;
+	bool sparse_file = false;
+
+	// a file whose blocks cover its size has no hole
+	if (!size || (uint64_t)st->st_blocks * 512 >= size)
+		return (false);
+	while (offset < size) {
+		off_t data = lseek(fd, (off_t)offset, SEEK_DATA);
+		if (data == -1) {
+			// ENXIO: the end of the file is a hole
+			if (errno == ENXIO)
+				break;
+			goto end;
+		}
+		off_t hole = lseek(fd, data, SEEK_HOLE);
+		if (hole == -1)
+			goto end;
+		if ((uint64_t)data >= size)
+			break;
+		if ((uint64_t)hole > size)
+			hole = (off_t)size;
+		if (sparse->nbr_regions == allocated) {
+			size_t new_allocated = allocated ? (allocated * 2) : 16;
+			uint64_t (*regions)[2] = realloc(sparse->regions, (new_allocated + 1) * sizeof(*regions));
+			if (!regions)
+				goto end;
+			sparse->regions = regions;
+			allocated = new_allocated;
+		}
+		sparse->regions[sparse->nbr_regions][0] = (uint64_t)data;
+		sparse->regions[sparse->nbr_regions][1] = (uint64_t)(hole - data);
+		sparse->nbr_regions++;
+		sparse->data_size += (uint64_t)(hole - data);
+		offset = (uint64_t)hole;
+	}
+	if (sparse->data_size == size)
+		goto end;
+	// a file ending with a hole has a last empty region
+	if (!sparse->nbr_regions || sparse->regions[sparse->nbr_regions - 1][0] +
+	                            sparse->regions[sparse->nbr_regions - 1][1] < size) {
+		if (sparse->nbr_regions == allocated) {
+			uint64_t (*regions)[2] = realloc(sparse->regions, (allocated + 1) * sizeof(*regions));
+			if (!regions)
+				goto end;
+			sparse->regions = regions;
+		}
+		sparse->regions[sparse->nbr_regions][0] = size;
+		sparse->regions[sparse->nbr_regions][1] = 0;
+		sparse->nbr_regions++;
+	}
+	// map: number of regions, then offset and size of each region, one number per line
+	if (!(sparse->map = malloc0(24 + sparse->nbr_regions * 48)))
+		goto end;
+	sparse->map_len = (size_t)sprintf(sparse->map, "%zu\n", sparse->nbr_regions);
+	for (size_t i = 0; i < sparse->nbr_regions; ++i)
+		sparse->map_len += (size_t)sprintf(sparse->map + sparse->map_len, "%llu\n%llu\n",
+		                                   (unsigned long long)sparse->regions[i][0],
+		                                   (unsigned long long)sparse->regions[i][1]);
+	sparse_file = true;
+end:
+	if (!sparse_file) {
+		free(sparse->regions);
+		memset(sparse, 0, sizeof(_ytar_sparse_t));
+	}
+	// the file is read from its beginning if it is not sparse
+	lseek(fd, 0, SEEK_SET);
+	return (sparse_file);
+#else /* SEEK_DATA && SEEK_HOLE */
+	return (false);
+#endif /* SEEK_DATA && SEEK_HOLE */
+}
+/*
+ * _ytar_write_member()
+ * Write a member of the archive (header and content).
+ */
+static ystatus_t _ytar_write_member(_ytar_writer_t *writer, const char *name, const struct stat *st,
+                                    const char *link) {
+	ystatus_t status = YENOERR;
+	char *full = NULL;
+	char *dir_name = NULL;
+	int fd = -1;
+	_ytar_sparse_t sparse = {0};
+	bool is_sparse = false;
+
+	if (S_ISDIR(st->st_mode)) {
+		// directory names end with a slash
+		size_t len = strlen(name) + 2;
+		if (!(dir_name = malloc0(len)))
+			return (YENOMEM);
+		snprintf(dir_name, len, "%s/", name);
+		writer->stats.nbr_dirs++;
+		status = _ytar_write_header(writer, dir_name, st, '5', NULL, 0, 0);
+		free0(dir_name);
+		return (status);
+	}
+	if (S_ISLNK(st->st_mode)) {
+		writer->stats.nbr_others++;
+		return (_ytar_write_header(writer, name, st, '2', link, 0, 0));
+	}
+	if (S_ISCHR(st->st_mode) || S_ISBLK(st->st_mode) || S_ISFIFO(st->st_mode)) {
+		writer->stats.nbr_others++;
+		return (_ytar_write_header(writer, name, st, (S_ISCHR(st->st_mode) ? '3' : S_ISBLK(st->st_mode) ? '4' : '6'),
+		                           NULL, 0, 0));
+	}
+	if (!S_ISREG(st->st_mode))
+		return (YENOERR);
+	// hard link to a file already archived
+	if (st->st_nlink > 1) {
+		_ytar_link_t *hard_link = writer->links_size ? _ytar_link_find(writer, st->st_dev, st->st_ino) : NULL;
+		if (hard_link && hard_link->name) {
+			writer->stats.nbr_others++;
+			return (_ytar_write_header(writer, name, st, '1', hard_link->name, 0, 0));
+		}
+	}
+	// the file is opened before its header is written, so an unreadable file is skipped
+	if (!(full = _ytar_full_path(writer->walk->base, name)))
+		return (YENOMEM);
+	fd = open(full, O_RDONLY | O_NOFOLLOW | O_CLOEXEC
+#ifdef O_NOATIME
+	          | O_NOATIME
+#endif /* O_NOATIME */
+	     );
+#ifdef O_NOATIME
+	// O_NOATIME is allowed only to the file's owner
+	if (fd == -1 && errno == EPERM)
+		fd = open(full, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+#endif /* O_NOATIME */
+	free0(full);
+	if (fd == -1) {
+		writer->stats.nbr_errors++;
+		return (YENOERR);
+	}
+#ifdef POSIX_FADV_NOREUSE
+	// files are read once, their pages shouldn't evict the pages used by other programs
+	posix_fadvise(fd, 0, 0, POSIX_FADV_NOREUSE);
+#endif /* POSIX_FADV_NOREUSE */
+	if (st->st_nlink > 1 && (status = _ytar_link_add(writer, st->st_dev, st->st_ino, name)) != YENOERR)
+		goto end;
+	// the holes of a sparse file are skipped
+	if (writer->walk->options->sparse && _ytar_sparse_map(fd, st, &sparse))
+		is_sparse = true;
+	uint64_t size = is_sparse ? ((sparse.map_len + YTAR_BLOCK_SIZE - 1) / YTAR_BLOCK_SIZE * YTAR_BLOCK_SIZE +
+	                             sparse.data_size) : (uint64_t)st->st_size;
+	if ((status = _ytar_write_header(writer, name, st, '0', NULL, size,
+	                                 is_sparse ? (uint64_t)st->st_size : 0)) == YENOERR) {
+		bool changed = false;
+		if ((status = _ytar_write_file_data(writer, fd, st, is_sparse ? &sparse : NULL, &changed)) == YENOERR)
+			status = _ytar_pad(writer, size);
+		if (changed)
+			writer->stats.nbr_errors++;
+		writer->stats.nbr_files++;
+		if (is_sparse)
+			writer->stats.nbr_sparse++;
+		writer->stats.data_size += (uint64_t)st->st_size;
+		writer->stats.physical_size += is_sparse ? sparse.data_size : (uint64_t)st->st_size;
+	}
+end:
+	free(sparse.regions);
+	free0(sparse.map);
+	close(fd);
+	return (status);
+}
+/*
+ * _ytar_release_dir()
+ * Free a written directory node. A node read by the writer may still be
+ * referenced by a thread's list, so it is kept until the end of the walk.
+ */
+static void _ytar_release_dir(_ytar_walk_t *walk, _ytar_dir_t *dir, bool claimed) {
+	_ytar_free_dir_content(dir);
+	if (claimed && dir->pushed) {
+		dir->next = walk->graveyard;
+		walk->graveyard = dir;
+	} else {
+		free0(dir);
+	}
+}
+/*
+ * _ytar_discard_dir()
+ * Free a directory node which was not written, and its subdirectories.
+ * Called once all threads are stopped.
+ */
+static void _ytar_discard_dir(_ytar_dir_t *dir) {
+	if (!dir)
+		return;
+	for (size_t i = 0; i < dir->nbr_entries; ++i)
+		_ytar_discard_dir(dir->entries[i].dir);
+	_ytar_free_dir_content(dir);
+	free0(dir);
+}
+/*
+ * _ytar_write_dir()
+ * Write the content of a directory, and free its node. If the directory was
+ * not read yet, it is read by the writer. On error, the node is not freed.
+ */
+static ystatus_t _ytar_write_dir(_ytar_writer_t *writer, _ytar_dir_t *dir) {
+	_ytar_walk_t *walk = writer->walk;
+	ystatus_t status = YENOERR;
+	char *name = NULL;
+	size_t name_size = 0;
+	int expected = _YTAR_DIR_QUEUED;
+	bool claimed = false;
+
+	// read the directory, or wait for a thread to read it
+	if (__atomic_compare_exchange_n(&dir->state, &expected, _YTAR_DIR_READING, false,
+	                                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		claimed = true;
+		pthread_mutex_lock(&walk->mutex);
+		walk->nbr_queued--;
+		pthread_mutex_unlock(&walk->mutex);
+		_ytar_read_dir(walk, dir, walk->nbr_deques - 1);
+	} else {
+		pthread_mutex_lock(&walk->mutex);
+		while (__atomic_load_n(&dir->state, __ATOMIC_ACQUIRE) != _YTAR_DIR_READY && !walk->end)
+			pthread_cond_wait(&walk->cond, &walk->mutex);
+		pthread_mutex_unlock(&walk->mutex);
+	}
+	if (walk->status != YENOERR) {
+		status = walk->status;
+		goto error;
+	}
+	if (dir->error)
+		writer->stats.nbr_errors++;
+	writer->stats.nbr_excluded += dir->nbr_excluded;
+	for (size_t i = 0; i < dir->nbr_entries; ++i) {
+		_ytar_entry_t *entry = &dir->entries[i];
+		size_t len = strlen(dir->path) + strlen(entry->name) + 2;
+
+		if (entry->error) {
+			writer->stats.nbr_errors++;
+			continue;
+		}
+		if (len > name_size) {
+			free0(name);
+			name_size = len * 2;
+			if (!(name = malloc0(name_size))) {
+				status = YENOMEM;
+				goto error;
+			}
+		}
+		snprintf(name, name_size, "%s/%s", dir->path, entry->name);
+		if ((status = _ytar_write_member(writer, name, &entry->st, entry->link)) != YENOERR)
+			goto error;
+		if (entry->dir) {
+			if ((status = _ytar_write_dir(writer, entry->dir)) != YENOERR)
+				goto error;
+			entry->dir = NULL;
+		}
+	}
+	free0(name);
+	pthread_mutex_lock(&walk->mutex);
+	walk->nbr_buffered -= dir->nbr_entries;
+	pthread_cond_broadcast(&walk->cond);
+	pthread_mutex_unlock(&walk->mutex);
+	_ytar_release_dir(walk, dir, claimed);
+	return (YENOERR);
+error:
+	free0(name);
+	return (status);
+}
+
+/* ********** PUBLIC FUNCTIONS ********** */
+
+/* Write a tar archive of a file or directory tree. */
+ystatus_t ytar_create(const char *base, const char *path, const ytar_options_t *options,
+                      ytar_output_function_t func, void *user_data, ytar_stats_t *stats) {
+	ystatus_t status = YENOERR;
+	ytar_options_t default_options = {0};
+	_ytar_walk_t walk = {0};
+	_ytar_writer_t writer = {0};
+	_ytar_worker_t *workers = NULL;
+	size_t nbr_workers = 0;
+	_ytar_dir_t *root = NULL;
+	char *member = NULL, *full = NULL;
+	struct stat st;
+
+	if (!base || !path || !func)
+		return (YEINVAL);
+	if (!options)
+		options = &default_options;
+	// member name of the path (without leading and trailing slashes)
+	while (*path == '/')
+		path++;
+	if (!(member = strdup(*path ? path : "."))) {
+		status = YENOMEM;
+		goto end;
+	}
+	for (size_t len = strlen(member); len > 1 && member[len - 1] == '/'; --len)
+		member[len - 1] = '\0';
+	walk.base = base;
+	walk.options = options;
+	walk.nbr_deques = ((options->nbr_threads > 1) ? options->nbr_threads : 0) + 1;
+	writer.walk = &walk;
+	writer.func = func;
+	writer.user_data = user_data;
+	if (!(walk.deques = calloc0(walk.nbr_deques, sizeof(_ytar_deque_t))) ||
+	    !(writer.buffer = malloc0(_YTAR_BUFFER_SIZE)) ||
+	    !(full = _ytar_full_path(base, member))) {
+		status = YENOMEM;
+		goto end;
+	}
+	pthread_mutex_init(&walk.mutex, NULL);
+	pthread_cond_init(&walk.cond, NULL);
+	for (size_t i = 0; i < walk.nbr_deques; ++i)
+		pthread_mutex_init(&walk.deques[i].mutex, NULL);
+	// the path itself
+	if (lstat(full, &st)) {
+		status = (errno == ENOENT) ? YENOENT : YEACCES;
+		goto end_walk;
+	}
+	if (S_ISLNK(st.st_mode)) {
+		char target[4096];
+		ssize_t len = readlink(full, target, sizeof(target) - 1);
+		if (len == -1) {
+			status = YEACCES;
+			goto end_walk;
+		}
+		target[len] = '\0';
+		status = _ytar_write_member(&writer, member, &st, target);
+	} else {
+		status = _ytar_write_member(&writer, member, &st, NULL);
+	}
+	if (status != YENOERR || !S_ISDIR(st.st_mode))
+		goto end_archive;
+	// directory tree: the threads read the directories, the current thread writes the archive
+	if (!(root = _ytar_new_dir(member, NULL, NULL))) {
+		status = YENOMEM;
+		goto end_archive;
+	}
+	if (walk.nbr_deques > 1 && (workers = calloc0(walk.nbr_deques - 1, sizeof(_ytar_worker_t)))) {
+		for (size_t i = 0; i < walk.nbr_deques - 1; ++i) {
+			workers[i].walk = &walk;
+			workers[i].index = i;
+			if (pthread_create(&workers[i].thread, NULL, _ytar_worker, &workers[i]))
+				break;
+			nbr_workers++;
+		}
+	}
+	// the root directory is read by the writer, its subdirectories are shared
+	pthread_mutex_lock(&walk.mutex);
+	walk.nbr_queued++;
+	pthread_mutex_unlock(&walk.mutex);
+	if ((status = _ytar_write_dir(&writer, root)) == YENOERR)
+		root = NULL;
+	// stop the threads
+	pthread_mutex_lock(&walk.mutex);
+	walk.end = true;
+	pthread_cond_broadcast(&walk.cond);
+	pthread_mutex_unlock(&walk.mutex);
+	for (size_t i = 0; i < nbr_workers; ++i)
+		pthread_join(workers[i].thread, NULL);
+end_archive:
+	// end of archive: two empty blocks, then padding up to the record size
+	if (status == YENOERR)
+		status = _ytar_output(&writer, NULL, 2 * YTAR_BLOCK_SIZE);
+	if (status == YENOERR) {
+		uint64_t size = writer.stats.archive_size + writer.len;
+		if (size % YTAR_RECORD_SIZE)
+			status = _ytar_output(&writer, NULL, YTAR_RECORD_SIZE - (size % YTAR_RECORD_SIZE));
+	}
+	if (status == YENOERR)
+		status = _ytar_flush(&writer);
+	if (status == YENOERR && writer.stats.nbr_errors)
+		status = YEIO;
+end_walk:
+	// nodes are freed once the threads are stopped
+	_ytar_discard_dir(root);
+	while (walk.graveyard) {
+		_ytar_dir_t *next = walk.graveyard->next;
+		free0(walk.graveyard);
+		walk.graveyard = next;
+	}
+	for (size_t i = 0; i < walk.nbr_deques; ++i) {
+		pthread_mutex_destroy(&walk.deques[i].mutex);
+		free(walk.deques[i].items);
+	}
+	pthread_cond_destroy(&walk.cond);
+	pthread_mutex_destroy(&walk.mutex);
+end:
+	if (stats)
+		*stats = writer.stats;
+	for (size_t i = 0; i < writer.links_size; ++i)
+		free0(writer.links[i].name);
+	free0(writer.links);
+	free0(writer.buffer);
+	free0(walk.deques);
+	free0(workers);
+	free0(member);
+	free0(full);
+	return (status);
+}
+
@@ -0,0 +1,140 @@
+/**
+ * @header	ytar.h
+ * @abstract	Creation of tar archives.
+ * @discussion	A directory tree is written as a POSIX tar stream (ustar
+ *		headers, with pax extended headers for long names, large
+ *		files and large identifiers), readable by GNU tar, bsdtar and
+ *		any POSIX-compliant reader.
+ *
+ *		Directories are read by several threads, with work stealing:
+ *		each thread has its own list of directories to read, and takes
+ *		directories from the other threads' lists when its own list is
+ *		empty. The archive is written by the calling thread, in a
+ *		deterministic order (depth-first, entries sorted by name),
+ *		whatever the order in which directories were read. If the
+ *		writer needs a directory which was not read yet, it reads it
+ *		itself.
+ *
+ *		Exclusion options follow GNU tar's semantics:
+ *		- exclude_caches: the content of a directory containing a
+ *		  valid CACHEDIR.TAG file is excluded (except the tag file).
+ *		- exclude_tag: the content of a directory containing the
+ *		  given file is excluded (except the tag file).
+ *		- exclude_ignore, exclude_ignore_recursive: exclusion
+ *		  patterns are read from the given files, and apply to the
+ *		  directory's entries and to its subdirectories' entries.
+ *		Patterns are shell wildcards, matched against the entries'
+ *		names (like GNU tar does, patterns containing a slash never
+ *		match).
+ *
+ *		With the sparse option, the holes of sparse files (found with
+ *		SEEK_DATA/SEEK_HOLE) are neither read nor written: the file is
+ *		stored in the pax sparse format 1.0 (as GNU tar's --sparse
+ *		option does), with a map of its data regions followed by
+ *		their content.
+ *
+ *		Files are read with the POSIX_FADV_NOREUSE hint, so the
+ *		archive's creation doesn't evict the page cache of other
+ *		programs (on systems which implement it).
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ */
+#pragma once
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif /* __cplusplus || c_plusplus */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "ystatus.h"
+#include "ymemory.h"
+
+/** @const YTAR_BLOCK_SIZE	Size of a tar block. */
+#define YTAR_BLOCK_SIZE		512
+/** @const YTAR_RECORD_SIZE	Size of a tar record (the archive's size is a multiple of it). */
+#define YTAR_RECORD_SIZE	10240
+/** @const YTAR_CACHEDIR_TAG	Name of the cache directory tag file. */
+#define YTAR_CACHEDIR_TAG	"CACHEDIR.TAG"
+/** @const YTAR_CACHEDIR_SIGNATURE	Signature at the beginning of a cache directory tag file. */
+#define YTAR_CACHEDIR_SIGNATURE	"Signature: 8a477f597d28d172789f06886806bc55"
+
+/**
+ * @typedef	ytar_output_function_t
+ * @abstract	Function called with each chunk of the archive.
+ * @param	data		Pointer to the data.
+ * @param	len		Size of the data.
+ * @param	user_data	Pointer to user data.
+ * @return	YENOERR if the data were written.
+ */
+typedef ystatus_t (*ytar_output_function_t)(const void *data, size_t len, void *user_data);
+
+/**
+ * @typedef	ytar_options_t
+ * @abstract	Options of an archive's creation.
+ * @field	exclude_caches			True to exclude the content of cache directories.
+ * @field	exclude_tag			Name of the tag file (could be NULL).
+ * @field	exclude_ignore			Name of the pattern files (could be NULL).
+ * @field	exclude_ignore_recursive	Name of the recursive pattern files (could be NULL).
+ * @field	nbr_threads			Number of threads reading directories (0 or 1 to read
+ *						them in the calling thread).
+ * @field	sparse				True to skip the holes of sparse files.
+ */
+typedef struct {
+	bool exclude_caches;
+	const char *exclude_tag;
+	const char *exclude_ignore;
+	const char *exclude_ignore_recursive;
+	size_t nbr_threads;
+	bool sparse;
+} ytar_options_t;
+
+/**
+ * @typedef	ytar_stats_t
+ * @abstract	Statistics of an archive's creation.
+ * @field	nbr_files	Number of regular files.
+ * @field	nbr_dirs	Number of directories.
+ * @field	nbr_others	Number of other entries (links, devices, FIFOs).
+ * @field	nbr_excluded	Number of excluded entries.
+ * @field	nbr_errors	Number of entries which couldn't be read, or which
+ *				changed while they were read.
+ * @field	nbr_sparse	Number of regular files stored as sparse files.
+ * @field	data_size	Size of the files' data (logical size).
+ * @field	physical_size	Size of the files' data actually read (holes of
+ *				sparse files are not counted).
+ * @field	archive_size	Size of the archive.
+ */
+typedef struct {
+	uint64_t nbr_files;
+	uint64_t nbr_dirs;
+	uint64_t nbr_others;
+	uint64_t nbr_excluded;
+	uint64_t nbr_errors;
+	uint64_t nbr_sparse;
+	uint64_t data_size;
+	uint64_t physical_size;
+	uint64_t archive_size;
+} ytar_stats_t;
+
+/**
+ * @function	ytar_create
+ *		Write a tar archive of a file or directory tree.
+ * @param	base		Directory the path is relative to (like tar's -C option).
+ * @param	path		Path of the file or directory to archive, relative to
+ *				the base directory. Members' names start with it.
+ * @param	options		Pointer to the options (could be NULL).
+ * @param	func		Function called with each chunk of the archive.
+ * @param	user_data	Pointer given to the function.
+ * @param	stats		Pointer to a structure filled with statistics (could be NULL).
+ * @return	YENOERR if OK. If some entries couldn't be read, or changed while
+ *		they were read, the archive is complete but YEIO is returned
+ *		(like GNU tar, which exits with a non-zero status). Other errors
+ *		stop the archive's creation.
+ */
+ystatus_t ytar_create(const char *base, const char *path, const ytar_options_t *options,
+                      ytar_output_function_t func, void *user_data, ytar_stats_t *stats);
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}
+#endif /* __cplusplus || c_plusplus */
+
@@ -23,6 +23,10 @@
 #include "yjson.h"
 #include "yexec.h"
 #include "utils.h"
+#include "encrypt.h"
+#include "dedup.h"
+#include "journal.h"
+#include "throttle.h"
 #include "agent.h"
 
 /* Create a new agent structure. */
@@ -379,10 +383,333 @@ void agent_load_configuration(agent_t *agent, bool permissive) {
 			agent->debug_mode = yvar_get_bool(var);
 		}
 	}
+	// manage streaming mode
+	ys = agent_getenv(A_ENV_STREAMING, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		agent->conf.streaming = STR_IS_TRUE(ys) ? true : false;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_STREAMING);
+		if (yvar_is_bool(var)) {
+			// got value from configuration file
+			agent->conf.streaming = yvar_get_bool(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage number of concurrent file backups
+	ys = agent_getenv(A_ENV_FILE_WORKERS, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		int workers = atoi(ys);
+		if (workers > 0 && workers <= A_MAX_WORKERS)
+			agent->conf.file_workers = (uint16_t)workers;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_FILE_WORKERS);
+		if (yvar_is_int(var) && yvar_get_int(var) > 0 && yvar_get_int(var) <= A_MAX_WORKERS) {
+			// got value from configuration file
+			agent->conf.file_workers = (uint16_t)yvar_get_int(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage number of concurrent database backups
+	ys = agent_getenv(A_ENV_DB_WORKERS, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		int workers = atoi(ys);
+		if (workers > 0 && workers <= A_MAX_WORKERS)
+			agent->conf.db_workers = (uint16_t)workers;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_DB_WORKERS);
+		if (yvar_is_int(var) && yvar_get_int(var) > 0 && yvar_get_int(var) <= A_MAX_WORKERS) {
+			// got value from configuration file
+			agent->conf.db_workers = (uint16_t)yvar_get_int(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage upload queue mode
+	ys = agent_getenv(A_ENV_UPLOAD_QUEUE, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		agent->conf.upload_queue = STR_IS_TRUE(ys) ? true : false;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_UPLOAD_QUEUE);
+		if (yvar_is_bool(var)) {
+			// got value from configuration file
+			agent->conf.upload_queue = yvar_get_bool(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage compression level
+	ys = agent_getenv(A_ENV_COMPRESS_LEVEL, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		int level = atoi(ys);
+		if (level > 0 && level <= A_ZSTD_MAX_LEVEL)
+			agent->conf.compress_level = (uint8_t)level;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_COMPRESS_LEVEL);
+		if (yvar_is_int(var) && yvar_get_int(var) > 0 && yvar_get_int(var) <= A_ZSTD_MAX_LEVEL) {
+			// got value from configuration file
+			agent->conf.compress_level = (uint8_t)yvar_get_int(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage number of compression threads
+	ys = agent_getenv(A_ENV_COMPRESS_THREADS, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		int threads = atoi(ys);
+		if (threads > 0 && threads <= A_MAX_COMPRESS_THREADS)
+			agent->conf.compress_threads = (uint16_t)threads;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_COMPRESS_THREADS);
+		if (yvar_is_int(var) && yvar_get_int(var) > 0 && yvar_get_int(var) <= A_MAX_COMPRESS_THREADS) {
+			// got value from configuration file
+			agent->conf.compress_threads = (uint16_t)yvar_get_int(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage deduplication mode
+	ys = agent_getenv(A_ENV_DEDUP, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		agent->conf.dedup = STR_IS_TRUE(ys) ? true : false;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_DEDUP);
+		if (yvar_is_bool(var)) {
+			// got value from configuration file
+			agent->conf.dedup = yvar_get_bool(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage skipping of unchanged paths
+	ys = agent_getenv(A_ENV_SKIP_UNCHANGED, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		agent->conf.skip_unchanged = STR_IS_TRUE(ys) ? true : false;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_SKIP_UNCHANGED);
+		if (yvar_is_bool(var)) {
+			// got value from configuration file
+			agent->conf.skip_unchanged = yvar_get_bool(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage native tar writer
+	ys = agent_getenv(A_ENV_NATIVE_TAR, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		agent->conf.native_tar = STR_IS_TRUE(ys) ? true : false;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_NATIVE_TAR);
+		if (yvar_is_bool(var)) {
+			// got value from configuration file
+			agent->conf.native_tar = yvar_get_bool(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage size of archive volumes
+	ys = agent_getenv(A_ENV_VOLUME_SIZE, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		int size = atoi(ys);
+		if (size > 0 && size <= A_MAX_VOLUME_SIZE)
+			agent->conf.volume_size = (uint32_t)size;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_VOLUME_SIZE);
+		if (yvar_is_int(var) && yvar_get_int(var) > 0 && yvar_get_int(var) <= A_MAX_VOLUME_SIZE) {
+			// got value from configuration file
+			agent->conf.volume_size = (uint32_t)yvar_get_int(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage adaptive compression
+	ys = agent_getenv(A_ENV_COMPRESS_AUTO, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		agent->conf.compress_auto = STR_IS_TRUE(ys) ? true : false;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_COMPRESS_AUTO);
+		if (yvar_is_bool(var)) {
+			// got value from configuration file
+			agent->conf.compress_auto = yvar_get_bool(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage read rate limit
+	ys = agent_getenv(A_ENV_READ_LIMIT, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		int limit = atoi(ys);
+		if (limit > 0 && limit <= A_MAX_IO_LIMIT)
+			agent->conf.read_limit = (uint32_t)limit;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_READ_LIMIT);
+		if (yvar_is_int(var) && yvar_get_int(var) > 0 && yvar_get_int(var) <= A_MAX_IO_LIMIT) {
+			// got value from configuration file
+			agent->conf.read_limit = (uint32_t)yvar_get_int(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage write rate limit
+	ys = agent_getenv(A_ENV_WRITE_LIMIT, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		int limit = atoi(ys);
+		if (limit > 0 && limit <= A_MAX_IO_LIMIT)
+			agent->conf.write_limit = (uint32_t)limit;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_WRITE_LIMIT);
+		if (yvar_is_int(var) && yvar_get_int(var) > 0 && yvar_get_int(var) <= A_MAX_IO_LIMIT) {
+			// got value from configuration file
+			agent->conf.write_limit = (uint32_t)yvar_get_int(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage idle I/O mode
+	ys = agent_getenv(A_ENV_IO_IDLE, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		agent->conf.io_idle = STR_IS_TRUE(ys) ? true : false;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_IO_IDLE);
+		if (yvar_is_bool(var)) {
+			// got value from configuration file
+			agent->conf.io_idle = yvar_get_bool(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage nice value
+	ys = agent_getenv(A_ENV_CPU_NICE, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		int nice = atoi(ys);
+		if (nice > 0 && nice <= A_MAX_CPU_NICE)
+			agent->conf.cpu_nice = (uint8_t)nice;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_CPU_NICE);
+		if (yvar_is_int(var) && yvar_get_int(var) > 0 && yvar_get_int(var) <= A_MAX_CPU_NICE) {
+			// got value from configuration file
+			agent->conf.cpu_nice = (uint8_t)yvar_get_int(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage idle CPU scheduling policy
+	ys = agent_getenv(A_ENV_CPU_IDLE, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		agent->conf.cpu_idle = STR_IS_TRUE(ys) ? true : false;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_CPU_IDLE);
+		if (yvar_is_bool(var)) {
+			// got value from configuration file
+			agent->conf.cpu_idle = yvar_get_bool(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage list of usable CPUs
+	ys = agent_getenv(A_ENV_CPU_SET, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		agent->conf.cpu_set = ys;
+		ys = NULL;
+	} else {
+		ys_delete(&ys); // in case of allocated but empty string
+		yvar_t *var = ytable_get_key_data(json, A_JSON_CPU_SET);
+		if (yvar_is_string(var) && (ys = yvar_get_string(var)) && !ys_empty(ys)) {
+			// got value from the configuration file
+			agent->conf.cpu_set = ys_copy(ys);
+		}
+		ys = NULL;
+	}
+	// manage CPU limit
+	ys = agent_getenv(A_ENV_CPU_MAX, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		int cores = atoi(ys);
+		if (cores > 0 && cores <= A_MAX_CPU_CORES)
+			agent->conf.cpu_max = (uint16_t)cores;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_CPU_MAX);
+		if (yvar_is_int(var) && yvar_get_int(var) > 0 && yvar_get_int(var) <= A_MAX_CPU_CORES) {
+			// got value from configuration file
+			agent->conf.cpu_max = (uint16_t)yvar_get_int(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage memory limit
+	ys = agent_getenv(A_ENV_MEMORY_HIGH, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		int limit = atoi(ys);
+		if (limit > 0 && limit <= A_MAX_MEMORY_HIGH)
+			agent->conf.memory_high = (uint32_t)limit;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_MEMORY_HIGH);
+		if (yvar_is_int(var) && yvar_get_int(var) > 0 && yvar_get_int(var) <= A_MAX_MEMORY_HIGH) {
+			// got value from configuration file
+			agent->conf.memory_high = (uint32_t)yvar_get_int(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage number of connections of a database dump
+	ys = agent_getenv(A_ENV_DUMP_JOBS, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		int jobs = atoi(ys);
+		if (jobs > 0 && jobs <= A_MAX_DUMP_JOBS)
+			agent->conf.dump_jobs = (uint16_t)jobs;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_DUMP_JOBS);
+		if (yvar_is_int(var) && yvar_get_int(var) > 0 && yvar_get_int(var) <= A_MAX_DUMP_JOBS) {
+			// got value from configuration file
+			agent->conf.dump_jobs = (uint16_t)yvar_get_int(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage number of WAL segments uploaded together
+	ys = agent_getenv(A_ENV_WAL_BATCH, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		int batch = atoi(ys);
+		if (batch > 0 && batch <= A_MAX_WAL_BATCH)
+			agent->conf.wal_batch = (uint16_t)batch;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_WAL_BATCH);
+		if (yvar_is_int(var) && yvar_get_int(var) > 0 && yvar_get_int(var) <= A_MAX_WAL_BATCH) {
+			// got value from configuration file
+			agent->conf.wal_batch = (uint16_t)yvar_get_int(var);
+		}
+	}
+	ys_delete(&ys);
+	// manage maximum size of the WAL segments spool
+	ys = agent_getenv(A_ENV_WAL_SPOOL, NULL);
+	if (!ys_empty(ys)) {
+		// got value from environment
+		int size = atoi(ys);
+		if (size > 0)
+			agent->conf.wal_spool = (uint32_t)size;
+	} else {
+		yvar_t *var = ytable_get_key_data(json, A_JSON_WAL_SPOOL);
+		if (yvar_is_int(var) && yvar_get_int(var) > 0 && yvar_get_int(var) <= UINT32_MAX) {
+			// got value from configuration file
+			agent->conf.wal_spool = (uint32_t)yvar_get_int(var);
+		}
+	}
+	ys_delete(&ys);
 cleanup:
 	ytable_free(json);
 	yjson_free(json_parser);
 }
+/* Returns the duration of the distant retention. */
+int64_t agent_retention(agent_t *agent) {
+	int64_t days = (agent->param.retention_type == A_RETENTION_DAYS) ? 1 :
+	               (agent->param.retention_type == A_RETENTION_WEEKS) ? 7 :
+	               (agent->param.retention_type == A_RETENTION_MONTHS) ? 28 :
+	               (agent->param.retention_type == A_RETENTION_YEARS) ? 365 : 0;
+
+	return (days * (int64_t)agent->param.retention_duration * A_RETENTION_DAY);
+}
 /* Frees a previously created agent structure. */
 void agent_free(agent_t *agent) {
 	if (!agent)
@@ -407,6 +734,11 @@ void agent_free(agent_t *agent) {
 	yarray_del(&agent->log.backup_databases, callback_free_log_item, NULL);
 	yarray_del(&agent->log.upload_s3, callback_free_log_item, NULL);
 	*/
+	dedup_close(agent->dedup);
+	journal_close(agent->journal);
+	throttle_free(agent->read_throttle);
+	throttle_free(agent->write_throttle);
+	encrypt_key_free(agent->crypt_key);
 	free0(agent);
 }
 
@@ -29,6 +29,10 @@
 #define	A_OPT_BACKUP		"backup"
 /** @const A_OPT_RESTORE	CLI option for restore. */
 #define	A_OPT_RESTORE		"restore"
+/** @const A_OPT_DECRYPT	CLI option for decryption. */
+#define	A_OPT_DECRYPT		"decrypt"
+/** @const A_OPT_WAL_PUSH	CLI option for WAL segment archiving. */
+#define	A_OPT_WAL_PUSH		"wal-push"
 
 /* ********** ENVIRONMENT VARIABLES ********** */
 /** @const A_ENV_CONF		Environment variable for the configuration file's path. */
@@ -61,6 +65,50 @@
 #define A_ENV_PARAM_FILE	"param_file"
 /** @const A_ENV_DEBUG_MODE	Environment variable for the debug mode. */
 #define A_ENV_DEBUG_MODE	"debug"
+/** @const A_ENV_STREAMING	Environment variable for the streaming mode. */
+#define A_ENV_STREAMING		"streaming"
+/** @const A_ENV_FILE_WORKERS	Environment variable for the number of concurrent file backups. */
+#define A_ENV_FILE_WORKERS	"file_workers"
+/** @const A_ENV_DB_WORKERS	Environment variable for the number of concurrent database backups. */
+#define A_ENV_DB_WORKERS	"db_workers"
+/** @const A_ENV_UPLOAD_QUEUE	Environment variable for the upload queue mode. */
+#define A_ENV_UPLOAD_QUEUE	"upload_queue"
+/** @const A_ENV_COMPRESS_LEVEL	Environment variable for the compression level. */
+#define A_ENV_COMPRESS_LEVEL	"compress_level"
+/** @const A_ENV_COMPRESS_THREADS	Environment variable for the number of compression threads. */
+#define A_ENV_COMPRESS_THREADS	"compress_threads"
+/** @const A_ENV_DEDUP		Environment variable for the deduplication mode. */
+#define A_ENV_DEDUP		"dedup"
+/** @const A_ENV_SKIP_UNCHANGED	Environment variable for the skipping of unchanged paths. */
+#define A_ENV_SKIP_UNCHANGED	"skip_unchanged"
+/** @const A_ENV_NATIVE_TAR	Environment variable for the native tar writer. */
+#define A_ENV_NATIVE_TAR	"native_tar"
+/** @const A_ENV_VOLUME_SIZE	Environment variable for the size of archive volumes. */
+#define A_ENV_VOLUME_SIZE	"volume_size"
+/** @const A_ENV_COMPRESS_AUTO	Environment variable for the adaptive compression. */
+#define A_ENV_COMPRESS_AUTO	"compress_auto"
+/** @const A_ENV_READ_LIMIT	Environment variable for the read rate limit. */
+#define A_ENV_READ_LIMIT	"read_limit"
+/** @const A_ENV_WRITE_LIMIT	Environment variable for the write rate limit. */
+#define A_ENV_WRITE_LIMIT	"write_limit"
+/** @const A_ENV_IO_IDLE	Environment variable for the idle I/O mode. */
+#define A_ENV_IO_IDLE		"io_idle"
+/** @const A_ENV_CPU_NICE	Environment variable for the nice value. */
+#define A_ENV_CPU_NICE		"cpu_nice"
+/** @const A_ENV_CPU_IDLE	Environment variable for the idle CPU scheduling policy. */
+#define A_ENV_CPU_IDLE		"cpu_idle"
+/** @const A_ENV_CPU_SET	Environment variable for the list of usable CPUs. */
+#define A_ENV_CPU_SET		"cpu_set"
+/** @const A_ENV_CPU_MAX	Environment variable for the CPU limit. */
+#define A_ENV_CPU_MAX		"cpu_max"
+/** @const A_ENV_MEMORY_HIGH	Environment variable for the memory limit. */
+#define A_ENV_MEMORY_HIGH	"memory_high"
+/** @const A_ENV_DUMP_JOBS	Environment variable for the number of connections of a database dump. */
+#define A_ENV_DUMP_JOBS		"dump_jobs"
+/** @const A_ENV_WAL_BATCH	Environment variable for the number of WAL segments uploaded together. */
+#define A_ENV_WAL_BATCH		"wal_batch"
+/** @const A_ENV_WAL_SPOOL	Environment variable for the maximum size of the WAL segments spool. */
+#define A_ENV_WAL_SPOOL		"wal_spool"
 
 /* ********** DEFAULT PATHS ************ */
 /** @const A_PATH_ROOT		Arkiv root path. */
@@ -141,6 +189,50 @@
 #define A_JSON_PARAM_FILE	"param_file"
 /** @const A_JSON_DEBUG_MODE	JSON key for the debug mode. */
 #define A_JSON_DEBUG_MODE	"debug"
+/** @const A_JSON_STREAMING	JSON key for the streaming mode. */
+#define A_JSON_STREAMING	"streaming"
+/** @const A_JSON_FILE_WORKERS	JSON key for the number of concurrent file backups. */
+#define A_JSON_FILE_WORKERS	"file_workers"
+/** @const A_JSON_DB_WORKERS	JSON key for the number of concurrent database backups. */
+#define A_JSON_DB_WORKERS	"db_workers"
+/** @const A_JSON_UPLOAD_QUEUE	JSON key for the upload queue mode. */
+#define A_JSON_UPLOAD_QUEUE	"upload_queue"
+/** @const A_JSON_COMPRESS_LEVEL	JSON key for the compression level. */
+#define A_JSON_COMPRESS_LEVEL	"compress_level"
+/** @const A_JSON_COMPRESS_THREADS	JSON key for the number of compression threads. */
+#define A_JSON_COMPRESS_THREADS	"compress_threads"
+/** @const A_JSON_DEDUP		JSON key for the deduplication mode. */
+#define A_JSON_DEDUP		"dedup"
+/** @const A_JSON_SKIP_UNCHANGED	JSON key for the skipping of unchanged paths. */
+#define A_JSON_SKIP_UNCHANGED	"skip_unchanged"
+/** @const A_JSON_NATIVE_TAR	JSON key for the native tar writer. */
+#define A_JSON_NATIVE_TAR	"native_tar"
+/** @const A_JSON_VOLUME_SIZE	JSON key for the size of archive volumes. */
+#define A_JSON_VOLUME_SIZE	"volume_size"
+/** @const A_JSON_COMPRESS_AUTO	JSON key for the adaptive compression. */
+#define A_JSON_COMPRESS_AUTO	"compress_auto"
+/** @const A_JSON_READ_LIMIT	JSON key for the read rate limit. */
+#define A_JSON_READ_LIMIT	"read_limit"
+/** @const A_JSON_WRITE_LIMIT	JSON key for the write rate limit. */
+#define A_JSON_WRITE_LIMIT	"write_limit"
+/** @const A_JSON_IO_IDLE	JSON key for the idle I/O mode. */
+#define A_JSON_IO_IDLE		"io_idle"
+/** @const A_JSON_CPU_NICE	JSON key for the nice value. */
+#define A_JSON_CPU_NICE		"cpu_nice"
+/** @const A_JSON_CPU_IDLE	JSON key for the idle CPU scheduling policy. */
+#define A_JSON_CPU_IDLE		"cpu_idle"
+/** @const A_JSON_CPU_SET	JSON key for the list of usable CPUs. */
+#define A_JSON_CPU_SET		"cpu_set"
+/** @const A_JSON_CPU_MAX	JSON key for the CPU limit. */
+#define A_JSON_CPU_MAX		"cpu_max"
+/** @const A_JSON_MEMORY_HIGH	JSON key for the memory limit. */
+#define A_JSON_MEMORY_HIGH	"memory_high"
+/** @const A_JSON_DUMP_JOBS	JSON key for the number of connections of a database dump. */
+#define A_JSON_DUMP_JOBS	"dump_jobs"
+/** @const A_JSON_WAL_BATCH	JSON key for the number of WAL segments uploaded together. */
+#define A_JSON_WAL_BATCH	"wal_batch"
+/** @const A_JSON_WAL_SPOOL	JSON key for the maximum size of the WAL segments spool. */
+#define A_JSON_WAL_SPOOL	"wal_spool"
 
 /* ********** SYSLOG STRINGS ********** */
 /** @const A_SYSLOG_IDENT	Syslog identity. */
@@ -198,6 +290,38 @@
 #define A_MINIMUM_CRYPT_PWD_LENGTH	24
 /** @const A_DEFAULT_LOCAL_RETENTION	Default value for the local retention duration in hours. */
 #define A_DEFAULT_LOCAL_RETENTION	24
+/** @const A_RETENTION_DAY		Number of seconds in a day (distant retention durations). */
+#define A_RETENTION_DAY			86400
+/** @const A_MAX_WORKERS		Maximum number of concurrent item backups. */
+#define A_MAX_WORKERS			64
+/** @const A_INCREMENTAL_DIRNAME	Subdirectory of the archives path where incremental snapshots are stored. */
+#define A_INCREMENTAL_DIRNAME		"incremental"
+/** @const A_INCREMENTAL_SNAR_EXT	Extension of the snapshots of incremental file backups. */
+#define A_INCREMENTAL_SNAR_EXT		"snar"
+/** @const A_DEDUP_DIRNAME		Subdirectory of the archives path where the index of stored chunks is kept. */
+#define A_DEDUP_DIRNAME			"dedup"
+/** @const A_CHANGES_DIRNAME		Subdirectory of the archives path where the indexes of backed up paths are kept. */
+#define A_CHANGES_DIRNAME		"changes"
+/** @const A_WAL_DIRNAME		Subdirectory of the archives path where the WAL segments are spooled. */
+#define A_WAL_DIRNAME			"wal"
+/** @const A_ZSTD_MAX_LEVEL		Maximum zstd compression level (without the --ultra option). */
+#define A_ZSTD_MAX_LEVEL		19
+/** @const A_MAX_COMPRESS_THREADS	Maximum number of compression threads. */
+#define A_MAX_COMPRESS_THREADS		256
+/** @const A_MAX_VOLUME_SIZE		Maximum size of archive volumes, in MB. */
+#define A_MAX_VOLUME_SIZE		1048576
+/** @const A_MAX_IO_LIMIT		Maximum I/O rate limit, in MB per second. */
+#define A_MAX_IO_LIMIT			1048576
+/** @const A_MAX_CPU_NICE		Maximum nice value. */
+#define A_MAX_CPU_NICE			19
+/** @const A_MAX_CPU_CORES		Maximum CPU limit, in number of cores. */
+#define A_MAX_CPU_CORES			4096
+/** @const A_MAX_MEMORY_HIGH		Maximum memory limit, in MB. */
+#define A_MAX_MEMORY_HIGH		16777216
+/** @const A_MAX_DUMP_JOBS		Maximum number of connections of a database dump. */
+#define A_MAX_DUMP_JOBS			64
+/** @const A_MAX_WAL_BATCH		Maximum number of WAL segments uploaded together. */
+#define A_MAX_WAL_BATCH			1024
 
 /* ********** PARAMETERS FILE VARPATH ********** */
 /** @const A_PARAM_PATH_RETENTION_HOURS		Path to the local retention duration in hours. */
@@ -214,6 +338,10 @@
 #define A_PARAM_PATH_RETENTION_TYPE		"/rt"
 /** @const A_PARAM_PATH_RETENTION_DURATION	Path to the retention duration. */
 #define A_PARAM_PATH_RETENTION_DURATION		"/rd"
+/** @const A_PARAM_PATH_FULL_EVERY		Path to the number of runs between two full file backups. */
+#define A_PARAM_PATH_FULL_EVERY			"/fe"
+/** @const A_PARAM_PATH_INCREMENTAL_TYPE	Path to the type of incremental file backups. */
+#define A_PARAM_PATH_INCREMENTAL_TYPE		"/it"
 /** @const A_PARAM_PATH_STORAGES		Path to the storages parameter. */
 #define A_PARAM_PATH_STORAGES			"/st"
 /** @const A_PARAM_PATH_SAVEPACKS		Path to the savepacks parameter. */
@@ -228,6 +356,12 @@
 #define A_PARAM_PATH_FILE			"/file"
 /** @const A_PARAM_PATH_DB			Path to the list of databases. */
 #define A_PARAM_PATH_DB				"/db"
+/** @const A_PARAM_PATH_FILE_WORKERS		Path to the number of concurrent file backups. */
+#define A_PARAM_PATH_FILE_WORKERS		"/wf"
+/** @const A_PARAM_PATH_DB_WORKERS		Path to the number of concurrent database backups. */
+#define A_PARAM_PATH_DB_WORKERS			"/wd"
+/** @const A_PARAM_PATH_WAL_STORAGE		Path to the identifier of the storage of the WAL segments. */
+#define A_PARAM_PATH_WAL_STORAGE		"/ws"
 /** @const A_PARAM_KEY_TYPE			Key to a type element. */
 #define A_PARAM_KEY_TYPE			"t"
 /** @const A_PARAM_KEY_ACCESS_KEY		Key to an access key element. */
@@ -256,8 +390,28 @@
 #define A_PARAM_KEY_STATUS			"s"
 /** @const A_PARAM_KEY_SIZE			Key to a file size. */
 #define A_PARAM_KEY_SIZE			"sz"
+/** @const A_PARAM_KEY_LEVEL			Key to an archive level. */
+#define A_PARAM_KEY_LEVEL			"lv"
+/** @const A_PARAM_KEY_REFERENCE		Key to the archive of a previous backup. */
+#define A_PARAM_KEY_REFERENCE			"ref"
+/** @const A_PARAM_KEY_COMPRESSION		Key to the compression decision of an item. */
+#define A_PARAM_KEY_COMPRESSION			"zm"
+/** @const A_PARAM_KEY_RATIO			Key to the compression ratio of an item. */
+#define A_PARAM_KEY_RATIO			"zr"
+/** @const A_PARAM_KEY_DISK_PEAK		Key to the peak disk space used by the backup of an item. */
+#define A_PARAM_KEY_DISK_PEAK			"dp"
+/** @const A_PARAM_KEY_LOGICAL_SIZE		Key to the size of the archived files of an item. */
+#define A_PARAM_KEY_LOGICAL_SIZE		"ls"
+/** @const A_PARAM_KEY_PHYSICAL_SIZE		Key to the size of the data read from the archived files of an item. */
+#define A_PARAM_KEY_PHYSICAL_SIZE		"ps"
+/** @const A_PARAM_KEY_SKIP_GTID		Key to the flag which keeps the purged GTIDs out of a database dump. */
+#define A_PARAM_KEY_SKIP_GTID			"ng"
 /** @const A_PARAM_KEY_AUTH_DATABASE		Key to an authentication database. */
 #define A_PARAM_KEY_AUTH_DATABASE		"ad"
+/** @const A_PARAM_KEY_PARALLEL_COLLECTIONS	Key to the number of collections dumped at the same time. */
+#define A_PARAM_KEY_PARALLEL_COLLECTIONS	"pc"
+/** @const A_PARAM_KEY_COLLECTIONS		Key to the sizes of the collections of a database dump. */
+#define A_PARAM_KEY_COLLECTIONS			"cl"
 
 /* ********** ENCRYPTION METHOD PARAM CHARACTERS ********** */
 /** @const A_CRYPT_OPENSSL	OpenSSL. */
@@ -266,6 +420,8 @@
 #define A_CHAR_CRYPT_SCRYPT	's'
 /** @const A_CRYPT_GPG		GPG. */
 #define A_CHAR_CRYPT_GPG	'g'
+/** @const A_CRYPT_ARKIV	Native encryption (ChaCha20-Poly1305). */
+#define A_CHAR_CRYPT_ARKIV	'a'
 
 /* ********** COMPRESSION ALGORITHM PARAM CHARACTERS ********** */
 /** @const A_COMPRESS_NONE	Flat tar'ed file without compression. */
@@ -296,6 +452,10 @@
 #define A_DB_ALL_DATABASES_DEFINITION	"*"
 /** @const A_DB_ALL_DATABASES_FILENAME		Name of the dumpfile for all databases. */
 #define A_DB_ALL_DATABASES_FILENAME	"__all_databases__"
+/** @const A_DB_MANIFEST_EXT		Extension of the manifest listing the dumps of all databases. */
+#define A_DB_MANIFEST_EXT		"manifest"
+/** @const A_DB_BINLOG_EXT		Extension of the binary logs archived by incremental MySQL backups. */
+#define A_DB_BINLOG_EXT			"binlog"
 
 /* ********** WEB PROGAMS ********** */
 /**
@@ -321,12 +481,14 @@ typedef enum {
  * @field	A_CRYPT_OPENSSL	OpenSSL.
  * @field	A_CRYPT_SCRYPT	scrypt.
  * @field	A_CRYPT_GPG	Gnu Privacy Guard.
+ * @field	A_CRYPT_ARKIV	Native encryption (ChaCha20-Poly1305).
  */
 typedef enum {
 	A_CRYPT_UNDEF = 0,
 	A_CRYPT_OPENSSL,
 	A_CRYPT_SCRYPT,
-	A_CRYPT_GPG
+	A_CRYPT_GPG,
+	A_CRYPT_ARKIV
 } encrypt_type_t;
 /**
  * @typedef	compress_type_t
@@ -360,6 +522,18 @@ typedef enum {
 	A_RETENTION_MONTHS,
 	A_RETENTION_YEARS
 } retention_type_t;
+/**
+ * @typedef	incremental_type_t
+ * @abstract	Defines a type of incremental file backup.
+ * @field	A_INCREMENTAL_CHAIN		Each archive contains the changes since the previous one
+ *						(level 1, then 2, 3...).
+ * @field	A_INCREMENTAL_DIFFERENTIAL	Each archive contains the changes since the last full
+ *						backup (always level 1).
+ */
+typedef enum {
+	A_INCREMENTAL_CHAIN = 0,
+	A_INCREMENTAL_DIFFERENTIAL
+} incremental_type_t;
 /**
  * @typedef	database_type_t
  * @abstract	Defines a type of database.
@@ -379,6 +553,7 @@ typedef enum {
  * @field	conf_path			Path to the configuration file.
  * @field	debug_mode			True if the debug mode was set.
  * @field	log_fd				File descriptor to the log file.
+ * @field	log_lines			List of buffered log lines (used by concurrent workers).
  * @field	datetime_chunk_path		Date and time string.
  * @field	backup_path			Real path to the backup directory.
  * @field	backup_files_path		Path to the files backup directory.
@@ -398,13 +573,52 @@ typedef enum {
  * @field	conf.param_url			URL to the parameter file.
  * @field	conf.api_base_url		Base of API URL.
  * @field	conf.param_file			Path to the local parameter file.
+ * @field	conf.streaming			True if archives are created in one pass (tar, compression,
+ *						encryption and checksum chained through pipes).
+ * @field	conf.file_workers		Number of concurrent file backups (0 if not set).
+ * @field	conf.db_workers			Number of concurrent database backups (0 if not set).
+ * @field	conf.upload_queue		True if items are uploaded as soon as they are ready,
+ *						while the next items are backed up.
+ * @field	conf.compress_level		Compression level (0 for the program's default).
+ * @field	conf.compress_threads		Number of compression threads, used by zstd and xz
+ *						(0 for the program's default).
+ * @field	conf.dedup			True if archives are cut into chunks, stored only once on
+ *						the storage.
+ * @field	conf.skip_unchanged		True if paths which didn't change since their last
+ *						backup are not backed up again.
+ * @field	conf.native_tar			True if archives of full backups are created by the agent
+ *						instead of the tar program.
+ * @field	conf.volume_size		Size of archive volumes, in MB (0 if archives are not
+ *						split into volumes).
+ * @field	conf.compress_auto		True if the compressibility of each item is estimated, and
+ *						incompressible items are compressed at the fastest level.
+ * @field	conf.read_limit			Read rate limit, in MB per second (0 for no limit).
+ * @field	conf.write_limit		Write rate limit, in MB per second (0 for no limit).
+ * @field	conf.io_idle			True if the backup uses the idle I/O scheduling class, and
+ *						doesn't keep the archives in the page cache.
+ * @field	conf.cpu_nice			Nice value of the backup (0 to keep the current value).
+ * @field	conf.cpu_idle			True if the backup uses the idle CPU scheduling policy.
+ * @field	conf.cpu_set			List of CPUs usable by the backup ("0-3,6"; NULL if not set).
+ * @field	conf.cpu_max			Maximum number of cores used by the backup (0 for no limit).
+ * @field	conf.memory_high		Memory limit of the backup, in MB (0 for no limit).
+ * @field	conf.dump_jobs			Number of concurrent connections used to dump a database
+ *						(0 or 1 for a single connection). PostgreSQL databases
+ *						are then dumped in directory format, and the databases
+ *						of a '*' entry are dumped separately (except the MySQL
+ *						ones of incremental backups).
+ * @field	conf.wal_batch			Number of spooled WAL segments which triggers their upload
+ *						(0 or 1 to upload each segment when it is archived).
+ * @field	conf.wal_spool			Maximum size of the WAL segments spool, in MB (0 for no
+ *						limit). Above it, the archiving of a segment fails.
  * @field	bin.rclone			Path to the rclone program.
  * @field	bin.find			Path to the find program.
  * @field	bin.tar				Path to the tar program.
  * @field	bin.z				Path to the compression program.
  * @field	bin.crypt			Path to the encryption program.
- * @field	bin.checksum			Path to sha512sum.
+ * @field	bin.mysql			Path to the mysql client.
  * @field	bin.mysqldump			Path to mysqldump.
+ * @field	bin.mysqlbinlog			Path to mysqlbinlog.
+ * @field	bin.psql			Path to the psql client.
  * @field	bin.pg_dump			Path to pg_dump.
  * @field	bin.pg_dumpall			Path to pg_dumpall.
  * @field	bin.mongodump			Path to mongodump.
@@ -415,13 +629,33 @@ typedef enum {
  * @field	param.retention_type		Type of distant retention.
  * @field	param.retention_duration	Duration of the distant retention.
  * @field	param.savepack_id		Identifier of the used saepack.
+ * @field	param.full_every		Number of runs between two full backups of the files and
+ *						MySQL databases (0 or 1 to always do full backups).
+ * @field	param.incremental_type		Type of incremental file and MySQL backups.
  * @field	param.pre_scripts		List of pre-scripts.
  * @field	param.post_scripts		List of post-scripts.
  * @field	param.files			List of files to back up.
  * @field	param.databases			List of databases to back up.
+ * @field	param.file_workers		Number of concurrent file backups.
+ * @field	param.db_workers		Number of concurrent database backups.
  * @field	param.storage_name		Name of the used storage.
  * @field	param.storage			Associative array of storage parameters.
  * @field	param.storage_env		List of environment variables for the storage setting.
+ * @field	param.wal_storage_name		Name of the storage of the WAL segments.
+ * @field	param.wal_storage		Associative array of the parameters of the storage of
+ *						the WAL segments.
+ * @field	crypt_key			Pointer to the master key of the native encryption,
+ *						derived once per execution (NULL if not used).
+ * @field	upload_queue			Pointer to the running upload queue (NULL if not used).
+ * @field	dedup				Pointer to the index of stored chunks (NULL if the
+ *						deduplication is not used).
+ * @field	journal				Pointer to the journal of the run (NULL if not used).
+ * @field	read_throttle			Pointer to the read rate limit (NULL if not used).
+ * @field	write_throttle			Pointer to the write rate limit (NULL if not used).
+ * @field	mysqldump_source_opt		mysqldump option which writes the position in the binary
+ *						logs, probed once per run (NULL if not needed).
+ * @field	mysqldump_gtid			True if mysqldump has the --set-gtid-purged option
+ *						(MySQL, not MariaDB), probed once per run.
  * @field	exec_log.pre_scripts		List of executed pre-scripts, with a status.
  * @field	exec_log.backup_files		List of backed up files, with a status.
  * @field	exec_log.backup_databases	List of backed up databases, with a status.
@@ -431,6 +665,7 @@ typedef enum {
  * @field	exec_log.status_files		Status of the files backup.
  * @field	exec_log.status_databases	Status of the databases backup.
  * @field	exeec_log.status_post_scripts	Status of the post-scripts execution.
+ * @field	exec_log.cpu_time		CPU time consumed by the run, in seconds.
  */
 typedef struct agent_s {
 	time_t exec_timestamp;
@@ -438,6 +673,7 @@ typedef struct agent_s {
 	ystr_t conf_path;
 	bool debug_mode;
 	FILE *log_fd;
+	yarray_t log_lines;
 	ystr_t datetime_chunk_path;
 	ystr_t backup_path;
 	ystr_t backup_files_path;
@@ -458,6 +694,28 @@ typedef struct agent_s {
 		ystr_t param_url;
 		ystr_t api_base_url;
 		ystr_t param_file;
+		bool streaming;
+		uint16_t file_workers;
+		uint16_t db_workers;
+		bool upload_queue;
+		uint8_t compress_level;
+		uint16_t compress_threads;
+		bool dedup;
+		bool skip_unchanged;
+		bool native_tar;
+		uint32_t volume_size;
+		bool compress_auto;
+		uint32_t read_limit;
+		uint32_t write_limit;
+		bool io_idle;
+		uint8_t cpu_nice;
+		bool cpu_idle;
+		ystr_t cpu_set;
+		uint16_t cpu_max;
+		uint32_t memory_high;
+		uint16_t dump_jobs;
+		uint16_t wal_batch;
+		uint32_t wal_spool;
 	} conf;
 	struct {
 		ystr_t rclone;
@@ -465,8 +723,10 @@ typedef struct agent_s {
 		ystr_t tar;
 		ystr_t z;
 		ystr_t crypt;
-		ystr_t checksum;
+		ystr_t mysql;
 		ystr_t mysqldump;
+		ystr_t mysqlbinlog;
+		ystr_t psql;
 		ystr_t pg_dump;
 		ystr_t pg_dumpall;
 		ystr_t mongodump;
@@ -479,15 +739,29 @@ typedef struct agent_s {
 		retention_type_t retention_type;
 		uint8_t retention_duration;
 		uint64_t savepack_id;
+		uint16_t full_every;
+		incremental_type_t incremental_type;
 		ytable_t *pre_scripts;
 		ytable_t *post_scripts;
 		ytable_t *files;
 		ytable_t *databases;
+		uint16_t file_workers;
+		uint16_t db_workers;
 		ystr_t storage_name;
 		uint64_t storage_id;
 		ytable_t *storage;
 		yarray_t storage_env;
+		ystr_t wal_storage_name;
+		ytable_t *wal_storage;
 	} param;
+	struct encrypt_key_s *crypt_key;
+	struct upload_queue_s *upload_queue;
+	struct dedup_s *dedup;
+	struct journal_s *journal;
+	struct throttle_s *read_throttle;
+	struct throttle_s *write_throttle;
+	const char *mysqldump_source_opt;
+	bool mysqldump_gtid;
 	struct {
 		ytable_t *pre_scripts;
 		ytable_t *backup_files;
@@ -498,6 +772,7 @@ typedef struct agent_s {
 		bool status_files;
 		bool status_databases;
 		bool status_post_scripts;
+		double cpu_time;
 	} exec_log;
 } agent_t;
 
@@ -531,6 +806,14 @@ ystr_t agent_getenv_static(char *envvar, const char *default_value);
  * @param	permissive	True to have a permissive behaviour (no exit on error).
  */
 void agent_load_configuration(agent_t *agent, bool permissive);
+/**
+ * @function	agent_retention
+ * @abstract	Returns the duration of the distant retention (months of 28 days,
+ *		years of 365 days).
+ * @param	agent	Pointer to the agent structure.
+ * @return	The duration in seconds (0 for an infinite retention).
+ */
+int64_t agent_retention(agent_t *agent);
 /**
  * @function	agent_free
  * @abstract	Frees a previously created agent structure.
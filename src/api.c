@@ -1,6 +1,8 @@
 #define __A_API_PRIVATE__
 #include "api.h"
 
+#include <math.h>
+
 #include "yansi.h"
 #include "yvar.h"
 #include "yfile.h"
@@ -89,7 +91,8 @@ ystatus_t api_backup_report(agent_t *agent) {
 	// encryption type
 	char *e = (agent->param.encryption == A_CRYPT_OPENSSL) ? "o" :
 	          (agent->param.encryption == A_CRYPT_SCRYPT) ? "s" :
-	          (agent->param.encryption == A_CRYPT_GPG) ? "g" : "u";
+	          (agent->param.encryption == A_CRYPT_GPG) ? "g" :
+	          (agent->param.encryption == A_CRYPT_ARKIV) ? "a" : "u";
 	if (!(var = yvar_new_const_string(e))) {
 		st = YENOMEM;
 		goto cleanup;
@@ -213,9 +216,18 @@ ystatus_t api_backup_report(agent_t *agent) {
 		if ((st = ytable_set_key(root, "st_db", var)) != YENOERR)
 			goto cleanup;
 	}
+	// CPU time, in seconds
+	if (agent->exec_log.cpu_time > 0.0) {
+		if (!(var = yvar_new_float(round(agent->exec_log.cpu_time * 100.0) / 100.0))) {
+			st = YENOMEM;
+			goto cleanup;
+		}
+		if ((st = ytable_set_key(root, "cpu", var)) != YENOERR)
+			goto cleanup;
+	}
 	// API URL
 	apiUrl = ys_new(agent->conf.api_base_url);
-	if (!ys_append(&apiUrl, A_API_BACKUP_REPORT_SUFFIX)) {
+	if (ys_append(&apiUrl, A_API_BACKUP_REPORT_SUFFIX) != YENOERR) {
 		st = YENOMEM;
 		goto cleanup;
 	}
@@ -586,6 +598,60 @@ static ystatus_t api_report_process_item(uint64_t hash, char *key, void *data, v
 			return (YENOMEM);
 		ytable_set_key(yvar_get_table(entry), A_PARAM_KEY_SIZE, var);
 	}
+	// adaptive compression: decision, and ratio when the size of the data is known
+	if (item->success && item->compress_mode != A_ZMODE_DEFAULT) {
+		if (!(var = yvar_new_const_string((item->compress_mode == A_ZMODE_FAST) ? "fast" : "normal")))
+			return (YENOMEM);
+		ytable_set_key(yvar_get_table(entry), A_PARAM_KEY_COMPRESSION, var);
+		if (item->data_size && item->archive_size) {
+			if (!(var = yvar_new_float(round((double)item->data_size / (double)item->archive_size * 100.0) / 100.0)))
+				return (YENOMEM);
+			ytable_set_key(yvar_get_table(entry), A_PARAM_KEY_RATIO, var);
+		}
+	}
+	// peak disk space used by the backup
+	if (item->success && item->disk_peak) {
+		if (!(var = yvar_new_int(item->disk_peak)))
+			return (YENOMEM);
+		ytable_set_key(yvar_get_table(entry), A_PARAM_KEY_DISK_PEAK, var);
+	}
+	// logical and physical sizes of the archived files (they differ for sparse files)
+	if (item->success && item->logical_size) {
+		if (!(var = yvar_new_int(item->logical_size)))
+			return (YENOMEM);
+		ytable_set_key(yvar_get_table(entry), A_PARAM_KEY_LOGICAL_SIZE, var);
+		if (!(var = yvar_new_int(item->physical_size)))
+			return (YENOMEM);
+		ytable_set_key(yvar_get_table(entry), A_PARAM_KEY_PHYSICAL_SIZE, var);
+	}
+	// sizes of the collections of a MongoDB dump
+	if (item->success && item->dump_parts) {
+		ytable_t *parts;
+
+		if (!(var = yvar_new_table(NULL)))
+			return (YENOMEM);
+		parts = yvar_get_table(var);
+		for (size_t i = 0; i < yarray_length(item->dump_parts); ++i) {
+			log_part_t *part = item->dump_parts[i];
+			yvar_t *size = yvar_new_int((int64_t)part->size);
+
+			if (!size || ytable_set_key(parts, part->name, size) != YENOERR)
+				return (YENOMEM);
+		}
+		ytable_set_key(yvar_get_table(entry), A_PARAM_KEY_COLLECTIONS, var);
+	}
+	// for files and MySQL databases, add the archive level (needed to rebuild incremental restore chains)
+	if (item->type == A_ITEM_TYPE_FILE || item->type == A_ITEM_TYPE_DB_MYSQL) {
+		if (!(var = yvar_new_int(item->level)))
+			return (YENOMEM);
+		ytable_set_key(yvar_get_table(entry), A_PARAM_KEY_LEVEL, var);
+		// an unchanged path references the archive of its previous backup
+		if (item->unchanged && item->reference) {
+			if (!(var = yvar_new_string(ys_copy(item->reference))))
+				return (YENOMEM);
+			ytable_set_key(yvar_get_table(entry), A_PARAM_KEY_REFERENCE, var);
+		}
+	}
 	// for databases, add the database type
 	if (item->type == A_ITEM_TYPE_DB_MYSQL ||
 	    item->type == A_ITEM_TYPE_DB_PGSQL ||
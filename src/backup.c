@@ -2,15 +2,33 @@
 #include <inttypes.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include "yansi.h"
 #include "ytable.h"
 #include "yvar.h"
 #include "yfile.h"
+#include "yjson.h"
 #include "yexec.h"
+#include "ypool.h"
+#include "yhash.h"
 #include "log.h"
 #include "api.h"
 #include "utils.h"
 #include "upload.h"
+#include "encrypt.h"
+#include "dedup.h"
+#include "changes.h"
+#include "volume.h"
+#include "journal.h"
+#include "entropy.h"
+#include "throttle.h"
+#include "resources.h"
+#include "dbdump.h"
+#include "wal.h"
 
 #define __A_BACKUP_PRIVATE__
 #include "backup.h"
@@ -38,15 +56,11 @@ void exec_backup(agent_t *agent) {
 		ALOG(YANSI_RED "Abort" YANSI_RESET);
 		return;
 	}
-	// get sha512sum path
-	if (!(agent->bin.checksum = get_program_path("sha512sum"))) {
-		ALOG("Search local programs");
-		ALOG("└ " YANSI_RED "Unable to find " YANSI_RESET "sha512sum" YANSI_RED " program" YANSI_RESET);
-		ALOG(YANSI_RED "Abort" YANSI_RESET);
-		return;
-	}
 	// get database dump programs path
+	agent->bin.mysql = get_program_path("mysql");
 	agent->bin.mysqldump = get_program_path("mysqldump");
+	agent->bin.mysqlbinlog = get_program_path("mysqlbinlog");
+	agent->bin.psql = get_program_path("psql");
 	agent->bin.pg_dump = get_program_path("pg_dump");
 	agent->bin.pg_dumpall = get_program_path("pg_dumpall");
 	agent->bin.mongodump = get_program_path("mongodump");
@@ -67,9 +81,11 @@ void exec_backup(agent_t *agent) {
 		return;
 	}
 	ALOG("└ " YANSI_GREEN "Done" YANSI_RESET);
+	// upload the WAL segments left in the spool by the archiving command
+	wal_flush(agent);
 
-	/* purge old local archives */
-	if (backup_purge_local(agent) != YENOERR) {
+	/* purge old local archives (an interrupted run of the current schedule slot is kept) */
+	if (backup_purge_local(agent, true) != YENOERR) {
 		ALOG(YANSI_BG_RED "Abort" YANSI_RESET);
 		return;
 	}
@@ -98,19 +114,44 @@ void exec_backup(agent_t *agent) {
 			ALOG(YANSI_BG_RED "Abort" YANSI_RESET);
 			return;
 		}
+		// open the journal of the run (the stages completed by an interrupted run are not redone)
+		agent->journal = journal_open(agent);
+		// CPU and memory controls (inherited by the threads and programs created afterwards, scripts included)
+		resources_apply(agent);
 		// execute pre-scripts
 		if (backup_exec_scripts(agent, A_SCRIPT_TYPE_PRE) == YENOERR) {
+			// open the index of stored chunks (archives are cut into chunks, uploaded once)
+			if (agent->conf.dedup)
+				agent->dedup = dedup_open(agent);
+			// start the upload queue (items are encrypted and uploaded as soon as they are backed up)
+			if (agent->conf.upload_queue)
+				upload_queue_start(agent);
+			// I/O controls (the idle I/O class is inherited by the threads and programs created afterwards)
+			backup_io_control(agent);
 			// backup files
 			backup_files(agent);
 			// backup databases
 			backup_databases(agent);
-			// encrypt files
-			backup_encrypt_files(agent);
-			// compute checksums
-			backup_compute_checksums(agent);
+			// effective throughput of the limited streams
+			if (agent->read_throttle || agent->write_throttle) {
+				ALOG("I/O rate limits");
+				throttle_log(agent, agent->read_throttle, "Read", !agent->write_throttle);
+				throttle_log(agent, agent->write_throttle, "Written", true);
+			}
+			if (!agent->upload_queue) {
+				// encrypt files
+				backup_encrypt_files(agent);
+				// compute checksums
+				backup_compute_checksums(agent);
+			}
 			// upload files
 			upload_files(agent);
+			// the incremental states of the archives which were not uploaded are removed
+			ytable_foreach(agent->exec_log.backup_files, backup_incremental_cleanup, agent);
+			ytable_foreach(agent->exec_log.backup_databases, backup_incremental_cleanup, agent);
 		}
+		// CPU time consumed by the agent and its sub-programs
+		resources_usage(agent);
 	}
 	// send report
 	ALOG("Send report to arkiv.sh");
@@ -131,90 +172,19 @@ void exec_backup(agent_t *agent) {
 	}
 	// purge archive if needed
 	if (!agent->param.local_retention_hours) {
-		backup_purge_local(agent);
+		backup_purge_local(agent, false);
 	}
 }
 
-/* ********** PRIVATE FUNCTIONS ********** */
-/* Purge local archive files. */
-static ystatus_t backup_purge_local(agent_t *agent) {
-	ystatus_t status = YENOERR;
-	yarray_t args = NULL;
-	ystr_t ys = NULL;
-
-	ALOG("Purge local archives");
-	if (!(args = yarray_create(6))) {
-		ALOG("└ " YANSI_RED "Memory allocation error" YANSI_RESET);
-		return (YENOMEM);
-	}
-	// check if files may be purged
-	if (!yfile_is_dir(agent->conf.archives_path)) {
-		ADEBUG("├ " YANSI_FAINT "No directory " YANSI_RESET "%s", agent->conf.archives_path);
-		ALOG("└ " YANSI_GREEN "Pass" YANSI_RESET);
-		return (YENOERR);
-	}
-	// removes files older than the configured duration
-	ADEBUG("├ " YANSI_FAINT "Delete archives older than %d hours" YANSI_RESET, agent->param.local_retention_hours);
-	yarray_push_multi(
-		&args,
-		3,
-		agent->conf.archives_path,
-		"-type",
-		"f"
-	);
-	if (agent->param.local_retention_hours > 0) {
-		ys = ys_printf(NULL, "+%d", (agent->param.local_retention_hours * 60));
-		yarray_push_multi(&args, 2, "-mmin", ys);
-	}
-	yarray_push(&args, "-delete");
-	status = yexec(agent->bin.find, args, NULL, NULL, NULL);
-	if (status == YENOERR) {
-		ADEBUG("│ └ " YANSI_GREEN "Done" YANSI_RESET);
-	} else {
-		ALOG("└ " YANSI_RED "Error" YANSI_RESET);
-		goto cleanup;
-	}
-	ys_delete(&ys);
-	/* removes empty directories */
-	ADEBUG("├ " YANSI_FAINT "Delete empty archive folders" YANSI_RESET);
-	// first, create a file to avoid the deletion of the root archives directory
-	ys = ys_printf(NULL, "%s/purge_time", agent->conf.archives_path);
-	if (!ys) {
-		ALOG("└ " YANSI_RED "Memory allocation error" YANSI_RESET);
-		goto cleanup;
-	}
-	yfile_touch(ys, 0600, 0700);
-	// then remove the empty directories
-	yarray_trunc(args, NULL, NULL);
-	yarray_push_multi(
-		&args,
-		5,
-		agent->conf.archives_path,
-		"-type",
-		"d",
-		"-empty",
-		"-delete"
-	);
-	status = yexec(agent->bin.find, args, NULL, NULL, NULL);
-	if (status == YENOERR) {
-		ADEBUG("│ └ " YANSI_GREEN "Done" YANSI_RESET);
-	} else {
-		ALOG("└ " YANSI_RED "Execution error" YANSI_RESET);
-		goto cleanup;
-	}
-	// and finally the file is deleted
-	unlink(ys);
-	ALOG("└ " YANSI_GREEN "Done" YANSI_RESET);
-cleanup:
-	ys_free(ys);
-	yarray_free(args);
-	return (status);
-}
 /* Fetch and process host backup parameter file. */
-static ystatus_t backup_fetch_params(agent_t *agent) {
+ystatus_t backup_fetch_params(agent_t *agent) {
+	return (backup_fetch_params_cache(agent, NULL, 0));
+}
+/* Fetch and process host backup parameter file, using a local copy if it is recent enough. */
+ystatus_t backup_fetch_params_cache(agent_t *agent, const char *cache_path, time_t ttl) {
 	ALOG("Fetch host parameters");
 	// fetch params file
-	yvar_t *params = api_get_params_file(agent);
+	yvar_t *params = cache_path ? backup_params_cache(agent, cache_path, ttl) : api_get_params_file(agent);
 	if (!params) {
 		ALOG("└ " YANSI_RED "Failed (unable to download or deserialize the file)" YANSI_RESET);
 		return (YEBADCONF);
@@ -254,6 +224,15 @@ static ystatus_t backup_fetch_params(agent_t *agent) {
 			agent->param.encryption = A_CRYPT_OPENSSL;
 			ADEBUG("│ └ openssl");
 			break;
+		} else if (c == A_CHAR_CRYPT_ARKIV) {
+			// the key is derived once (unless it was read from a cache), and used for all the archives
+			if (!agent->crypt_key && !(agent->crypt_key = encrypt_key_new(agent->conf.crypt_pwd))) {
+				ALOG("└ " YANSI_RED "Failed (unable to derive the encryption key)" YANSI_RESET);
+				return (YENOMEM);
+			}
+			agent->param.encryption = A_CRYPT_ARKIV;
+			ADEBUG("│ └ arkiv (ChaCha20-Poly1305)");
+			break;
 		}
 	}
 	if (agent->param.encryption == A_CRYPT_UNDEF) {
@@ -296,6 +275,27 @@ static ystatus_t backup_fetch_params(agent_t *agent) {
 			break;
 		}
 	}
+	// extract the storage of the WAL segments (the first declared storage by default)
+	yvar_t *wal_storage = NULL;
+	var_ptr = yvar_get_from_path(params, A_PARAM_PATH_WAL_STORAGE);
+	if (var_ptr && yvar_is_int(var_ptr)) {
+		ystr_t wal_path = ys_printf(NULL, "%s/%" PRId64, A_PARAM_PATH_STORAGES, yvar_get_int(var_ptr));
+		if (!wal_path) {
+			ALOG("└ " YANSI_RED "Memory allocation error" YANSI_RESET);
+			return (YENOMEM);
+		}
+		wal_storage = yvar_get_from_path(params, wal_path);
+		ys_free(wal_path);
+	} else {
+		ytable_foreach(yvar_get_table(yvar_get_from_path(params, A_PARAM_PATH_STORAGES)), backup_first_storage,
+		               &wal_storage);
+	}
+	if (wal_storage && yvar_is_table(wal_storage) &&
+	    (var_ptr = yvar_get_from_path(wal_storage, A_PARAM_PATH_NAME)) && yvar_is_string(var_ptr)) {
+		agent->param.wal_storage = yvar_get_table(wal_storage);
+		agent->param.wal_storage_name = yvar_get_string(var_ptr);
+		ADEBUG("├ " YANSI_FAINT "WAL segments storage: " YANSI_RESET "%s", agent->param.wal_storage_name);
+	}
 	// extract local retention
 	var_ptr = yvar_get_from_path(params, A_PARAM_PATH_RETENTION_HOURS);
 	int64_t retention_int = yvar_get_int(var_ptr);
@@ -370,6 +370,23 @@ static ystatus_t backup_fetch_params(agent_t *agent) {
 	int64_t storage_id = yvar_get_int(var_ptr2);
 	ADEBUG("│ └ " YANSI_FAINT "Storage ID: " YANSI_RESET "%" PRId64, storage_id);
 	agent->param.storage_id = storage_id;
+	// from the schedule, get the incremental parameters
+	ADEBUG("├ " YANSI_FAINT "From the schedule, extract the incremental backup parameters" YANSI_RESET);
+	var_ptr2 = yvar_get_from_path(schedule, A_PARAM_PATH_FULL_EVERY);
+	agent->param.full_every = 0;
+	if (var_ptr2 && yvar_is_int(var_ptr2) && yvar_get_int(var_ptr2) > 0 &&
+	    yvar_get_int(var_ptr2) <= UINT16_MAX)
+		agent->param.full_every = (uint16_t)yvar_get_int(var_ptr2);
+	var_ptr2 = yvar_get_from_path(schedule, A_PARAM_PATH_INCREMENTAL_TYPE);
+	ystr_t inc_type = (var_ptr2 && yvar_is_string(var_ptr2)) ? yvar_get_string(var_ptr2) : NULL;
+	agent->param.incremental_type = (!ys_empty(inc_type) && inc_type[0] == 'd') ?
+	                                A_INCREMENTAL_DIFFERENTIAL : A_INCREMENTAL_CHAIN;
+	if (agent->param.full_every <= 1)
+		ADEBUG("│ └ " YANSI_FAINT "Full backups only" YANSI_RESET);
+	else
+		ADEBUG("│ └ " YANSI_FAINT "Full backup every " YANSI_RESET "%d" YANSI_FAINT " runs, %s otherwise" YANSI_RESET,
+		       agent->param.full_every,
+		       (agent->param.incremental_type == A_INCREMENTAL_DIFFERENTIAL) ? "differential" : "incremental");
 
 	// search the savepack
 	ADEBUG("├ " YANSI_FAINT "Search for the savepack from its ID" YANSI_RESET);
@@ -413,6 +430,23 @@ static ystatus_t backup_fetch_params(agent_t *agent) {
 		ADEBUG("│ └ %d" YANSI_FAINT " database(s)" YANSI_RESET, ytable_length(agent->param.databases));
 	} else
 		ADEBUG("│ └ " YANSI_FAINT "No database" YANSI_RESET);
+	// get the number of concurrent backups (the local configuration has precedence)
+	var_ptr2 = yvar_get_from_path(params, A_PARAM_PATH_FILE_WORKERS);
+	agent->param.file_workers = 1;
+	if (var_ptr2 && yvar_is_int(var_ptr2) && yvar_get_int(var_ptr2) > 0 &&
+	    yvar_get_int(var_ptr2) <= A_MAX_WORKERS)
+		agent->param.file_workers = (uint16_t)yvar_get_int(var_ptr2);
+	if (agent->conf.file_workers)
+		agent->param.file_workers = agent->conf.file_workers;
+	var_ptr2 = yvar_get_from_path(params, A_PARAM_PATH_DB_WORKERS);
+	agent->param.db_workers = 1;
+	if (var_ptr2 && yvar_is_int(var_ptr2) && yvar_get_int(var_ptr2) > 0 &&
+	    yvar_get_int(var_ptr2) <= A_MAX_WORKERS)
+		agent->param.db_workers = (uint16_t)yvar_get_int(var_ptr2);
+	if (agent->conf.db_workers)
+		agent->param.db_workers = agent->conf.db_workers;
+	ADEBUG("├ " YANSI_FAINT "Concurrent backups: " YANSI_RESET "%d" YANSI_FAINT " file(s), " YANSI_RESET "%d" YANSI_FAINT " database(s)" YANSI_RESET,
+	       agent->param.file_workers, agent->param.db_workers);
 
 	// search the storage
 	ADEBUG("├ " YANSI_FAINT "Search for the storage from its ID" YANSI_RESET);
@@ -438,15 +472,237 @@ static ystatus_t backup_fetch_params(agent_t *agent) {
 	
 	return (YENOERR);
 }
-/* Create output directory. */
-static ystatus_t backup_create_output_directory(agent_t *agent) {
+/* Stream a local file through the compression, encryption and checksum stages of the archives. */
+ystatus_t backup_stream_file(agent_t *agent, log_item_t *log, const char *path) {
+	return (backup_stream_item(agent, log, NULL, backup_file_input, (void*)path));
+}
+
+/* Keep the state file of an uploaded incremental backup, and update the number of runs. */
+ystatus_t backup_incremental_commit(agent_t *agent, log_item_t *log) {
+	ystatus_t status = YENOERR;
+	ystr_t ys = NULL;
+	char buffer[16];
+
+	if (!log->state_tmp)
+		return (YENOERR);
+	if (!(ys = ys_printf(NULL, "%s.%d.%s", log->state_path, log->level, log->state_ext))) {
+		ALOG("│ ├ " YANSI_YELLOW "Memory allocation error, snapshot not kept" YANSI_RESET);
+		backup_incremental_discard(log);
+		return (YENOMEM);
+	}
+	if (rename(log->state_tmp, ys)) {
+		ALOG("│ ├ " YANSI_YELLOW "Unable to move snapshot file " YANSI_RESET "%s" YANSI_YELLOW " to " YANSI_RESET "%s",
+		     log->state_tmp, ys);
+		backup_incremental_discard(log);
+		status = YEIO;
+		goto cleanup;
+	}
+	free0(log->state_tmp);
+	ys_delete(&ys);
+	snprintf(buffer, sizeof(buffer), "%d", log->level ? (log->state_runs + 1) : 0);
+	if (!(ys = ys_printf(NULL, "%s.runs", log->state_path)) || !yfile_put_string(ys, buffer)) {
+		ALOG("│ ├ " YANSI_YELLOW "Unable to write incremental state" YANSI_RESET);
+		status = YEIO;
+		goto cleanup;
+	}
+cleanup:
+	ys_free(ys);
+	return (status);
+}
+/* Remove the state file of an incremental backup which was not uploaded. */
+void backup_incremental_discard(log_item_t *log) {
+	if (!log->state_tmp)
+		return;
+	unlink(log->state_tmp);
+	free0(log->state_tmp);
+}
+
+/* ********** PRIVATE FUNCTIONS ********** */
+
+/* Read the host parameters from a local copy, or download them and update the copy. */
+static yvar_t *backup_params_cache(agent_t *agent, const char *cache_path, time_t ttl) {
+	yvar_t *params = NULL;
+	ystr_t tmp_path = NULL;
+	FILE *file = NULL;
+	struct stat st;
+	time_t now = time(NULL);
+	int fd;
+
+	if (!stat(cache_path, &st) && st.st_mtime <= now && (now - st.st_mtime) < ttl &&
+	    (params = backup_params_read(cache_path))) {
+		ADEBUG("├ " YANSI_FAINT "Read local copy: " YANSI_RESET "%s", cache_path);
+		return (params);
+	}
+	if (!(params = api_get_params_file(agent))) {
+		// the server is not reachable, the previous parameters are used
+		if ((params = backup_params_read(cache_path)))
+			ALOG("├ " YANSI_YELLOW "Unable to download the file, use the local copy" YANSI_RESET);
+		return (params);
+	}
+	// the copy contains the storages' credentials, it is written in a temporary file readable by its owner
+	if (!(tmp_path = ys_printf(NULL, "%s.%d", cache_path, (int)getpid())) ||
+	    (fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) == -1)
+		goto cleanup;
+	if (!(file = fdopen(fd, "w"))) {
+		close(fd);
+		unlink(tmp_path);
+		goto cleanup;
+	}
+	yjson_fprint(file, params, false);
+	if (ferror(file) | fclose(file) || rename(tmp_path, cache_path)) {
+		ADEBUG("├ " YANSI_YELLOW "Unable to write the local copy" YANSI_RESET);
+		unlink(tmp_path);
+	}
+cleanup:
+	ys_free(tmp_path);
+	return (params);
+}
+/* Read the host parameters from a local copy. */
+static yvar_t *backup_params_read(const char *path) {
+	yjson_parser_t *parser = NULL;
+	yvar_t *params = NULL;
+	ystr_t content;
+
+	if (!(content = yfile_get_string_contents(path)))
+		return (NULL);
+	if ((parser = yjson_new()) && (params = yjson_parse_simple(parser, content)) && !yvar_is_table(params)) {
+		yvar_release(params);
+		params = NULL;
+	}
+	yjson_free(parser);
+	ys_free(content);
+	return (params);
+}
+/* Purge local archive files. */
+static ystatus_t backup_purge_local(agent_t *agent, bool keep_current) {
+	ystatus_t status = YENOERR;
+	yarray_t args = NULL;
+	ystr_t ys = NULL;
+	ystr_t state = NULL;
+	ystr_t index = NULL;
+	ystr_t changes = NULL;
+	ystr_t wal = NULL;
+	ystr_t run = NULL;
+
+	ALOG("Purge local archives");
+	if (!(args = yarray_create(15))) {
+		ALOG("└ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		return (YENOMEM);
+	}
+	// check if files may be purged
+	if (!yfile_is_dir(agent->conf.archives_path)) {
+		ADEBUG("├ " YANSI_FAINT "No directory " YANSI_RESET "%s", agent->conf.archives_path);
+		ALOG("└ " YANSI_GREEN "Pass" YANSI_RESET);
+		return (YENOERR);
+	}
+	// removes files older than the configured duration
+	ADEBUG("├ " YANSI_FAINT "Delete archives older than %d hours" YANSI_RESET, agent->param.local_retention_hours);
+	yarray_push_multi(
+		&args,
+		3,
+		agent->conf.archives_path,
+		"-type",
+		"f"
+	);
+	if (agent->param.local_retention_hours > 0) {
+		ys = ys_printf(NULL, "+%d", (agent->param.local_retention_hours * 60));
+		yarray_push_multi(&args, 2, "-mmin", ys);
+	}
+	// snapshots of incremental backups, the index of stored chunks, the
+	// indexes of backed up paths and the spooled WAL segments are kept
+	if (!(state = ys_printf(NULL, "%s/%s/*", agent->conf.archives_path, A_INCREMENTAL_DIRNAME)) ||
+	    !(index = ys_printf(NULL, "%s/%s/*", agent->conf.archives_path, A_DEDUP_DIRNAME)) ||
+	    !(changes = ys_printf(NULL, "%s/%s/*", agent->conf.archives_path, A_CHANGES_DIRNAME)) ||
+	    !(wal = ys_printf(NULL, "%s/%s/*", agent->conf.archives_path, A_WAL_DIRNAME))) {
+		ALOG("└ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		status = YENOMEM;
+		goto cleanup;
+	}
+	// the directory of an interrupted run of the current schedule slot is resumed
+	if (keep_current && backup_output_path(agent) == YENOERR && journal_exists(agent->backup_path)) {
+		if (!(run = ys_printf(NULL, "%s/*", agent->backup_path))) {
+			ALOG("└ " YANSI_RED "Memory allocation error" YANSI_RESET);
+			status = YENOMEM;
+			goto cleanup;
+		}
+		ADEBUG("├ " YANSI_FAINT "Keep interrupted run " YANSI_RESET "%s", agent->backup_path);
+		yarray_push_multi(&args, 3, "-not", "-path", run);
+	}
+	yarray_push_multi(&args, 13, "-not", "-path", state, "-not", "-path", index, "-not", "-path", changes,
+	                  "-not", "-path", wal, "-delete");
+	status = yexec(agent->bin.find, args, NULL, NULL, NULL);
+	if (status == YENOERR) {
+		ADEBUG("│ └ " YANSI_GREEN "Done" YANSI_RESET);
+	} else {
+		ALOG("└ " YANSI_RED "Error" YANSI_RESET);
+		goto cleanup;
+	}
+	ys_delete(&ys);
+	/* removes empty directories */
+	ADEBUG("├ " YANSI_FAINT "Delete empty archive folders" YANSI_RESET);
+	// first, create a file to avoid the deletion of the root archives directory
+	ys = ys_printf(NULL, "%s/purge_time", agent->conf.archives_path);
+	if (!ys) {
+		ALOG("└ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		goto cleanup;
+	}
+	yfile_touch(ys, 0600, 0700);
+	// then remove the empty directories
+	yarray_trunc(args, NULL, NULL);
+	yarray_push_multi(
+		&args,
+		5,
+		agent->conf.archives_path,
+		"-type",
+		"d",
+		"-empty",
+		"-delete"
+	);
+	status = yexec(agent->bin.find, args, NULL, NULL, NULL);
+	if (status == YENOERR) {
+		ADEBUG("│ └ " YANSI_GREEN "Done" YANSI_RESET);
+	} else {
+		ALOG("└ " YANSI_RED "Execution error" YANSI_RESET);
+		goto cleanup;
+	}
+	// and finally the file is deleted
+	unlink(ys);
+	ALOG("└ " YANSI_GREEN "Done" YANSI_RESET);
+cleanup:
+	ys_free(ys);
+	ys_free(state);
+	ys_free(index);
+	ys_free(changes);
+	ys_free(wal);
+	ys_free(run);
+	yarray_free(args);
+	return (status);
+}
+/* Get the first declared storage. */
+static ystatus_t backup_first_storage(uint64_t hash, char *key, void *data, void *user_data) {
+	*(yvar_t**)user_data = (yvar_t*)data;
+	// the loop is stopped
+	return (YEAGAIN);
+}
+/* Generate the path to the output directory. */
+static ystatus_t backup_output_path(agent_t *agent) {
 	struct tm tm = *gmtime(&agent->exec_timestamp);
 
+	if (agent->backup_path)
+		return (YENOERR);
+	// an execution for the same schedule slot uses the same directory
+	if (!agent->datetime_chunk_path &&
+	    !(agent->datetime_chunk_path = ys_printf(NULL, "%04d-%02d-%02d/%02d:00", tm.tm_year + 1900,
+	                                             tm.tm_mon + 1, tm.tm_mday, tm.tm_hour)))
+		return (YENOMEM);
+	if (!(agent->backup_path = ys_printf(NULL, "%s/%s", agent->conf.archives_path, agent->datetime_chunk_path)))
+		return (YENOMEM);
+	return (YENOERR);
+}
+/* Create output directory. */
+static ystatus_t backup_create_output_directory(agent_t *agent) {
 	// generate path
-	agent->datetime_chunk_path = ys_printf(NULL, "%04d-%02d-%02d/%02d:00", tm.tm_year + 1900,
-	                                       tm.tm_mon + 1, tm.tm_mday, tm.tm_hour);
-	agent->backup_path = ys_printf(NULL, "%s/%s", agent->conf.archives_path, agent->datetime_chunk_path);
-	if (!agent->datetime_chunk_path || !agent->backup_path) {
+	if (backup_output_path(agent) != YENOERR) {
 		ALOG("└ " YANSI_RED "Memory allocation error" YANSI_RESET);
 		return (YENOMEM);
 	}
@@ -585,7 +841,7 @@ static void backup_files(agent_t *agent) {
 		return;
 	}
 	// tar and compress all files
-	st = ytable_foreach(agent->param.files, backup_file, agent);
+	st = backup_items(agent, agent->param.files, backup_file, agent->param.file_workers);
 	if (st == YENOERR)
 		ALOG("└ " YANSI_GREEN "Done" YANSI_RESET);
 	else
@@ -601,6 +857,7 @@ static ystatus_t backup_file(uint64_t hash, char *key, void *data, void *user_da
 	ystr_t filename = NULL;
 	yarray_t args = NULL;
 	char *tmp_file = NULL;
+	ystr_t snar_opt = NULL;
 
 	// checks
 	if (!yvar_is_string(var_file_path) || !(file_path = yvar_get_string(var_file_path))) {
@@ -625,21 +882,77 @@ static ystatus_t backup_file(uint64_t hash, char *key, void *data, void *user_da
 	if (!(filename = ys_filenamize_path(path, ",")) ||
 	    !(log->archive_name = ys_printf(NULL, "%s.tar", filename)) ||
 	    !(log->archive_path = ys_printf(NULL, "%s/%s", agent->backup_files_path, log->archive_name)) ||
-	    !(args = yarray_create(9))) {
+	    !(args = yarray_create(11))) {
 		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
 		status = log->dump_status = YENOMEM;
 		goto cleanup;
 	}
-	if (!(tmp_file = yfile_tmp(log->archive_path))) {
+	// a path archived by an interrupted execution is not archived again
+	if (journal_resume(agent, log)) {
+		backup_incremental_resume(agent, log, filename, A_INCREMENTAL_SNAR_EXT);
+		goto cleanup;
+	}
+	// a path which didn't change since its last backup is not backed up again
+	// (errors are not fatal, the path is just backed up)
+	if (agent->conf.skip_unchanged) {
+		changes_scan(agent, log, file_path, filename);
+		if (log->unchanged) {
+			log->dump_status = log->compress_status = log->encrypt_status = YENOERR;
+			log->checksum_status = log->upload_status = YENOERR;
+			goto cleanup;
+		}
+	}
+	// incremental backup: tar compares the files to the snapshot of the base archive
+	if (agent->param.full_every > 1) {
+		if ((status = backup_incremental_prepare(agent, log, filename, A_INCREMENTAL_SNAR_EXT)) != YENOERR) {
+			log->dump_status = status;
+			goto cleanup;
+		}
+		if (!(snar_opt = ys_printf(NULL, "--listed-incremental=%s", log->state_tmp))) {
+			ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+			status = log->dump_status = YENOMEM;
+			goto cleanup;
+		}
+	}
+	// the size of an incremental archive's data is unknown
+	backup_compress_probe(agent, log, file_path, !snar_opt);
+	// full backups may be archived by the native tar writer (incremental backups need GNU tar)
+	if (agent->conf.native_tar && !snar_opt) {
+		backup_tar_t tar = {
+			.path = path,
+			.fd = -1,
+			.throttle = agent->read_throttle,
+		};
+		ADEBUG("│ ├ " YANSI_FAINT "Native tar " YANSI_RESET "%s", file_path);
+		status = backup_stream_item(agent, log, NULL, backup_tar_write, &tar);
+		ADEBUG("│ ├ " YANSI_FAINT "Files: " YANSI_RESET "%" PRIu64 YANSI_FAINT ", directories: " YANSI_RESET
+		       "%" PRIu64 YANSI_FAINT ", excluded: " YANSI_RESET "%" PRIu64 YANSI_FAINT ", errors: " YANSI_RESET
+		       "%" PRIu64, tar.stats.nbr_files, tar.stats.nbr_dirs, tar.stats.nbr_excluded, tar.stats.nbr_errors);
+		// holes of sparse files are not read
+		log->logical_size = tar.stats.data_size;
+		log->physical_size = tar.stats.physical_size;
+		ALOG("│ ├ " YANSI_FAINT "Logical size: " YANSI_RESET "%" PRIu64 YANSI_FAINT " bytes, physical size: " YANSI_RESET
+		     "%" PRIu64 YANSI_FAINT " bytes (" YANSI_RESET "%" PRIu64 YANSI_FAINT " sparse files)" YANSI_RESET,
+		     log->logical_size, log->physical_size, tar.stats.nbr_sparse);
+		if (status == YENOERR && log->compress_mode != A_ZMODE_DEFAULT && !agent->dedup)
+			log->data_size = tar.stats.data_size;
+		goto cleanup;
+	}
+	// the tar output is streamed when the archive is compressed, encrypted or cut into chunks on the fly,
+	// or when it is written at a limited rate
+	bool stream = (agent->conf.streaming || agent->dedup || agent->conf.volume_size || agent->write_throttle ||
+	               agent->param.compression != A_COMP_NONE) ? true : false;
+	if (!stream && !(tmp_file = yfile_tmp(log->archive_path))) {
 		ALOG("│ └ " YANSI_RED "Unable to create temporary file" YANSI_RESET);
 		status = log->dump_status = YEIO;
 		goto cleanup;
 	}
 	yarray_push_multi(
 		&args,
-		9,
+		10,
 		"cf",
-		tmp_file,
+		(stream ? "-" : tmp_file),
+		"--sparse",
 		"--exclude-caches",
 		"--exclude-tag=.arkiv-exclude",
 		"--exclude-ignore=.arkiv-ignore",
@@ -648,6 +961,18 @@ static ystatus_t backup_file(uint64_t hash, char *key, void *data, void *user_da
 		"/",
 		path
 	);
+	// device numbers may change between reboots (NFS, LVM), only inodes are checked
+	if (snar_opt)
+		yarray_push_multi(&args, 2, snar_opt, "--no-check-device");
+	// tar output is compressed (and, in streaming mode, encrypted and hashed) on the fly
+	if (stream) {
+		yexec_cmd_t dump = {
+			.command = agent->bin.tar,
+			.args = args,
+		};
+		status = backup_stream_item(agent, log, &dump, NULL, NULL);
+		goto cleanup;
+	}
 	// execution
 	ADEBUG("│ ├ " YANSI_FAINT "Tar " YANSI_RESET "%s" YANSI_FAINT " to " YANSI_RESET "%s", file_path, log->archive_path);
 	status = yexec(agent->bin.tar, args, NULL, NULL, NULL);
@@ -665,68 +990,344 @@ static ystatus_t backup_file(uint64_t hash, char *key, void *data, void *user_da
 		unlink(tmp_file);
 		goto cleanup;
 	}
-	// compression of the file
-	status = backup_compress_file(agent, log);
 	// get archive file's size
 	log->archive_size = yfile_get_size(log->archive_path);
+	backup_drop_cache(agent, log);
 cleanup:
-	if (status != YENOERR)
+	// the snapshot is kept only once the archive is uploaded, so the next run
+	// is based on the last archive which reached the storage
+	if (status != YENOERR) {
 		agent->exec_log.status_files = false;
-	if (log)
+		if (log)
+			backup_incremental_discard(log);
+	}
+	if (log) {
 		log->success = (status == YENOERR) ? true : false;
+		journal_write(agent, log);
+	}
 	ys_free(filename);
+	ys_free(snar_opt);
 	yarray_free(args);
 	free0(tmp_file);
 	return (status);
 }
-/* Backup all listed databases. They are tar'ed and compressed. */
-static void backup_databases(agent_t *agent) {
-	ystatus_t st = YENOERR;
+/* Write the tar archive of a path, using the native tar writer. */
+static ystatus_t backup_tar_write(int fd, void *user_data) {
+	backup_tar_t *tar = (backup_tar_t*)user_data;
+	ytar_options_t options = {
+		.exclude_caches = true,
+		.exclude_tag = ".arkiv-exclude",
+		.exclude_ignore = ".arkiv-ignore",
+		.exclude_ignore_recursive = ".arkiv-ignore-recursive",
+		.nbr_threads = A_NATIVE_TAR_THREADS,
+		.sparse = true,
+	};
 
-	agent->exec_log.status_databases = true;
-	if (!ytable_length(agent->param.databases))
-		return;
-	// log message
-	ALOG("Backup databases");
-	// dump_databases
-	st = ytable_foreach(agent->param.databases, backup_database, agent);
-	if (st == YENOERR)
-		ALOG("└ " YANSI_GREEN "Done" YANSI_RESET);
-	// database status
-	agent->exec_log.status_databases = (st == YENOERR) ? true : false;
+	tar->fd = fd;
+	return (ytar_create("/", tar->path, &options, backup_tar_output, tar, &tar->stats));
 }
-/* Backup a database. */
-static ystatus_t backup_database(uint64_t hash, char *key, void *data, void *user_data) {
-	yvar_t *var_db_data = (yvar_t*)data;
-	agent_t *agent = (agent_t*)user_data;
-	ytable_t *db_data = NULL;
-	ystr_t dbtype = NULL;
+/* Write a chunk of a tar archive to a file descriptor. */
+static ystatus_t backup_tar_output(const void *data, size_t len, void *user_data) {
+	backup_tar_t *tar = (backup_tar_t*)user_data;
+	const char *ptr = data;
+	ssize_t written;
 
-	if (!yvar_is_table(var_db_data) || !(db_data = yvar_get_table(var_db_data)) ||
-	    !(dbtype = yvar_get_string(ytable_get_key_data(db_data, A_PARAM_KEY_TYPE)))) {
-		ALOG("└ " YANSI_RED "Error (bad parameter)" YANSI_RESET);
-		return (YEBADCONF);
+	throttle_consume(tar->throttle, len);
+	while (len) {
+		written = write(tar->fd, ptr, len);
+		if (written == -1 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return (YEIO);
+		ptr += written;
+		len -= (size_t)written;
 	}
-	if (!strcmp0(dbtype, A_DB_STR_MYSQL)) {
-		/* MySQL database */
-		// check if mysqldump is available
+	return (YENOERR);
+}
+/* Set the path to the state files of an incremental backup, and read the number of runs since the last full one. */
+static ystatus_t backup_incremental_state(agent_t *agent, log_item_t *log, const char *filename, const char *ext) {
+	ystr_t runs_path = NULL;
+	ystr_t ys = NULL;
+
+	log->state_runs = -1;
+	log->state_ext = ext;
+	if (!(log->state_path = ys_printf(NULL, "%s/%s/%s", agent->conf.archives_path, A_INCREMENTAL_DIRNAME, filename)) ||
+	    !(runs_path = ys_printf(NULL, "%s.runs", log->state_path))) {
+		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		return (YENOMEM);
+	}
+	if ((ys = yfile_get_string_contents(runs_path)) && !ys_empty(ys))
+		log->state_runs = (int32_t)atoi(ys);
+	ys_free(runs_path);
+	ys_free(ys);
+	return (YENOERR);
+}
+/* Restore the incremental state of an archive resumed from the journal. */
+static void backup_incremental_resume(agent_t *agent, log_item_t *log, const char *filename, const char *ext) {
+	// the state file was kept, or the archive was not incremental
+	if (!log->state_tmp)
+		return;
+	if (backup_incremental_state(agent, log, filename, ext) != YENOERR) {
+		backup_incremental_discard(log);
+		return;
+	}
+	ADEBUG("│ ├ " YANSI_FAINT "Snapshot of the interrupted execution: " YANSI_RESET "%s", log->state_tmp);
+}
+/* Compute the level of an incremental backup, and create the state file of the new archive. */
+static ystatus_t backup_incremental_prepare(agent_t *agent, log_item_t *log, const char *filename, const char *ext) {
+	ystatus_t status = YENOERR;
+	ystr_t base_path = NULL;
+	ystr_t ys = NULL;
+	ybin_t *base = NULL;
+
+	log->level = 0;
+	// number of runs since the last full backup
+	if ((status = backup_incremental_state(agent, log, filename, ext)) != YENOERR)
+		goto cleanup;
+	// a full backup is done every N runs; the others are based on the previous
+	// archive (incremental) or on the last full backup (differential)
+	if (log->state_runs >= 0 && (log->state_runs + 1) < agent->param.full_every)
+		log->level = (agent->param.incremental_type == A_INCREMENTAL_DIFFERENTIAL) ? 1 : (log->state_runs + 1);
+	if (log->level) {
+		if (!(base_path = ys_printf(NULL, "%s.%d.%s", log->state_path, log->level - 1, ext))) {
+			ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+			status = YENOMEM;
+			goto cleanup;
+		}
+		// an empty state means the base archive can't be used as a reference
+		if (!yfile_exists(base_path) || !yfile_get_size(base_path)) {
+			ALOG("│ ├ " YANSI_YELLOW "No snapshot of the base archive, a full backup is done" YANSI_RESET);
+			log->level = 0;
+		}
+	}
+	ADEBUG("│ ├ " YANSI_FAINT "Archive level " YANSI_RESET "%d" YANSI_FAINT " (%s)" YANSI_RESET, log->level,
+	       !log->level ? "full" :
+	       (agent->param.incremental_type == A_INCREMENTAL_DIFFERENTIAL) ? "differential" : "incremental");
+	// create the state file (a copy of the base archive's one, or an empty file for a full backup)
+	ys_delete(&ys);
+	if (!(ys = ys_printf(NULL, "%.*s", (int)(strrchr(log->state_path, '/') - log->state_path), log->state_path)) ||
+	    !yfile_mkpath(ys, 0700) ||
+	    !(log->state_tmp = yfile_tmp(log->state_path))) {
+		ALOG("│ └ " YANSI_RED "Unable to create snapshot file" YANSI_RESET);
+		status = YEIO;
+		goto cleanup;
+	}
+	if (log->level &&
+	    (!(base = yfile_get_contents(base_path)) || !yfile_put_contents(log->state_tmp, base))) {
+		ALOG("│ └ " YANSI_RED "Unable to copy snapshot file " YANSI_RESET "%s", base_path);
+		status = YEIO;
+		backup_incremental_discard(log);
+		goto cleanup;
+	}
+cleanup:
+	ys_free(base_path);
+	ys_free(ys);
+	if (base)
+		ybin_delete(base);
+	return (status);
+}
+/* Remove the incremental state of an archive which was not uploaded. */
+static ystatus_t backup_incremental_cleanup(uint64_t hash, char *key, void *data, void *user_data) {
+	agent_t *agent = user_data;
+	log_item_t *log = data;
+
+	// the state of a journaled archive is kept for the execution which resumes it
+	if (agent->journal && (log->stages & A_STAGE_DUMP) && log->upload_status != YENOERR) {
+		free0(log->state_tmp);
+		return (YENOERR);
+	}
+	backup_incremental_discard(log);
+	return (YENOERR);
+}
+/* Backup all listed databases. They are tar'ed and compressed. */
+static void backup_databases(agent_t *agent) {
+	ystatus_t st = YENOERR;
+
+	agent->exec_log.status_databases = true;
+	if (!ytable_length(agent->param.databases))
+		return;
+	// log message
+	ALOG("Backup databases");
+	// create output directories
+	ytable_foreach(agent->param.databases, backup_database_directory, agent);
+	// the options of mysqldump are probed once, before the jobs get their copy of the agent
+	if (agent->backup_mysql_path && agent->bin.mysqldump)
+		backup_mysqldump_probe(agent);
+	// dump_databases
+	st = backup_items(agent, agent->param.databases, backup_database, agent->param.db_workers);
+	if (st == YENOERR)
+		ALOG("└ " YANSI_GREEN "Done" YANSI_RESET);
+	// database status
+	if (st != YENOERR)
+		agent->exec_log.status_databases = false;
+}
+/* Create the output directory of a database, if needed. */
+static ystatus_t backup_database_directory(uint64_t hash, char *key, void *data, void *user_data) {
+	yvar_t *var_db_data = (yvar_t*)data;
+	agent_t *agent = (agent_t*)user_data;
+	ytable_t *db_data = NULL;
+	ystr_t dbtype = NULL;
+	ystr_t *path = NULL;
+	char *subdir = NULL;
+
+	// bad parameters are reported by backup_database()
+	if (!yvar_is_table(var_db_data) || !(db_data = yvar_get_table(var_db_data)) ||
+	    !(dbtype = yvar_get_string(ytable_get_key_data(db_data, A_PARAM_KEY_TYPE))))
+		return (YENOERR);
+	if (!strcmp0(dbtype, A_DB_STR_MYSQL)) {
+		path = &agent->backup_mysql_path;
+		subdir = "mysql";
+	} else if (!strcmp0(dbtype, A_DB_STR_PGSQL)) {
+		path = &agent->backup_pgsql_path;
+		subdir = "postgresql";
+	} else if (!strcmp0(dbtype, A_DB_STR_MONGODB)) {
+		path = &agent->backup_mongodb_path;
+		subdir = "mongodb";
+	} else
+		return (YENOERR);
+	// check if the directory was already created
+	if (*path)
+		return (YENOERR);
+	if (!(*path = ys_printf(NULL, "%s/%s", agent->backup_path, subdir))) {
+		ALOG("├ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		return (YENOERR);
+	}
+	ADEBUG("├ " YANSI_FAINT "Create directory " YANSI_RESET "%s", *path);
+	if (!yfile_mkpath(*path, 0700)) {
+		ADEBUG("│ └ " YANSI_RED "Failed" YANSI_RESET);
+		ys_delete(path);
+	}
+	return (YENOERR);
+}
+/* Backup a list of items, using a bounded number of concurrent workers. */
+static ystatus_t backup_items(agent_t *agent, ytable_t *items, ytable_function_t func, uint16_t nbr_workers) {
+	backup_pool_t pool = {
+		.agent = agent,
+		.func = func,
+		// the messages of a nested pool are kept in the buffer of its worker
+		.buffered = (nbr_workers > 1 || agent->log_lines) ? true : false,
+		// a single worker stops at the first failed item
+		.stop_on_error = (nbr_workers < 2) ? true : false,
+		.status = YENOERR,
+	};
+
+	if (!(pool.jobs = calloc0(ytable_length(items), sizeof(backup_job_t)))) {
+		ALOG("├ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		return (YENOMEM);
+	}
+	ytable_foreach(items, backup_job_add, &pool);
+	ypool_run(pool.nbr_jobs, nbr_workers, backup_job_run, backup_job_done, &pool);
+	free0(pool.jobs);
+	return (pool.status);
+}
+/* Add an item to the list of jobs. */
+static ystatus_t backup_job_add(uint64_t hash, char *key, void *data, void *user_data) {
+	backup_pool_t *pool = (backup_pool_t*)user_data;
+	agent_t *agent = pool->agent;
+	backup_job_t *job = &pool->jobs[pool->nbr_jobs++];
+
+	job->item = (yvar_t*)data;
+	// private copy of the agent structure, with its own execution logs
+	// (the other pointers are shared, and not modified by the jobs)
+	job->agent = *agent;
+	job->agent.exec_log.backup_files = ytable_new();
+	job->agent.exec_log.backup_databases = ytable_new();
+	job->agent.exec_log.status_files = true;
+	job->agent.exec_log.status_databases = true;
+	job->agent.log_lines = pool->buffered ? yarray_create(16) : NULL;
+	if (!job->agent.exec_log.backup_files || !job->agent.exec_log.backup_databases ||
+	    (pool->buffered && !job->agent.log_lines)) {
+		ALOG("├ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		job->status = YENOMEM;
+	}
+	return (YENOERR);
+}
+/* Process a job (executed by a worker). */
+static void backup_job_run(size_t index, void *user_data) {
+	backup_pool_t *pool = (backup_pool_t*)user_data;
+	backup_job_t *job = &pool->jobs[index];
+
+	if (job->status != YENOERR)
+		return;
+	// the jobs of a single worker are merged before the next one is run
+	if (pool->stop_on_error && pool->status != YENOERR)
+		return;
+	job->status = pool->func(index, NULL, job->item, &job->agent);
+	// encrypt the archives and compute their checksums, so they can be uploaded
+	if (job->agent.upload_queue) {
+		ytable_foreach(job->agent.exec_log.backup_files, backup_job_finalize_item, &job->agent);
+		ytable_foreach(job->agent.exec_log.backup_databases, backup_job_finalize_item, &job->agent);
+	}
+}
+/* Encrypt a backed up item and compute its checksum. */
+static ystatus_t backup_job_finalize_item(uint64_t hash, char *key, void *data, void *user_data) {
+	backup_encrypt_item(hash, key, data, user_data);
+	backup_compute_checksum_item(hash, key, data, user_data);
+	return (YENOERR);
+}
+/* Merge the execution logs of a completed job (called in the jobs' order). */
+static void backup_job_done(size_t index, void *user_data) {
+	backup_pool_t *pool = (backup_pool_t*)user_data;
+	backup_job_t *job = &pool->jobs[index];
+	agent_t *agent = pool->agent;
+
+	// write buffered log messages
+	log_flush_lines(agent, job->agent.log_lines);
+	yarray_free(job->agent.log_lines);
+	// add the items to the upload queue
+	if (agent->upload_queue) {
+		ytable_foreach(job->agent.exec_log.backup_files, backup_job_upload_item, agent);
+		ytable_foreach(job->agent.exec_log.backup_databases, backup_job_upload_item, agent);
+	}
+	// merge execution logs
+	if (job->agent.exec_log.backup_files) {
+		ytable_foreach(job->agent.exec_log.backup_files, backup_job_merge_log, agent->exec_log.backup_files);
+		ytable_free(job->agent.exec_log.backup_files);
+	}
+	if (job->agent.exec_log.backup_databases) {
+		ytable_foreach(job->agent.exec_log.backup_databases, backup_job_merge_log, agent->exec_log.backup_databases);
+		ytable_free(job->agent.exec_log.backup_databases);
+	}
+	if (!job->agent.exec_log.status_files)
+		agent->exec_log.status_files = false;
+	if (!job->agent.exec_log.status_databases)
+		agent->exec_log.status_databases = false;
+	// keep the first error
+	if (pool->status == YENOERR)
+		pool->status = job->status;
+}
+/* Add a backed up item to the upload queue. */
+static ystatus_t backup_job_upload_item(uint64_t hash, char *key, void *data, void *user_data) {
+	upload_queue_push((agent_t*)user_data, (log_item_t*)data);
+	return (YENOERR);
+}
+/* Add a log entry to the global execution logs. */
+static ystatus_t backup_job_merge_log(uint64_t hash, char *key, void *data, void *user_data) {
+	return (ytable_add((ytable_t*)user_data, data));
+}
+/* Backup a database. */
+static ystatus_t backup_database(uint64_t hash, char *key, void *data, void *user_data) {
+	yvar_t *var_db_data = (yvar_t*)data;
+	agent_t *agent = (agent_t*)user_data;
+	ytable_t *db_data = NULL;
+	ystr_t dbtype = NULL;
+
+	if (!yvar_is_table(var_db_data) || !(db_data = yvar_get_table(var_db_data)) ||
+	    !(dbtype = yvar_get_string(ytable_get_key_data(db_data, A_PARAM_KEY_TYPE)))) {
+		ALOG("└ " YANSI_RED "Error (bad parameter)" YANSI_RESET);
+		return (YEBADCONF);
+	}
+	if (!strcmp0(dbtype, A_DB_STR_MYSQL)) {
+		/* MySQL database */
+		// check if mysqldump is available
 		if (!agent->bin.mysqldump) {
 			ALOG("└ " YANSI_RED "Error (mysqldump is not installed)" YANSI_RESET);
 			return (YENOEXEC);
 		}
-		// create output directory if needed
+		// check output directory
 		if (!agent->backup_mysql_path) {
-			agent->backup_mysql_path = ys_printf(NULL, "%s/mysql", agent->backup_path);
-			if (!agent->backup_mysql_path) {
-				ALOG("└ " YANSI_RED "Memory allocation error" YANSI_RESET);
-				return (YENOMEM);
-			}
-			ADEBUG("├ " YANSI_FAINT "Create directory " YANSI_RESET "%s", agent->backup_mysql_path);
-			if (!yfile_mkpath(agent->backup_mysql_path, 0700)) {
-				ADEBUG("│ └ " YANSI_RED "Failed" YANSI_RESET);
-				ALOG("└ " YANSI_RED "Error (unable to create output directory)" YANSI_RESET);
-				return (YEIO);
-			}
+			ALOG("└ " YANSI_RED "Error (unable to create output directory)" YANSI_RESET);
+			return (YEIO);
 		}
 		// dump database
 		return (backup_mysql(agent, db_data));
@@ -737,19 +1338,10 @@ static ystatus_t backup_database(uint64_t hash, char *key, void *data, void *use
 			ALOG("└ " YANSI_RED "Error (pg_dump is not installed)" YANSI_RESET);
 			return (YENOEXEC);
 		}
-		// create output directory if needed
+		// check output directory
 		if (!agent->backup_pgsql_path) {
-			agent->backup_pgsql_path = ys_printf(NULL, "%s/postgresql", agent->backup_path);
-			if (!agent->backup_pgsql_path) {
-				ALOG("└ " YANSI_RED "Memory allocation error" YANSI_RESET);
-				return (YENOMEM);
-			}
-			ADEBUG("├ " YANSI_FAINT "Create directory " YANSI_RESET "%s", agent->backup_pgsql_path);
-			if (!yfile_mkpath(agent->backup_pgsql_path, 0700)) {
-				ADEBUG("│ └ " YANSI_RED "Failed" YANSI_RESET);
-				ALOG("└ " YANSI_RED "Error (unable to create output directory)" YANSI_RESET);
-				return (YEIO);
-			}
+			ALOG("└ " YANSI_RED "Error (unable to create output directory)" YANSI_RESET);
+			return (YEIO);
 		}
 		// dump database
 		return (backup_pgsql(agent, db_data));
@@ -760,19 +1352,10 @@ static ystatus_t backup_database(uint64_t hash, char *key, void *data, void *use
 			ALOG("└ " YANSI_RED "Error (mongodump is not installed)" YANSI_RESET);
 			return (YENOEXEC);
 		}
-		// create output directory if needed
+		// check output directory
 		if (!agent->backup_mongodb_path) {
-			agent->backup_mongodb_path = ys_printf(NULL, "%s/mongodb", agent->backup_path);
-			if (!agent->backup_mongodb_path) {
-				ALOG("└ " YANSI_RED "Memory allocation error" YANSI_RESET);
-				return (YENOMEM);
-			}
-			ADEBUG("├ " YANSI_FAINT "Create directory " YANSI_RESET "%s", agent->backup_mongodb_path);
-			if (!yfile_mkpath(agent->backup_mongodb_path, 0700)) {
-				ADEBUG("│ └ " YANSI_RED "Failed" YANSI_RESET);
-				ALOG("└ " YANSI_RED "Error (unable to create output directory)" YANSI_RESET);
-				return (YEIO);
-			}
+			ALOG("└ " YANSI_RED "Error (unable to create output directory)" YANSI_RESET);
+			return (YEIO);
 		}
 		// dump database
 		return (backup_mongodb(agent, db_data));
@@ -786,6 +1369,7 @@ static ystatus_t backup_mysql(agent_t *agent, ytable_t *db_data) {
 	ystatus_t status = YENOERR;
 	log_item_t *log = NULL;
 	bool all_databases = false;
+	bool split = false;
 	ystr_t dbname = NULL;
 	ystr_t dbuser = NULL;
 	ystr_t dbpwd = NULL;
@@ -794,9 +1378,13 @@ static ystatus_t backup_mysql(agent_t *agent, ytable_t *db_data) {
 	ystr_t dbport_str = NULL;
 	ystr_t filename = NULL;
 	ystr_t password_env = NULL;
+	yarray_t conn_args = NULL;
 	yarray_t args = NULL;
 	yarray_t env = NULL;
-	char *tmp_file = NULL;
+	bool binlog = false;
+	bool skip_gtid = false;
+	ybin_t binlogs = {0};
+	ystr_t state_name = NULL;
 
 	// extract parameters and check them
 	if (!(dbname = yvar_get_string(ytable_get_key_data(db_data, A_PARAM_KEY_DB))) ||
@@ -810,8 +1398,20 @@ static ystatus_t backup_mysql(agent_t *agent, ytable_t *db_data) {
 	}
 	if (!strcmp(dbname, A_DB_ALL_DATABASES_DEFINITION))
 		all_databases = true;
+	// set for the databases of a '*' entry, except the first one
+	if (agent->mysqldump_gtid && yvar_get_bool(ytable_get_key_data(db_data, A_PARAM_KEY_SKIP_GTID)))
+		skip_gtid = true;
+	// between two full dumps, the binary logs written since the base archive are archived
+	if (agent->param.full_every > 1 && agent->bin.mysql && agent->bin.mysqlbinlog)
+		binlog = true;
+	// with several jobs, all the databases are dumped separately, and listed in a manifest
+	// (unless their dumps must share a position in the binary logs)
+	if (all_databases && agent->conf.dump_jobs > 1 && agent->bin.mysql && !binlog)
+		split = true;
 	// log message
 	ALOG("├ " YANSI_FAINT "MySQL database " YANSI_RESET "%s", dbname);
+	if (all_databases && agent->conf.dump_jobs > 1 && agent->bin.mysql && binlog)
+		ALOG("│ ├ " YANSI_YELLOW "Incremental backup, the databases are dumped together" YANSI_RESET);
 	// creation of the log entry
 	if (!(log = log_create_mysql(agent, dbname))) {
 		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
@@ -825,79 +1425,554 @@ static ystatus_t backup_mysql(agent_t *agent, ytable_t *db_data) {
 	else
 		filename = ys_filenamize(dbname);
 	if (!filename ||
-	    !(log->archive_name = ys_printf(NULL, "%s.sql", filename)) ||
+	    !(log->archive_name = ys_printf(NULL, "%s.%s", filename, (split ? A_DB_MANIFEST_EXT : "sql"))) ||
 	    !(log->archive_path = ys_printf(NULL, "%s/%s", agent->backup_mysql_path, log->archive_name)) ||
 	    !(dbport_str = ys_printf(NULL, "%d", (int)dbport)) ||
 	    !(password_env = ys_printf(NULL, "MYSQL_PWD=%s", dbpwd)) ||
-	    !(args = yarray_create(11)) ||
+	    !(conn_args = yarray_create(6)) ||
 	    !(env = yarray_create(1))) {
 		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
 		status = log->dump_status = YENOMEM;
 		goto cleanup;
 	}
-	if (!(tmp_file = yfile_tmp(log->archive_path))) {
-		ALOG("│ └ " YANSI_RED "Unable to create temporary file" YANSI_RESET);
-		status = log->dump_status = YEIO;
+	// a database dumped by an interrupted execution is not dumped again
+	if (journal_resume(agent, log)) {
+		// its compression may have been interrupted
+		if (log->compress_status == YEUNDEF && log->encrypt_status == YEUNDEF &&
+		    (status = backup_compress_file(agent, log)) == YENOERR)
+			log->archive_size = yfile_get_size(log->archive_path);
+		if (log->state_tmp && !(state_name = ys_printf(NULL, "%s/%s", A_DB_STR_MYSQL, filename)))
+			backup_incremental_discard(log);
+		backup_incremental_resume(agent, log, state_name, A_DB_BINLOG_EXT);
 		goto cleanup;
 	}
 	yarray_push(&env, password_env);
+	yarray_push_multi(&conn_args, 6, "-u", dbuser, "-h", dbhost, "-P", dbport_str);
+	if (split) {
+		status = backup_mysql_databases(agent, log, db_data, conn_args, env);
+		goto cleanup;
+	}
+	// incremental backup: the position of the base archive in the binary logs is kept in its state file
+	if (binlog) {
+		if (!(state_name = ys_printf(NULL, "%s/%s", A_DB_STR_MYSQL, filename))) {
+			ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+			status = log->dump_status = YENOMEM;
+			goto cleanup;
+		}
+		if ((status = backup_incremental_prepare(agent, log, state_name, A_DB_BINLOG_EXT)) != YENOERR) {
+			log->dump_status = status;
+			goto cleanup;
+		}
+		// without binary logs, full dumps are done
+		if ((status = backup_mysql_binlog_list(agent, conn_args, env, &binlogs)) != YENOERR) {
+			if (status == YENOMEM) {
+				ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+				log->dump_status = status;
+				goto cleanup;
+			}
+			ALOG("│ ├ " YANSI_YELLOW "The binary logs are not available, a full dump is done" YANSI_RESET);
+			log->level = 0;
+			binlog = false;
+			if (truncate(log->state_tmp, 0)) {
+				ALOG("│ └ " YANSI_RED "Unable to empty the snapshot file" YANSI_RESET);
+				status = log->dump_status = YEIO;
+				goto cleanup;
+			}
+		} else if (log->level) {
+			status = backup_mysql_binlog(agent, log, (all_databases ? NULL : dbname), filename, conn_args, env,
+			                             log->state_tmp, &binlogs);
+			if (status != YEAGAIN)
+				goto cleanup;
+			log->level = 0;
+		}
+		status = YENOERR;
+	}
+	// the tables of a database can be dumped through several connections
+	if (agent->conf.dump_jobs > 1 && !all_databases) {
+		if ((status = backup_mysql_parallel(agent, log, dbname, conn_args, env, binlog)) !=
+		    YEAGAIN)
+			goto cleanup;
+		status = YENOERR;
+	}
+	if (!(args = yarray_clone(conn_args))) {
+		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		status = log->dump_status = YENOMEM;
+		goto cleanup;
+	}
 	yarray_push_multi(
 		&args,
-		11,
-		"-u",
-		dbuser,
+		5,
 		"--single-transaction",
 		"--no-tablespaces",
 		"--skip-lock-tables",
 		"--routines",
-		"-h",
-		dbhost,
-		"-P",
-		dbport_str,
 		(all_databases ? "-A" : dbname)
 	);
-	// execution
+	// mysqldump writes the position of its snapshot in the binary logs as a comment
+	if (binlog && agent->mysqldump_source_opt)
+		yarray_push(&args, (char*)agent->mysqldump_source_opt);
+	if (skip_gtid)
+		yarray_push(&args, "--set-gtid-purged=OFF");
+	// the dump is compressed while it is written, only the archive is written to disk
+	yexec_cmd_t dump = {
+		.command = agent->bin.mysqldump,
+		.args = args,
+		.env = env,
+	};
 	ADEBUG("│ ├ " YANSI_FAINT "Execute " YANSI_RESET "mysqldump" YANSI_FAINT " to " YANSI_RESET "%s", log->archive_path);
-	status = yexec(agent->bin.mysqldump, args, env, NULL, tmp_file);
-	if (status != YENOERR) {
-		ALOG("│ └ " YANSI_RED "Mysqldump error" YANSI_RESET);
-		log->dump_status = status;
-		unlink(tmp_file);
-		goto cleanup;
-	}
-	ADEBUG("│ ├ " YANSI_GREEN "Done" YANSI_RESET);
-	// set log status
-	log->dump_status = YENOERR;
-	// move the file to its destination
-	if (rename(tmp_file, log->archive_path)) {
-		ALOG("│ └ " YANSI_RED "Unable to move file " YANSI_RESET "%s" YANSI_RED " to " YANSI_RED "%s" YANSI_RESET, tmp_file, log->archive_path);
-		status = log->dump_status = YEIO;
-		unlink(tmp_file);
-		goto cleanup;
-	}
-	// compression of the file
-	status = backup_compress_file(agent, log);
-	// get archive file's size
-	log->archive_size = yfile_get_size(log->archive_path);
+	if (binlog)
+		status = backup_mysqldump_binlog(agent, log, &dump);
+	else
+		status = backup_stream_item(agent, log, &dump, NULL, NULL);
 cleanup:
 	if (status != YENOERR) {
 		agent->exec_log.status_databases = false;
 		ALOG("└ " YANSI_RED "Failed" YANSI_RESET);
 	}
-	if (log)
+	// the state is kept only once the archive is uploaded, so the next run
+	// is based on the last archive which reached the storage
+	if (status != YENOERR && log)
+		backup_incremental_discard(log);
+	if (log) {
 		log->success = (status == YENOERR) ? true : false;
+		journal_write(agent, log);
+	}
 	ys_free(filename);
 	ys_free(password_env);
 	ys_free(dbport_str);
+	ys_free(state_name);
+	ybin_delete_data(&binlogs);
+	yarray_free(conn_args);
 	yarray_free(args);
 	yarray_free(env);
-	free0(tmp_file);
 	return (status);
 }
+/* Dump a MySQL database through several connections sharing a consistent snapshot. */
+static ystatus_t backup_mysql_parallel(agent_t *agent, log_item_t *log, const char *dbname, yarray_t conn_args,
+                                       yarray_t env, bool binlog) {
+	ystatus_t status = YENOERR;
+	dbdump_t dump;
+	yarray_t z_args = NULL;
+	char level_opt[8], threads_opt[16];
+	yexec_cmd_t z = {
+		.command = agent->bin.z,
+	};
+
+	if (!agent->bin.mysql) {
+		ALOG("│ ├ " YANSI_YELLOW "The mysql client is not installed, the tables are dumped through one connection"
+		     YANSI_RESET);
+		return (YEAGAIN);
+	}
+	if ((status = dbdump_mysql_open(&dump, agent, dbname, conn_args, env, log->archive_path)) != YENOERR) {
+		dbdump_close(&dump);
+		if (status == YENOMEM) {
+			ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+			log->dump_status = status;
+			return (status);
+		}
+		ADEBUG("│ ├ " YANSI_FAINT "%s, the tables are dumped through one connection" YANSI_RESET,
+		       ((status == YENODATA) ? "Not enough tables" : "Unable to list the tables"));
+		return (YEAGAIN);
+	}
+	// the position of the snapshot in the binary logs is read while the lock is held
+	dump.binlog = binlog;
+	// each part is compressed while it is dumped
+	if (agent->param.compression != A_COMP_NONE) {
+		if (!(z_args = yarray_create(6))) {
+			ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+			status = log->dump_status = YENOMEM;
+			goto cleanup;
+		}
+		backup_compress_options(agent, log, &z_args, level_opt, threads_opt);
+		if (agent->dedup && (agent->param.compression == A_COMP_ZSTD || agent->param.compression == A_COMP_GZIP))
+			yarray_push(&z_args, "--rsyncable");
+		yarray_push_multi(&z_args, 2, "--quiet", "--stdout");
+		z.args = z_args;
+	}
+	status = dbdump_mysql_run(&dump, (z_args ? &z : NULL));
+	if (status == YEACCES) {
+		ALOG("│ ├ " YANSI_YELLOW "Unable to take the global read lock, the tables are dumped through one connection"
+		     YANSI_RESET);
+		status = YEAGAIN;
+		goto cleanup;
+	}
+	if (status != YENOERR) {
+		ALOG("│ └ " YANSI_RED "Mysqldump error" YANSI_RESET);
+		log->dump_status = status;
+		goto cleanup;
+	}
+	// the parts are concatenated (they are already compressed)
+	if (z_args) {
+		if (ys_append(&log->archive_name, ".") != YENOERR ||
+		    ys_append(&log->archive_name, backup_compress_ext(agent)) != YENOERR ||
+		    ys_append(&log->archive_path, ".") != YENOERR ||
+		    ys_append(&log->archive_path, backup_compress_ext(agent)) != YENOERR) {
+			ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+			status = log->dump_status = YENOMEM;
+			goto cleanup;
+		}
+		log->compress_status = YENOERR;
+	}
+	status = backup_stream_item(agent, log, NULL, dbdump_write, &dump);
+	// the position is written to the state file once the archive is uploaded
+	if (status == YENOERR && binlog)
+		backup_mysql_binlog_position(agent, log, dump.binlog_file, dump.binlog_position);
+cleanup:
+	dbdump_close(&dump);
+	yarray_free(z_args);
+	return (status);
+}
+/* Dump each MySQL database as a separate job, and write the manifest of the dumps. */
+static ystatus_t backup_mysql_databases(agent_t *agent, log_item_t *log, ytable_t *db_data, yarray_t conn_args,
+                                        yarray_t env) {
+	ystatus_t status = YENOERR;
+	yarray_t args = NULL;
+	ybin_t out = {0};
+	ytable_t *items = NULL;
+	ystr_t manifest = NULL;
+	yvar_t *skip_gtid = NULL;
+	char *line, *next;
+	uint16_t dump_jobs = agent->conf.dump_jobs;
+
+	// only the first dump sets the purged GTIDs (each dump would set its own), the flag is shared by the others
+	if (!(args = yarray_clone(conn_args)) ||
+	    yarray_push_multi(&args, 4, "--batch", "--skip-column-names", "-e", "SHOW DATABASES") != YENOERR ||
+	    !(items = ytable_new()) ||
+	    !(manifest = ys_printf(NULL, "# Databases of the '%s' entry\n", A_DB_ALL_DATABASES_DEFINITION)) ||
+	    (agent->mysqldump_gtid &&
+	     (!(skip_gtid = yvar_new_bool(true)) ||
+	      ys_append(&manifest, "# GTID_PURGED is set by the first dump only: on a server using GTIDs, restore\n"
+	                "# the dumps in this order, into a server whose GTID_EXECUTED is empty.\n") != YENOERR))) {
+		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		status = log->dump_status = YENOMEM;
+		goto cleanup;
+	}
+	ADEBUG("│ ├ " YANSI_FAINT "List the databases" YANSI_RESET);
+	if ((status = yexec(agent->bin.mysql, args, env, &out, NULL)) != YENOERR || !out.data) {
+		ALOG("│ └ " YANSI_RED "Unable to list the databases" YANSI_RESET);
+		status = log->dump_status = (status != YENOERR) ? status : YENODATA;
+		goto cleanup;
+	}
+	ybin_set_nullend(&out);
+	for (line = out.data; *line; line = next) {
+		ystr_t filename = NULL;
+		yvar_t *item = NULL;
+
+		if ((next = strchr(line, '\n')))
+			*next++ = '\0';
+		else
+			next = line + strlen(line);
+		if (!*line || !strcmp(line, "information_schema") || !strcmp(line, "performance_schema") ||
+		    !strcmp(line, "sys"))
+			continue;
+		// a name starting with a dash would be read as an option by mysqldump
+		if (line[0] == '-') {
+			ALOG("│ ├ " YANSI_YELLOW "Database " YANSI_RESET "%s" YANSI_YELLOW " skipped (unsupported name)"
+			     YANSI_RESET, line);
+			continue;
+		}
+		// each line of the manifest gives the name of a database and its dump
+		if (!(filename = ys_filenamize(line)) ||
+		    ys_append(&manifest, line) != YENOERR ||
+		    ys_append(&manifest, "\t") != YENOERR ||
+		    ys_append(&manifest, filename) != YENOERR ||
+		    ys_append(&manifest, ".sql\n") != YENOERR ||
+		    !(item = backup_database_params(db_data, line)) ||
+		    (skip_gtid && ytable_length(items) &&
+		     ytable_set_key(yvar_get_table(item), A_PARAM_KEY_SKIP_GTID, skip_gtid) != YENOERR) ||
+		    ytable_add(items, item) != YENOERR) {
+			ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+			ys_free(filename);
+			backup_database_params_free(0, NULL, item, NULL);
+			status = log->dump_status = YENOMEM;
+			goto cleanup;
+		}
+		ys_free(filename);
+	}
+	ADEBUG("│ ├ " YANSI_FAINT "Dump " YANSI_RESET "%zu" YANSI_FAINT " databases with " YANSI_RESET "%u"
+	       YANSI_FAINT " concurrent jobs" YANSI_RESET, ytable_length(items), dump_jobs);
+	// each database is dumped through one connection, so the number of connections is bounded
+	agent->conf.dump_jobs = 1;
+	status = backup_items(agent, items, backup_database, dump_jobs);
+	agent->conf.dump_jobs = dump_jobs;
+	if (status != YENOERR) {
+		log->dump_status = status;
+		goto cleanup;
+	}
+	// the manifest is written once all the databases are dumped
+	ALOG("├ " YANSI_FAINT "Manifest of " YANSI_RESET "%s", A_DB_ALL_DATABASES_DEFINITION);
+	status = backup_stream_item(agent, log, NULL, backup_string_input, manifest);
+cleanup:
+	if (items) {
+		ytable_foreach(items, backup_database_params_free, NULL);
+		ytable_free(items);
+	}
+	yvar_free(skip_gtid);
+	ybin_delete_data(&out);
+	yarray_free(args);
+	ys_free(manifest);
+	return (status);
+}
+/* Create the parameters of a database, from the parameters of another one. */
+static yvar_t *backup_database_params(ytable_t *db_data, const char *dbname) {
+	ytable_t *params = NULL;
+	yvar_t *var = NULL;
+	yvar_t *db = NULL;
+	ystr_t name = NULL;
+
+	// the connection parameters are shared; the name is kept by the database's log entry
+	if (!(params = ytable_new()) ||
+	    !(name = ys_new(dbname)) ||
+	    !(db = yvar_new_string(name)) ||
+	    ytable_set_key(params, A_PARAM_KEY_TYPE, ytable_get_key_data(db_data, A_PARAM_KEY_TYPE)) != YENOERR ||
+	    ytable_set_key(params, A_PARAM_KEY_USER, ytable_get_key_data(db_data, A_PARAM_KEY_USER)) != YENOERR ||
+	    ytable_set_key(params, A_PARAM_KEY_PWD, ytable_get_key_data(db_data, A_PARAM_KEY_PWD)) != YENOERR ||
+	    ytable_set_key(params, A_PARAM_KEY_HOST, ytable_get_key_data(db_data, A_PARAM_KEY_HOST)) != YENOERR ||
+	    ytable_set_key(params, A_PARAM_KEY_PORT, ytable_get_key_data(db_data, A_PARAM_KEY_PORT)) != YENOERR ||
+	    ytable_set_key(params, A_PARAM_KEY_DB, db) != YENOERR ||
+	    !(var = yvar_new_table(params))) {
+		ys_free(name);
+		yvar_free(db);
+		ytable_free(params);
+		return (NULL);
+	}
+	return (var);
+}
+/* Free the parameters of a database created by backup_database_params(). */
+static ystatus_t backup_database_params_free(uint64_t hash, char *key, void *data, void *user_data) {
+	yvar_t *var = (yvar_t*)data;
+	ytable_t *params = yvar_get_table(var);
+
+	if (!var)
+		return (YENOERR);
+	yvar_free(ytable_get_key_data(params, A_PARAM_KEY_DB));
+	ytable_free(params);
+	yvar_free(var);
+	return (YENOERR);
+}
+/* List the binary logs of a MySQL server, with their sizes. */
+static ystatus_t backup_mysql_binlog_list(agent_t *agent, yarray_t conn_args, yarray_t env, ybin_t *out) {
+	ystatus_t status;
+	yarray_t args = NULL;
+
+	if (!(args = yarray_clone(conn_args)) ||
+	    yarray_push_multi(&args, 4, "--batch", "--skip-column-names", "-e", A_MYSQL_BINLOGS_QUERY) != YENOERR) {
+		yarray_free(args);
+		return (YENOMEM);
+	}
+	ADEBUG("│ ├ " YANSI_FAINT "List the binary logs" YANSI_RESET);
+	status = yexec(agent->bin.mysql, args, env, out, NULL);
+	yarray_free(args);
+	if (status == YENOERR && (!out->data || !out->bytesize))
+		status = YENODATA;
+	if (status == YENOERR)
+		ybin_set_nullend(out);
+	return (status);
+}
+/* Archive the binary logs written since the base archive of a MySQL database. */
+static ystatus_t backup_mysql_binlog(agent_t *agent, log_item_t *log, const char *dbname, const char *filename,
+                                     yarray_t conn_args, yarray_t env, const char *state_tmp, ybin_t *binlogs) {
+	ystatus_t status = YENOERR;
+	ystr_t state = NULL;
+	ystr_t start_opt = NULL;
+	ystr_t stop_opt = NULL;
+	ystr_t db_opt = NULL;
+	yarray_t files = NULL;
+	yarray_t args = NULL;
+	char *line, *next, *tab;
+	char *last_file = NULL;
+	uint64_t start_position, last_size = 0;
+
+	// position of the base archive
+	if (!(state = yfile_get_string_contents(state_tmp)) || !(tab = strchr(state, '\t'))) {
+		ALOG("│ ├ " YANSI_YELLOW "Unable to read the position of the base archive, a full dump is done" YANSI_RESET);
+		status = YEAGAIN;
+		goto cleanup;
+	}
+	*tab = '\0';
+	start_position = strtoull(tab + 1, NULL, 10);
+	// the binary logs from the base archive's one (each line gives the name of a log and its size)
+	if (!(files = yarray_create(8))) {
+		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		status = log->dump_status = YENOMEM;
+		goto cleanup;
+	}
+	for (line = (char*)binlogs->data; *line; line = next) {
+		if ((next = strchr(line, '\n')))
+			*next++ = '\0';
+		else
+			next = line + strlen(line);
+		if (!(tab = strchr(line, '\t')))
+			continue;
+		*tab = '\0';
+		if (!last_file && strcmp(line, state))
+			continue;
+		last_file = line;
+		last_size = strtoull(tab + 1, NULL, 10);
+		yarray_push(&files, line);
+	}
+	if (!last_file) {
+		ALOG("│ ├ " YANSI_YELLOW "The binary log " YANSI_RESET "%s" YANSI_YELLOW " is not available anymore, "
+		     "a full dump is done" YANSI_RESET, state);
+		status = YEAGAIN;
+		goto cleanup;
+	}
+	// the events are decoded from the base archive's position to the current end of the logs
+	ys_free(log->archive_name);
+	ys_free(log->archive_path);
+	if (!(log->archive_name = ys_printf(NULL, "%s.%s.sql", filename, A_DB_BINLOG_EXT)) ||
+	    !(log->archive_path = ys_printf(NULL, "%s/%s", agent->backup_mysql_path, log->archive_name)) ||
+	    !(start_opt = ys_printf(NULL, "--start-position=%" PRIu64, start_position)) ||
+	    !(stop_opt = ys_printf(NULL, "--stop-position=%" PRIu64, last_size)) ||
+	    (dbname && !(db_opt = ys_printf(NULL, "--database=%s", dbname))) ||
+	    !(args = yarray_clone(conn_args)) ||
+	    yarray_push_multi(&args, 3, "--read-from-remote-server", start_opt, stop_opt) != YENOERR ||
+	    (db_opt && yarray_push(&args, db_opt) != YENOERR) ||
+	    yarray_append(&args, files) != YENOERR) {
+		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		status = log->dump_status = YENOMEM;
+		goto cleanup;
+	}
+	ADEBUG("│ ├ " YANSI_FAINT "Binary logs from " YANSI_RESET "%s:%" PRIu64 YANSI_FAINT " to " YANSI_RESET "%s:%" PRIu64
+	       YANSI_FAINT " (" YANSI_RESET "%zu" YANSI_FAINT " file(s))" YANSI_RESET, state, start_position, last_file,
+	       last_size, yarray_length(files));
+	yexec_cmd_t cmd = {
+		.command = agent->bin.mysqlbinlog,
+		.args = args,
+		.env = env,
+	};
+	ADEBUG("│ ├ " YANSI_FAINT "Execute " YANSI_RESET "mysqlbinlog" YANSI_FAINT " to " YANSI_RESET "%s", log->archive_path);
+	if ((status = backup_stream_item(agent, log, &cmd, NULL, NULL)) == YENOERR)
+		backup_mysql_binlog_position(agent, log, last_file, last_size);
+cleanup:
+	ys_free(state);
+	ys_free(start_opt);
+	ys_free(stop_opt);
+	ys_free(db_opt);
+	yarray_free(files);
+	yarray_free(args);
+	return (status);
+}
+/* Set the position in the binary logs reached by a MySQL archive. */
+static void backup_mysql_binlog_position(agent_t *agent, log_item_t *log, const char *file, uint64_t position) {
+	// without position, the next backup is a full one
+	if (!file || !(log->binlog_file = ys_copy(file))) {
+		ALOG("│ ├ " YANSI_YELLOW "Position in the binary logs not found, the next backup is a full one" YANSI_RESET);
+	} else {
+		log->binlog_position = position;
+		ADEBUG("│ ├ " YANSI_FAINT "Position in the binary logs: " YANSI_RESET "%s:%" PRIu64, file, position);
+	}
+	// the state file is written now (it is kept once the archive is uploaded), so
+	// it is complete if an interrupted execution is resumed
+	if (log->state_tmp && backup_mysql_binlog_save(agent, log) != YENOERR)
+		backup_incremental_discard(log);
+}
+/* Write the position in the binary logs to the state file of a MySQL archive. */
+static ystatus_t backup_mysql_binlog_save(agent_t *agent, log_item_t *log) {
+	ystatus_t status = YENOERR;
+	ystr_t state = NULL;
+
+	// with an empty state, the next backup is a full one
+	if (!log->binlog_file) {
+		if (truncate(log->state_tmp, 0)) {
+			ALOG("│ ├ " YANSI_YELLOW "Unable to empty the snapshot file" YANSI_RESET);
+			return (YEIO);
+		}
+		return (YENOERR);
+	}
+	if (!(state = ys_printf(NULL, "%s\t%" PRIu64 "\n", log->binlog_file, log->binlog_position)) ||
+	    !yfile_put_string(log->state_tmp, state)) {
+		ALOG("│ ├ " YANSI_YELLOW "Unable to write the position in the binary logs" YANSI_RESET);
+		status = YEIO;
+	}
+	ys_free(state);
+	return (status);
+}
+/* Dump a MySQL database, and read the position of its snapshot in the binary logs. */
+static ystatus_t backup_mysqldump_binlog(agent_t *agent, log_item_t *log, const yexec_cmd_t *cmd) {
+	ystatus_t status;
+	ystr_t file = NULL;
+	uint64_t position = 0;
+	backup_mysqldump_t dump = {
+		.cmd = cmd,
+		.fd = -1,
+	};
+
+	if (!(dump.head = ys_new(""))) {
+		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		return (log->dump_status = YENOMEM);
+	}
+	if ((status = backup_stream_item(agent, log, NULL, backup_mysqldump_write, &dump)) == YENOERR) {
+		file = backup_mysqldump_position(dump.head, &position);
+		backup_mysql_binlog_position(agent, log, file, position);
+	} else
+		log_program_errors(agent, "│   ", &dump.err);
+	ys_free(file);
+	ys_free(dump.head);
+	ybin_delete_data(&dump.err);
+	return (status);
+}
+/* Probe the options of mysqldump. */
+static void backup_mysqldump_probe(agent_t *agent) {
+	const char *opt = "--master-data=2";
+	yarray_t args = NULL;
+	ybin_t out = {0};
+
+	if ((args = yarray_create(1)) && yarray_push(&args, "--help") == YENOERR &&
+	    yexec(agent->bin.mysqldump, args, NULL, &out, NULL) == YENOERR && out.data) {
+		ybin_set_nullend(&out);
+		// the option was renamed in MySQL 8.0.26 (the old name is deprecated)
+		if (strstr((char*)out.data, "--source-data"))
+			opt = "--source-data=2";
+		// the mysqldump of MariaDB doesn't write the GTIDs of the server
+		if (!strstr((char*)out.data, "MariaDB") && strstr((char*)out.data, "--set-gtid-purged"))
+			agent->mysqldump_gtid = true;
+	}
+	// the position is used by the incremental backups
+	if (agent->param.full_every > 1 && agent->bin.mysql && agent->bin.mysqlbinlog)
+		agent->mysqldump_source_opt = opt;
+	ybin_delete_data(&out);
+	yarray_free(args);
+}
+/* Execute mysqldump, and write its dump to a file descriptor. */
+static ystatus_t backup_mysqldump_write(int fd, void *user_data) {
+	backup_mysqldump_t *dump = (backup_mysqldump_t*)user_data;
+	ystatus_t status;
+
+	dump->fd = fd;
+	dump->status = YENOERR;
+	status = yexec_pipeline_input(dump->cmd, 1, NULL, NULL, NULL, NULL, backup_mysqldump_output, dump, &dump->err);
+	return ((dump->status != YENOERR) ? dump->status : status);
+}
+/* Write a chunk of a dump, and keep the beginning of the dump. */
+static void backup_mysqldump_output(const void *data, size_t len, void *user_data) {
+	backup_mysqldump_t *dump = (backup_mysqldump_t*)user_data;
+	size_t head_len = ys_bytesize(dump->head);
+
+	if (dump->status != YENOERR)
+		return;
+	if (head_len < A_MYSQLDUMP_HEAD_SIZE)
+		ys_nappend(&dump->head, data, ((len < A_MYSQLDUMP_HEAD_SIZE - head_len) ? len :
+		                               (A_MYSQLDUMP_HEAD_SIZE - head_len)));
+	dump->status = backup_write_all(dump->fd, data, len);
+}
+/* Read the position in the binary logs written by mysqldump at the beginning of a dump. */
+static ystr_t backup_mysqldump_position(const char *head, uint64_t *position) {
+	const char *file, *end, *pos;
+
+	// "CHANGE MASTER TO MASTER_LOG_FILE='...', MASTER_LOG_POS=...;"
+	// or "CHANGE REPLICATION SOURCE TO SOURCE_LOG_FILE='...', SOURCE_LOG_POS=...;"
+	if (!(file = strstr(head, "_LOG_FILE='")) ||
+	    !(end = strchr(file + strlen("_LOG_FILE='"), '\'')) ||
+	    !(pos = strstr(end, "_LOG_POS=")))
+		return (NULL);
+	file += strlen("_LOG_FILE='");
+	*position = strtoull(pos + strlen("_LOG_POS="), NULL, 10);
+	return (ys_printf(NULL, "%.*s", (int)(end - file), file));
+}
 /* Backup a PostgreSQL database. */
 static ystatus_t backup_pgsql(agent_t *agent, ytable_t *db_data) {
 	ystatus_t status = YENOERR;
-	log_item_t *log = NULL;
 	bool all_databases = false;
 	ystr_t dbname = NULL;
 	ystr_t dbuser = NULL;
@@ -905,32 +1980,70 @@ static ystatus_t backup_pgsql(agent_t *agent, ytable_t *db_data) {
 	ystr_t dbhost = NULL;
 	int64_t dbport = 0;
 	ystr_t dbport_str = NULL;
-	ystr_t filename = NULL;
 	ystr_t password_env = NULL;
-	yarray_t args = NULL;
+	yarray_t conn_args = NULL;
 	yarray_t env = NULL;
-	char *tmp_file = NULL;
 
 	// extract parameters and check them
 	if (!(dbname = yvar_get_string(ytable_get_key_data(db_data, A_PARAM_KEY_DB))) ||
 	    !(dbuser = yvar_get_string(ytable_get_key_data(db_data, A_PARAM_KEY_USER))) ||
-	    !(dbpwd = yvar_get_string(ytable_get_key_data(db_data, A_PARAM_KEY_USER))) ||
+	    !(dbpwd = yvar_get_string(ytable_get_key_data(db_data, A_PARAM_KEY_PWD))) ||
 	    !(dbhost = yvar_get_string(ytable_get_key_data(db_data, A_PARAM_KEY_HOST))) ||
 	    !(dbport = yvar_get_int(ytable_get_key_data(db_data, A_PARAM_KEY_PORT)))) {
 		ALOG("└ " YANSI_RED "Failed (bad parameter)" YANSI_RESET);
-		status = YEBADCONF;
-		goto cleanup;
+		agent->exec_log.status_databases = false;
+		return (YEBADCONF);
 	}
 	if (!strcmp(dbname, A_DB_ALL_DATABASES_DEFINITION))
 		all_databases = true;
 	// log message
 	ALOG("├ " YANSI_FAINT "PostgreSQL database " YANSI_RESET "%s", dbname);
-	// creation of the log entry
-	if (!(log = log_create_pgsql(agent, dbname))) {
+	if (!(dbport_str = ys_printf(NULL, "%d", (int)dbport)) ||
+	    !(password_env = ys_printf(NULL, "PGPASSWORD=%s", dbpwd)) ||
+	    !(conn_args = yarray_create(6)) ||
+	    !(env = yarray_create(1))) {
 		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
 		status = YENOMEM;
 		goto cleanup;
 	}
+	yarray_push(&env, password_env);
+	yarray_push_multi(&conn_args, 6, "-U", dbuser, "-h", dbhost, "-p", dbport_str);
+	// with several jobs, the tables are dumped concurrently, in directory format
+	if (agent->conf.dump_jobs > 1 && !all_databases) {
+		status = backup_pgsql_directory(agent, dbname, conn_args, env);
+		goto cleanup;
+	}
+	// all the databases are dumped separately, after the global objects
+	if (agent->conf.dump_jobs > 1 && agent->bin.psql) {
+		if ((status = backup_pgsql_plain(agent, dbname, conn_args, env, true)) == YENOERR)
+			status = backup_pgsql_databases(agent, db_data, conn_args, env);
+		goto cleanup;
+	}
+	status = backup_pgsql_plain(agent, dbname, conn_args, env, false);
+cleanup:
+	if (status != YENOERR) {
+		agent->exec_log.status_databases = false;
+		ALOG("└ " YANSI_RED "Failed" YANSI_RESET);
+	}
+	ys_free(password_env);
+	ys_free(dbport_str);
+	yarray_free(conn_args);
+	yarray_free(env);
+	return (status);
+}
+/* Dump a PostgreSQL database (or all of them, or their global objects) to a SQL file. */
+static ystatus_t backup_pgsql_plain(agent_t *agent, ystr_t dbname, yarray_t conn_args, yarray_t env, bool globals) {
+	ystatus_t status = YENOERR;
+	log_item_t *log = NULL;
+	bool all_databases = !strcmp(dbname, A_DB_ALL_DATABASES_DEFINITION);
+	ystr_t filename = NULL;
+	yarray_t args = NULL;
+
+	// creation of the log entry
+	if (!(log = log_create_pgsql(agent, dbname))) {
+		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		return (YENOMEM);
+	}
 	log->success = true;
 	// create pg_dump command
 	if (all_databases)
@@ -938,76 +2051,336 @@ static ystatus_t backup_pgsql(agent_t *agent, ytable_t *db_data) {
 	else
 		filename = ys_filenamize(dbname);
 	if (!filename ||
-	    !(log->archive_name = ys_printf(NULL, "%s.sql", filename)) ||
-	    !(log->archive_path = ys_printf(NULL, "%s/%s", agent->backup_mysql_path, log->archive_name)) ||
-	    !(dbport_str = ys_printf(NULL, "%d", (int)dbport)) ||
-	    !(password_env = ys_printf(NULL, "PGPASSWORD=\"%s\"", dbpwd)) ||
-	    !(args = yarray_create(11)) ||
-	    !(env = yarray_create(1))) {
+	    !(log->archive_name = ys_printf(NULL, "%s%s.sql", filename, (globals ? ".globals" : ""))) ||
+	    !(log->archive_path = ys_printf(NULL, "%s/%s", agent->backup_pgsql_path, log->archive_name)) ||
+	    !(args = yarray_clone(conn_args))) {
 		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
 		status = log->dump_status = YENOMEM;
 		goto cleanup;
 	}
-	if (!(tmp_file = yfile_tmp(log->archive_path))) {
-		ALOG("│ └ " YANSI_RED "Unable to create temporary file" YANSI_RESET);
-		status = log->dump_status = YEIO;
+	// a database dumped by an interrupted execution is not dumped again
+	if (journal_resume(agent, log)) {
+		// its compression may have been interrupted
+		if (log->compress_status == YEUNDEF && log->encrypt_status == YEUNDEF &&
+		    (status = backup_compress_file(agent, log)) == YENOERR)
+			log->archive_size = yfile_get_size(log->archive_path);
+		goto cleanup;
+	}
+	if (globals)
+		yarray_push(&args, "--globals-only");
+	// a listed database name starting with a dash is not read as an option
+	if (!all_databases)
+		yarray_push_multi(&args, 2, "--", dbname);
+	// the dump is compressed while it is written, only the archive is written to disk
+	yexec_cmd_t dump = {
+		.command = all_databases ? agent->bin.pg_dumpall : agent->bin.pg_dump,
+		.args = args,
+		.env = env,
+	};
+	ADEBUG("│ ├ " YANSI_FAINT "Execute " YANSI_RESET "%s" YANSI_FAINT " to " YANSI_RESET "%s",
+	       (all_databases ? "pg_dumpall" : "pg_dump"), log->archive_path);
+	status = backup_stream_item(agent, log, &dump, NULL, NULL);
+cleanup:
+	log->success = (status == YENOERR) ? true : false;
+	journal_write(agent, log);
+	ys_free(filename);
+	yarray_free(args);
+	return (status);
+}
+/* Dump a PostgreSQL database in directory format, with concurrent jobs, and archive each file of the dump. */
+static ystatus_t backup_pgsql_directory(agent_t *agent, ystr_t dbname, yarray_t conn_args, yarray_t env) {
+	ystatus_t status = YENOERR;
+	log_item_t *log = NULL;
+	ystr_t item = NULL;
+	ystr_t filename = NULL;
+	ystr_t dir_name = NULL;
+	ystr_t dir_path = NULL;
+	ystr_t tmp_dir = NULL;
+	ystr_t list_path = NULL;
+	ystr_t list = NULL;
+	yarray_t args = NULL;
+	struct dirent **entries = NULL;
+	int nbr_entries = 0;
+	uint64_t dump_size = 0;
+	size_t len;
+	char *line, *next;
+	char jobs_opt[8], level_opt[8];
+
+	snprintf(jobs_opt, sizeof(jobs_opt), "%u", agent->conf.dump_jobs);
+	if (!(filename = ys_filenamize(dbname)) ||
+	    !(dir_name = ys_printf(NULL, "%s.dir", filename)) ||
+	    !(dir_path = ys_printf(NULL, "%s/%s", agent->backup_pgsql_path, dir_name)) ||
+	    !(tmp_dir = ys_printf(NULL, "%s.tmp", dir_path)) ||
+	    !(list_path = ys_printf(NULL, "%s/" A_PGSQL_DUMP_FILES, dir_path)) ||
+	    !(args = yarray_clone(conn_args))) {
+		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		status = YENOMEM;
+		goto cleanup;
+	}
+	// the dump of an interrupted execution is kept once it is complete (its list of files is written)
+	if (agent->journal && (list = yfile_get_string_contents(list_path))) {
+		ADEBUG("│ ├ " YANSI_FAINT "Dump of a previous execution: " YANSI_RESET "%s", dir_path);
+		goto archive;
+	}
+	backup_remove_directory(tmp_dir);
+	backup_remove_directory(dir_path);
+	// pg_dump compresses the table files while it writes them (gzip), so the
+	// uncompressed database is never written to disk
+	yarray_push_multi(&args, 3, "-Fd", "-j", jobs_opt);
+	if (agent->param.compression == A_COMP_NONE) {
+		yarray_push_multi(&args, 2, "-Z", "0");
+	} else if (agent->conf.compress_level) {
+		snprintf(level_opt, sizeof(level_opt), "%d", (agent->conf.compress_level > 9) ? 9 :
+		                                                agent->conf.compress_level);
+		yarray_push_multi(&args, 2, "-Z", level_opt);
+	}
+	yarray_push_multi(&args, 4, "-f", tmp_dir, "--", dbname);
+	ADEBUG("│ ├ " YANSI_FAINT "Execute " YANSI_RESET "pg_dump" YANSI_FAINT " with " YANSI_RESET "%s" YANSI_FAINT
+	       " jobs to " YANSI_RESET "%s", jobs_opt, dir_path);
+	if ((status = yexec(agent->bin.pg_dump, args, env, NULL, NULL)) != YENOERR) {
+		ALOG("│ └ " YANSI_RED "pg_dump error" YANSI_RESET);
+		goto error;
+	}
+	// the list of the dump's files tells that the dump is complete
+	if ((nbr_entries = scandir(tmp_dir, &entries, NULL, alphasort)) < 0 || !(list = ys_new(""))) {
+		ALOG("│ └ " YANSI_RED "Unable to read directory " YANSI_RESET "%s", tmp_dir);
+		status = YEIO;
+		goto error;
+	}
+	for (int i = 0; i < nbr_entries; ++i) {
+		if (entries[i]->d_type != DT_DIR && entries[i]->d_name[0] != '.' && !strchr(entries[i]->d_name, '\n') &&
+		    (ys_append(&list, entries[i]->d_name) != YENOERR || ys_append(&list, "\n") != YENOERR)) {
+			ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+			status = YENOMEM;
+			goto error;
+		}
+	}
+	ys_free(list_path);
+	if (!(list_path = ys_printf(NULL, "%s/" A_PGSQL_DUMP_FILES, tmp_dir)) ||
+	    !yfile_put_string(list_path, list) || rename(tmp_dir, dir_path)) {
+		ALOG("│ └ " YANSI_RED "Unable to move the dump" YANSI_RESET);
+		status = YEIO;
+		goto error;
+	}
+	ADEBUG("│ ├ " YANSI_GREEN "Done" YANSI_RESET);
+archive:
+	// size of the dump on disk (the files are removed once the database is uploaded)
+	for (line = list; *line; line += len + (line[len] ? 1 : 0)) {
+		len = strcspn(line, "\n");
+		ys_free(item);
+		if ((item = ys_printf(NULL, "%s/%.*s", dir_path, (int)len, line)))
+			dump_size += yfile_get_size(item);
+	}
+	ADEBUG("│ ├ " YANSI_FAINT "Dump size on disk: " YANSI_RESET "%" PRIu64 YANSI_FAINT " bytes" YANSI_RESET, dump_size);
+	// each file of the dump is an archive, in the dump's directory
+	for (line = list; *line && status == YENOERR; line = next) {
+		len = strcspn(line, "\n");
+		next = line + len + (line[len] ? 1 : 0);
+		line[len] = '\0';
+		if (len)
+			status = backup_pgsql_file(agent, dbname, dir_name, dir_path, line, dump_size);
+	}
+	goto cleanup;
+error:
+	backup_remove_directory(tmp_dir);
+	// the failure is reported for the database (its log entry keeps a copy of the name)
+	if ((item = ys_dup(dbname)) && (log = log_create_pgsql(agent, item))) {
+		log->dump_status = status;
+		log->success = false;
+	} else
+		ys_free(item);
+	item = NULL;
+cleanup:
+	for (int i = 0; i < nbr_entries; ++i)
+		free(entries[i]);
+	free(entries);
+	ys_free(item);
+	ys_free(filename);
+	ys_free(dir_name);
+	ys_free(dir_path);
+	ys_free(tmp_dir);
+	ys_free(list_path);
+	ys_free(list);
+	yarray_free(args);
+	return (status);
+}
+/* Archive a file of a PostgreSQL directory dump. */
+static ystatus_t backup_pgsql_file(agent_t *agent, ystr_t dbname, const char *dir_name, const char *dir_path,
+                                   const char *file, uint64_t dump_size) {
+	ystatus_t status = YENOERR;
+	log_item_t *log = NULL;
+	ystr_t item = NULL;
+	ystr_t dump_path = NULL;
+	size_t len = strlen(file);
+	// the table files are compressed by pg_dump
+	bool compressed = (len > 3 && !strcmp(file + len - 3, ".gz"));
+
+	// the item's name and the archive's name keep the layout of the dump
+	if (!(item = ys_printf(NULL, "%s/%s", dbname, file)) ||
+	    !(dump_path = ys_printf(NULL, "%s/%s", dir_path, file)) ||
+	    !(log = log_create_pgsql(agent, item))) {
+		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		ys_free(item);
+		ys_free(dump_path);
+		return (YENOMEM);
+	}
+	ADEBUG("│ ├ " YANSI_FAINT "File " YANSI_RESET "%s", file);
+	if (!(log->archive_name = ys_printf(NULL, "%s/%s", dir_name, file)) ||
+	    !(log->archive_path = ys_dup(dump_path))) {
+		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		status = log->dump_status = YENOMEM;
+		goto cleanup;
+	}
+	// a file archived by an interrupted execution is not archived again
+	if (journal_resume(agent, log)) {
+		// its compression may have been interrupted
+		if (!compressed && log->compress_status == YEUNDEF && log->encrypt_status == YEUNDEF &&
+		    (status = backup_compress_file(agent, log)) == YENOERR)
+			log->archive_size = yfile_get_size(log->archive_path);
+		goto cleanup;
+	}
+	log->dump_status = YENOERR;
+	if (compressed)
+		log->compress_status = YENOERR;
+	log->archive_size = yfile_get_size(log->archive_path);
+	// the whole dump is on disk while its files are archived
+	backup_disk_usage(log, dump_size);
+	// in deduplication and volumes modes, or with a write rate limit, the file is streamed
+	if (agent->dedup || agent->conf.volume_size || agent->write_throttle) {
+		if ((status = backup_stream_item(agent, log, NULL, backup_file_input, dump_path)) == YENOERR &&
+		    strcmp(dump_path, log->archive_path))
+			unlink(dump_path);
+	} else if (!compressed) {
+		status = backup_compress_file(agent, log);
+		log->archive_size = yfile_get_size(log->archive_path);
+	}
+cleanup:
+	log->success = (status == YENOERR) ? true : false;
+	journal_write(agent, log);
+	ys_free(dump_path);
+	return (status);
+}
+/* Dump all the PostgreSQL databases as separate jobs. */
+static ystatus_t backup_pgsql_databases(agent_t *agent, ytable_t *db_data, yarray_t conn_args, yarray_t env) {
+	ystatus_t status = YENOERR;
+	yarray_t args = NULL;
+	ybin_t out = {0};
+	ytable_t *items = NULL;
+	char *line, *next;
+	uint16_t dump_jobs = agent->conf.dump_jobs;
+	uint16_t nbr_workers;
+
+	if (!(args = yarray_clone(conn_args)) ||
+	    yarray_push_multi(&args, 5, "-d", "postgres", "-At", "-c", A_PGSQL_DATABASES_QUERY) != YENOERR ||
+	    !(items = ytable_new())) {
+		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		status = YENOMEM;
+		goto cleanup;
+	}
+	ADEBUG("│ ├ " YANSI_FAINT "List the databases" YANSI_RESET);
+	if ((status = yexec(agent->bin.psql, args, env, &out, NULL)) != YENOERR) {
+		ALOG("│ └ " YANSI_RED "psql error" YANSI_RESET);
 		goto cleanup;
 	}
-	yarray_push(&env, password_env);
-	yarray_push_multi(
-		&args,
-		11,
-		"-U",
-		dbuser,
-		"-h",
-		dbhost,
-		"-p",
-		dbport,
-		"-f",
-		tmp_file
-	);
-	if (!all_databases)
-		yarray_push(&args, dbname);
-	// execution
-	char *bin_path = all_databases ? agent->bin.pg_dumpall : agent->bin.pg_dump;
-	char *bin_name = all_databases ? "pg_dumpall" : "pg_dump";
-	ADEBUG("│ ├ " YANSI_FAINT "Execute " YANSI_RESET "%s" YANSI_FAINT " to " YANSI_RESET "%s", bin_name, log->archive_path);
-	status = yexec(bin_path, args, env, NULL, NULL);
-	if (status != YENOERR) {
-		ALOG("│ └ " YANSI_RED "%s error" YANSI_RESET, bin_name);
-		log->dump_status = status;
-		unlink(tmp_file);
+	if (!out.data)
 		goto cleanup;
+	ybin_set_nullend(&out);
+	for (line = out.data; *line; line = next) {
+		yvar_t *item = NULL;
+
+		if ((next = strchr(line, '\n')))
+			*next++ = '\0';
+		else
+			next = line + strlen(line);
+		if (!*line)
+			continue;
+		if (!(item = backup_database_params(db_data, line)) || ytable_add(items, item) != YENOERR) {
+			ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+			backup_database_params_free(0, NULL, item, NULL);
+			status = YENOMEM;
+			goto cleanup;
+		}
 	}
-	ADEBUG("│ ├ " YANSI_GREEN "Done" YANSI_RESET);
-	// set log status
-	log->dump_status = YENOERR;
-	// move the file to its destination
-	if (rename(tmp_file, log->archive_path)) {
-		ALOG("│ └ " YANSI_RED "Unable to move file " YANSI_RESET "%s" YANSI_RED " to " YANSI_RED "%s" YANSI_RESET, tmp_file, log->archive_path);
-		status = log->dump_status = YEIO;
-		unlink(tmp_file);
+	if (ytable_empty(items))
 		goto cleanup;
-	}
-	// compression of the file
-	status = backup_compress_file(agent, log);
-	// get archive file's size
-	log->archive_size = yfile_get_size(log->archive_path);
+	// the connections are shared among the databases dumped at the same time
+	nbr_workers = (ytable_length(items) < dump_jobs) ? (uint16_t)ytable_length(items) : dump_jobs;
+	ADEBUG("│ ├ " YANSI_FAINT "Dump " YANSI_RESET "%zu" YANSI_FAINT " databases with " YANSI_RESET "%u"
+	       YANSI_FAINT " concurrent jobs" YANSI_RESET, ytable_length(items), nbr_workers);
+	agent->conf.dump_jobs = dump_jobs / nbr_workers;
+	status = backup_items(agent, items, backup_database, nbr_workers);
+	agent->conf.dump_jobs = dump_jobs;
 cleanup:
-	if (status != YENOERR) {
-		agent->exec_log.status_databases = false;
-		ALOG("└ " YANSI_RED "Failed" YANSI_RESET);
+	if (items) {
+		ytable_foreach(items, backup_database_params_free, NULL);
+		ytable_free(items);
 	}
-	if (log)
-		log->success = (status == YENOERR) ? true : false;
-	ys_free(filename);
-	ys_free(password_env);
-	ys_free(dbport_str);
+	ybin_delete_data(&out);
 	yarray_free(args);
-	yarray_free(env);
-	free0(tmp_file);
 	return (status);
 }
+/* Write the content of a file to a file descriptor. */
+static ystatus_t backup_file_input(int fd, void *user_data) {
+	char buffer[A_FILE_INPUT_BUFFER_SIZE];
+	ystatus_t status = YENOERR;
+	ssize_t len;
+	int file_fd;
+
+	if ((file_fd = open((const char*)user_data, O_RDONLY | O_CLOEXEC)) == -1)
+		return (YEIO);
+	while (status == YENOERR) {
+		if ((len = read(file_fd, buffer, sizeof(buffer))) == -1 && errno == EINTR)
+			continue;
+		if (len <= 0) {
+			if (len < 0)
+				status = YEIO;
+			break;
+		}
+		status = backup_write_all(fd, buffer, (size_t)len);
+	}
+	close(file_fd);
+	return (status);
+}
+/* Write a string to a file descriptor. */
+static ystatus_t backup_string_input(int fd, void *user_data) {
+	ystr_t str = (ystr_t)user_data;
+
+	return (backup_write_all(fd, str, ys_bytesize(str)));
+}
+/* Write a buffer to a file descriptor. */
+static ystatus_t backup_write_all(int fd, const void *data, size_t len) {
+	ssize_t written;
+
+	for (size_t offset = 0; offset < len; offset += (size_t)written) {
+		if ((written = write(fd, (const char*)data + offset, len - offset)) == -1) {
+			if (errno == EINTR) {
+				written = 0;
+				continue;
+			}
+			return (YEPIPE);
+		}
+	}
+	return (YENOERR);
+}
+/* Remove a directory and the files it contains. */
+static void backup_remove_directory(const char *path) {
+	DIR *dir;
+	struct dirent *entry;
+	ystr_t file;
+
+	if (!(dir = opendir(path)))
+		return;
+	while ((entry = readdir(dir))) {
+		if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+			continue;
+		if ((file = ys_printf(NULL, "%s/%s", path, entry->d_name))) {
+			unlink(file);
+			ys_free(file);
+		}
+	}
+	closedir(dir);
+	rmdir(path);
+}
 /* Backup a MongoDB database. */
 static ystatus_t backup_mongodb(agent_t *agent, ytable_t *db_data) {
 	ystatus_t status = YENOERR;
@@ -1018,15 +2391,17 @@ static ystatus_t backup_mongodb(agent_t *agent, ytable_t *db_data) {
 	ystr_t dbhost = NULL;
 	int64_t dbport = 0;
 	ystr_t dbauthdb = NULL;
+	int64_t parallel = 0;
 	ystr_t dbport_str = NULL;
+	ystr_t parallel_str = NULL;
 	ystr_t filename = NULL;
 	yarray_t args = NULL;
-	char *tmp_file = NULL;
+	dbdump_mongodb_t dump = {0};
 
 	// extract parameters and check them
 	if (!(dbname = yvar_get_string(ytable_get_key_data(db_data, A_PARAM_KEY_DB))) ||
 	    !(dbuser = yvar_get_string(ytable_get_key_data(db_data, A_PARAM_KEY_USER))) ||
-	    !(dbpwd = yvar_get_string(ytable_get_key_data(db_data, A_PARAM_KEY_USER))) ||
+	    !(dbpwd = yvar_get_string(ytable_get_key_data(db_data, A_PARAM_KEY_PWD))) ||
 	    !(dbhost = yvar_get_string(ytable_get_key_data(db_data, A_PARAM_KEY_HOST))) ||
 	    !(dbport = yvar_get_int(ytable_get_key_data(db_data, A_PARAM_KEY_PORT)))) {
 		ALOG("└ " YANSI_RED "Failed (bad parameter)" YANSI_RESET);
@@ -1034,10 +2409,11 @@ static ystatus_t backup_mongodb(agent_t *agent, ytable_t *db_data) {
 		goto cleanup;
 	}
 	dbauthdb = yvar_get_string(ytable_get_key_data(db_data, A_PARAM_KEY_AUTH_DATABASE));
+	parallel = yvar_get_int(ytable_get_key_data(db_data, A_PARAM_KEY_PARALLEL_COLLECTIONS));
 	// log message
 	ALOG("├ " YANSI_FAINT "MongoDB database " YANSI_RESET "%s", dbname);
 	// creation of the log entry
-	if (!(log = log_create_pgsql(agent, dbname))) {
+	if (!(log = log_create_mongodb(agent, dbname))) {
 		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
 		status = YENOMEM;
 		goto cleanup;
@@ -1046,72 +2422,68 @@ static ystatus_t backup_mongodb(agent_t *agent, ytable_t *db_data) {
 	// create mongodump command
 	filename = ys_filenamize(dbname);
 	if (!filename ||
-	    !(log->archive_name = ys_printf(NULL, "%s.dump", filename)) ||
-	    !(log->archive_path = ys_printf(NULL, "%s/%s", agent->backup_mysql_path, log->archive_name)) ||
+	    !(log->archive_name = ys_printf(NULL, "%s.archive", filename)) ||
+	    !(log->archive_path = ys_printf(NULL, "%s/%s", agent->backup_mongodb_path, log->archive_name)) ||
 	    !(dbport_str = ys_printf(NULL, "%d", (int)dbport)) ||
-	    !(args = yarray_create(11))) {
+	    (parallel > 0 && !(parallel_str = ys_printf(NULL, "%d", (int)parallel))) ||
+	    !(args = yarray_create(13))) {
 		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
 		status = log->dump_status = YENOMEM;
 		goto cleanup;
 	}
-	if (!(tmp_file = yfile_tmp(log->archive_path))) {
-		ALOG("│ └ " YANSI_RED "Unable to create temporary file" YANSI_RESET);
-		status = log->dump_status = YEIO;
+	// a database dumped by an interrupted execution is not dumped again
+	if (journal_resume(agent, log)) {
+		// its compression may have been interrupted
+		if (log->compress_status == YEUNDEF && log->encrypt_status == YEUNDEF &&
+		    (status = backup_compress_file(agent, log)) == YENOERR)
+			log->archive_size = yfile_get_size(log->archive_path);
 		goto cleanup;
 	}
+	// the archive is written to the standard output; without the password
+	// option, mongodump reads the password on its standard input
 	yarray_push_multi(
 		&args,
-		11,
-		"--username",
-		dbuser,
-		"--hiost",
+		9,
+		"--host",
 		dbhost,
 		"--port",
-		dbport,
+		dbport_str,
+		"--username",
+		dbuser,
 		"--db",
 		dbname,
-		"--out",
-		tmp_file,
-		"--password"
+		"--archive"
 	);
-	if (!dbauthdb) {
-		yarray_push(&args, "--authenticationDatabase");
-		yarray_push(&args, dbauthdb);
-	}
-	// execution
-	ADEBUG("│ ├ " YANSI_FAINT "Execute " YANSI_RESET "mongodump" YANSI_FAINT " to " YANSI_RESET "%s", log->archive_path);
-	status = yexec_stdin(agent->bin.mongodump, args, NULL, dbpwd, NULL, NULL, NULL, NULL);
-	if (status != YENOERR) {
-		ALOG("│ └ " YANSI_RED "mongodump error" YANSI_RESET);
+	if (parallel_str)
+		yarray_push_multi(&args, 2, "--numParallelCollections", parallel_str);
+	if (dbauthdb)
+		yarray_push_multi(&args, 2, "--authenticationDatabase", dbauthdb);
+	if ((status = dbdump_mongodb_open(&dump, agent, args, dbpwd)) != YENOERR) {
+		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
 		log->dump_status = status;
-		unlink(tmp_file);
 		goto cleanup;
 	}
-	ADEBUG("│ ├ " YANSI_GREEN "Done" YANSI_RESET);
-	// set log status
-	log->dump_status = YENOERR;
-	// move the file to its destination
-	if (rename(tmp_file, log->archive_path)) {
-		ALOG("│ └ " YANSI_RED "Unable to move file " YANSI_RESET "%s" YANSI_RED " to " YANSI_RED "%s" YANSI_RESET, tmp_file, log->archive_path);
-		status = log->dump_status = YEIO;
-		unlink(tmp_file);
+	// the archive is compressed while it is written, and its collections are measured
+	ADEBUG("│ ├ " YANSI_FAINT "Execute " YANSI_RESET "mongodump" YANSI_FAINT " to " YANSI_RESET "%s", log->archive_path);
+	if ((status = backup_stream_item(agent, log, NULL, dbdump_mongodb_write, &dump)) != YENOERR ||
+	    dump.state == A_DBDUMP_MONGODB_INVALID)
 		goto cleanup;
-	}
-	// compression of the file
-	status = backup_compress_file(agent, log);
-	// get archive file's size
-	log->archive_size = yfile_get_size(log->archive_path);
+	log->dump_parts = dump.collections;
+	dump.collections = NULL;
 cleanup:
 	if (status != YENOERR) {
 		agent->exec_log.status_databases = false;
 		ALOG("└ " YANSI_RED "Failed" YANSI_RESET);
 	}
-	if (log)
+	if (log) {
 		log->success = (status == YENOERR) ? true : false;
+		journal_write(agent, log);
+	}
+	dbdump_mongodb_close(&dump);
 	ys_free(filename);
 	ys_free(dbport_str);
+	ys_free(parallel_str);
 	yarray_free(args);
-	free0(tmp_file);
 	return (status);
 }
 /* Encrypt each backed up file. */
@@ -1128,7 +2500,8 @@ static void backup_encrypt_files(agent_t *agent) {
 		"Encrypt files using " YANSI_FAINT "%s" YANSI_RESET,
 		(agent->param.encryption == A_CRYPT_GPG) ? "gpg" :
 		(agent->param.encryption == A_CRYPT_SCRYPT) ? "scrypt" :
-		(agent->param.encryption == A_CRYPT_OPENSSL) ? "openssl" : "undef"
+		(agent->param.encryption == A_CRYPT_OPENSSL) ? "openssl" :
+		(agent->param.encryption == A_CRYPT_ARKIV) ? "arkiv" : "undef"
 	);
 	// encrypt backed up files
 	if (agent->exec_log.backup_files && !ytable_empty(agent->exec_log.backup_files)) {
@@ -1162,99 +2535,51 @@ static ystatus_t backup_encrypt_item(uint64_t hash, char *key, void *data, void
 	ystr_t output_name = NULL;
 	ystr_t output_path = NULL;
 	ystr_t param = NULL;
+	const char *ext = backup_encrypt_ext(agent);
+	uint64_t clear_size;
 
-	if (!item->success)
+	// the item may have been encrypted while streamed
+	if (!item->success || item->encrypt_status != YEUNDEF)
 		return (YENOERR);
-	if (!(args = yarray_create(10)) ||
-	    !(pass_path = yfile_tmp("/tmp/arkiv"))) {
+	if (!(output_name = ys_printf(NULL, "%s.%s", item->archive_name, ext)) ||
+	    !(output_path = ys_printf(NULL, "%s.%s", item->archive_path, ext))) {
 		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
 		status = YENOMEM;
 		item->encrypt_status = status;
 		item->success = false;
 		goto cleanup;
 	}
-	yfile_put_string(pass_path, agent->conf.crypt_pwd);
 	ADEBUG("│ ├ " YANSI_FAINT "Encrypting " YANSI_RESET "%s", item->archive_path);
-	// prepare command
-	if (agent->param.encryption == A_CRYPT_GPG) {
-		// GPG
-		if (!(output_name = ys_printf(NULL, "%s.gpg", item->archive_name)) ||
-		    !(output_path = ys_printf(NULL, "%s.gpg", item->archive_path))) {
-			status = YENOMEM;
-			item->encrypt_status = status;
-			item->success = false;
-			goto cleanup;
-		}
-		// gpg --batch --passphrase-file /chemin/vers/votre/fichier_passphrase.txt --symmetric --output fichier_crypte.gpg fichier_a_chiffrer.txt
-		yarray_push_multi(
-			&args,
-			8,
-			"--batch",
-			"--yes",
-			"--passphrase-file",
-			pass_path,
-			"--symmetric",
-			"--output",
-			output_path,
-			item->archive_path
-		);
-		// decrypt: gpg --batch --passphrase-file /chemin/vers/votre/fichier_passphrase.txt --decrypt -o fichier_decrypte.txt fichier_crypte.gpg
-	} else if (agent->param.encryption == A_CRYPT_SCRYPT) {
-		// SCRYPT
-		if (!(output_name = ys_printf(NULL, "%s.scrypt", item->archive_name)) ||
-		    !(output_path = ys_printf(NULL, "%s.scrypt", item->archive_path)) ||
-		    !(param = ys_printf(NULL, "file:%s", pass_path))) {
+	if (agent->param.encryption == A_CRYPT_ARKIV) {
+		// native encryption
+		status = encrypt_file(agent->crypt_key, item->archive_path, output_path);
+	} else {
+		// prepare command
+		if (!(args = yarray_create(10)) ||
+		    !(pass_path = yfile_tmp("/tmp/arkiv"))) {
+			ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
 			status = YENOMEM;
 			item->encrypt_status = status;
 			item->success = false;
 			goto cleanup;
 		}
-		// scrypt enc --passphrase file:/chemin/vers/fichier_mot_de_passe.txt fichier_a_crypter fichier_crypté
-		yarray_push_multi(
-			&args,
-			5,
-			"enc",
-			"--passphrase",
-			param,
-			item->archive_path,
-			output_path
-		);
-	} else if (agent->param.encryption == A_CRYPT_OPENSSL) {
-		// OPENSSL
-		if (!(output_name = ys_printf(NULL, "%s.openssl", item->archive_name)) ||
-		    !(output_path = ys_printf(NULL, "%s.openssl", item->archive_path)) ||
-		    !(param = ys_printf(NULL, "file:%s", pass_path))) {
-			status = YENOMEM;
+		yfile_put_string(pass_path, agent->conf.crypt_pwd);
+		if ((status = backup_encrypt_args(agent, &args, pass_path, &param, item->archive_path, output_path)) != YENOERR) {
 			item->encrypt_status = status;
 			item->success = false;
 			goto cleanup;
 		}
-		// openssl enc -aes-256-cbc -e -salt -in file/to/encrypt -out file/encrypted -pass file:path/to/pass
-		yarray_push_multi(
-			&args,
-			10,
-			"enc",
-			"-aes-256-cbc",
-			"-e",
-			"-salt",
-			"-in",
-			item->archive_path,
-			"-out",
-			output_path,
-			"-pass",
-			param
-		);
+		// execution
+		status = yexec(agent->bin.crypt, args, NULL, NULL, NULL);
 	}
-	// execution
-	status = yexec(agent->bin.crypt, args, NULL, NULL, NULL);
 	if (status != YENOERR) {
 		ADEBUG("│ └ " YANSI_RED "Failed" YANSI_RESET);
-		status = YENOMEM;
 		item->encrypt_status = status;
 		item->success = false;
 		goto cleanup;
 	}
 	// remove unencrypted file
+	clear_size = yfile_get_size(item->archive_path);
 	unlink(item->archive_path);
 	// set log status
 	item->encrypt_status = YENOERR;
@@ -1267,6 +2592,8 @@ static ystatus_t backup_encrypt_item(uint64_t hash, char *key, void *data, void
 	output_path = NULL;
 	// get archive file's size
 	item->archive_size = yfile_get_size(item->archive_path);
+	backup_disk_usage(item, clear_size + item->archive_size);
+	journal_write(agent, item);
 cleanup:
 	ys_free(param);
 	if (pass_path) {
@@ -1278,19 +2605,88 @@ cleanup:
 	yarray_free(args);
 	return (status);
 }
+/* Returns the file extension of the used encryption method. */
+static const char *backup_encrypt_ext(agent_t *agent) {
+	if (agent->param.encryption == A_CRYPT_GPG)
+		return ("gpg");
+	if (agent->param.encryption == A_CRYPT_SCRYPT)
+		return ("scrypt");
+	if (agent->param.encryption == A_CRYPT_OPENSSL)
+		return ("openssl");
+	if (agent->param.encryption == A_CRYPT_ARKIV)
+		return ("arkiv");
+	return (NULL);
+}
+/* Fill the argument list of the encryption program. */
+static ystatus_t backup_encrypt_args(agent_t *agent, yarray_t *args, const char *pass_path, ystr_t *param,
+                                     const char *in_path, const char *out_path) {
+	if (agent->param.encryption == A_CRYPT_GPG) {
+		// GPG
+		// gpg --batch --yes --passphrase-file pass.txt --symmetric --output out.gpg in.txt
+		// decrypt: gpg --batch --passphrase-file pass.txt --decrypt -o out.txt in.gpg
+		yarray_push_multi(
+			args,
+			7,
+			"--batch",
+			"--yes",
+			"--passphrase-file",
+			pass_path,
+			"--symmetric",
+			"--output",
+			(out_path ? out_path : "-")
+		);
+		if (in_path)
+			yarray_push(args, (void*)in_path);
+	} else if (agent->param.encryption == A_CRYPT_SCRYPT) {
+		// SCRYPT
+		// scrypt enc --passphrase file:pass.txt in.txt out.scrypt
+		if (!(*param = ys_printf(NULL, "file:%s", pass_path)))
+			return (YENOMEM);
+		yarray_push_multi(
+			args,
+			4,
+			"enc",
+			"--passphrase",
+			*param,
+			(in_path ? in_path : "-")
+		);
+		if (out_path)
+			yarray_push(args, (void*)out_path);
+	} else if (agent->param.encryption == A_CRYPT_OPENSSL) {
+		// OPENSSL
+		// openssl enc -aes-256-cbc -e -salt -in in.txt -out out.openssl -pass file:pass.txt
+		if (!(*param = ys_printf(NULL, "file:%s", pass_path)))
+			return (YENOMEM);
+		yarray_push_multi(args, 4, "enc", "-aes-256-cbc", "-e", "-salt");
+		if (in_path)
+			yarray_push_multi(args, 2, "-in", in_path);
+		if (out_path)
+			yarray_push_multi(args, 2, "-out", out_path);
+		yarray_push_multi(args, 2, "-pass", *param);
+	} else
+		return (YEBADCONF);
+	return (YENOERR);
+}
 /* Compress a backed up file. */
 static ystatus_t backup_compress_file(agent_t *agent, log_item_t *log) {
 	ystatus_t status = YENOERR;
 	yarray_t args = NULL;
 	ystr_t z_name = NULL, z_path = NULL;
+	char level_opt[8], threads_opt[16];
+	uint64_t data_size;
 
 	// check if compression is needed
 	if (agent->param.compression == A_COMP_NONE ||
-	    !log->success)
+	    !log->success) {
+		if (log->success)
+			backup_drop_cache(agent, log);
 		return (YENOERR);
+	}
 	ADEBUG("│ ├ " YANSI_FAINT "Compress file " YANSI_RESET "%s", log->archive_path);
+	backup_compress_probe(agent, log, log->archive_path, true);
+	data_size = yfile_get_size(log->archive_path);
 	// create compression command
-	if (!(args = yarray_create(4))) {
+	if (!(args = yarray_create(6))) {
 		ALOG("│ │ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
 		status = YENOMEM;
 		log->compress_status = status;
@@ -1299,6 +2695,7 @@ static ystatus_t backup_compress_file(agent_t *agent, log_item_t *log) {
 	}
 	if (agent->param.compression == A_COMP_ZSTD)
 		yarray_push(&args, "--rm");
+	backup_compress_options(agent, log, &args, level_opt, threads_opt);
 	yarray_push_multi(&args, 3, "--quiet", "--force", log->archive_path);
 	// execution
 	status = yexec(agent->bin.z, args, NULL, NULL, NULL);
@@ -1312,15 +2709,7 @@ static ystatus_t backup_compress_file(agent_t *agent, log_item_t *log) {
 	// set log status
 	log->compress_status = YENOERR;
 	// definitive paths
-	char *ext = NULL;
-	if (agent->param.compression == A_COMP_GZIP)
-		ext = "gz";
-	else if (agent->param.compression == A_COMP_BZIP2)
-		ext = "bz2";
-	else if (agent->param.compression == A_COMP_XZ)
-		ext = "xz";
-	else if (agent->param.compression == A_COMP_ZSTD)
-		ext = "zst";
+	const char *ext = backup_compress_ext(agent);
 	z_name = ys_printf(NULL, "%s.%s", log->archive_name, ext);
 	z_path = ys_printf(NULL, "%s.%s", log->archive_path, ext);
 	if (!z_name || !z_path) {
@@ -1335,12 +2724,353 @@ static ystatus_t backup_compress_file(agent_t *agent, log_item_t *log) {
 	log->archive_name = z_name;
 	log->archive_path = z_path;
 	z_name = z_path = NULL;
+	// the dump is removed once the compressed file is written
+	backup_disk_usage(log, data_size + yfile_get_size(log->archive_path));
+	backup_drop_cache(agent, log);
 cleanup:
 	yarray_free(args);
 	ys_free(z_name);
 	ys_free(z_path);
 	return (status);
 }
+/* Estimate the compressibility of an item's data, and choose its compression level. */
+static void backup_compress_probe(agent_t *agent, log_item_t *log, const char *path, bool size_known) {
+	entropy_t estimation;
+
+	if (!agent->conf.compress_auto || agent->param.compression == A_COMP_NONE)
+		return;
+	estimation = entropy_path(path);
+	log->entropy = estimation.entropy;
+	log->compress_mode = (estimation.entropy >= A_ENTROPY_INCOMPRESSIBLE) ? A_ZMODE_FAST : A_ZMODE_NORMAL;
+	// in deduplication mode, the archive is a manifest, its size is not the compressed size
+	if (size_known && estimation.complete && !agent->dedup)
+		log->data_size = estimation.data_size;
+	if (estimation.entropy < 0.0)
+		ADEBUG("│ ├ " YANSI_FAINT "Entropy: " YANSI_RESET "unknown" YANSI_FAINT " (normal compression)" YANSI_RESET);
+	else
+		ADEBUG("│ ├ " YANSI_FAINT "Entropy: " YANSI_RESET "%.2f" YANSI_FAINT " bits per byte (%s compression)" YANSI_RESET,
+		       estimation.entropy, (log->compress_mode == A_ZMODE_FAST) ? "fastest" : "normal");
+}
+/* Add the compression level and threads options to a list of arguments. */
+static void backup_compress_options(agent_t *agent, log_item_t *log, yarray_t *args, char level_opt[8],
+                                    char threads_opt[16]) {
+	int level = agent->conf.compress_level;
+
+	// incompressible data are compressed at the fastest level (xz's fastest level is 0)
+	if (log && log->compress_mode == A_ZMODE_FAST) {
+		snprintf(level_opt, 8, "-%d", (agent->param.compression == A_COMP_XZ) ? 0 : 1);
+		yarray_push(args, level_opt);
+	} else if (level) {
+		// bound the level to the range supported by the compression program
+		if (agent->param.compression == A_COMP_ZSTD && level > A_ZSTD_MAX_LEVEL)
+			level = A_ZSTD_MAX_LEVEL;
+		else if (agent->param.compression != A_COMP_ZSTD && level > 9)
+			level = 9;
+		snprintf(level_opt, 8, "-%d", level);
+		yarray_push(args, level_opt);
+	}
+	// only zstd and xz are multithreaded
+	if (agent->conf.compress_threads &&
+	    (agent->param.compression == A_COMP_ZSTD || agent->param.compression == A_COMP_XZ)) {
+		snprintf(threads_opt, 16, "-T%d", agent->conf.compress_threads);
+		yarray_push(args, threads_opt);
+	}
+}
+/* Returns the file extension of the used compression method. */
+static const char *backup_compress_ext(agent_t *agent) {
+	if (agent->param.compression == A_COMP_GZIP)
+		return ("gz");
+	if (agent->param.compression == A_COMP_BZIP2)
+		return ("bz2");
+	if (agent->param.compression == A_COMP_XZ)
+		return ("xz");
+	if (agent->param.compression == A_COMP_ZSTD)
+		return ("zst");
+	return (NULL);
+}
+/* Stream a dump through the compression, encryption and checksum programs. */
+static ystatus_t backup_stream_item(agent_t *agent, log_item_t *log, const yexec_cmd_t *dump,
+                                    yexec_input_function_t producer, void *producer_data) {
+	ystatus_t status = YENOERR;
+	yexec_cmd_t cmds[5] = {0};
+	size_t nbr_cmds = 0;
+	yarray_t z_args = NULL, crypt_args = NULL;
+	char *pass_path = NULL, *tmp_file = NULL;
+	ystr_t param = NULL, archive_name = NULL, archive_path = NULL, volume_base = NULL;
+	yhash_sha512_t sha512;
+	uint8_t digest[YHASH_SHA512_SIZE];
+	char level_opt[8], threads_opt[16];
+	// deduplication is enabled only with the native encryption
+	bool dedup = agent->dedup ? true : false;
+	// chunks of a deduplicated archive are already stored independently
+	bool volumes = (agent->conf.volume_size && !dedup);
+	bool streaming = (agent->conf.streaming || dedup || volumes);
+	bool native_crypt = (streaming && agent->param.encryption == A_CRYPT_ARKIV);
+	encrypt_stream_t crypt_stream;
+	dedup_stream_t dedup_stream;
+	volume_stream_t volume;
+	FILE *crypt_file = NULL;
+	// an input which is already compressed keeps its name
+	const char *z_ext = (log->compress_status == YEUNDEF) ? backup_compress_ext(agent) : NULL;
+	const char *crypt_ext = streaming ? backup_encrypt_ext(agent) : NULL;
+	const char *manifest_ext = dedup ? ".manifest" : "";
+	const char *volume_ext = volumes ? ("." A_VOLUME_MANIFEST_EXT) : "";
+	uint64_t chunks_size = 0;
+
+	// final archive name (in deduplication mode, the archive is the manifest of its chunks;
+	// in volumes mode, it is the list of its volumes)
+	archive_name = ys_printf(NULL, "%s%s%s%s%s%s%s", log->archive_name, (z_ext ? "." : ""), (z_ext ? z_ext : ""),
+	                         manifest_ext, (crypt_ext ? "." : ""), (crypt_ext ? crypt_ext : ""), volume_ext);
+	archive_path = ys_printf(NULL, "%s%s%s%s%s%s%s", log->archive_path, (z_ext ? "." : ""), (z_ext ? z_ext : ""),
+	                         manifest_ext, (crypt_ext ? "." : ""), (crypt_ext ? crypt_ext : ""), volume_ext);
+	if (archive_path && volumes)
+		volume_base = ys_printf(NULL, "%.*s", (int)(ys_bytesize(archive_path) - strlen(volume_ext)), archive_path);
+	if (!archive_name || !archive_path || (volumes && !volume_base) ||
+	    !(z_args = yarray_create(4)) ||
+	    !(crypt_args = yarray_create(10)) ||
+	    (streaming && !native_crypt && !(pass_path = yfile_tmp("/tmp/arkiv")))) {
+		ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		status = log->dump_status = YENOMEM;
+		goto cleanup;
+	}
+	if (!(tmp_file = yfile_tmp(archive_path))) {
+		ALOG("│ └ " YANSI_RED "Unable to create temporary file" YANSI_RESET);
+		status = log->dump_status = YEIO;
+		goto cleanup;
+	}
+	// dump
+	if (dump)
+		cmds[nbr_cmds++] = *dump;
+	// compression (the producer's output may already be compressed)
+	if (agent->param.compression != A_COMP_NONE && log->compress_status == YEUNDEF) {
+		backup_compress_options(agent, log, &z_args, level_opt, threads_opt);
+		// the compressed stream is reset regularly, so a local change in the
+		// dump only changes the chunks around it
+		if (dedup && (agent->param.compression == A_COMP_ZSTD || agent->param.compression == A_COMP_GZIP))
+			yarray_push(&z_args, "--rsyncable");
+		yarray_push_multi(&z_args, 2, "--quiet", "--stdout");
+		cmds[nbr_cmds++] = (yexec_cmd_t){
+			.command = agent->bin.z,
+			.args = z_args,
+		};
+	}
+	// encryption by a sub-program (streaming mode)
+	if (streaming && !native_crypt) {
+		yfile_put_string(pass_path, agent->conf.crypt_pwd);
+		if ((status = backup_encrypt_args(agent, &crypt_args, pass_path, &param, NULL, NULL)) != YENOERR) {
+			ALOG("│ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+			log->dump_status = status;
+			goto cleanup;
+		}
+		cmds[nbr_cmds++] = (yexec_cmd_t){
+			.command = agent->bin.crypt,
+			.args = crypt_args,
+		};
+	}
+	// execution (in streaming mode, the archive's checksum is computed while it is written)
+	ADEBUG("│ ├ " YANSI_FAINT "Stream to " YANSI_RESET "%s", archive_path);
+	yhash_sha512_init(&sha512);
+	if (volumes) {
+		// the output is split into volumes; the checksum file is the manifest's one
+		if ((status = volume_stream_open(&volume, agent, log, volume_base)) == YENOERR) {
+			if (!native_crypt) {
+				status = backup_pipeline(agent, cmds, nbr_cmds, producer, producer_data, NULL,
+				                         volume_stream_write, &volume);
+			} else {
+				if ((status = encrypt_stream_open_func(&crypt_stream, agent->crypt_key, volume_stream_write,
+				                                       &volume, NULL)) == YENOERR)
+					status = backup_pipeline(agent, cmds, nbr_cmds, producer, producer_data, NULL,
+					                         encrypt_stream_write, &crypt_stream);
+				status = AERROR_OVERRIDE(status, encrypt_stream_close(&crypt_stream));
+			}
+		}
+		status = AERROR_OVERRIDE(status, volume_stream_close(&volume, ((status == YENOERR) ? tmp_file : NULL),
+		                                                     &sha512));
+		if (status == YENOERR)
+			ADEBUG("│ ├ " YANSI_FAINT "Volumes: " YANSI_RESET "%zu" YANSI_FAINT " (" YANSI_RESET "%" PRIu64
+			       YANSI_FAINT " bytes)" YANSI_RESET, yarray_length(log->parts), volume.total_size);
+	} else if (native_crypt) {
+		// native encryption of the pipeline's output
+		if (!(crypt_file = fopen(tmp_file, "we"))) {
+			status = YEIO;
+		} else {
+			if (encrypt_stream_open(&crypt_stream, agent->crypt_key, crypt_file, &sha512) == YENOERR) {
+				if (!dedup) {
+					status = backup_pipeline(agent, cmds, nbr_cmds, producer, producer_data, NULL,
+					                         encrypt_stream_write, &crypt_stream);
+				} else {
+					// the output is cut into chunks, and their list is written to the manifest
+					if (dedup_stream_open(&dedup_stream, agent, log, &crypt_stream) == YENOERR)
+						status = backup_pipeline(agent, cmds, nbr_cmds, producer, producer_data, NULL,
+						                         dedup_stream_write, &dedup_stream);
+					status = AERROR_OVERRIDE(status, dedup_stream_close(&dedup_stream));
+					chunks_size = dedup_stream.new_size;
+					if (status == YENOERR)
+						ADEBUG("│ ├ " YANSI_FAINT "Chunks: " YANSI_RESET "%" PRIu64 YANSI_FAINT ", new: " YANSI_RESET
+						       "%" PRIu64 YANSI_FAINT " (" YANSI_RESET "%" PRIu64 YANSI_FAINT " bytes)" YANSI_RESET,
+						       dedup_stream.nbr_chunks, dedup_stream.nbr_new, dedup_stream.new_size);
+				}
+			}
+			status = AERROR_OVERRIDE(status, encrypt_stream_close(&crypt_stream));
+			if (fclose(crypt_file) && status == YENOERR)
+				status = YEIO;
+		}
+	} else
+		status = backup_pipeline(agent, cmds, nbr_cmds, producer, producer_data, tmp_file,
+		                         (streaming ? backup_checksum_update : NULL), &sha512);
+	if (status != YENOERR) {
+		ALOG("│ └ " YANSI_RED "Streaming error" YANSI_RESET);
+		log->dump_status = status;
+		unlink(tmp_file);
+		goto cleanup;
+	}
+	// move the file to its destination
+	if (rename(tmp_file, archive_path)) {
+		ALOG("│ └ " YANSI_RED "Unable to move file " YANSI_RESET "%s" YANSI_RED " to " YANSI_RED "%s" YANSI_RESET, tmp_file, archive_path);
+		status = log->dump_status = YEIO;
+		unlink(tmp_file);
+		goto cleanup;
+	}
+	// set log status
+	log->dump_status = YENOERR;
+	if (agent->param.compression != A_COMP_NONE)
+		log->compress_status = YENOERR;
+	if (streaming)
+		log->encrypt_status = YENOERR;
+	ys_free(log->archive_name);
+	ys_free(log->archive_path);
+	log->archive_name = archive_name;
+	log->archive_path = archive_path;
+	archive_name = archive_path = NULL;
+	// the size of a split archive is the size of its volumes
+	log->archive_size = volumes ? volume.total_size : yfile_get_size(log->archive_path);
+	// only the archive (and the new chunks) were written to disk
+	backup_disk_usage(log, log->archive_size + chunks_size);
+	ADEBUG("│ ├ " YANSI_FAINT "Peak disk usage: " YANSI_RESET "%" PRIu64 YANSI_FAINT " bytes" YANSI_RESET, log->disk_peak);
+	// write the checksum file
+	yhash_sha512_final(&sha512, digest);
+	if (streaming && (status = log->checksum_status = backup_write_checksum(agent, log, digest)) != YENOERR)
+		goto cleanup;
+	backup_drop_cache(agent, log);
+	ADEBUG("│ └ " YANSI_GREEN "Done" YANSI_RESET);
+cleanup:
+	if (pass_path) {
+		unlink(pass_path);
+		free0(pass_path);
+	}
+	free0(tmp_file);
+	ys_free(param);
+	ys_free(archive_name);
+	ys_free(archive_path);
+	ys_free(volume_base);
+	yarray_free(z_args);
+	yarray_free(crypt_args);
+	return (status);
+}
+/* Update the peak disk space used by an item's backup. */
+static void backup_disk_usage(log_item_t *log, uint64_t size) {
+	if (size > log->disk_peak)
+		log->disk_peak = size;
+}
+/* Add a chunk of a streamed archive to its checksum computation. */
+static void backup_checksum_update(const void *data, size_t len, void *user_data) {
+	yhash_sha512_update((yhash_sha512_t*)user_data, data, len);
+}
+/* Execute the pipeline of a streamed archive, at the write rate limit. */
+static ystatus_t backup_pipeline(agent_t *agent, const yexec_cmd_t *cmds, size_t nbr_cmds,
+                                 yexec_input_function_t producer, void *producer_data, const char *out_file,
+                                 yexec_output_function_t out_func, void *out_data) {
+	backup_throttle_t throttle = {
+		.throttle = agent->write_throttle,
+		.func = out_func,
+		.data = out_data,
+	};
+	ybin_t err = {0};
+	ystatus_t status;
+
+	if (!agent->write_throttle)
+		status = yexec_pipeline_input(cmds, nbr_cmds, producer, producer_data, NULL, out_file, out_func,
+		                              out_data, &err);
+	else {
+		// the pipe is read at the limited rate, so the programs are slowed down
+		status = yexec_pipeline_input(cmds, nbr_cmds, producer, producer_data, NULL, out_file,
+		                              backup_throttle_output, &throttle, &err);
+	}
+	if (status != YENOERR)
+		log_program_errors(agent, "│ ├ ", &err);
+	ybin_delete_data(&err);
+	return (status);
+}
+/* Wait for the write rate limit, then give a chunk of a pipeline's output to the output function. */
+static void backup_throttle_output(const void *data, size_t len, void *user_data) {
+	backup_throttle_t *throttle = user_data;
+
+	throttle_consume(throttle->throttle, len);
+	if (throttle->func)
+		throttle->func(data, len, throttle->data);
+}
+/* Remove the files of an archive from the page cache. */
+static void backup_drop_cache(agent_t *agent, log_item_t *log) {
+	if (!agent->conf.io_idle || !log->archive_path)
+		return;
+	for (size_t i = 0; i < yarray_length(log->parts); ++i)
+		throttle_drop_cache(log->parts[i]);
+	throttle_drop_cache(log->archive_path);
+}
+/* Set the I/O controls of the run. */
+static void backup_io_control(agent_t *agent) {
+	if (!agent->conf.read_limit && !agent->conf.write_limit && !agent->conf.io_idle)
+		return;
+	ALOG("Set I/O controls");
+	if (agent->conf.read_limit) {
+		if (!(agent->read_throttle = throttle_create(agent->conf.read_limit)))
+			ALOG("├ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		else
+			ALOG("├ " YANSI_FAINT "Read limit: " YANSI_RESET "%u" YANSI_FAINT " MB/s" YANSI_RESET,
+			     agent->conf.read_limit);
+	}
+	if (agent->conf.write_limit) {
+		if (!(agent->write_throttle = throttle_create(agent->conf.write_limit)))
+			ALOG("├ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		else
+			ALOG("├ " YANSI_FAINT "Write limit: " YANSI_RESET "%u" YANSI_FAINT " MB/s" YANSI_RESET,
+			     agent->conf.write_limit);
+	}
+	if (agent->conf.io_idle) {
+		if (throttle_io_idle() == YENOERR)
+			ALOG("├ " YANSI_FAINT "Idle I/O scheduling class" YANSI_RESET);
+		else
+			ALOG("├ " YANSI_YELLOW "Unable to set the idle I/O scheduling class" YANSI_RESET);
+	}
+	ALOG("└ " YANSI_GREEN "Done" YANSI_RESET);
+}
+/* Write the checksum file of a backed up item. */
+static ystatus_t backup_write_checksum(agent_t *agent, log_item_t *item, const uint8_t digest[YHASH_SHA512_SIZE]) {
+	char hex[YHASH_SHA512_HEX_SIZE + 1];
+	ystr_t sum = NULL;
+	ystatus_t status = YENOERR;
+	const char *name;
+
+	if (!(item->checksum_name = ys_printf(NULL, "%s.sha512", item->archive_name)) ||
+	    !(item->checksum_path = ys_printf(NULL, "%s.sha512", item->archive_path))) {
+		ALOG("│ │ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		return (YENOMEM);
+	}
+	// same format as the sha512sum program, with the file name relative to the archive's directory
+	// (the archives of a directory dump are named after their subdirectory)
+	if ((name = strrchr(item->archive_name, '/')))
+		name++;
+	else
+		name = item->archive_name;
+	yhash_sha512_hex(digest, hex);
+	if (!(sum = ys_printf(NULL, "%s  %s\n", hex, name)) ||
+	    !yfile_put_string(item->checksum_path, sum)) {
+		ALOG("│ │ └ " YANSI_RED "Unable to write checksum result to " YANSI_RESET "%s", item->checksum_path);
+		status = YEIO;
+	}
+	ys_free(sum);
+	return (status);
+}
 /* Compute the checksum of each backed up file. */
 static void backup_compute_checksums(agent_t *agent) {
 	ystatus_t st_files = YENOERR, st_db = YENOERR;
@@ -1383,58 +3113,22 @@ static ystatus_t backup_compute_checksum_item(uint64_t hash, char *key, void *da
 	ystatus_t status = YENOERR;
 	log_item_t *item = data;
 	agent_t *agent = user_data;
-	yarray_t args = NULL;
-	ybin_t bin = {0};
+	uint8_t digest[YHASH_SHA512_SIZE];
 
-	if (!item->success)
+	// the checksum may have been computed while streamed
+	if (!item->success || item->checksum_status != YEUNDEF)
 		return (YENOERR);
 	ADEBUG("│ ├ " YANSI_FAINT "Compute checksum of " YANSI_RESET "%s", item->archive_path);
-	// change working directory
-	char *working_dir = NULL;
-	if (item->type == A_ITEM_TYPE_FILE)
-		working_dir = agent->backup_files_path;
-	else if (item->type == A_ITEM_TYPE_DB_MYSQL)
-		working_dir = agent->backup_mysql_path;
-	else if (item->type == A_ITEM_TYPE_DB_PGSQL)
-		working_dir = agent->backup_pgsql_path;
-	else if (item->type == A_ITEM_TYPE_DB_MONGODB)
-		working_dir = agent->backup_mongodb_path;
-	if (!working_dir || chdir(working_dir)) {
-		ALOG("│ │ └ " YANSI_RED "Unable to change working directory to '" YANSI_RESET "%s" YANSI_RED "'" YANSI_RESET, working_dir);
-		status = YEIO;
-		goto end;
-	}
-	// create argument list
-	if (!(args = yarray_create(1))) {
-		ALOG("│ │ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
-		status = YENOMEM;
-		goto end;
-	}
-	yarray_push(&args, item->archive_name);
-	// execution
-	status = yexec(agent->bin.checksum, args, NULL, &bin, NULL);
-	if (status != YENOERR || !bin.bytesize) {
+	if ((status = yhash_sha512_file(item->archive_path, digest)) != YENOERR) {
 		ALOG("│ │ └ " YANSI_RED "Checksum error" YANSI_RESET);
-		status = YENOEXEC;
 		goto end;
 	}
 	// write result
-	if (!(item->checksum_name = ys_printf(NULL, "%s.sha512", item->archive_name)) ||
-	    !(item->checksum_path = ys_printf(NULL, "%s.sha512", item->archive_path))) {
-		ALOG("│ │ └ " YANSI_RED "Memory allocation error" YANSI_RESET);
-		status = YENOMEM;
-		goto end;
-	}
-	if (!yfile_put_contents(item->checksum_path, &bin)) {
-		ALOG("│ │ └ " YANSI_RED "Unable to write checksum result to " YANSI_RESET "%s", item->checksum_path);
-		status = YENOMEM;
-		goto end;
-	}
+	status = backup_write_checksum(agent, item, digest);
 end:
 	item->checksum_status = status;
 	item->success = (status == YENOERR) ? true : false;
-	yarray_free(args);
-	ybin_delete_data(&bin);
+	journal_write(agent, item);
 	return (status);
 }
 
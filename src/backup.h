@@ -7,7 +7,23 @@
 #pragma once
 
 #include "yjson.h"
+#include "yhash.h"
+#include "ytar.h"
 #include "agent.h"
+#include "log.h"
+
+/** @const A_NATIVE_TAR_THREADS	Number of threads reading directories for the native tar writer. */
+#define A_NATIVE_TAR_THREADS	4
+/** @const A_FILE_INPUT_BUFFER_SIZE	Size of the buffer used to stream a file through a pipeline. */
+#define A_FILE_INPUT_BUFFER_SIZE	65536
+/** @const A_PGSQL_DUMP_FILES		Name of the list of files of a complete PostgreSQL directory dump. */
+#define A_PGSQL_DUMP_FILES		".arkiv-files"
+/** @const A_PGSQL_DATABASES_QUERY	Query listing the PostgreSQL databases which can be dumped. */
+#define A_PGSQL_DATABASES_QUERY		"SELECT datname FROM pg_database WHERE datallowconn AND NOT datistemplate ORDER BY 1"
+/** @const A_MYSQL_BINLOGS_QUERY	Query listing the binary logs of a MySQL server, with their sizes. */
+#define A_MYSQL_BINLOGS_QUERY		"SHOW BINARY LOGS"
+/** @const A_MYSQLDUMP_HEAD_SIZE	Size of the beginning of a dump searched for the position in the binary logs. */
+#define A_MYSQLDUMP_HEAD_SIZE		65536
 
 /**
  * @function	exec_backup
@@ -15,9 +31,78 @@
  * @param	agent	Pointer to the agent structure.
  */
 void exec_backup(agent_t *agent);
+/**
+ * @function	backup_fetch_params
+ * @abstract	Fetch and process host backup parameter file.
+ * @discussion	The storage of the WAL segments is read before the schedules, so
+ *		it is available even if no backup is scheduled.
+ * @param	agent	Pointer to the agent structure.
+ * @return	YENOERR if everything went fine;
+ *		YEAGAIN if no backup is schedule for the current execution time;
+ *		other status if an error occurred.
+ */
+ystatus_t backup_fetch_params(agent_t *agent);
+/**
+ * @function	backup_fetch_params_cache
+ * @abstract	Fetch and process host backup parameter file, using a local
+ *		copy if it is recent enough.
+ * @discussion	The copy is written after each download, readable by its
+ *		owner only. If the file can't be downloaded, the copy is used
+ *		whatever its age.
+ * @param	agent		Pointer to the agent structure.
+ * @param	cache_path	Path to the local copy.
+ * @param	ttl		Duration of validity of the copy, in seconds.
+ * @return	Same values as backup_fetch_params().
+ */
+ystatus_t backup_fetch_params_cache(agent_t *agent, const char *cache_path, time_t ttl);
+/**
+ * @function	backup_stream_file
+ * @abstract	Stream a local file through the compression, encryption and
+ *		checksum stages of the archives.
+ * @param	agent	Pointer to the agent structure.
+ * @param	log	Pointer to the item's log entry, whose archive_name and
+ *			archive_path are the ones of the uncompressed archive.
+ * @param	path	Path to the file.
+ * @return	YENOERR if the archive and its checksum file were written successfully.
+ */
+ystatus_t backup_stream_file(agent_t *agent, log_item_t *log, const char *path);
+/**
+ * @function	backup_incremental_commit
+ * @abstract	Keep the state file of an uploaded incremental backup, and update
+ *		the number of runs since the last full backup. Errors are not
+ *		fatal: the next backup is based on the previous state.
+ * @param	agent	Pointer to the agent structure.
+ * @param	log	Pointer to the item's log entry.
+ * @return	YENOERR if OK.
+ */
+ystatus_t backup_incremental_commit(agent_t *agent, log_item_t *log);
+/**
+ * @function	backup_incremental_discard
+ * @abstract	Remove the state file of an incremental backup which was not
+ *		uploaded, so the next backup is based on the previous state.
+ * @param	log	Pointer to the item's log entry.
+ */
+void backup_incremental_discard(log_item_t *log);
 
 /* ********** PRIVATE DECLARATIONS ********** */
 #ifdef __A_BACKUP_PRIVATE__
+	/**
+	 * @function	backup_params_cache
+	 * @abstract	Read the host parameters from a local copy if it is recent
+	 *		enough, or download them and update the copy.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	cache_path	Path to the local copy.
+	 * @param	ttl		Duration of validity of the copy, in seconds.
+	 * @return	The parameters, or NULL if an error occurred.
+	 */
+	static yvar_t *backup_params_cache(agent_t *agent, const char *cache_path, time_t ttl);
+	/**
+	 * @function	backup_params_read
+	 * @abstract	Read the host parameters from a local copy.
+	 * @param	path	Path to the local copy.
+	 * @return	The parameters, or NULL if the file can't be read or deserialized.
+	 */
+	static yvar_t *backup_params_read(const char *path);
 	/**
 	 * @typedef	script_type_t
 	 * @abstract	Type of script (pre or post).
@@ -28,23 +113,114 @@ void exec_backup(agent_t *agent);
 		A_SCRIPT_TYPE_PRE = 0,
 		A_SCRIPT_TYPE_POST
 	} script_type_t;
+	/**
+	 * @typedef	backup_job_t
+	 * @abstract	Backup of one item, processed by a worker.
+	 * @field	item	Pointer to the item's parameters.
+	 * @field	agent	Copy of the agent structure, with the job's own execution logs
+	 *			and log buffer. Its other pointers (configuration,
+	 *			parameters, program paths, journal, dedup index, upload
+	 *			queue, rate limits) are shared with the agent: they are
+	 *			set before the jobs are created, and only read by the jobs.
+	 * @field	status	Execution status.
+	 */
+	typedef struct {
+		yvar_t *item;
+		agent_t agent;
+		ystatus_t status;
+	} backup_job_t;
+	/**
+	 * @typedef	backup_pool_t
+	 * @abstract	List of jobs processed by a pool of workers.
+	 * @field	agent		Pointer to the agent structure.
+	 * @field	jobs		Array of jobs.
+	 * @field	nbr_jobs	Number of jobs.
+	 * @field	func		Function used to backup an item.
+	 * @field	buffered	True if log messages must be buffered by the jobs.
+	 * @field	stop_on_error	True if the remaining jobs are skipped after a failure
+	 *				(sequential processing, like the loop it replaces).
+	 * @field	status		Status of the first failed job (in the jobs' order).
+	 */
+	typedef struct {
+		agent_t *agent;
+		backup_job_t *jobs;
+		size_t nbr_jobs;
+		ytable_function_t func;
+		bool buffered;
+		bool stop_on_error;
+		ystatus_t status;
+	} backup_pool_t;
+	/**
+	 * @typedef	backup_tar_t
+	 * @abstract	Archive created by the native tar writer.
+	 * @field	path		Path to archive, relative to the root directory.
+	 * @field	fd		File descriptor the archive is written to.
+	 * @field	throttle	Read rate limit (could be NULL).
+	 * @field	stats		Statistics of the archive's creation.
+	 */
+	typedef struct {
+		const char *path;
+		int fd;
+		struct throttle_s *throttle;
+		ytar_stats_t stats;
+	} backup_tar_t;
+	/**
+	 * @typedef	backup_throttle_t
+	 * @abstract	Output of a pipeline, written at a limited rate.
+	 * @field	throttle	Write rate limit.
+	 * @field	func		Output function (could be NULL).
+	 * @field	data		Pointer given to the output function.
+	 */
+	typedef struct {
+		struct throttle_s *throttle;
+		yexec_output_function_t func;
+		void *data;
+	} backup_throttle_t;
+	/**
+	 * @typedef	backup_mysqldump_t
+	 * @abstract	Dump of a MySQL database, whose beginning is kept to read the
+	 *		position of its snapshot in the binary logs.
+	 * @field	cmd	mysqldump command.
+	 * @field	fd	File descriptor the dump is written to.
+	 * @field	head	Beginning of the dump.
+	 * @field	err	Beginning of the standard error of mysqldump.
+	 * @field	status	Status of the writings.
+	 */
+	typedef struct {
+		const yexec_cmd_t *cmd;
+		int fd;
+		ystr_t head;
+		ybin_t err;
+		ystatus_t status;
+	} backup_mysqldump_t;
 
 	/**
 	 * @function	backup_purge_local
 	 * @abstract	Purge local archive files.
-	 * @param	agent	Pointer to the agent structure.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	keep_current	True to keep the directory of an interrupted run of
+	 *				the current schedule slot (it is resumed).
 	 * @return	YENOERR if everything went fine.
 	 */
-	static ystatus_t backup_purge_local(agent_t *agent);
+	static ystatus_t backup_purge_local(agent_t *agent, bool keep_current);
+	/**
+	 * @function	backup_first_storage
+	 * @abstract	Get the first declared storage.
+	 * @param	hash		Index of the storage.
+	 * @param	key		Identifier of the storage.
+	 * @param	data		Pointer to the storage's yvar.
+	 * @param	user_data	Pointer to the yvar pointer to set.
+	 * @return	Always YEAGAIN (the loop is stopped).
+	 */
+	static ystatus_t backup_first_storage(uint64_t hash, char *key, void *data, void *user_data);
 	/**
-	 * @function	backup_fetch_param
-	 * @abstract	Fetch and process host backup parameter file.
+	 * @function	backup_output_path
+	 * @abstract	Generate the path to the output directory, which depends on
+	 *		the schedule slot of the execution.
 	 * @param	agent	Pointer to the agent structure.
-	 * @return	YENOERR if everything went fine;
-	 *		YEAGAIN if no backup is schedule for the current execution time;
-	 *		other status if an error occurred.
+	 * @return	YENOERR if OK.
 	 */
-	static ystatus_t backup_fetch_params(agent_t *agent);
+	static ystatus_t backup_output_path(agent_t *agent);
 	/**
 	 * @function	backup_create_output_directory
 	 * @abstract	Create output directory.
@@ -102,6 +278,75 @@ void exec_backup(agent_t *agent);
 	 *		YENOEXEC if an error occurred during the backup.
 	 */
 	static ystatus_t backup_file(uint64_t hash, char *key, void *data, void *user_data);
+	/**
+	 * @function	backup_incremental_state
+	 * @abstract	Set the path to the state files of an incremental backup, and
+	 *		read the number of runs since the last full backup.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	log		Pointer to the item's log entry.
+	 * @param	filename	Name of the state files, relative to the incremental directory.
+	 * @param	ext		Extension of the state files.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t backup_incremental_state(agent_t *agent, log_item_t *log, const char *filename,
+	                                          const char *ext);
+	/**
+	 * @function	backup_incremental_resume
+	 * @abstract	Restore the incremental state of an archive resumed from the
+	 *		journal, so its state file is kept once it is uploaded.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	log		Pointer to the item's log entry, whose state_tmp was
+	 *				restored by the journal (if any).
+	 * @param	filename	Name of the state files, relative to the incremental directory.
+	 * @param	ext		Extension of the state files.
+	 */
+	static void backup_incremental_resume(agent_t *agent, log_item_t *log, const char *filename, const char *ext);
+	/**
+	 * @function	backup_incremental_prepare
+	 * @abstract	Compute the level of an incremental backup, and create the state
+	 *		file of the new archive: a copy of the state of the base archive
+	 *		(tar's snapshot of the files, or position in the MySQL binary
+	 *		logs), or an empty file for a full backup.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	log		Pointer to the item's log entry. Its level and state
+	 *				fields are set.
+	 * @param	filename	Name of the state files, relative to the incremental directory.
+	 * @param	ext		Extension of the state files.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t backup_incremental_prepare(agent_t *agent, log_item_t *log, const char *filename,
+	                                            const char *ext);
+	/**
+	 * @function	backup_incremental_cleanup
+	 * @abstract	Remove the incremental state of an archive which was not
+	 *		uploaded. Used as a ytable_foreach callback on the log tables.
+	 *		The state of an archive recorded in the journal is kept, for
+	 *		the execution which resumes it.
+	 * @param	hash		Always 0.
+	 * @param	key		Always null.
+	 * @param	data		Pointer to the item's log entry.
+	 * @param	user_data	Pointer to the agent structure.
+	 * @return	Always YENOERR.
+	 */
+	static ystatus_t backup_incremental_cleanup(uint64_t hash, char *key, void *data, void *user_data);
+	/**
+	 * @function	backup_tar_write
+	 * @abstract	Write the tar archive of a path, using the native tar writer.
+	 *		Used as the input of the compression pipeline.
+	 * @param	fd		File descriptor to write to.
+	 * @param	user_data	Pointer to the archive structure.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t backup_tar_write(int fd, void *user_data);
+	/**
+	 * @function	backup_tar_output
+	 * @abstract	Write a chunk of a tar archive to a file descriptor.
+	 * @param	data		Pointer to the data.
+	 * @param	len		Size of the data.
+	 * @param	user_data	Pointer to the archive structure.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t backup_tar_output(const void *data, size_t len, void *user_data);
 	/**
 	 * @function	backup_databases
 	 * @abstract	Backup all listed databases. They are tar'ed and compressed.
@@ -120,6 +365,83 @@ void exec_backup(agent_t *agent);
 	 *		YENOEXEC if an error occurred during the backup.
 	 */
 	static ystatus_t backup_database(uint64_t hash, char *key, void *data, void *user_data);
+	/**
+	 * @function	backup_database_directory
+	 * @abstract	Create the output directory of a database, if needed.
+	 * @param	hash		Index in the list of databases.
+	 * @param	key		Always null.
+	 * @param	data		Associative array with database's information.
+	 * @param	user_data	Pointer to the agent structure.
+	 * @return	Always YENOERR.
+	 */
+	static ystatus_t backup_database_directory(uint64_t hash, char *key, void *data, void *user_data);
+	/**
+	 * @function	backup_items
+	 * @abstract	Backup a list of items, using a bounded number of concurrent workers.
+	 *		Execution logs are merged in the items' order.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	items		List of items.
+	 * @param	func		Function used to backup an item.
+	 * @param	nbr_workers	Maximum number of concurrent backups.
+	 * @return	YENOERR if all items were backed up successfully, the error of
+	 *		the first failed item otherwise.
+	 */
+	static ystatus_t backup_items(agent_t *agent, ytable_t *items, ytable_function_t func, uint16_t nbr_workers);
+	/**
+	 * @function	backup_job_add
+	 * @abstract	Add an item to the list of jobs.
+	 * @param	hash		Index in the list of items.
+	 * @param	key		Always null.
+	 * @param	data		Item's parameters.
+	 * @param	user_data	Pointer to the pool structure.
+	 * @return	Always YENOERR.
+	 */
+	static ystatus_t backup_job_add(uint64_t hash, char *key, void *data, void *user_data);
+	/**
+	 * @function	backup_job_run
+	 * @abstract	Process a job (executed by a worker).
+	 * @param	index		Index of the job.
+	 * @param	user_data	Pointer to the pool structure.
+	 */
+	static void backup_job_run(size_t index, void *user_data);
+	/**
+	 * @function	backup_job_finalize_item
+	 * @abstract	Encrypt a backed up item and compute its checksum (used with the upload queue).
+	 * @param	hash		Index in the job's execution logs.
+	 * @param	key		Always null.
+	 * @param	data		Pointer to the log entry.
+	 * @param	user_data	Pointer to the job's agent structure.
+	 * @return	Always YENOERR.
+	 */
+	static ystatus_t backup_job_finalize_item(uint64_t hash, char *key, void *data, void *user_data);
+	/**
+	 * @function	backup_job_done
+	 * @abstract	Write the logs of a completed job, and merge its execution logs.
+	 *		Called in the jobs' order.
+	 * @param	index		Index of the job.
+	 * @param	user_data	Pointer to the pool structure.
+	 */
+	static void backup_job_done(size_t index, void *user_data);
+	/**
+	 * @function	backup_job_upload_item
+	 * @abstract	Add a backed up item to the upload queue.
+	 * @param	hash		Index in the job's execution logs.
+	 * @param	key		Always null.
+	 * @param	data		Pointer to the log entry.
+	 * @param	user_data	Pointer to the agent structure.
+	 * @return	Always YENOERR.
+	 */
+	static ystatus_t backup_job_upload_item(uint64_t hash, char *key, void *data, void *user_data);
+	/**
+	 * @function	backup_job_merge_log
+	 * @abstract	Add a log entry to the global execution logs.
+	 * @param	hash		Index in the job's execution logs.
+	 * @param	key		Always null.
+	 * @param	data		Pointer to the log entry.
+	 * @param	user_data	Pointer to the global list of log entries.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t backup_job_merge_log(uint64_t hash, char *key, void *data, void *user_data);
 	/**
 	 * @funuction	backup_mysql
 	 * @abstract	Backup a MySQL database.
@@ -128,6 +450,151 @@ void exec_backup(agent_t *agent);
 	 * @return	YENOERR if the database was dumped and compressed successfully.
 	 */
 	static ystatus_t backup_mysql(agent_t *agent, ytable_t *db_data);
+	/**
+	 * @function	backup_mysql_parallel
+	 * @abstract	Dump a MySQL database through several connections sharing a
+	 *		consistent snapshot.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	log		Pointer to the database's log entry.
+	 * @param	dbname		Name of the database.
+	 * @param	conn_args	Connection arguments of the MySQL programs.
+	 * @param	env		Environment of the MySQL programs.
+	 * @param	binlog		True if the position of the snapshot in the binary logs
+	 *				is needed.
+	 * @return	YENOERR if OK, YEAGAIN if the database must be dumped through
+	 *		one connection.
+	 */
+	static ystatus_t backup_mysql_parallel(agent_t *agent, log_item_t *log, const char *dbname,
+	                                       yarray_t conn_args, yarray_t env, bool binlog);
+	/**
+	 * @function	backup_mysql_databases
+	 * @abstract	List the MySQL databases, dump each one as a separate job, and write
+	 *		the manifest of the dumps as the archive of the '*' entry.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	log		Pointer to the log entry of the '*' entry.
+	 * @param	db_data		Parameters of the '*' entry.
+	 * @param	conn_args	Connection arguments of the MySQL programs.
+	 * @param	env		Environment of the MySQL programs.
+	 * @return	YENOERR if all the databases were dumped successfully.
+	 */
+	static ystatus_t backup_mysql_databases(agent_t *agent, log_item_t *log, ytable_t *db_data,
+	                                        yarray_t conn_args, yarray_t env);
+	/**
+	 * @function	backup_database_params
+	 * @abstract	Create the parameters of a database, sharing the connection
+	 *		parameters of another one.
+	 * @param	db_data	Parameters of the other database.
+	 * @param	dbname	Name of the database.
+	 * @return	A table yvar, or NULL on error.
+	 */
+	static yvar_t *backup_database_params(ytable_t *db_data, const char *dbname);
+	/**
+	 * @function	backup_database_params_free
+	 * @abstract	Free the parameters created by backup_database_params().
+	 *		Could be used as a callback of ytable_foreach().
+	 * @param	hash		Unused.
+	 * @param	key		Unused.
+	 * @param	data		Pointer to the parameters.
+	 * @param	user_data	Unused.
+	 * @return	Always YENOERR.
+	 */
+	static ystatus_t backup_database_params_free(uint64_t hash, char *key, void *data, void *user_data);
+	/**
+	 * @function	backup_mysql_binlog_list
+	 * @abstract	List the binary logs of a MySQL server, with their sizes.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	conn_args	Connection arguments of the MySQL programs.
+	 * @param	env		Environment of the MySQL programs.
+	 * @param	out		Pointer to a ybin_t filled with the list (one log per
+	 *				line, its name and its size separated by a tab).
+	 * @return	YENOERR if OK, YENODATA if the list is empty.
+	 */
+	static ystatus_t backup_mysql_binlog_list(agent_t *agent, yarray_t conn_args, yarray_t env, ybin_t *out);
+	/**
+	 * @function	backup_mysql_binlog
+	 * @abstract	Archive the binary logs written since the base archive of a MySQL
+	 *		database. The events are decoded by mysqlbinlog, from the position
+	 *		of the base archive to the current end of the logs, as SQL
+	 *		statements applied after the full dump.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	log		Pointer to the database's log entry.
+	 * @param	dbname		Name of the database (NULL for all databases).
+	 * @param	filename	Filenamized name of the database.
+	 * @param	conn_args	Connection arguments of the MySQL programs.
+	 * @param	env		Environment of the MySQL programs.
+	 * @param	state_tmp	State file, containing the position of the base archive.
+	 * @param	binlogs		List of the binary logs.
+	 * @return	YENOERR if OK, YEAGAIN if a full dump must be done.
+	 */
+	static ystatus_t backup_mysql_binlog(agent_t *agent, log_item_t *log, const char *dbname, const char *filename,
+	                                     yarray_t conn_args, yarray_t env, const char *state_tmp, ybin_t *binlogs);
+	/**
+	 * @function	backup_mysql_binlog_position
+	 * @abstract	Set the position in the binary logs reached by a MySQL archive,
+	 *		and write it to the state file of the archive (which is kept
+	 *		once the archive is uploaded).
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	log		Pointer to the database's log entry.
+	 * @param	file		Name of the binary log (could be NULL).
+	 * @param	position	Position in the binary log.
+	 */
+	static void backup_mysql_binlog_position(agent_t *agent, log_item_t *log, const char *file, uint64_t position);
+	/**
+	 * @function	backup_mysql_binlog_save
+	 * @abstract	Write the position in the binary logs to the state file of a
+	 *		MySQL archive. Without position, the state is emptied, so the
+	 *		next backup is a full one.
+	 * @param	agent	Pointer to the agent structure.
+	 * @param	log	Pointer to the database's log entry.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t backup_mysql_binlog_save(agent_t *agent, log_item_t *log);
+	/**
+	 * @function	backup_mysqldump_binlog
+	 * @abstract	Dump a MySQL database, and read the position of its snapshot in
+	 *		the binary logs.
+	 * @param	agent	Pointer to the agent structure.
+	 * @param	log	Pointer to the database's log entry.
+	 * @param	cmd	mysqldump command.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t backup_mysqldump_binlog(agent_t *agent, log_item_t *log, const yexec_cmd_t *cmd);
+	/**
+	 * @function	backup_mysqldump_probe
+	 * @abstract	Read the help of mysqldump, to find the option which writes the
+	 *		position of the snapshot in the binary logs as a comment of the
+	 *		dump, and whether it writes the GTIDs of the server. Called once
+	 *		per run.
+	 * @param	agent	Pointer to the agent structure.
+	 */
+	static void backup_mysqldump_probe(agent_t *agent);
+	/**
+	 * @function	backup_mysqldump_write
+	 * @abstract	Execute mysqldump, and write its dump to a file descriptor.
+	 *		Could be used as an input function of yexec_pipeline_input().
+	 * @param	fd		File descriptor.
+	 * @param	user_data	Pointer to a backup_mysqldump_t structure.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t backup_mysqldump_write(int fd, void *user_data);
+	/**
+	 * @function	backup_mysqldump_output
+	 * @abstract	Write a chunk of a dump, and keep the beginning of the dump.
+	 *		Output function of yexec_pipeline().
+	 * @param	data		Pointer to the data.
+	 * @param	len		Size of the data.
+	 * @param	user_data	Pointer to a backup_mysqldump_t structure.
+	 */
+	static void backup_mysqldump_output(const void *data, size_t len, void *user_data);
+	/**
+	 * @function	backup_mysqldump_position
+	 * @abstract	Read the position in the binary logs written by mysqldump at the
+	 *		beginning of a dump.
+	 * @param	head		Beginning of the dump.
+	 * @param	position	Pointer set to the position in the binary log.
+	 * @return	The name of the binary log (must be freed), or NULL if not found.
+	 */
+	static ystr_t backup_mysqldump_position(const char *head, uint64_t *position);
 	/**
 	 * @function	backup_pgsql
 	 * @abstract	Backup a PostgreSQL database.
@@ -136,6 +603,92 @@ void exec_backup(agent_t *agent);
 	 * @return	YENOERR if the database was dumped and compressed successfully.
 	 */
 	static ystatus_t backup_pgsql(agent_t *agent, ytable_t *db_data);
+	/**
+	 * @function	backup_pgsql_plain
+	 * @abstract	Dump a PostgreSQL database (or all of them) to a SQL file, and compress it.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	dbname		Name of the database ("*" for all the databases).
+	 * @param	conn_args	Connection arguments of the PostgreSQL programs.
+	 * @param	env		Environment of the PostgreSQL programs.
+	 * @param	globals		True to dump only the global objects (roles and tablespaces)
+	 *				of all the databases.
+	 * @return	YENOERR if the database was dumped and compressed successfully.
+	 */
+	static ystatus_t backup_pgsql_plain(agent_t *agent, ystr_t dbname, yarray_t conn_args, yarray_t env,
+	                                    bool globals);
+	/**
+	 * @function	backup_pgsql_directory
+	 * @abstract	Dump a PostgreSQL database in directory format, with concurrent jobs.
+	 *		pg_dump compresses the table files; each file of the dump is
+	 *		a separate archive, in the dump's directory. A complete dump
+	 *		(whose list of files was written) is kept if the execution is
+	 *		resumed.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	dbname		Name of the database.
+	 * @param	conn_args	Connection arguments of the PostgreSQL programs.
+	 * @param	env		Environment of the PostgreSQL programs.
+	 * @return	YENOERR if the database was dumped and compressed successfully.
+	 */
+	static ystatus_t backup_pgsql_directory(agent_t *agent, ystr_t dbname, yarray_t conn_args, yarray_t env);
+	/**
+	 * @function	backup_pgsql_file
+	 * @abstract	Compress (or stream) a file of a PostgreSQL directory dump. The
+	 *		files already compressed by pg_dump are not compressed again.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	dbname		Name of the database.
+	 * @param	dir_name	Name of the dump's directory.
+	 * @param	dir_path	Path to the dump's directory.
+	 * @param	file		Name of the file.
+	 * @param	dump_size	Size of the whole dump on disk.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t backup_pgsql_file(agent_t *agent, ystr_t dbname, const char *dir_name, const char *dir_path,
+	                                   const char *file, uint64_t dump_size);
+	/**
+	 * @function	backup_pgsql_databases
+	 * @abstract	List the PostgreSQL databases, and dump each one as a separate
+	 *		job. The dump jobs are shared among the databases dumped at
+	 *		the same time; a database given only one of them is dumped in
+	 *		plain format.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	db_data		Parameters of the '*' entry.
+	 * @param	conn_args	Connection arguments of the PostgreSQL programs.
+	 * @param	env		Environment of the PostgreSQL programs.
+	 * @return	YENOERR if all the databases were dumped successfully.
+	 */
+	static ystatus_t backup_pgsql_databases(agent_t *agent, ytable_t *db_data, yarray_t conn_args, yarray_t env);
+	/**
+	 * @function	backup_file_input
+	 * @abstract	Write the content of a file to a file descriptor (input function
+	 *		of a pipeline).
+	 * @param	fd		File descriptor.
+	 * @param	user_data	Path to the file.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t backup_file_input(int fd, void *user_data);
+	/**
+	 * @function	backup_string_input
+	 * @abstract	Write a string to a file descriptor (input function of a pipeline).
+	 * @param	fd		File descriptor.
+	 * @param	user_data	Pointer to the string.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t backup_string_input(int fd, void *user_data);
+	/**
+	 * @function	backup_write_all
+	 * @abstract	Write a buffer to a file descriptor.
+	 * @param	fd	File descriptor.
+	 * @param	data	Pointer to the data.
+	 * @param	len	Size of the data.
+	 * @return	YENOERR if OK, YEPIPE on error.
+	 */
+	static ystatus_t backup_write_all(int fd, const void *data, size_t len);
+	/**
+	 * @function	backup_remove_directory
+	 * @abstract	Remove a directory and the files it contains (not recursive).
+	 * @param	path	Path to the directory.
+	 */
+	static void backup_remove_directory(const char *path);
 	/**
 	 * @function	backup_mongodb
 	 * @abstract	Backup a MongoDB database.
@@ -168,6 +721,136 @@ void exec_backup(agent_t *agent);
 	 * @return	YENOERR if the file was compressed successfully.
 	 */
 	static ystatus_t backup_compress_file(agent_t *agent, log_item_t *log);
+	/**
+	 * @function	backup_compress_probe
+	 * @abstract	Estimate the compressibility of an item's data (adaptive compression),
+	 *		and choose its compression level.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	log		Pointer to the item's log entry.
+	 * @param	path		Path to the data (file or directory).
+	 * @param	size_known	True if the archive will contain all the data (the size of
+	 *				the data is used to compute the compression ratio).
+	 */
+	static void backup_compress_probe(agent_t *agent, log_item_t *log, const char *path, bool size_known);
+	/**
+	 * @function	backup_compress_options
+	 * @abstract	Add the compression level and threads options to a list of arguments.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	log		Pointer to the item's log entry (could be NULL).
+	 * @param	args		Pointer to the argument list.
+	 * @param	level_opt	Buffer used to write the level option.
+	 * @param	threads_opt	Buffer used to write the threads option.
+	 */
+	static void backup_compress_options(agent_t *agent, log_item_t *log, yarray_t *args, char level_opt[8],
+	                                    char threads_opt[16]);
+	/**
+	 * @function	backup_compress_ext
+	 * @abstract	Returns the file extension of the used compression method.
+	 * @param	agent	Pointer to the agent structure.
+	 * @return	The extension, or NULL if there is no compression.
+	 */
+	static const char *backup_compress_ext(agent_t *agent);
+	/**
+	 * @function	backup_encrypt_ext
+	 * @abstract	Returns the file extension of the used encryption method.
+	 * @param	agent	Pointer to the agent structure.
+	 * @return	The extension, or NULL if the encryption is undefined.
+	 */
+	static const char *backup_encrypt_ext(agent_t *agent);
+	/**
+	 * @function	backup_encrypt_args
+	 * @abstract	Fill the argument list of the encryption program.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	args		Pointer to the argument list.
+	 * @param	pass_path	Path to the file which contains the password.
+	 * @param	param		Pointer to a string that could be allocated for the
+	 *				password parameter. Must be freed by the caller.
+	 * @param	in_path		Path to the file to encrypt. NULL to read from stdin.
+	 * @param	out_path	Path to the encrypted file. NULL to write to stdout.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t backup_encrypt_args(agent_t *agent, yarray_t *args, const char *pass_path, ystr_t *param,
+	                                     const char *in_path, const char *out_path);
+	/**
+	 * @function	backup_stream_item
+	 * @abstract	Stream the output of a dump program through the compression program.
+	 *		In streaming mode, the output is also encrypted, and the checksum of the
+	 *		archive file is computed while it is written. In deduplication
+	 *		mode, the output is cut into chunks and the archive is a manifest.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	log		Pointer to the item's log entry.
+	 * @param	dump		Pointer to the dump command, which writes to its standard
+	 *				output (NULL if the dump is written by a function).
+	 * @param	producer	Function writing the dump (NULL if a dump command is given).
+	 * @param	producer_data	Pointer given to the function.
+	 * @return	YENOERR if the archive and its checksum file were written successfully.
+	 */
+	static ystatus_t backup_stream_item(agent_t *agent, log_item_t *log, const yexec_cmd_t *dump,
+	                                    yexec_input_function_t producer, void *producer_data);
+	/**
+	 * @function	backup_disk_usage
+	 * @abstract	Update the peak disk space used by an item's backup.
+	 * @param	log	Pointer to the item's log entry.
+	 * @param	size	Disk space used at a given time, in bytes.
+	 */
+	static void backup_disk_usage(log_item_t *log, uint64_t size);
+	/**
+	 * @function	backup_checksum_update
+	 * @abstract	Add a chunk of a streamed archive to its checksum computation.
+	 * @param	data		Pointer to the data.
+	 * @param	len		Size of the data.
+	 * @param	user_data	Pointer to the SHA-512 context.
+	 */
+	static void backup_checksum_update(const void *data, size_t len, void *user_data);
+	/**
+	 * @function	backup_pipeline
+	 * @abstract	Execute the pipeline of a streamed archive. If a write rate limit
+	 *		is set, its output is read at the limited rate. If it fails, the
+	 *		standard errors of its programs are logged.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	cmds		Array of commands.
+	 * @param	nbr_cmds	Number of commands.
+	 * @param	producer	Function writing the input (could be NULL).
+	 * @param	producer_data	Pointer given to the producer function.
+	 * @param	out_file	Path to the output file (could be NULL).
+	 * @param	out_func	Function called with each chunk of the output (could be NULL).
+	 * @param	out_data	Pointer given to the output function.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t backup_pipeline(agent_t *agent, const yexec_cmd_t *cmds, size_t nbr_cmds,
+	                                 yexec_input_function_t producer, void *producer_data, const char *out_file,
+	                                 yexec_output_function_t out_func, void *out_data);
+	/**
+	 * @function	backup_throttle_output
+	 * @abstract	Wait for the write rate limit, then give a chunk of a pipeline's
+	 *		output to the real output function.
+	 * @param	data		Pointer to the data.
+	 * @param	len		Size of the data.
+	 * @param	user_data	Pointer to the backup_throttle_t structure.
+	 */
+	static void backup_throttle_output(const void *data, size_t len, void *user_data);
+	/**
+	 * @function	backup_drop_cache
+	 * @abstract	Remove the files of an archive from the page cache (idle I/O mode).
+	 * @param	agent	Pointer to the agent structure.
+	 * @param	log	Pointer to the item's log entry.
+	 */
+	static void backup_drop_cache(agent_t *agent, log_item_t *log);
+	/**
+	 * @function	backup_io_control
+	 * @abstract	Set the I/O controls of the run (rate limits, idle I/O class).
+	 * @param	agent	Pointer to the agent structure.
+	 */
+	static void backup_io_control(agent_t *agent);
+	/**
+	 * @function	backup_write_checksum
+	 * @abstract	Write the checksum file of a backed up item, in the sha512sum format.
+	 * @param	agent	Pointer to the agent structure.
+	 * @param	item	Pointer to the item's log entry.
+	 * @param	digest	SHA-512 digest of the archive file.
+	 * @return	YENOERR if the checksum file was written successfully.
+	 */
+	static ystatus_t backup_write_checksum(agent_t *agent, log_item_t *item, const uint8_t digest[YHASH_SHA512_SIZE]);
 	/**
 	 * @function	backup_compute_checksums
 	 * @abstract	Compute the checksum of each backed up file.
@@ -0,0 +1,373 @@
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "yansi.h"
+#include "ymemory.h"
+#include "yfile.h"
+#include "ystr.h"
+
+#define __A_CHANGES_PRIVATE__
+#include "changes.h"
+
+/** @const A_CHANGES_FNV_OFFSET	Initial value of the FNV-1a hash. */
+#define A_CHANGES_FNV_OFFSET	0xcbf29ce484222325ULL
+/** @const A_CHANGES_FNV_PRIME	Multiplier of the FNV-1a hash. */
+#define A_CHANGES_FNV_PRIME	0x100000001b3ULL
+
+/* Walk a backup path, and compare it to the index of its last successful backup. */
+ystatus_t changes_scan(agent_t *agent, log_item_t *log, const char *path, const char *filename) {
+	ystatus_t status = YENOERR;
+	ystr_t dir = NULL;
+	int fd = -1;
+	uint8_t *map = NULL;
+	struct stat sb;
+	uint32_t version, ref_size;
+	uint64_t count, size, nbr_entries, nbr_changes = 0;
+	uint16_t level;
+	int64_t date, retention;
+
+	if (!(log->changes = ybin_new()) ||
+	    !(dir = ys_printf(NULL, "%s/%s", agent->conf.archives_path, A_CHANGES_DIRNAME)) ||
+	    !(log->changes_path = ys_printf(NULL, "%s/%s.idx", dir, filename))) {
+		ALOG("│ ├ " YANSI_YELLOW "Memory allocation error, changes not checked" YANSI_RESET);
+		status = YENOMEM;
+		goto cleanup;
+	}
+	if (!yfile_mkpath(dir, 0700)) {
+		ALOG("│ ├ " YANSI_YELLOW "Unable to create directory " YANSI_RESET "%s", dir);
+		status = YEIO;
+		goto cleanup;
+	}
+	// metadata of the files
+	if ((status = changes_walk(path, log->changes)) != YENOERR) {
+		ALOG("│ ├ " YANSI_YELLOW "Unable to walk " YANSI_RESET "%s" YANSI_YELLOW ", changes not checked" YANSI_RESET, path);
+		goto cleanup;
+	}
+	nbr_entries = log->changes->bytesize / sizeof(changes_entry_t);
+	// index of the last successful backup
+	if ((fd = open(log->changes_path, O_RDONLY | O_CLOEXEC)) < 0) {
+		ADEBUG("│ ├ " YANSI_FAINT "No index of the previous backup (" YANSI_RESET "%" PRIu64 YANSI_FAINT " entries)" YANSI_RESET,
+		       nbr_entries);
+		goto cleanup;
+	}
+	if (fstat(fd, &sb) || sb.st_size < A_CHANGES_INDEX_HEADER_SIZE ||
+	    (map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		map = NULL;
+		ADEBUG("│ ├ " YANSI_YELLOW "Unable to read " YANSI_RESET "%s", log->changes_path);
+		goto cleanup;
+	}
+	memcpy(&version, map + 8, sizeof(uint32_t));
+	memcpy(&ref_size, map + 12, sizeof(uint32_t));
+	memcpy(&count, map + 16, sizeof(uint64_t));
+	memcpy(&level, map + 24, sizeof(uint16_t));
+	memcpy(&size, map + 32, sizeof(uint64_t));
+	memcpy(&date, map + 40, sizeof(int64_t));
+	if (memcmp(map, A_CHANGES_INDEX_MAGIC, 8) || version != A_CHANGES_INDEX_VERSION || !ref_size ||
+	    count > ((uint64_t)sb.st_size - A_CHANGES_INDEX_HEADER_SIZE) / sizeof(changes_entry_t) ||
+	    A_CHANGES_INDEX_HEADER_SIZE + count * sizeof(changes_entry_t) + ref_size != (uint64_t)sb.st_size) {
+		ADEBUG("│ ├ " YANSI_YELLOW "Invalid index " YANSI_RESET "%s", log->changes_path);
+		goto cleanup;
+	}
+	// the previous archive is not referenced anymore when it gets close to its deletion
+	retention = agent_retention(agent);
+	if (retention && (int64_t)agent->exec_timestamp - date > retention / 2) {
+		ADEBUG("│ ├ " YANSI_FAINT "Previous archive close to its retention limit, a new archive is created" YANSI_RESET);
+	} else if (count == nbr_entries &&
+	    !memcmp(map + A_CHANGES_INDEX_HEADER_SIZE, log->changes->data, log->changes->bytesize)) {
+		if (!(log->reference = ys_new(""))) {
+			status = YENOMEM;
+			goto cleanup;
+		}
+		ys_nappend(&log->reference, (char*)map + A_CHANGES_INDEX_HEADER_SIZE + count * sizeof(changes_entry_t), ref_size);
+		log->unchanged = true;
+		log->level = level;
+		log->archive_size = size;
+		ALOG("│ ├ " YANSI_FAINT "Unchanged since " YANSI_RESET "%s", log->reference);
+		goto cleanup;
+	}
+	// count the changes (both lists are sorted)
+	const changes_entry_t *old = (const changes_entry_t*)(map + A_CHANGES_INDEX_HEADER_SIZE);
+	const changes_entry_t *new = (const changes_entry_t*)log->changes->data;
+	uint64_t i = 0, j = 0;
+	while (i < count || j < nbr_entries) {
+		if (j >= nbr_entries || (i < count && old[i].path < new[j].path)) {
+			// removed entry
+			i++;
+		} else if (i >= count || new[j].path < old[i].path) {
+			// added entry
+			j++;
+		} else {
+			// same path: modified if the metadata are different
+			bool same = (old[i].meta == new[j].meta) ? true : false;
+			i++;
+			j++;
+			if (same)
+				continue;
+		}
+		nbr_changes++;
+	}
+	ADEBUG("│ ├ " YANSI_FAINT "Changed entries: " YANSI_RESET "%" PRIu64 YANSI_FAINT " / " YANSI_RESET "%" PRIu64,
+	       nbr_changes, nbr_entries);
+cleanup:
+	if (map)
+		munmap(map, sb.st_size);
+	if (fd >= 0)
+		close(fd);
+	ys_free(dir);
+	// without a valid scan, the index can't be updated
+	if (status != YENOERR || log->unchanged) {
+		if (log->changes)
+			ybin_delete(log->changes);
+		log->changes = NULL;
+	}
+	return (status);
+}
+/* Write the index of an uploaded item. */
+ystatus_t changes_commit(agent_t *agent, log_item_t *log) {
+	ystatus_t status = YENOERR;
+	uint8_t header[A_CHANGES_INDEX_HEADER_SIZE] = {0};
+	uint32_t version = A_CHANGES_INDEX_VERSION;
+	uint32_t ref_size;
+	uint64_t count;
+	int64_t date = (int64_t)agent->exec_timestamp;
+	ystr_t ref = NULL;
+	char *tmp_path = NULL;
+	FILE *file = NULL;
+
+	if (!log->changes || !log->changes_path)
+		return (YENOERR);
+	// path of the archive on the storage
+	if (!(ref = ys_printf(NULL, "%s/files/%s", agent->datetime_chunk_path, log->archive_name))) {
+		status = YENOMEM;
+		goto cleanup;
+	}
+	ref_size = (uint32_t)ys_bytesize(ref);
+	count = log->changes->bytesize / sizeof(changes_entry_t);
+	memcpy(header, A_CHANGES_INDEX_MAGIC, 8);
+	memcpy(header + 8, &version, sizeof(uint32_t));
+	memcpy(header + 12, &ref_size, sizeof(uint32_t));
+	memcpy(header + 16, &count, sizeof(uint64_t));
+	memcpy(header + 24, &log->level, sizeof(uint16_t));
+	memcpy(header + 32, &log->archive_size, sizeof(uint64_t));
+	memcpy(header + 40, &date, sizeof(int64_t));
+	// the new index replaces the old one atomically
+	if (!(tmp_path = yfile_tmp(log->changes_path)) || !(file = fopen(tmp_path, "w"))) {
+		status = YEIO;
+		goto cleanup;
+	}
+	if (fwrite(header, sizeof(header), 1, file) != 1 ||
+	    (count && fwrite(log->changes->data, log->changes->bytesize, 1, file) != 1) ||
+	    fwrite(ref, ref_size, 1, file) != 1 ||
+	    fflush(file) || fsync(fileno(file))) {
+		status = YEIO;
+		goto cleanup;
+	}
+	if (fclose(file)) {
+		file = NULL;
+		status = YEIO;
+		goto cleanup;
+	}
+	file = NULL;
+	if (rename(tmp_path, log->changes_path))
+		status = YEIO;
+cleanup:
+	if (file)
+		fclose(file);
+	if (status != YENOERR && tmp_path)
+		unlink(tmp_path);
+	free0(tmp_path);
+	ys_free(ref);
+	return (status);
+}
+
+/* ********** PRIVATE FUNCTIONS ********** */
+
+/* Walk a directory tree, using several threads. */
+static ystatus_t changes_walk(const char *path, ybin_t *entries) {
+	ystatus_t status;
+	changes_walk_t walk = {.status = YENOERR};
+	changes_worker_t workers[A_CHANGES_WALK_THREADS];
+	size_t nbr_workers = 0;
+	ystr_t root = NULL;
+	bool is_dir = false;
+
+	// the path itself
+	if ((status = changes_add_entry(entries, AT_FDCWD, path, path, &is_dir)) != YENOERR || !is_dir)
+		return (status);
+	if (!(walk.dirs = yarray_create(64)) || !(root = ys_new(path)) || yarray_push(&walk.dirs, root) != YENOERR) {
+		ys_free(root);
+		yarray_free(walk.dirs);
+		return (YENOMEM);
+	}
+	pthread_mutex_init(&walk.mutex, NULL);
+	pthread_cond_init(&walk.cond, NULL);
+	// start the threads
+	memset(workers, 0, sizeof(workers));
+	for (size_t i = 0; i < A_CHANGES_WALK_THREADS; ++i) {
+		workers[i].walk = &walk;
+		if (!(workers[i].entries = ybin_new()))
+			break;
+		if (pthread_create(&workers[i].thread, NULL, changes_worker, &workers[i])) {
+			ybin_delete(workers[i].entries);
+			workers[i].entries = NULL;
+			break;
+		}
+		nbr_workers++;
+	}
+	// without thread, the tree is walked by the current thread
+	if (!nbr_workers) {
+		workers[0].walk = &walk;
+		if ((workers[0].entries = ybin_new()))
+			changes_worker(&workers[0]);
+		else
+			walk.status = YENOMEM;
+	}
+	// wait for the threads, and merge their entries
+	for (size_t i = 0; i < A_CHANGES_WALK_THREADS; ++i) {
+		if (i < nbr_workers)
+			pthread_join(workers[i].thread, NULL);
+		if (!workers[i].entries)
+			continue;
+		if (walk.status == YENOERR && workers[i].entries->bytesize)
+			walk.status = ybin_append(entries, workers[i].entries->data, workers[i].entries->bytesize);
+		ybin_delete(workers[i].entries);
+	}
+	status = walk.status;
+	pthread_cond_destroy(&walk.cond);
+	pthread_mutex_destroy(&walk.mutex);
+	yarray_free(walk.dirs);
+	// entries are sorted, so two walks of the same tree give the same list
+	if (status == YENOERR && entries->bytesize)
+		qsort(entries->data, entries->bytesize / sizeof(changes_entry_t), sizeof(changes_entry_t), changes_compare);
+	return (status);
+}
+/* Main function of a walking thread. */
+static void *changes_worker(void *data) {
+	changes_worker_t *worker = data;
+	changes_walk_t *walk = worker->walk;
+	ystatus_t status;
+	ystr_t dir;
+	bool failed;
+
+	for (; ; ) {
+		pthread_mutex_lock(&walk->mutex);
+		while (!yarray_length(walk->dirs) && walk->busy)
+			pthread_cond_wait(&walk->cond, &walk->mutex);
+		if (!yarray_length(walk->dirs)) {
+			// no pending directory, and no thread could add one: the walk is over
+			pthread_cond_broadcast(&walk->cond);
+			pthread_mutex_unlock(&walk->mutex);
+			return (NULL);
+		}
+		dir = yarray_pop(walk->dirs);
+		failed = (walk->status != YENOERR) ? true : false;
+		walk->busy++;
+		pthread_mutex_unlock(&walk->mutex);
+		// after an error, the pending directories are just removed
+		status = failed ? YENOERR : changes_read_dir(worker, dir);
+		ys_free(dir);
+		pthread_mutex_lock(&walk->mutex);
+		walk->busy--;
+		if (status != YENOERR && walk->status == YENOERR)
+			walk->status = status;
+		if (!walk->busy)
+			pthread_cond_broadcast(&walk->cond);
+		pthread_mutex_unlock(&walk->mutex);
+	}
+	return (NULL);
+}
+/* Read a directory. */
+static ystatus_t changes_read_dir(changes_worker_t *worker, const char *dir) {
+	ystatus_t status = YENOERR;
+	changes_walk_t *walk = worker->walk;
+	DIR *d;
+	struct dirent *de;
+	ystr_t path = NULL;
+	ystr_t subdir;
+	bool is_dir;
+
+	if (!(d = opendir(dir)))
+		return (YEACCES);
+	while ((de = readdir(d))) {
+		if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+			continue;
+		if (!(path = ys_printf(&path, "%s/%s", dir, de->d_name))) {
+			status = YENOMEM;
+			break;
+		}
+		if ((status = changes_add_entry(worker->entries, dirfd(d), de->d_name, path, &is_dir)) != YENOERR)
+			break;
+		if (!is_dir)
+			continue;
+		// the subdirectory is read by the first available thread
+		if (!(subdir = ys_copy(path))) {
+			status = YENOMEM;
+			break;
+		}
+		pthread_mutex_lock(&walk->mutex);
+		status = yarray_push(&walk->dirs, subdir);
+		pthread_cond_signal(&walk->cond);
+		pthread_mutex_unlock(&walk->mutex);
+		if (status != YENOERR) {
+			ys_free(subdir);
+			break;
+		}
+	}
+	closedir(d);
+	ys_free(path);
+	return (status);
+}
+/* Fetch the metadata of a file, and add it to a list of entries. */
+static ystatus_t changes_add_entry(ybin_t *entries, int dirfd, const char *name, const char *path,
+                                   bool *is_dir) {
+	struct statx stx;
+	changes_entry_t entry;
+	uint64_t meta[9];
+
+	*is_dir = false;
+	// symbolic links are not followed, like tar does
+	if (statx(dirfd, name, AT_SYMLINK_NOFOLLOW, STATX_BASIC_STATS, &stx)) {
+		// a file removed since the directory was read is not listed
+		return ((errno == ENOENT && dirfd != AT_FDCWD) ? YENOERR : YEIO);
+	}
+	meta[0] = stx.stx_ino;
+	meta[1] = stx.stx_size;
+	meta[2] = stx.stx_mode;
+	meta[3] = stx.stx_uid;
+	meta[4] = stx.stx_gid;
+	meta[5] = (uint64_t)stx.stx_mtime.tv_sec;
+	meta[6] = stx.stx_mtime.tv_nsec;
+	meta[7] = (uint64_t)stx.stx_ctime.tv_sec;
+	meta[8] = stx.stx_ctime.tv_nsec;
+	entry.path = changes_hash(A_CHANGES_FNV_OFFSET, path, strlen(path));
+	entry.meta = changes_hash(A_CHANGES_FNV_OFFSET, meta, sizeof(meta));
+	*is_dir = S_ISDIR(stx.stx_mode) ? true : false;
+	return (ybin_append(entries, &entry, sizeof(entry)));
+}
+/* Compare two entries by their path hash. */
+static int changes_compare(const void *a, const void *b) {
+	const changes_entry_t *ea = a;
+	const changes_entry_t *eb = b;
+
+	if (ea->path != eb->path)
+		return ((ea->path < eb->path) ? -1 : 1);
+	if (ea->meta != eb->meta)
+		return ((ea->meta < eb->meta) ? -1 : 1);
+	return (0);
+}
+/* Compute the FNV-1a hash of some data. */
+static uint64_t changes_hash(uint64_t hash, const void *data, size_t len) {
+	const uint8_t *ptr = data;
+
+	for (size_t i = 0; i < len; ++i) {
+		hash ^= ptr[i];
+		hash *= A_CHANGES_FNV_PRIME;
+	}
+	return (hash);
+}
+
@@ -0,0 +1,167 @@
+/**
+ * @header	changes.h
+ * @abstract	Detection of unchanged backup paths.
+ * @discussion	Before a path is tar'ed, its directory tree is walked by some
+ *		threads, and the metadata of each entry (inode, size, mode,
+ *		owner, modification and change times) are fetched with statx().
+ *		The result is compared to the index written after the last
+ *		successful backup of the path. If nothing changed, the path is
+ *		not backed up again: the report references the previous archive.
+ *		The referenced archive is removed by the storage retention, so
+ *		a new archive is created once it is older than half of the
+ *		retention duration.
+ *
+ *		Index file (one per backed up path, under the archives path):
+ *		  header (64 bytes): magic string, version as uint32, size of
+ *		  the reference as uint32, number of entries as uint64, level
+ *		  of the referenced archive as uint16, padding, size of the
+ *		  referenced archive as uint64, date of the referenced archive
+ *		  as int64 (all in host byte order);
+ *		  entries, sorted: hash of the path as uint64, hash of the
+ *		  metadata as uint64;
+ *		  reference: path of the archive on the storage, relative to
+ *		  the host's directory.
+ *		The index is written in a temporary file, renamed once the
+ *		archive has been uploaded.
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ */
+#pragma once
+
+#include <pthread.h>
+#include "ystatus.h"
+#include "yarray.h"
+#include "ybin.h"
+#include "agent.h"
+#include "log.h"
+
+/** @const A_CHANGES_INDEX_MAGIC	Magic string at the beginning of the index file. */
+#define A_CHANGES_INDEX_MAGIC		"ARKIVCHG"
+/** @const A_CHANGES_INDEX_VERSION	Version of the index file format. */
+#define A_CHANGES_INDEX_VERSION		2
+/** @const A_CHANGES_INDEX_HEADER_SIZE	Size of the index file header. */
+#define A_CHANGES_INDEX_HEADER_SIZE	64
+/** @const A_CHANGES_WALK_THREADS	Number of threads walking a directory tree. */
+#define A_CHANGES_WALK_THREADS		4
+
+/**
+ * @typedef	changes_entry_t
+ * @abstract	Entry of the index.
+ * @field	path	Hash of the entry's path.
+ * @field	meta	Hash of the entry's metadata.
+ */
+typedef struct {
+	uint64_t path;
+	uint64_t meta;
+} changes_entry_t;
+
+/**
+ * @typedef	changes_walk_t
+ * @abstract	Directory tree being walked.
+ * @field	mutex		Mutex protecting the list of directories.
+ * @field	cond		Condition signaled when a directory is added, or when the walk is over.
+ * @field	dirs		List of directories waiting to be read.
+ * @field	busy		Number of threads reading a directory.
+ * @field	status		Status of the first error.
+ */
+typedef struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	yarray_t dirs;
+	size_t busy;
+	ystatus_t status;
+} changes_walk_t;
+
+/**
+ * @typedef	changes_worker_t
+ * @abstract	Thread walking a directory tree.
+ * @field	thread	Thread identifier.
+ * @field	walk	Pointer to the shared walk structure.
+ * @field	entries	Entries found by the thread.
+ */
+typedef struct {
+	pthread_t thread;
+	changes_walk_t *walk;
+	ybin_t *entries;
+} changes_worker_t;
+
+/**
+ * @function	changes_scan
+ * @abstract	Walk a backup path, and compare it to the index of its last
+ *		successful backup. If nothing changed, the item is marked as
+ *		unchanged, with a reference to the previous archive (unless it
+ *		is older than half of the retention duration). Otherwise, the
+ *		new index is kept in the log entry, to be written by
+ *		changes_commit().
+ * @param	agent		Pointer to the agent structure.
+ * @param	log		Pointer to the item's log entry.
+ * @param	path		Path to walk.
+ * @param	filename	Filenamized path, used to name the index file.
+ * @return	YENOERR if the path was walked successfully.
+ */
+ystatus_t changes_scan(agent_t *agent, log_item_t *log, const char *path, const char *filename);
+/**
+ * @function	changes_commit
+ * @abstract	Write the index of an uploaded item, which replaces the previous one.
+ * @param	agent	Pointer to the agent structure.
+ * @param	log	Pointer to the item's log entry.
+ * @return	YENOERR if OK.
+ */
+ystatus_t changes_commit(agent_t *agent, log_item_t *log);
+
+/* ********** PRIVATE DECLARATIONS ********** */
+#ifdef __A_CHANGES_PRIVATE__
+	/**
+	 * @function	changes_walk
+	 * @abstract	Walk a directory tree, using several threads.
+	 * @param	path	Path to walk.
+	 * @param	entries	Pointer to the binary buffer filled with the sorted entries.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t changes_walk(const char *path, ybin_t *entries);
+	/**
+	 * @function	changes_worker
+	 * @abstract	Main function of a walking thread.
+	 * @param	data	Pointer to the worker structure.
+	 * @return	Always NULL.
+	 */
+	static void *changes_worker(void *data);
+	/**
+	 * @function	changes_read_dir
+	 * @abstract	Read a directory. Its entries are added to the worker's list,
+	 *		its subdirectories are added to the list of directories.
+	 * @param	worker	Pointer to the worker structure.
+	 * @param	dir	Path to the directory.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t changes_read_dir(changes_worker_t *worker, const char *dir);
+	/**
+	 * @function	changes_add_entry
+	 * @abstract	Fetch the metadata of a file, and add it to a list of entries.
+	 * @param	entries	Pointer to the list of entries.
+	 * @param	dirfd	File descriptor of the parent directory (or AT_FDCWD).
+	 * @param	name	Name of the file in the directory.
+	 * @param	path	Full path of the file.
+	 * @param	is_dir	Pointer to a boolean set to true if the file is a directory.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t changes_add_entry(ybin_t *entries, int dirfd, const char *name, const char *path,
+	                                   bool *is_dir);
+	/**
+	 * @function	changes_compare
+	 * @abstract	Compare two entries by their path hash (used to sort entries).
+	 * @param	a	Pointer to the first entry.
+	 * @param	b	Pointer to the second entry.
+	 * @return	-1, 0 or 1.
+	 */
+	static int changes_compare(const void *a, const void *b);
+	/**
+	 * @function	changes_hash
+	 * @abstract	Compute the FNV-1a hash of some data.
+	 * @param	hash	Initial value.
+	 * @param	data	Pointer to the data.
+	 * @param	len	Size of the data.
+	 * @return	The hash value.
+	 */
+	static uint64_t changes_hash(uint64_t hash, const void *data, size_t len);
+#endif /* __A_CHANGES_PRIVATE__ */
+
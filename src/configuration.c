@@ -42,8 +42,6 @@ void exec_configuration(agent_t *agent) {
 	check_rclone();
 	// tar
 	check_tar();
-	// sha512sum
-	check_sha512sum();
 	// compression programs
 	check_z();
 	// encryption programs
@@ -0,0 +1,831 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include "yansi.h"
+#include "ymemory.h"
+#include "ybin.h"
+#include "yfile.h"
+#include "ypool.h"
+#include "log.h"
+#include "throttle.h"
+
+#define __A_DBDUMP_PRIVATE__
+#include "dbdump.h"
+
+/* List the tables of a MySQL database, and share them between parts. */
+ystatus_t dbdump_mysql_open(dbdump_t *dump, agent_t *agent, const char *dbname, yarray_t conn_args,
+                            yarray_t env, const char *base_path) {
+	ystatus_t status = YENOERR;
+	yarray_t args = NULL;
+	ybin_t out = {0};
+	char **names = NULL;
+	uint64_t *sizes = NULL;
+	bool *views = NULL;
+	size_t nbr_lines = 0, nbr_data;
+	char *line, *next;
+
+	*dump = (dbdump_t){
+		.agent = agent,
+		.dbname = dbname,
+		.conn_args = conn_args,
+		.env = env,
+		.lock_pid = -1,
+		.lock_in = -1,
+		.lock_out = -1,
+	};
+	pthread_mutex_init(&dump->mutex, NULL);
+	// list the tables
+	if (!(args = yarray_clone(conn_args)) ||
+	    yarray_push_multi(&args, 6, "--batch", "--skip-column-names", "-D", dbname, "-e",
+	                      A_DBDUMP_TABLES_QUERY) != YENOERR)
+		return (YENOMEM);
+	status = yexec(agent->bin.mysql, args, env, &out, NULL);
+	yarray_free(args);
+	if (status != YENOERR)
+		goto cleanup;
+	if (!out.data || !out.bytesize) {
+		status = YENODATA;
+		goto cleanup;
+	}
+	ybin_set_nullend(&out);
+	for (size_t i = 0; i < out.bytesize; ++i)
+		if (((char*)out.data)[i] == '\n')
+			++nbr_lines;
+	if (!(names = malloc0((nbr_lines + 1) * sizeof(char*))) ||
+	    !(sizes = malloc0((nbr_lines + 1) * sizeof(uint64_t))) ||
+	    !(views = malloc0((nbr_lines + 1) * sizeof(bool)))) {
+		status = YENOMEM;
+		goto cleanup;
+	}
+	nbr_lines = 0;
+	for (line = out.data; *line; line = next) {
+		if ((next = strchr(line, '\n')))
+			*next++ = '\0';
+		else
+			next = line + strlen(line);
+		if (!*line)
+			continue;
+		status = dbdump_parse_table(line, &names[nbr_lines], &views[nbr_lines], &sizes[nbr_lines]);
+		if (status == YENODATA)
+			continue;
+		if (status != YENOERR)
+			goto cleanup;
+		if (views[nbr_lines])
+			++dump->nbr_views;
+		else
+			++dump->nbr_tables;
+		++nbr_lines;
+	}
+	status = YENOERR;
+	if (dump->nbr_tables < 2) {
+		status = YENODATA;
+		goto cleanup;
+	}
+	// the manifest, the parts of tables, and the part of views and routines
+	nbr_data = (agent->conf.dump_jobs < dump->nbr_tables) ? agent->conf.dump_jobs : dump->nbr_tables;
+	dump->nbr_parts = nbr_data + 2;
+	if (!(dump->parts = calloc0(dump->nbr_parts, sizeof(dbdump_part_t)))) {
+		status = YENOMEM;
+		goto cleanup;
+	}
+	for (size_t i = 0; i < dump->nbr_parts; ++i) {
+		dbdump_part_t *part = &dump->parts[i];
+
+		part->dump = dump;
+		part->snapshot = (i > 0 && i <= nbr_data);
+		part->status = YENOERR;
+		if (!(part->path = ys_printf(NULL, "%s.%03zu", base_path, i + 1)) ||
+		    !(part->tables = yarray_create(8)) ||
+		    (i > 0 && !(part->args = yarray_clone(conn_args)))) {
+			status = YENOMEM;
+			goto cleanup;
+		}
+	}
+	// the tables are listed from the biggest, each one is given to the smallest part
+	// (or to the one with fewer tables, so empty tables are spread and no part stays empty)
+	for (size_t i = 0; i < nbr_lines; ++i) {
+		dbdump_part_t *part = &dump->parts[dump->nbr_parts - 1];
+		ystr_t name;
+
+		if (!views[i]) {
+			part = &dump->parts[1];
+			for (size_t j = 2; j <= nbr_data; ++j)
+				if (dump->parts[j].size < part->size ||
+				    (dump->parts[j].size == part->size &&
+				     yarray_length(dump->parts[j].tables) < yarray_length(part->tables)))
+					part = &dump->parts[j];
+		}
+		if (!(name = ys_new(names[i])) || yarray_push(&part->tables, name) != YENOERR) {
+			ys_free(name);
+			status = YENOMEM;
+			goto cleanup;
+		}
+		part->size += sizes[i];
+	}
+	// mysqldump arguments
+	for (size_t i = 1; i < dump->nbr_parts; ++i) {
+		dbdump_part_t *part = &dump->parts[i];
+
+		// the purged GTIDs are set by the first part only (each part would set them again)
+		if (i > 1 && agent->mysqldump_gtid && yarray_push(&part->args, "--set-gtid-purged=OFF") != YENOERR) {
+			status = YENOMEM;
+			goto cleanup;
+		}
+		if (part->snapshot) {
+			// without tables, mysqldump would dump the whole database
+			if (!yarray_length(part->tables)) {
+				status = YENODATA;
+				goto cleanup;
+			}
+			status = yarray_push_multi(&part->args, 4, "--single-transaction", "--no-tablespaces",
+			                           "--skip-lock-tables", dbname);
+		} else {
+			// the triggers are dumped with their tables
+			status = yarray_push_multi(&part->args, 5, "--no-tablespaces", "--skip-lock-tables", "--no-data",
+			                           "--skip-triggers", "--routines");
+			if (status == YENOERR && !yarray_length(part->tables))
+				status = yarray_push(&part->args, "--no-create-info");
+			if (status == YENOERR)
+				status = yarray_push(&part->args, (void*)dbname);
+		}
+		if (status == YENOERR)
+			status = yarray_append(&part->args, part->tables);
+		if (status != YENOERR)
+			goto cleanup;
+	}
+cleanup:
+	ybin_delete_data(&out);
+	free0(names);
+	free0(sizes);
+	free0(views);
+	return (status);
+}
+/* Take the global read lock, then dump and compress all the parts concurrently. */
+ystatus_t dbdump_mysql_run(dbdump_t *dump, const yexec_cmd_t *z) {
+	ystatus_t status = YENOERR;
+	agent_t *agent = dump->agent;
+	double lock_time;
+	int exec_status;
+
+	dump->z = z;
+	dump->nbr_waiting = dump->nbr_parts - 2;
+	// the snapshot can't be shared without the lock
+	if (dbdump_lock(dump) != YENOERR) {
+		dbdump_unlock(dump);
+		if (dump->lock_out != -1)
+			close(dump->lock_out);
+		if (dump->lock_pid != -1)
+			while (waitpid(dump->lock_pid, &exec_status, 0) == -1 && errno == EINTR)
+				;
+		dump->lock_out = -1;
+		dump->lock_pid = -1;
+		return (YEACCES);
+	}
+	ADEBUG("│ ├ " YANSI_FAINT "Global read lock taken, dump " YANSI_RESET "%zu" YANSI_FAINT " tables and " YANSI_RESET
+	       "%zu" YANSI_FAINT " views through " YANSI_RESET "%zu" YANSI_FAINT " connections" YANSI_RESET,
+	       dump->nbr_tables, dump->nbr_views, dump->nbr_parts - 1);
+	// all the parts are dumped at the same time, so they can all join the snapshot
+	ypool_run(dump->nbr_parts - 1, dump->nbr_parts - 1, dbdump_part_job, NULL, dump);
+	dbdump_unlock(dump);
+	close(dump->lock_out);
+	while (waitpid(dump->lock_pid, &exec_status, 0) == -1 && errno == EINTR)
+		;
+	dump->lock_out = -1;
+	dump->lock_pid = -1;
+	lock_time = (double)(dump->lock_end.tv_sec - dump->lock_start.tv_sec) +
+	            (double)(dump->lock_end.tv_nsec - dump->lock_start.tv_nsec) / 1e9;
+	ADEBUG("│ ├ " YANSI_FAINT "Global read lock held during " YANSI_RESET "%.3f" YANSI_FAINT " s" YANSI_RESET, lock_time);
+	// the manifest
+	dump->parts[0].status = yexec_pipeline_input(z, (z ? 1 : 0), dbdump_manifest_input, dump, NULL,
+	                                             dump->parts[0].path, NULL, NULL, &dump->parts[0].err);
+	for (size_t i = 0; i < dump->nbr_parts; ++i) {
+		dbdump_part_t *part = &dump->parts[i];
+
+		if (part->status != YENOERR) {
+			ADEBUG("│ ├ " YANSI_RED "Part " YANSI_RESET "%zu" YANSI_RED " failed" YANSI_RESET, i + 1);
+			log_program_errors(agent, "│ ├ ", &part->err);
+			if (status == YENOERR)
+				status = part->status;
+			continue;
+		}
+		if (!i)
+			ADEBUG("│ ├ " YANSI_FAINT "Part " YANSI_RESET "1" YANSI_FAINT ": manifest (" YANSI_RESET "%" PRIu64
+			       YANSI_FAINT " bytes)" YANSI_RESET, yfile_get_size(part->path));
+		else
+			ADEBUG("│ ├ " YANSI_FAINT "Part " YANSI_RESET "%zu" YANSI_FAINT ": " YANSI_RESET "%zu" YANSI_FAINT " %s ("
+			       YANSI_RESET "%" PRIu64 YANSI_FAINT " bytes)" YANSI_RESET, i + 1, yarray_length(part->tables),
+			       (part->snapshot ? "table(s)" : "view(s) and routines"), yfile_get_size(part->path));
+	}
+	return (status);
+}
+/* Write all the parts of a dump, in their order, to a file descriptor. */
+ystatus_t dbdump_write(int fd, void *user_data) {
+	dbdump_t *dump = (dbdump_t*)user_data;
+	ystatus_t status = YENOERR;
+	char *buffer;
+	ssize_t len;
+	int part_fd;
+
+	if (!(buffer = malloc0(A_DBDUMP_BUFFER_SIZE)))
+		return (YENOMEM);
+	for (size_t i = 0; i < dump->nbr_parts && status == YENOERR; ++i) {
+		if ((part_fd = open(dump->parts[i].path, O_RDONLY | O_CLOEXEC)) == -1) {
+			status = YEIO;
+			break;
+		}
+		while ((len = read(part_fd, buffer, A_DBDUMP_BUFFER_SIZE))) {
+			if (len == -1 && errno == EINTR)
+				continue;
+			if (len == -1) {
+				status = YEIO;
+				break;
+			}
+			if ((status = dbdump_write_all(fd, buffer, (size_t)len)) != YENOERR)
+				break;
+		}
+		close(part_fd);
+	}
+	free0(buffer);
+	return (status);
+}
+/* Remove the parts' files of a dump, and free its memory. */
+void dbdump_close(dbdump_t *dump) {
+	for (size_t i = 0; dump->parts && i < dump->nbr_parts; ++i) {
+		dbdump_part_t *part = &dump->parts[i];
+
+		if (part->path) {
+			unlink(part->path);
+			ys_free(part->path);
+		}
+		for (size_t j = 0; j < yarray_length(part->tables); ++j)
+			ys_free(part->tables[j]);
+		yarray_free(part->tables);
+		yarray_free(part->args);
+		ybin_delete_data(&part->err);
+	}
+	free0(dump->parts);
+	dump->nbr_parts = 0;
+	ys_delete(&dump->binlog_file);
+	pthread_mutex_destroy(&dump->mutex);
+}
+/* Initialize a MongoDB archive dump. */
+ystatus_t dbdump_mongodb_open(dbdump_mongodb_t *dump, agent_t *agent, yarray_t args, const char *password) {
+	*dump = (dbdump_mongodb_t){
+		.agent = agent,
+		.args = args,
+		.password = password,
+		.state = A_DBDUMP_MONGODB_START,
+	};
+	if (!(dump->collections = yarray_create(8)))
+		return (YENOMEM);
+	return (YENOERR);
+}
+/* Execute mongodump, and write its archive to a file descriptor. */
+ystatus_t dbdump_mongodb_write(int fd, void *user_data) {
+	dbdump_mongodb_t *dump = (dbdump_mongodb_t*)user_data;
+	ystatus_t status = YENOERR;
+	int in_fds[2] = {-1, -1}, out_fds[2] = {-1, -1}, null_fd = -1;
+	int exec_status = 0;
+	char *buffer = NULL;
+	ssize_t len;
+	pid_t pid;
+	yexec_cmd_t cmd = {
+		.command = dump->agent->bin.mongodump,
+		.args = dump->args,
+	};
+
+	if (!(buffer = malloc0(A_DBDUMP_BUFFER_SIZE)))
+		return (YENOMEM);
+	if ((null_fd = open("/dev/null", O_RDWR | O_CLOEXEC)) == -1 || dbdump_pipe(in_fds) || dbdump_pipe(out_fds)) {
+		status = YEPIPE;
+		goto cleanup;
+	}
+	// the password is read by mongodump on its standard input, so it isn't visible in the list of
+	// processes (it is small enough to be written to the pipe before the program is started)
+	if (dbdump_write_all(in_fds[1], dump->password, strlen(dump->password)) != YENOERR ||
+	    dbdump_write_all(in_fds[1], "\n", 1) != YENOERR) {
+		status = YEPIPE;
+		goto cleanup;
+	}
+	close(in_fds[1]);
+	in_fds[1] = -1;
+	status = yexec_spawn(&cmd, in_fds[0], out_fds[1], null_fd, &pid);
+	close(out_fds[1]);
+	out_fds[1] = -1;
+	if (status != YENOERR)
+		goto cleanup;
+	while ((len = read(out_fds[0], buffer, A_DBDUMP_BUFFER_SIZE))) {
+		if (len == -1 && errno == EINTR)
+			continue;
+		if (len == -1) {
+			status = YEIO;
+			break;
+		}
+		dbdump_mongodb_read(dump, (uint8_t*)buffer, (size_t)len);
+		if ((status = dbdump_write_all(fd, buffer, (size_t)len)) != YENOERR)
+			break;
+	}
+	// if the compression program failed, mongodump is stopped by SIGPIPE
+	close(out_fds[0]);
+	out_fds[0] = -1;
+	while (waitpid(pid, &exec_status, 0) == -1 && errno == EINTR)
+		;
+	if (status == YENOERR && (!WIFEXITED(exec_status) || WEXITSTATUS(exec_status)))
+		status = YEFAULT;
+	if (status == YENOERR)
+		dbdump_mongodb_log(dump);
+cleanup:
+	for (int i = 0; i < 2; ++i) {
+		if (in_fds[i] != -1)
+			close(in_fds[i]);
+		if (out_fds[i] != -1)
+			close(out_fds[i]);
+	}
+	if (null_fd != -1)
+		close(null_fd);
+	free0(buffer);
+	return (status);
+}
+/* Read a chunk of a mongodump archive, and add the size of its documents to their collections. */
+void dbdump_mongodb_read(dbdump_mongodb_t *dump, const uint8_t *data, size_t len) {
+	dump->total_size += len;
+	while (len && dump->state != A_DBDUMP_MONGODB_INVALID) {
+		// the rest of a document is skipped
+		if (dump->skip) {
+			size_t n = (dump->skip < len) ? (size_t)dump->skip : len;
+
+			if (dump->state == A_DBDUMP_MONGODB_BODY && dump->current)
+				dump->current->size += n;
+			dump->skip -= n;
+			data += n;
+			len -= n;
+			continue;
+		}
+		// the length of a document (or a whole namespace header) is read
+		size_t needed = dump->header_size ? dump->header_size : 4;
+		size_t n = ((needed - dump->length) < len) ? (needed - dump->length) : len;
+
+		memcpy(dump->buffer + dump->length, data, n);
+		dump->length += n;
+		data += n;
+		len -= n;
+		if (dump->length < needed)
+			break;
+		if (dump->header_size) {
+			// the namespace header is complete, the segment's documents follow
+			dump->current = dbdump_mongodb_collection(dump);
+			dump->state = dump->current ? A_DBDUMP_MONGODB_BODY : A_DBDUMP_MONGODB_INVALID;
+			dump->header_size = dump->length = 0;
+			continue;
+		}
+		// little-endian 32 bits value
+		uint32_t value = (uint32_t)dump->buffer[0] | ((uint32_t)dump->buffer[1] << 8) |
+		                 ((uint32_t)dump->buffer[2] << 16) | ((uint32_t)dump->buffer[3] << 24);
+
+		if (dump->state == A_DBDUMP_MONGODB_START) {
+			dump->state = (value == A_DBDUMP_MONGODB_MAGIC) ? A_DBDUMP_MONGODB_PRELUDE : A_DBDUMP_MONGODB_INVALID;
+			dump->length = 0;
+			continue;
+		}
+		if (value == A_DBDUMP_MONGODB_TERMINATOR) {
+			// end of the prelude or of a segment
+			dump->state = (dump->state == A_DBDUMP_MONGODB_HEADER) ? A_DBDUMP_MONGODB_INVALID :
+			              A_DBDUMP_MONGODB_HEADER;
+			dump->current = NULL;
+			dump->length = 0;
+			continue;
+		}
+		// the smallest BSON document is 5 bytes long
+		if (value < 5) {
+			dump->state = A_DBDUMP_MONGODB_INVALID;
+			break;
+		}
+		if (dump->state == A_DBDUMP_MONGODB_HEADER) {
+			if (value > A_DBDUMP_MONGODB_HEADER_MAX) {
+				dump->state = A_DBDUMP_MONGODB_INVALID;
+				break;
+			}
+			dump->header_size = value;
+			continue;
+		}
+		// document of the prelude or of a collection
+		if (dump->state == A_DBDUMP_MONGODB_BODY && dump->current)
+			dump->current->size += 4;
+		dump->skip = value - 4;
+		dump->length = 0;
+	}
+}
+/* Free the memory of a MongoDB archive dump. */
+void dbdump_mongodb_close(dbdump_mongodb_t *dump) {
+	for (size_t i = 0; i < yarray_length(dump->collections); ++i) {
+		log_part_t *collection = dump->collections[i];
+
+		ys_free(collection->name);
+		free0(collection);
+	}
+	yarray_free(dump->collections);
+	dump->collections = NULL;
+}
+
+/* ********** PRIVATE FUNCTIONS ********** */
+
+/* Parse a line of the tables' list. */
+static ystatus_t dbdump_parse_table(char *line, char **name, bool *view, uint64_t *size) {
+	char *type, *pt;
+
+	if (!(type = strchr(line, '\t')) || !(pt = strchr(type + 1, '\t')))
+		return (YEINVAL);
+	*type++ = '\0';
+	*pt++ = '\0';
+	// special characters are escaped by the mysql client; a name starting
+	// with a dash would be read as an option by mysqldump
+	if (!*line || *line == '-' || strchr(line, '\\'))
+		return (YEINVAL);
+	if (!strcmp(type, "SYSTEM VIEW"))
+		return (YENODATA);
+	*name = line;
+	*view = !strcmp(type, "VIEW");
+	*size = strtoull(pt, NULL, 10);
+	return (YENOERR);
+}
+/* Start the control connection, and take the global read lock. */
+static ystatus_t dbdump_lock(dbdump_t *dump) {
+	ystatus_t status = YENOERR;
+	yarray_t args = NULL;
+	int in_fds[2] = {-1, -1}, out_fds[2] = {-1, -1}, null_fd = -1;
+	char query[256], answer[4096];
+	char *marker = NULL, *line, *tab;
+	size_t answer_len = 0;
+	ssize_t len;
+	yexec_cmd_t cmd = {
+		.command = dump->agent->bin.mysql,
+		.env = dump->env,
+	};
+
+	snprintf(query, sizeof(query), "SET SESSION lock_wait_timeout = %d;\nFLUSH TABLES WITH READ LOCK;\n%s"
+	         "SELECT '" A_DBDUMP_LOCK_MARKER "';\n", A_DBDUMP_LOCK_TIMEOUT,
+	         (dump->binlog ? "SHOW BINARY LOGS;\n" : ""));
+	if (!(args = yarray_clone(dump->conn_args)) ||
+	    yarray_push_multi(&args, 3, "--batch", "--skip-column-names", "--unbuffered") != YENOERR) {
+		status = YENOMEM;
+		goto cleanup;
+	}
+	cmd.args = args;
+	if ((null_fd = open("/dev/null", O_RDWR | O_CLOEXEC)) == -1 ||
+	    dbdump_pipe(in_fds) || dbdump_pipe(out_fds)) {
+		status = YEPIPE;
+		goto cleanup;
+	}
+	// the queries are written before the program's start, so the pipe has a reader;
+	// its standard input is kept open, to keep the session (and the lock) alive
+	if ((status = dbdump_write_all(in_fds[1], query, strlen(query))) != YENOERR ||
+	    (status = yexec_spawn(&cmd, in_fds[0], out_fds[1], null_fd, &dump->lock_pid)) != YENOERR) {
+		dump->lock_pid = -1;
+		goto cleanup;
+	}
+	// the program's ends of the pipes are closed, so its termination is seen
+	close(in_fds[0]);
+	close(out_fds[1]);
+	dump->lock_in = in_fds[1];
+	dump->lock_out = out_fds[0];
+	in_fds[0] = in_fds[1] = out_fds[0] = out_fds[1] = -1;
+	// wait for the marker (the program stops on error)
+	status = YEACCES;
+	while (true) {
+		// the binary logs are listed before the marker, only the last one is kept
+		if (answer_len == sizeof(answer) - 1) {
+			if (!(line = memrchr(answer, '\n', answer_len)) ||
+			    !(line = memrchr(answer, '\n', (size_t)(line - answer))))
+				break;
+			answer_len -= (size_t)(line + 1 - answer);
+			memmove(answer, line + 1, answer_len + 1);
+		}
+		len = read(dump->lock_out, answer + answer_len, sizeof(answer) - 1 - answer_len);
+		if (len == -1 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			break;
+		answer_len += (size_t)len;
+		answer[answer_len] = '\0';
+		if ((marker = strstr(answer, A_DBDUMP_LOCK_MARKER))) {
+			clock_gettime(CLOCK_MONOTONIC, &dump->lock_start);
+			status = YENOERR;
+			break;
+		}
+	}
+	// the size of the current binary log is the position of the snapshot
+	if (status == YENOERR && dump->binlog && marker > answer) {
+		*--marker = '\0';
+		line = strrchr(answer, '\n');
+		line = line ? (line + 1) : answer;
+		if ((tab = strchr(line, '\t')) && tab > line) {
+			dump->binlog_file = ys_printf(NULL, "%.*s", (int)(tab - line), line);
+			dump->binlog_position = strtoull(tab + 1, NULL, 10);
+		}
+	}
+cleanup:
+	yarray_free(args);
+	if (null_fd != -1)
+		close(null_fd);
+	for (int i = 0; i < 2; ++i) {
+		if (in_fds[i] != -1)
+			close(in_fds[i]);
+		if (out_fds[i] != -1)
+			close(out_fds[i]);
+	}
+	return (status);
+}
+/* Release the global read lock. */
+static void dbdump_unlock(dbdump_t *dump) {
+	if (dump->lock_in == -1)
+		return;
+	close(dump->lock_in);
+	dump->lock_in = -1;
+	clock_gettime(CLOCK_MONOTONIC, &dump->lock_end);
+}
+/* Mark the transaction of a part's program as started. */
+static void dbdump_started(dbdump_part_t *part) {
+	dbdump_t *dump = part->dump;
+
+	pthread_mutex_lock(&dump->mutex);
+	if (!part->started) {
+		part->started = true;
+		if (dump->nbr_waiting && !--dump->nbr_waiting)
+			dbdump_unlock(dump);
+	}
+	pthread_mutex_unlock(&dump->mutex);
+}
+/* Dump and compress a part. */
+static void dbdump_part_job(size_t index, void *user_data) {
+	dbdump_t *dump = (dbdump_t*)user_data;
+	dbdump_part_t *part = &dump->parts[index + 1];
+	struct throttle_s *throttle = dump->agent->write_throttle;
+	ybin_t z_err = {0};
+
+	part->status = yexec_pipeline_input(dump->z, (dump->z ? 1 : 0), dbdump_part_input, part, NULL, part->path,
+	                                    (throttle ? dbdump_part_output : NULL), throttle, &z_err);
+	// the errors of mysqldump are followed by the ones of the compression program
+	if (z_err.data && part->err.bytesize < YEXEC_STDERR_MAX)
+		ybin_append(&part->err, z_err.data, ((z_err.bytesize < YEXEC_STDERR_MAX - part->err.bytesize) ?
+		                                     z_err.bytesize : (YEXEC_STDERR_MAX - part->err.bytesize)));
+	ybin_delete_data(&z_err);
+	// a program which failed before its first table must not keep the lock
+	if (part->snapshot)
+		dbdump_started(part);
+}
+/* Execute the mysqldump program of a part, and write its output to the compression program. */
+static ystatus_t dbdump_part_input(int fd, void *user_data) {
+	dbdump_part_t *part = (dbdump_part_t*)user_data;
+	dbdump_t *dump = part->dump;
+	ystatus_t status = YENOERR;
+	const char *marker = A_DBDUMP_TABLE_MARKER;
+	size_t matched = 0;
+	int out_fds[2] = {-1, -1}, err_fds[2] = {-1, -1}, null_fd = -1;
+	int exec_status = 0;
+	struct pollfd fds[2];
+	char *buffer = NULL;
+	ssize_t len;
+	pid_t pid;
+	yexec_cmd_t cmd = {
+		.command = dump->agent->bin.mysqldump,
+		.args = part->args,
+		.env = dump->env,
+	};
+
+	if (!(buffer = malloc0(A_DBDUMP_BUFFER_SIZE)))
+		return (YENOMEM);
+	if ((null_fd = open("/dev/null", O_RDWR | O_CLOEXEC)) == -1 || dbdump_pipe(out_fds) || dbdump_pipe(err_fds)) {
+		if (null_fd != -1)
+			close(null_fd);
+		if (out_fds[0] != -1) {
+			close(out_fds[0]);
+			close(out_fds[1]);
+		}
+		free0(buffer);
+		return (YEPIPE);
+	}
+	status = yexec_spawn(&cmd, null_fd, out_fds[1], err_fds[1], &pid);
+	close(null_fd);
+	close(out_fds[1]);
+	close(err_fds[1]);
+	if (status != YENOERR) {
+		close(out_fds[0]);
+		close(err_fds[0]);
+		free0(buffer);
+		return (status);
+	}
+	// the standard error is read along with the dump, so mysqldump can't be blocked on it
+	fds[0] = (struct pollfd){.fd = out_fds[0], .events = POLLIN};
+	fds[1] = (struct pollfd){.fd = err_fds[0], .events = POLLIN};
+	while (fds[0].fd != -1 || fds[1].fd != -1) {
+		if (poll(fds, 2, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			status = YEIO;
+			break;
+		}
+		if (fds[1].revents) {
+			len = read(err_fds[0], buffer, A_DBDUMP_BUFFER_SIZE);
+			if (len > 0 && part->err.bytesize < YEXEC_STDERR_MAX)
+				ybin_append(&part->err, buffer, (((size_t)len < YEXEC_STDERR_MAX - part->err.bytesize) ?
+				                                 (size_t)len : (YEXEC_STDERR_MAX - part->err.bytesize)));
+			else if (!len || (len == -1 && errno != EINTR))
+				fds[1].fd = -1;
+		}
+		if (!fds[0].revents)
+			continue;
+		len = read(out_fds[0], buffer, A_DBDUMP_BUFFER_SIZE);
+		if (len == -1 && errno == EINTR)
+			continue;
+		if (len == -1) {
+			status = YEIO;
+			break;
+		}
+		if (!len) {
+			fds[0].fd = -1;
+			continue;
+		}
+		// the first table is written inside the transaction
+		for (ssize_t i = 0; part->snapshot && !part->started && i < len; ++i) {
+			if (buffer[i] == marker[matched])
+				++matched;
+			else
+				matched = (buffer[i] == marker[0]) ? 1 : 0;
+			if (!marker[matched])
+				dbdump_started(part);
+		}
+		if ((status = dbdump_write_all(fd, buffer, (size_t)len)) != YENOERR)
+			break;
+	}
+	// if the compression program failed, mysqldump is stopped by SIGPIPE
+	close(out_fds[0]);
+	close(err_fds[0]);
+	free0(buffer);
+	while (waitpid(pid, &exec_status, 0) == -1 && errno == EINTR)
+		;
+	if (status == YENOERR && (!WIFEXITED(exec_status) || WEXITSTATUS(exec_status)))
+		status = YEFAULT;
+	return (status);
+}
+/* Wait for the write rate limit. */
+static void dbdump_part_output(const void *data, size_t len, void *user_data) {
+	throttle_consume((struct throttle_s*)user_data, len);
+}
+/* Write the manifest of a dump. */
+static ystatus_t dbdump_manifest_input(int fd, void *user_data) {
+	dbdump_t *dump = (dbdump_t*)user_data;
+	ystatus_t status = YENOERR;
+	ystr_t manifest;
+
+	if (!(manifest = ys_printf(NULL, "-- Parallel dump of the '%s' database, in %zu parts.\n"
+	                           "-- Parts 2 to %zu were dumped concurrently, from a consistent snapshot.\n"
+	                           "-- The parts are concatenated, and must be restored in this order.\n--\n"
+	                           "-- Part 1: manifest\n", dump->dbname, dump->nbr_parts, dump->nbr_parts - 1)))
+		return (YENOMEM);
+	for (size_t i = 1; i < dump->nbr_parts; ++i) {
+		dbdump_part_t *part = &dump->parts[i];
+		char header[32];
+
+		snprintf(header, sizeof(header), "-- Part %zu: ", i + 1);
+		ys_append(&manifest, header);
+		ys_append(&manifest, (part->snapshot ? "tables" : (yarray_length(part->tables) ? "routines and views" :
+		                                                                              "routines")));
+		for (size_t j = 0; j < yarray_length(part->tables); ++j) {
+			ys_append(&manifest, (j ? ", `" : " `"));
+			ys_append(&manifest, part->tables[j]);
+			ys_append(&manifest, "`");
+		}
+		ys_append(&manifest, "\n");
+	}
+	if (dump->agent->mysqldump_gtid)
+		ys_append(&manifest, "--\n-- GTID_PURGED is set by part 2 only: on a server using GTIDs, restore the whole\n"
+		          "-- file in one session, into a server whose GTID_EXECUTED is empty.\n");
+	if (dump->binlog_file) {
+		char position[320];
+
+		snprintf(position, sizeof(position), "--\n-- Snapshot position in the binary logs: %s:%" PRIu64 "\n",
+		         dump->binlog_file, dump->binlog_position);
+		ys_append(&manifest, position);
+	}
+	if (ys_append(&manifest, "\n") != YENOERR) {
+		ys_free(manifest);
+		return (YENOMEM);
+	}
+	status = dbdump_write_all(fd, manifest, ys_bytesize(manifest));
+	ys_free(manifest);
+	return (status);
+}
+/* Read the namespace header of a mongodump archive's segment, and return its collection. */
+static log_part_t *dbdump_mongodb_collection(dbdump_mongodb_t *dump) {
+	const uint8_t *doc = dump->buffer;
+	size_t size = dump->header_size, offset = 4;
+	const char *db = NULL, *coll = NULL;
+	log_part_t *collection = NULL;
+	ystr_t name = NULL;
+
+	// elements of the BSON document: type, name, value
+	while (offset < size && doc[offset]) {
+		uint8_t type = doc[offset++];
+		const char *key = (const char*)doc + offset;
+		size_t key_len = strnlen(key, size - offset);
+		size_t value_len;
+
+		if ((offset += key_len + 1) > size)
+			return (NULL);
+		if (type == 0x02) {
+			// string: length (with the ending null byte), then the characters
+			if (offset + 4 > size)
+				return (NULL);
+			value_len = 4 + ((size_t)doc[offset] | ((size_t)doc[offset + 1] << 8) |
+			                 ((size_t)doc[offset + 2] << 16) | ((size_t)doc[offset + 3] << 24));
+			if (value_len < 5 || offset + value_len > size || doc[offset + value_len - 1])
+				return (NULL);
+			if (!strcmp(key, "db"))
+				db = (const char*)doc + offset + 4;
+			else if (!strcmp(key, "collection"))
+				coll = (const char*)doc + offset + 4;
+		} else if (type == 0x08) {
+			value_len = 1;
+		} else if (type == 0x10) {
+			value_len = 4;
+		} else if (type == 0x01 || type == 0x12) {
+			value_len = 8;
+		} else {
+			// other types are not used by the namespace headers
+			break;
+		}
+		offset += value_len;
+	}
+	if (!db || !coll || !(name = ys_printf(NULL, "%s.%s", db, coll)))
+		return (NULL);
+	for (size_t i = 0; i < yarray_length(dump->collections); ++i) {
+		collection = dump->collections[i];
+		if (!strcmp(collection->name, name)) {
+			ys_free(name);
+			return (collection);
+		}
+	}
+	if (!(collection = malloc0(sizeof(log_part_t))) ||
+	    yarray_push(&dump->collections, collection) != YENOERR) {
+		free0(collection);
+		ys_free(name);
+		return (NULL);
+	}
+	collection->name = name;
+	return (collection);
+}
+/* Write the sizes of the collections of a MongoDB archive dump to the log. */
+static void dbdump_mongodb_log(dbdump_mongodb_t *dump) {
+	agent_t *agent = dump->agent;
+
+	if (dump->state == A_DBDUMP_MONGODB_INVALID) {
+		ADEBUG("│ ├ " YANSI_YELLOW "Unknown archive format, the collections are not measured" YANSI_RESET);
+		return;
+	}
+	for (size_t i = 0; i < yarray_length(dump->collections); ++i) {
+		log_part_t *collection = dump->collections[i];
+
+		ADEBUG("│ ├ " YANSI_FAINT "Collection " YANSI_RESET "%s" YANSI_FAINT ": " YANSI_RESET "%" PRIu64
+		       YANSI_FAINT " bytes" YANSI_RESET, collection->name, collection->size);
+	}
+}
+/* Write a buffer to a file descriptor. */
+static ystatus_t dbdump_write_all(int fd, const void *data, size_t len) {
+	while (len) {
+		ssize_t written = write(fd, data, len);
+		if (written == -1 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return (YEIO);
+		data += written;
+		len -= (size_t)written;
+	}
+	return (YENOERR);
+}
+/* Create a pipe whose file descriptors are closed on exec. */
+static int dbdump_pipe(int fds[2]) {
+#ifdef __linux__
+	// the parts' programs are spawned concurrently, they must not inherit the pipe
+	if (pipe2(fds, O_CLOEXEC) == -1) {
+		fds[0] = fds[1] = -1;
+		return (-1);
+	}
+#else /* __linux__ */
+	if (pipe(fds) == -1)
+		return (-1);
+	if (fcntl(fds[0], F_SETFD, FD_CLOEXEC) == -1 ||
+	    fcntl(fds[1], F_SETFD, FD_CLOEXEC) == -1) {
+		close(fds[0]);
+		close(fds[1]);
+		fds[0] = fds[1] = -1;
+		return (-1);
+	}
+#endif /* __linux__ */
+	return (0);
+}
@@ -0,0 +1,353 @@
+/**
+ * @header	dbdump.h
+ * @abstract	Parallel dumps of MySQL and MongoDB databases.
+ * @discussion	MySQL: the tables of the database are listed (with their sizes), and
+ *		shared between a given number of mysqldump programs, the biggest
+ *		tables first. Each program dumps its tables in a separate part,
+ *		compressed while it is written; all the programs run at the
+ *		same time.
+ *
+ *		The programs share a consistent snapshot: a control connection
+ *		takes a global read lock (FLUSH TABLES WITH READ LOCK), the
+ *		programs are started with --single-transaction, and the lock is
+ *		released as soon as all of them have started their transaction
+ *		(detected when they begin to write their first table). Writes
+ *		are blocked only during this short time. If requested, the
+ *		binary logs are listed while the lock is held: the size of the
+ *		last one is the position of the snapshot, from which the
+ *		incremental backups archive the binary logs.
+ *
+ *		The views and routines are dumped in a last part, by another
+ *		program. The first part is a manifest, written as SQL comments,
+ *		which lists the parts and their tables. The parts are then
+ *		concatenated in their order, so the archive is a regular
+ *		compressed SQL dump (compressed streams can be concatenated),
+ *		restored in one pass.
+ *		On a server using GTIDs, only the first part of tables sets
+ *		GTID_PURGED (mysqldump of MySQL, not MariaDB).
+ *
+ *		MongoDB: mongodump writes an archive to its standard output,
+ *		dumping several collections at the same time. The archive is
+ *		relayed to the compression program, and read on the fly to
+ *		compute the size of each collection. An archive is made of a
+ *		magic number, a prelude (BSON documents ended by a terminator),
+ *		then segments: a namespace header (BSON document), the BSON
+ *		documents of the namespace, and a terminator. The segments of
+ *		the collections dumped at the same time are interleaved.
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "ystatus.h"
+#include "ystr.h"
+#include "yarray.h"
+#include "yexec.h"
+#include "agent.h"
+#include "log.h"
+
+/** @const A_DBDUMP_TABLES_QUERY	Query listing the tables of the current database, the biggest first. */
+#define A_DBDUMP_TABLES_QUERY		"SELECT table_name, table_type, COALESCE(data_length, 0) + COALESCE(index_length, 0) " \
+					"FROM information_schema.tables WHERE table_schema = DATABASE() ORDER BY 3 DESC, 1"
+/** @const A_DBDUMP_LOCK_TIMEOUT	Maximum time to wait for the global read lock, in seconds. */
+#define A_DBDUMP_LOCK_TIMEOUT		60
+/** @const A_DBDUMP_LOCK_MARKER	Value returned by the control connection once the lock is taken. */
+#define A_DBDUMP_LOCK_MARKER		"arkiv-snapshot"
+/** @const A_DBDUMP_TABLE_MARKER	First statement written by mysqldump inside its transaction. */
+#define A_DBDUMP_TABLE_MARKER		"CREATE TABLE"
+/** @const A_DBDUMP_BUFFER_SIZE	Size of the buffer used to copy the dumps. */
+#define A_DBDUMP_BUFFER_SIZE		65536
+/** @const A_DBDUMP_MONGODB_MAGIC	Magic number of a mongodump archive. */
+#define A_DBDUMP_MONGODB_MAGIC		0x8199e26d
+/** @const A_DBDUMP_MONGODB_TERMINATOR	Terminator of a mongodump archive's prelude or segment. */
+#define A_DBDUMP_MONGODB_TERMINATOR	0xffffffff
+/** @const A_DBDUMP_MONGODB_HEADER_MAX	Maximum size of a namespace header of a mongodump archive. */
+#define A_DBDUMP_MONGODB_HEADER_MAX	16384
+
+/**
+ * @typedef	dbdump_part_t
+ * @abstract	Part of a parallel dump.
+ * @field	dump		Pointer to the dump structure.
+ * @field	path		Path to the part's file.
+ * @field	tables		List of tables (or views) dumped in the part.
+ * @field	size		Estimated size of the tables.
+ * @field	args		Arguments of the mysqldump program.
+ * @field	snapshot	True if the part's program shares the snapshot.
+ * @field	started		True if the part's program has started its transaction.
+ * @field	err		Beginning of the standard errors of the part's programs.
+ * @field	status		Status of the part's dump.
+ */
+typedef struct {
+	struct dbdump_s *dump;
+	ystr_t path;
+	yarray_t tables;
+	uint64_t size;
+	yarray_t args;
+	bool snapshot;
+	bool started;
+	ybin_t err;
+	ystatus_t status;
+} dbdump_part_t;
+/**
+ * @typedef	dbdump_t
+ * @abstract	Parallel dump of a database.
+ * @field	agent		Pointer to the agent structure.
+ * @field	dbname		Name of the database.
+ * @field	conn_args	Connection arguments (user, host, port).
+ * @field	env		Environment of the MySQL programs (password).
+ * @field	z		Compression command (NULL if the parts are not compressed).
+ * @field	parts		Array of parts (the first one is the manifest).
+ * @field	nbr_parts	Number of parts.
+ * @field	nbr_tables	Number of tables.
+ * @field	nbr_views	Number of views.
+ * @field	mutex		Mutex protecting the snapshot synchronization.
+ * @field	nbr_waiting	Number of programs which have not started their transaction.
+ * @field	lock_pid	PID of the control connection.
+ * @field	lock_in		Standard input of the control connection (-1 once the lock is released).
+ * @field	lock_out	Standard output of the control connection.
+ * @field	lock_start	Time the lock was taken.
+ * @field	lock_end	Time the lock was released.
+ * @field	binlog		True to read the position in the binary logs while the lock is held.
+ * @field	binlog_file	Current binary log of the snapshot (NULL if unknown).
+ * @field	binlog_position	Position of the snapshot in the current binary log.
+ */
+typedef struct dbdump_s {
+	agent_t *agent;
+	const char *dbname;
+	yarray_t conn_args;
+	yarray_t env;
+	const yexec_cmd_t *z;
+	dbdump_part_t *parts;
+	size_t nbr_parts;
+	size_t nbr_tables;
+	size_t nbr_views;
+	pthread_mutex_t mutex;
+	size_t nbr_waiting;
+	pid_t lock_pid;
+	int lock_in;
+	int lock_out;
+	struct timespec lock_start;
+	struct timespec lock_end;
+	bool binlog;
+	ystr_t binlog_file;
+	uint64_t binlog_position;
+} dbdump_t;
+/**
+ * @typedef	dbdump_mongodb_state_t
+ * @abstract	Position in a mongodump archive.
+ * @constant	A_DBDUMP_MONGODB_START		Magic number.
+ * @constant	A_DBDUMP_MONGODB_PRELUDE	Documents of the prelude.
+ * @constant	A_DBDUMP_MONGODB_HEADER		Namespace header of a segment.
+ * @constant	A_DBDUMP_MONGODB_BODY		Documents of a segment.
+ * @constant	A_DBDUMP_MONGODB_INVALID	Unknown format (the archive is not read anymore).
+ */
+typedef enum {
+	A_DBDUMP_MONGODB_START = 0,
+	A_DBDUMP_MONGODB_PRELUDE,
+	A_DBDUMP_MONGODB_HEADER,
+	A_DBDUMP_MONGODB_BODY,
+	A_DBDUMP_MONGODB_INVALID
+} dbdump_mongodb_state_t;
+/**
+ * @typedef	dbdump_mongodb_t
+ * @abstract	MongoDB archive dump.
+ * @field	agent		Pointer to the agent structure.
+ * @field	args		Arguments of the mongodump program.
+ * @field	password	Password, given to mongodump on its standard input.
+ * @field	state		Position in the archive.
+ * @field	buffer		Length of the current document, or namespace header.
+ * @field	length		Number of bytes in the buffer.
+ * @field	header_size	Size of the current namespace header (0 while its length is read).
+ * @field	skip		Number of bytes of the current document not read yet.
+ * @field	collections	List of collections (log_part_t pointers).
+ * @field	current		Collection of the current segment.
+ * @field	total_size	Size of the archive, in bytes.
+ */
+typedef struct {
+	agent_t *agent;
+	yarray_t args;
+	const char *password;
+	dbdump_mongodb_state_t state;
+	uint8_t buffer[A_DBDUMP_MONGODB_HEADER_MAX];
+	size_t length;
+	size_t header_size;
+	uint64_t skip;
+	yarray_t collections;
+	log_part_t *current;
+	uint64_t total_size;
+} dbdump_mongodb_t;
+
+/**
+ * @function	dbdump_mysql_open
+ * @abstract	List the tables of a MySQL database, and share them between parts.
+ * @param	dump		Pointer to the dump structure.
+ * @param	agent		Pointer to the agent structure.
+ * @param	dbname		Name of the database.
+ * @param	conn_args	Connection arguments of the MySQL programs.
+ * @param	env		Environment of the MySQL programs.
+ * @param	base_path	Path of the archive (the parts' paths are derived from it).
+ * @return	YENOERR if OK, YENODATA if the database has not enough tables to
+ *		be dumped in parallel, YEINVAL if a table's name is not supported.
+ */
+ystatus_t dbdump_mysql_open(dbdump_t *dump, agent_t *agent, const char *dbname, yarray_t conn_args,
+                            yarray_t env, const char *base_path);
+/**
+ * @function	dbdump_mysql_run
+ * @abstract	Take the global read lock, then dump and compress all the parts
+ *		concurrently.
+ * @param	dump		Pointer to the dump structure.
+ * @param	z		Compression command (NULL if the parts are not compressed).
+ * @return	YENOERR if OK, YEACCES if the lock couldn't be taken (nothing was dumped).
+ */
+ystatus_t dbdump_mysql_run(dbdump_t *dump, const yexec_cmd_t *z);
+/**
+ * @function	dbdump_write
+ * @abstract	Write all the parts of a dump, in their order, to a file descriptor.
+ *		Could be used as an input function of yexec_pipeline_input().
+ * @param	fd		File descriptor.
+ * @param	user_data	Pointer to the dump structure.
+ * @return	YENOERR if OK.
+ */
+ystatus_t dbdump_write(int fd, void *user_data);
+/**
+ * @function	dbdump_close
+ * @abstract	Remove the parts' files of a dump, and free its memory.
+ * @param	dump	Pointer to the dump structure.
+ */
+void dbdump_close(dbdump_t *dump);
+/**
+ * @function	dbdump_mongodb_open
+ * @abstract	Initialize a MongoDB archive dump.
+ * @param	dump		Pointer to the dump structure.
+ * @param	agent		Pointer to the agent structure.
+ * @param	args		Arguments of the mongodump program.
+ * @param	password	Password of the connection.
+ * @return	YENOERR if OK, YENOMEM on memory allocation error.
+ */
+ystatus_t dbdump_mongodb_open(dbdump_mongodb_t *dump, agent_t *agent, yarray_t args, const char *password);
+/**
+ * @function	dbdump_mongodb_write
+ * @abstract	Execute mongodump, and write its archive to a file descriptor.
+ *		Could be used as an input function of yexec_pipeline_input().
+ * @param	fd		File descriptor.
+ * @param	user_data	Pointer to the dump structure.
+ * @return	YENOERR if OK.
+ */
+ystatus_t dbdump_mongodb_write(int fd, void *user_data);
+/**
+ * @function	dbdump_mongodb_read
+ * @abstract	Read a chunk of a mongodump archive, and add the size of its
+ *		documents to their collections.
+ * @param	dump	Pointer to the dump structure.
+ * @param	data	Pointer to the data.
+ * @param	len	Size of the data.
+ */
+void dbdump_mongodb_read(dbdump_mongodb_t *dump, const uint8_t *data, size_t len);
+/**
+ * @function	dbdump_mongodb_close
+ * @abstract	Free the memory of a MongoDB archive dump. The list of collections
+ *		is freed, unless it was taken by the caller (set to NULL).
+ * @param	dump	Pointer to the dump structure.
+ */
+void dbdump_mongodb_close(dbdump_mongodb_t *dump);
+
+/* ********** PRIVATE DECLARATIONS ********** */
+#ifdef __A_DBDUMP_PRIVATE__
+	/**
+	 * @function	dbdump_parse_table
+	 * @abstract	Parse a line of the tables' list ("name<TAB>type<TAB>size").
+	 * @param	line	Line (modified).
+	 * @param	name	Pointer to the table's name (set).
+	 * @param	view	Pointer to a boolean set to true if the table is a view.
+	 * @param	size	Pointer to the table's size (set).
+	 * @return	YENOERR if OK, YENODATA if the table must not be dumped, YEINVAL
+	 *		if the line is malformed or the name is not supported.
+	 */
+	static ystatus_t dbdump_parse_table(char *line, char **name, bool *view, uint64_t *size);
+	/**
+	 * @function	dbdump_lock
+	 * @abstract	Start the control connection, and take the global read lock.
+	 * @param	dump	Pointer to the dump structure.
+	 * @return	YENOERR if the lock is taken.
+	 */
+	static ystatus_t dbdump_lock(dbdump_t *dump);
+	/**
+	 * @function	dbdump_unlock
+	 * @abstract	Release the global read lock: the standard input of the control
+	 *		connection is closed, so it ends its session.
+	 * @param	dump	Pointer to the dump structure.
+	 */
+	static void dbdump_unlock(dbdump_t *dump);
+	/**
+	 * @function	dbdump_started
+	 * @abstract	Mark the transaction of a part's program as started. The lock
+	 *		is released once all the programs have started.
+	 * @param	part	Pointer to the part.
+	 */
+	static void dbdump_started(dbdump_part_t *part);
+	/**
+	 * @function	dbdump_part_job
+	 * @abstract	Dump and compress a part (called by a pool thread).
+	 * @param	index		Index of the part, minus one (the manifest is not dumped).
+	 * @param	user_data	Pointer to the dump structure.
+	 */
+	static void dbdump_part_job(size_t index, void *user_data);
+	/**
+	 * @function	dbdump_part_input
+	 * @abstract	Execute the mysqldump program of a part, and write its output
+	 *		to the compression program.
+	 * @param	fd		File descriptor of the compression program's input.
+	 * @param	user_data	Pointer to the part.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t dbdump_part_input(int fd, void *user_data);
+	/**
+	 * @function	dbdump_part_output
+	 * @abstract	Wait for the write rate limit (output function of a part's pipeline).
+	 * @param	data		Pointer to the data.
+	 * @param	len		Size of the data.
+	 * @param	user_data	Pointer to the write rate limit.
+	 */
+	static void dbdump_part_output(const void *data, size_t len, void *user_data);
+	/**
+	 * @function	dbdump_manifest_input
+	 * @abstract	Write the manifest of a dump.
+	 * @param	fd		File descriptor.
+	 * @param	user_data	Pointer to the dump structure.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t dbdump_manifest_input(int fd, void *user_data);
+	/**
+	 * @function	dbdump_mongodb_collection
+	 * @abstract	Read the namespace header of a mongodump archive's segment, and
+	 *		return its collection (added to the list if needed).
+	 * @param	dump	Pointer to the dump structure.
+	 * @return	A pointer to the collection, or NULL if the header is not valid.
+	 */
+	static log_part_t *dbdump_mongodb_collection(dbdump_mongodb_t *dump);
+	/**
+	 * @function	dbdump_mongodb_log
+	 * @abstract	Write the sizes of the collections of a MongoDB archive dump to the log.
+	 * @param	dump	Pointer to the dump structure.
+	 */
+	static void dbdump_mongodb_log(dbdump_mongodb_t *dump);
+	/**
+	 * @function	dbdump_write_all
+	 * @abstract	Write a buffer to a file descriptor.
+	 * @param	fd	File descriptor.
+	 * @param	data	Pointer to the data.
+	 * @param	len	Size of the data.
+	 * @return	YENOERR if OK, YEIO on error.
+	 */
+	static ystatus_t dbdump_write_all(int fd, const void *data, size_t len);
+	/**
+	 * @function	dbdump_pipe
+	 * @abstract	Create a pipe whose file descriptors are closed on exec.
+	 * @param	fds	Array of file descriptors.
+	 * @return	0 if OK, -1 on error.
+	 */
+	static int dbdump_pipe(int fds[2]);
+#endif /* __A_DBDUMP_PRIVATE__ */
@@ -0,0 +1,435 @@
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include "yansi.h"
+#include "ymemory.h"
+#include "yfile.h"
+#include "ystr.h"
+
+#define __A_DEDUP_PRIVATE__
+#include "dedup.h"
+
+/** @const A_DEDUP_EMPTY_SLOT	Content of an empty slot. */
+static const uint8_t A_DEDUP_EMPTY_SLOT[A_DEDUP_ID_SIZE] = {0};
+
+/* Open the index of stored chunks, and derive the dedup key. */
+dedup_t *dedup_open(agent_t *agent) {
+	dedup_t *dedup = NULL;
+	ystr_t dir = NULL;
+	ystatus_t st;
+	struct stat sb;
+
+	ALOG("Open deduplication index");
+	if (agent->param.encryption != A_CRYPT_ARKIV || !agent->crypt_key) {
+		ALOG("└ " YANSI_YELLOW "Deduplication needs the arkiv encryption, regular archives are created" YANSI_RESET);
+		return (NULL);
+	}
+	if (!(dedup = malloc0(sizeof(dedup_t))) ||
+	    !(dir = ys_printf(NULL, "%s/%s", agent->conf.archives_path, A_DEDUP_DIRNAME)) ||
+	    !(dedup->path = ys_printf(NULL, "%s/%" PRIu64 ".idx", dir, agent->param.storage_id))) {
+		ALOG("└ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		goto error;
+	}
+	dedup->fd = -1;
+	if (!yfile_mkpath(dir, 0700) ||
+	    (dedup->fd = open(dedup->path, O_RDWR | O_CREAT | O_CLOEXEC, 0600)) < 0) {
+		ALOG("└ " YANSI_RED "Unable to open " YANSI_RESET "%s", dedup->path);
+		goto error;
+	}
+	// another execution may be running
+	if (flock(dedup->fd, LOCK_EX | LOCK_NB)) {
+		ALOG("└ " YANSI_YELLOW "Index used by another execution, regular archives are created" YANSI_RESET);
+		goto error;
+	}
+	// map the index (a new or invalid file is initialized)
+	if (fstat(dedup->fd, &sb)) {
+		ALOG("└ " YANSI_RED "Unable to read " YANSI_RESET "%s", dedup->path);
+		goto error;
+	}
+	st = dedup_index_map(dedup->fd, (sb.st_size ? 0 : A_DEDUP_INDEX_MIN_CAPACITY), &dedup->map, &dedup->map_size);
+	if (st == YEBADMSG) {
+		ALOG("├ " YANSI_YELLOW "Invalid index file, it is reset" YANSI_RESET);
+		st = ftruncate(dedup->fd, 0) ? YEIO :
+		     dedup_index_map(dedup->fd, A_DEDUP_INDEX_MIN_CAPACITY, &dedup->map, &dedup->map_size);
+	}
+	if (st != YENOERR) {
+		ALOG("└ " YANSI_RED "Unable to map " YANSI_RESET "%s", dedup->path);
+		goto error;
+	}
+	memcpy(&dedup->capacity, dedup->map + 16, sizeof(uint64_t));
+	dedup->count = (uint64_t*)(dedup->map + 24);
+	pthread_mutex_init(&dedup->mutex, NULL);
+	ADEBUG("├ " YANSI_FAINT "Index " YANSI_RESET "%s" YANSI_FAINT " (" YANSI_RESET "%" PRIu64 YANSI_FAINT " chunks)" YANSI_RESET,
+	       dedup->path, *dedup->count);
+	// the dedup key doesn't depend on the execution
+	ycrypt_pbkdf2_sha512(agent->conf.crypt_pwd, strlen(agent->conf.crypt_pwd), A_DEDUP_ID_SALT,
+	                     strlen(A_DEDUP_ID_SALT), A_CRYPT_PBKDF2_ITERATIONS, dedup->id_key, sizeof(dedup->id_key));
+	// the chunks are uploaded again before the storage retention removes them
+	dedup->date = (int64_t)agent->exec_timestamp;
+	dedup->max_age = agent_retention(agent) / 2;
+	ys_free(dir);
+	ALOG("└ " YANSI_GREEN "Done" YANSI_RESET);
+	return (dedup);
+error:
+	ys_free(dir);
+	if (dedup) {
+		if (dedup->fd >= 0)
+			close(dedup->fd);
+		ys_free(dedup->path);
+		free0(dedup);
+	}
+	return (NULL);
+}
+/* Write the index to disk, and free it. */
+void dedup_close(dedup_t *dedup) {
+	if (!dedup)
+		return;
+	msync(dedup->map, dedup->map_size, MS_SYNC);
+	munmap(dedup->map, dedup->map_size);
+	close(dedup->fd);
+	pthread_mutex_destroy(&dedup->mutex);
+	ys_free(dedup->path);
+	ycrypt_wipe(dedup->id_key, sizeof(dedup->id_key));
+	free0(dedup);
+}
+/* Start to cut an archive into chunks. */
+ystatus_t dedup_stream_open(dedup_stream_t *stream, agent_t *agent, log_item_t *log,
+                            encrypt_stream_t *manifest) {
+	char line[128];
+
+	memset(stream, 0, sizeof(dedup_stream_t));
+	stream->dedup = agent->dedup;
+	stream->key = agent->crypt_key;
+	stream->manifest = manifest;
+	stream->log = log;
+	if (!(log->chunks_path = ys_printf(NULL, "%s.chunks", log->archive_path)) ||
+	    !(log->chunks = ybin_new()) ||
+	    !(stream->cdc = ycdc_new(A_DEDUP_CHUNK_MIN_SIZE, A_DEDUP_CHUNK_AVG_SIZE, A_DEDUP_CHUNK_MAX_SIZE,
+	                             dedup_chunk, stream)))
+		return (stream->status = YENOMEM);
+	if (!yfile_mkpath(log->chunks_path, 0700))
+		return (stream->status = YEIO);
+	// manifest header
+	snprintf(line, sizeof(line), A_DEDUP_MANIFEST_HEADER "chunker fastcdc %d %d %d\n",
+	         A_DEDUP_CHUNK_MIN_SIZE, A_DEDUP_CHUNK_AVG_SIZE, A_DEDUP_CHUNK_MAX_SIZE);
+	encrypt_stream_write(line, strlen(line), manifest);
+	return (stream->status = manifest->status);
+}
+/* Add data to the archive. */
+void dedup_stream_write(const void *data, size_t len, void *user_data) {
+	dedup_stream_t *stream = user_data;
+
+	if (stream->status == YENOERR)
+		ycdc_write(data, len, stream->cdc);
+}
+/* Write the last chunk, and free the stream's resources. */
+ystatus_t dedup_stream_close(dedup_stream_t *stream) {
+	if (stream->cdc) {
+		if (stream->status == YENOERR)
+			ycdc_end(stream->cdc);
+		ycdc_free(stream->cdc);
+		stream->cdc = NULL;
+	}
+	return (stream->status);
+}
+/* Add the new chunks of an item to the index. */
+ystatus_t dedup_commit(dedup_t *dedup, log_item_t *log) {
+	ystatus_t status = YENOERR;
+	const uint8_t *id;
+	uint8_t *slot;
+
+	if (!dedup || !log->chunks)
+		return (YENOERR);
+	pthread_mutex_lock(&dedup->mutex);
+	for (size_t offset = 0; offset + A_DEDUP_ID_SIZE <= log->chunks->bytesize; offset += A_DEDUP_ID_SIZE) {
+		id = (const uint8_t*)log->chunks->data + offset;
+		// an empty identifier can't be stored
+		if (!memcmp(id, A_DEDUP_EMPTY_SLOT, A_DEDUP_ID_SIZE))
+			continue;
+		slot = dedup_index_slot(dedup->map, dedup->capacity, id);
+		// a chunk uploaded again gets a new date
+		if (!memcmp(slot, id, A_DEDUP_ID_SIZE)) {
+			memcpy(slot + A_DEDUP_ID_SIZE, &dedup->date, sizeof(dedup->date));
+			continue;
+		}
+		// the load factor is kept under 75%
+		if ((*dedup->count + 1) * 4 > dedup->capacity * 3) {
+			if ((status = dedup_index_grow(dedup)) != YENOERR)
+				break;
+			slot = dedup_index_slot(dedup->map, dedup->capacity, id);
+		}
+		memcpy(slot, id, A_DEDUP_ID_SIZE);
+		memcpy(slot + A_DEDUP_ID_SIZE, &dedup->date, sizeof(dedup->date));
+		(*dedup->count)++;
+	}
+	pthread_mutex_unlock(&dedup->mutex);
+	return (status);
+}
+/* Rebuild the list of the new chunks of an archive from its directory of chunks. */
+ystatus_t dedup_resume(log_item_t *log, const char *chunks_path) {
+	ystatus_t status = YENOERR;
+	DIR *dir = NULL;
+	DIR *subdir = NULL;
+	struct dirent *entry;
+	ystr_t path = NULL;
+	ystr_t file = NULL;
+	uint8_t id[A_DEDUP_ID_SIZE];
+
+	if ((!log->chunks && !(log->chunks = ybin_new())) ||
+	    (!log->chunks_path && !(log->chunks_path = ys_new(chunks_path))))
+		return (YENOMEM);
+	if (!(dir = opendir(chunks_path)))
+		return (YEIO);
+	// <chunks path>/<2 first hex digits>/<identifier>
+	while (status == YENOERR && (entry = readdir(dir))) {
+		if (entry->d_name[0] == '.')
+			continue;
+		ys_free(path);
+		if (!(path = ys_printf(NULL, "%s/%s", chunks_path, entry->d_name))) {
+			status = YENOMEM;
+			break;
+		}
+		if (!(subdir = opendir(path)))
+			continue;
+		while (status == YENOERR && (entry = readdir(subdir))) {
+			if (entry->d_name[0] == '.')
+				continue;
+			if (dedup_id_parse(entry->d_name, id)) {
+				status = ybin_append(log->chunks, id, A_DEDUP_ID_SIZE);
+				continue;
+			}
+			// the temporary file of an interrupted writing is removed, so it isn't uploaded
+			if (!(file = ys_printf(NULL, "%s/%s", path, entry->d_name))) {
+				status = YENOMEM;
+				break;
+			}
+			unlink(file);
+			ys_free(file);
+		}
+		closedir(subdir);
+	}
+	closedir(dir);
+	ys_free(path);
+	if (status != YENOERR) {
+		ybin_delete(log->chunks);
+		log->chunks = NULL;
+		ys_delete(&log->chunks_path);
+	}
+	return (status);
+}
+
+/* ********** PRIVATE FUNCTIONS ********** */
+
+/* Process a chunk: add it to the manifest, and write it if it is not already stored. */
+static void dedup_chunk(const void *data, size_t len, void *user_data) {
+	static const char hexdigits[] = "0123456789abcdef";
+	dedup_stream_t *stream = user_data;
+	uint8_t mac[YCRYPT_HMAC_SIZE];
+	char hex[A_DEDUP_ID_HEX_SIZE + 1];
+	char line[A_DEDUP_ID_HEX_SIZE + 32];
+	ystr_t path = NULL;
+	char *tmp_path = NULL;
+	encrypt_stream_t crypt_stream;
+	FILE *file = NULL;
+	const uint8_t *slot;
+	int64_t date;
+	bool known;
+
+	if (stream->status != YENOERR)
+		return;
+	stream->nbr_chunks++;
+	// identifier
+	ycrypt_hmac_sha512(stream->dedup->id_key, YCRYPT_KEY_SIZE, data, len, mac);
+	for (int i = 0; i < A_DEDUP_ID_SIZE; ++i) {
+		hex[i * 2] = hexdigits[mac[i] >> 4];
+		hex[i * 2 + 1] = hexdigits[mac[i] & 0x0f];
+	}
+	hex[A_DEDUP_ID_HEX_SIZE] = '\0';
+	// manifest
+	snprintf(line, sizeof(line), "%s %zu\n", hex, len);
+	encrypt_stream_write(line, strlen(line), stream->manifest);
+	// search the chunk in the index (a chunk close to its retention limit is uploaded again)
+	pthread_mutex_lock(&stream->dedup->mutex);
+	slot = dedup_index_slot(stream->dedup->map, stream->dedup->capacity, mac);
+	known = !memcmp(slot, mac, A_DEDUP_ID_SIZE);
+	memcpy(&date, slot + A_DEDUP_ID_SIZE, sizeof(date));
+	pthread_mutex_unlock(&stream->dedup->mutex);
+	if (known && (!stream->dedup->max_age || stream->dedup->date - date <= stream->dedup->max_age))
+		return;
+	// the chunk may appear twice in the same archive
+	if (!(path = ys_printf(NULL, "%s/%.2s", stream->log->chunks_path, hex))) {
+		stream->status = YENOMEM;
+		return;
+	}
+	if (!yfile_mkpath(path, 0700) || ys_printf(&path, "%s/%.2s/%s", stream->log->chunks_path, hex, hex) == NULL) {
+		stream->status = YEIO;
+		goto cleanup;
+	}
+	if (yfile_exists(path))
+		goto cleanup;
+	// write the encrypted chunk (in a temporary file, so an interrupted
+	// writing doesn't leave a truncated chunk)
+	if (!(tmp_path = yfile_tmp(path)) || !(file = fopen(tmp_path, "we"))) {
+		stream->status = YEIO;
+		goto cleanup;
+	}
+	if (encrypt_stream_open(&crypt_stream, stream->key, file, NULL) == YENOERR)
+		encrypt_stream_write(data, len, &crypt_stream);
+	stream->status = encrypt_stream_close(&crypt_stream);
+	if (fclose(file) && stream->status == YENOERR)
+		stream->status = YEIO;
+	if (stream->status == YENOERR && rename(tmp_path, path))
+		stream->status = YEIO;
+	if (stream->status == YENOERR)
+		stream->status = ybin_append(stream->log->chunks, mac, A_DEDUP_ID_SIZE);
+	if (stream->status != YENOERR) {
+		unlink(tmp_path);
+		unlink(path);
+		goto cleanup;
+	}
+	stream->nbr_new++;
+	stream->new_size += len;
+cleanup:
+	ys_free(path);
+	free0(tmp_path);
+}
+/* Map an index file in memory. */
+static ystatus_t dedup_index_map(int fd, uint64_t capacity, uint8_t **map, size_t *map_size) {
+	uint32_t u32;
+	uint64_t u64;
+	struct stat sb;
+
+	if (capacity) {
+		// new file
+		*map_size = A_DEDUP_INDEX_HEADER_SIZE + capacity * A_DEDUP_INDEX_SLOT_SIZE;
+		if (ftruncate(fd, *map_size))
+			return (YEIO);
+	} else {
+		if (fstat(fd, &sb))
+			return (YEIO);
+		if ((size_t)sb.st_size < A_DEDUP_INDEX_HEADER_SIZE)
+			return (YEBADMSG);
+		*map_size = (size_t)sb.st_size;
+	}
+	*map = mmap(NULL, *map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (*map == MAP_FAILED) {
+		*map = NULL;
+		return (YEIO);
+	}
+	if (capacity) {
+		memcpy(*map, A_DEDUP_INDEX_MAGIC, 8);
+		u32 = A_DEDUP_INDEX_VERSION;
+		memcpy(*map + 8, &u32, sizeof(u32));
+		u32 = A_DEDUP_ID_SIZE;
+		memcpy(*map + 12, &u32, sizeof(u32));
+		memcpy(*map + 16, &capacity, sizeof(capacity));
+		u64 = 0;
+		memcpy(*map + 24, &u64, sizeof(u64));
+		return (YENOERR);
+	}
+	// check the header of an existing file
+	uint32_t version, id_size;
+	memcpy(&version, *map + 8, sizeof(version));
+	memcpy(&id_size, *map + 12, sizeof(id_size));
+	memcpy(&u64, *map + 16, sizeof(u64));
+	if (memcmp(*map, A_DEDUP_INDEX_MAGIC, 8) ||
+	    version != A_DEDUP_INDEX_VERSION || id_size != A_DEDUP_ID_SIZE ||
+	    !u64 || (u64 & (u64 - 1)) ||
+	    A_DEDUP_INDEX_HEADER_SIZE + u64 * A_DEDUP_INDEX_SLOT_SIZE != *map_size) {
+		munmap(*map, *map_size);
+		*map = NULL;
+		return (YEBADMSG);
+	}
+	return (YENOERR);
+}
+/* Search the slot of an identifier. */
+static uint8_t *dedup_index_slot(uint8_t *map, uint64_t capacity, const uint8_t id[A_DEDUP_ID_SIZE]) {
+	uint8_t *slots = map + A_DEDUP_INDEX_HEADER_SIZE;
+	uint64_t i;
+
+	// identifiers are uniformly distributed, their first bytes are used as hash value
+	memcpy(&i, id, sizeof(i));
+	for (i &= (capacity - 1); ; i = (i + 1) & (capacity - 1)) {
+		uint8_t *slot = slots + i * A_DEDUP_INDEX_SLOT_SIZE;
+		if (!memcmp(slot, id, A_DEDUP_ID_SIZE) ||
+		    !memcmp(slot, A_DEDUP_EMPTY_SLOT, A_DEDUP_ID_SIZE))
+			return (slot);
+	}
+}
+/* Double the number of slots of the index. */
+static ystatus_t dedup_index_grow(dedup_t *dedup) {
+	ystatus_t status = YENOERR;
+	ystr_t tmp_path = NULL;
+	uint8_t *map = NULL;
+	size_t map_size = 0;
+	uint64_t capacity = dedup->capacity * 2;
+	uint64_t count = 0;
+	int fd = -1;
+
+	if (!(tmp_path = ys_printf(NULL, "%s.tmp", dedup->path)))
+		return (YENOMEM);
+	if ((fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) < 0 ||
+	    flock(fd, LOCK_EX | LOCK_NB) ||
+	    (status = dedup_index_map(fd, capacity, &map, &map_size)) != YENOERR) {
+		if (status == YENOERR)
+			status = YEIO;
+		goto cleanup;
+	}
+	// copy the identifiers, with their dates
+	for (uint64_t i = 0; i < dedup->capacity; ++i) {
+		const uint8_t *id = dedup->map + A_DEDUP_INDEX_HEADER_SIZE + i * A_DEDUP_INDEX_SLOT_SIZE;
+		if (!memcmp(id, A_DEDUP_EMPTY_SLOT, A_DEDUP_ID_SIZE))
+			continue;
+		memcpy(dedup_index_slot(map, capacity, id), id, A_DEDUP_INDEX_SLOT_SIZE);
+		count++;
+	}
+	memcpy(map + 24, &count, sizeof(count));
+	// replace the old file
+	if (msync(map, map_size, MS_SYNC) || rename(tmp_path, dedup->path)) {
+		status = YEIO;
+		goto cleanup;
+	}
+	munmap(dedup->map, dedup->map_size);
+	close(dedup->fd);
+	dedup->fd = fd;
+	dedup->map = map;
+	dedup->map_size = map_size;
+	dedup->capacity = capacity;
+	dedup->count = (uint64_t*)(map + 24);
+	fd = -1;
+	map = NULL;
+cleanup:
+	if (map)
+		munmap(map, map_size);
+	if (fd >= 0) {
+		close(fd);
+		unlink(tmp_path);
+	}
+	ys_free(tmp_path);
+	return (status);
+}
+/* Read a chunk identifier from its hexadecimal representation. */
+static bool dedup_id_parse(const char *hex, uint8_t id[A_DEDUP_ID_SIZE]) {
+	uint8_t nibble;
+
+	if (strlen(hex) != A_DEDUP_ID_HEX_SIZE)
+		return (false);
+	for (int i = 0; i < A_DEDUP_ID_HEX_SIZE; ++i) {
+		if (hex[i] >= '0' && hex[i] <= '9')
+			nibble = (uint8_t)(hex[i] - '0');
+		else if (hex[i] >= 'a' && hex[i] <= 'f')
+			nibble = (uint8_t)(hex[i] - 'a' + 10);
+		else
+			return (false);
+		if (i % 2)
+			id[i / 2] |= nibble;
+		else
+			id[i / 2] = (uint8_t)(nibble << 4);
+	}
+	return (true);
+}
@@ -0,0 +1,251 @@
+/**
+ * @header	dedup.h
+ * @abstract	Deduplicated storage of archives.
+ * @discussion	The output of the compression program is cut into chunks of
+ *		variable size (content-defined chunking, 1 MiB on average). Each
+ *		chunk is identified by a keyed hash of its content, encrypted
+ *		in its own file, and uploaded only if it was not already stored.
+ *		Archives are replaced by manifests, which list their chunks.
+ *
+ *		Chunk identifier:
+ *		  HMAC-SHA512(dedup key, chunk) truncated to 32 bytes, written
+ *		  in hexadecimal. The dedup key is derived from the encryption
+ *		  password with PBKDF2-HMAC-SHA512 and a fixed salt, so the
+ *		  identifiers are the same from one execution to another, but
+ *		  they don't reveal the content of the chunks.
+ *
+ *		Storage:
+ *		  <org>/<host>/chunks/<2 first hex digits>/<identifier>
+ *		  Each chunk file is encrypted like a regular archive (see
+ *		  encrypt.h), so it could be decrypted by the "decrypt" command.
+ *
+ *		Manifest (text file, encrypted like a regular archive):
+ *		  arkiv-manifest 1
+ *		  chunker fastcdc <min size> <average size> <max size>
+ *		  <identifier> <size>
+ *		  <identifier> <size>
+ *		  ...
+ *		The archive is restored by concatenating the decrypted chunks,
+ *		in the manifest's order.
+ *
+ *		The identifiers of the uploaded chunks are kept in a local
+ *		index (one per storage), under the archives path. It is an
+ *		open-addressing hash table, mapped in memory, so checking if a
+ *		chunk is already stored doesn't need any network access. If
+ *		the index is lost, chunks are uploaded again.
+ *
+ *		The chunks are removed by the storage retention, like the
+ *		archives. The index keeps the date of each chunk's upload, and
+ *		a chunk older than half of the retention duration is uploaded
+ *		again when a new archive uses it.
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ */
+#pragma once
+
+#include <pthread.h>
+#include "ystatus.h"
+#include "ybin.h"
+#include "ycdc.h"
+#include "ycrypt.h"
+#include "agent.h"
+#include "log.h"
+#include "encrypt.h"
+
+/** @const A_DEDUP_CHUNK_MIN_SIZE	Minimum size of a chunk. */
+#define A_DEDUP_CHUNK_MIN_SIZE		(256 * 1024)
+/** @const A_DEDUP_CHUNK_AVG_SIZE	Average size of a chunk. */
+#define A_DEDUP_CHUNK_AVG_SIZE		(1024 * 1024)
+/** @const A_DEDUP_CHUNK_MAX_SIZE	Maximum size of a chunk. */
+#define A_DEDUP_CHUNK_MAX_SIZE		(4 * 1024 * 1024)
+/** @const A_DEDUP_ID_SIZE		Size of a chunk identifier, in bytes. */
+#define A_DEDUP_ID_SIZE			32
+/** @const A_DEDUP_ID_HEX_SIZE		Size of a chunk identifier, in hexadecimal. */
+#define A_DEDUP_ID_HEX_SIZE		(A_DEDUP_ID_SIZE * 2)
+/** @const A_DEDUP_ID_SALT		Salt used to derive the dedup key. */
+#define A_DEDUP_ID_SALT			"arkiv-dedup-id"
+/** @const A_DEDUP_MANIFEST_HEADER	First line of a manifest. */
+#define A_DEDUP_MANIFEST_HEADER		"arkiv-manifest 1\n"
+/** @const A_DEDUP_CHUNKS_DIRNAME	Name of the remote directory of chunks. */
+#define A_DEDUP_CHUNKS_DIRNAME		"chunks"
+/** @const A_DEDUP_INDEX_MAGIC		Magic string at the beginning of the index file. */
+#define A_DEDUP_INDEX_MAGIC		"ARKIVIDX"
+/** @const A_DEDUP_INDEX_VERSION	Version of the index file format. */
+#define A_DEDUP_INDEX_VERSION		2
+/** @const A_DEDUP_INDEX_HEADER_SIZE	Size of the index file header. */
+#define A_DEDUP_INDEX_HEADER_SIZE	64
+/** @const A_DEDUP_INDEX_SLOT_SIZE	Size of a slot of the index (identifier and upload date). */
+#define A_DEDUP_INDEX_SLOT_SIZE		(A_DEDUP_ID_SIZE + 8)
+/** @const A_DEDUP_INDEX_MIN_CAPACITY	Initial number of slots of the index (must be a power of 2). */
+#define A_DEDUP_INDEX_MIN_CAPACITY	65536
+
+/**
+ * @typedef	dedup_t
+ * @abstract	Index of the chunks stored on the storage.
+ * @discussion	The index file starts with a header (magic string, version as
+ *		uint32, identifiers' size as uint32, number of slots as uint64,
+ *		number of used slots as uint64; all in host byte order), followed
+ *		by the slots. A slot holds a chunk identifier and the date of
+ *		its upload as int64; an empty slot is filled with zeros.
+ * @field	mutex		Mutex protecting the index.
+ * @field	path		Path to the index file.
+ * @field	fd		File descriptor of the index file.
+ * @field	map		Pointer to the mapped index file.
+ * @field	map_size	Size of the mapped index file.
+ * @field	capacity	Number of slots.
+ * @field	count		Pointer to the number of used slots (in the mapped header).
+ * @field	id_key		Key used to compute the chunk identifiers.
+ * @field	date		Date of the execution (upload date of the new chunks).
+ * @field	max_age		Age from which a stored chunk is uploaded again (0 if never).
+ */
+typedef struct dedup_s {
+	pthread_mutex_t mutex;
+	ystr_t path;
+	int fd;
+	uint8_t *map;
+	size_t map_size;
+	uint64_t capacity;
+	uint64_t *count;
+	uint8_t id_key[YCRYPT_KEY_SIZE];
+	int64_t date;
+	int64_t max_age;
+} dedup_t;
+
+/**
+ * @typedef	dedup_stream_t
+ * @abstract	Archive being cut into chunks.
+ * @field	dedup		Pointer to the index of stored chunks.
+ * @field	key		Pointer to the master key, used to encrypt the chunks.
+ * @field	cdc		Pointer to the chunker.
+ * @field	manifest	Pointer to the encrypted stream of the manifest.
+ * @field	log		Pointer to the item's log entry (new chunks are added to it).
+ * @field	nbr_chunks	Number of chunks.
+ * @field	nbr_new		Number of chunks which were not already stored (or too old).
+ * @field	new_size	Size of the chunks which were not already stored (or too old).
+ * @field	status		Status of the first error.
+ */
+typedef struct {
+	dedup_t *dedup;
+	const encrypt_key_t *key;
+	ycdc_t *cdc;
+	encrypt_stream_t *manifest;
+	log_item_t *log;
+	uint64_t nbr_chunks;
+	uint64_t nbr_new;
+	uint64_t new_size;
+	ystatus_t status;
+} dedup_stream_t;
+
+/**
+ * @function	dedup_open
+ * @abstract	Open (or create) the index of the chunks stored on the current
+ *		storage, and derive the dedup key.
+ * @param	agent	Pointer to the agent structure.
+ * @return	A pointer to the index, or NULL if the deduplication can't be used.
+ */
+dedup_t *dedup_open(agent_t *agent);
+/**
+ * @function	dedup_close
+ * @abstract	Write the index to disk, and free it.
+ * @param	dedup	Pointer to the index (could be NULL).
+ */
+void dedup_close(dedup_t *dedup);
+/**
+ * @function	dedup_stream_open
+ * @abstract	Start to cut an archive into chunks. The manifest's header is
+ *		written, and the item's directory of new chunks is created.
+ * @param	stream		Pointer to the stream structure.
+ * @param	agent		Pointer to the agent structure.
+ * @param	log		Pointer to the item's log entry, whose chunks_path is set.
+ * @param	manifest	Pointer to the encrypted stream of the manifest.
+ * @return	YENOERR if OK.
+ */
+ystatus_t dedup_stream_open(dedup_stream_t *stream, agent_t *agent, log_item_t *log,
+                            encrypt_stream_t *manifest);
+/**
+ * @function	dedup_stream_write
+ * @abstract	Add data to the archive. Could be used as an output function of
+ *		yexec_pipeline(). Errors are stored in the stream structure.
+ * @param	data		Pointer to the data.
+ * @param	len		Size of the data.
+ * @param	user_data	Pointer to the stream structure.
+ */
+void dedup_stream_write(const void *data, size_t len, void *user_data);
+/**
+ * @function	dedup_stream_close
+ * @abstract	Write the last chunk, and free the stream's resources. Must be
+ *		called even if an error occurred. The manifest is not closed.
+ * @param	stream	Pointer to the stream structure.
+ * @return	YENOERR if all the chunks were written successfully.
+ */
+ystatus_t dedup_stream_close(dedup_stream_t *stream);
+/**
+ * @function	dedup_commit
+ * @abstract	Add the new chunks of an item to the index, once they are uploaded.
+ *		The upload date of the chunks which were uploaded again is updated.
+ * @param	dedup	Pointer to the index.
+ * @param	log	Pointer to the item's log entry.
+ * @return	YENOERR if OK.
+ */
+ystatus_t dedup_commit(dedup_t *dedup, log_item_t *log);
+/**
+ * @function	dedup_resume
+ * @abstract	Rebuild the list of the new chunks of an archive from its directory
+ *		of chunks (used when an interrupted run is resumed).
+ * @param	log		Pointer to the item's log entry, whose chunks and
+ *				chunks_path are set.
+ * @param	chunks_path	Path to the directory of chunks.
+ * @return	YENOERR if OK.
+ */
+ystatus_t dedup_resume(log_item_t *log, const char *chunks_path);
+
+/* ********** PRIVATE DECLARATIONS ********** */
+#ifdef __A_DEDUP_PRIVATE__
+	/**
+	 * @function	dedup_chunk
+	 * @abstract	Process a chunk: add it to the manifest, and write it if
+	 *		it is not already stored, or if it was uploaded too long
+	 *		ago. Called by the chunker.
+	 * @param	data		Pointer to the chunk's data.
+	 * @param	len		Size of the chunk.
+	 * @param	user_data	Pointer to the stream structure.
+	 */
+	static void dedup_chunk(const void *data, size_t len, void *user_data);
+	/**
+	 * @function	dedup_index_map
+	 * @abstract	Map an index file in memory. A new file is initialized.
+	 * @param	fd		File descriptor of the index file.
+	 * @param	capacity	Number of slots of a new file, or 0 to map an existing file.
+	 * @param	map		Pointer to the mapped memory.
+	 * @param	map_size	Pointer to the size of the mapped memory.
+	 * @return	YENOERR if OK, YEBADMSG if the file is not a valid index.
+	 */
+	static ystatus_t dedup_index_map(int fd, uint64_t capacity, uint8_t **map, size_t *map_size);
+	/**
+	 * @function	dedup_index_slot
+	 * @abstract	Search the slot of an identifier. The mutex must be locked.
+	 * @param	map		Pointer to the mapped index.
+	 * @param	capacity	Number of slots.
+	 * @param	id		Pointer to the identifier.
+	 * @return	A pointer to the identifier's slot, or to the empty slot
+	 *		where it could be added.
+	 */
+	static uint8_t *dedup_index_slot(uint8_t *map, uint64_t capacity, const uint8_t id[A_DEDUP_ID_SIZE]);
+	/**
+	 * @function	dedup_index_grow
+	 * @abstract	Double the number of slots of the index. The new index is
+	 *		written in a temporary file, which replaces the old one.
+	 *		The mutex must be locked.
+	 * @param	dedup	Pointer to the index.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t dedup_index_grow(dedup_t *dedup);
+	/**
+	 * @function	dedup_id_parse
+	 * @abstract	Read a chunk identifier from its hexadecimal representation.
+	 * @param	hex	Hexadecimal representation.
+	 * @param	id	Pointer to the identifier.
+	 * @return	True if the representation is valid.
+	 */
+	static bool dedup_id_parse(const char *hex, uint8_t id[A_DEDUP_ID_SIZE]);
+#endif /* __A_DEDUP_PRIVATE__ */
+
@@ -0,0 +1,378 @@
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "yansi.h"
+#include "ymemory.h"
+
+#define __A_ENCRYPT_PRIVATE__
+#include "encrypt.h"
+
+/** @const A_CRYPT_CHUNK_SIZE	Size of the chunks written by the agent. */
+#define A_CRYPT_CHUNK_SIZE	((size_t)1 << A_CRYPT_CHUNK_LOG2)
+
+/* Decrypt an archive encrypted by the agent. */
+void exec_decrypt(agent_t *agent, const char *in_path, const char *out_path) {
+	ystatus_t status;
+
+	if (ys_empty(agent->conf.crypt_pwd)) {
+		printf(YANSI_RED "No encryption password defined.\n" YANSI_RESET);
+		exit(2);
+	}
+	printf("‣ Decrypt '" YANSI_PURPLE "%s" YANSI_RESET "' to '" YANSI_PURPLE "%s" YANSI_RESET "'... ",
+	       in_path, out_path);
+	fflush(stdout);
+	status = decrypt_file(agent->conf.crypt_pwd, in_path, out_path);
+	if (status != YENOERR) {
+		printf(
+			YANSI_RED "failed\n\n" YANSI_RESET
+			YANSI_FAINT "  %s\n\n" YANSI_RESET
+			YANSI_RED "Abort.\n" YANSI_RESET,
+			(status == YEBADMSG) ? "The file is not an archive encrypted by the agent." :
+			(status == YEACCES) ? "Wrong password, or the file has been modified." :
+			(status == YENOMEM) ? "Memory allocation error." :
+			"Unable to read the encrypted file or to write the decrypted file."
+		);
+		exit(2);
+	}
+	printf(YANSI_GREEN "done\n" YANSI_RESET);
+}
+/* Derive a master key from a password, with a random salt. */
+encrypt_key_t *encrypt_key_new(const char *password) {
+	encrypt_key_t *key = malloc0(sizeof(encrypt_key_t));
+
+	if (!key)
+		return (NULL);
+	if (ycrypt_random(key->salt, sizeof(key->salt)) != YENOERR) {
+		free0(key);
+		return (NULL);
+	}
+	key->iterations = A_CRYPT_PBKDF2_ITERATIONS;
+	ycrypt_pbkdf2_sha512(password, strlen(password), key->salt, sizeof(key->salt),
+	                     key->iterations, key->key, sizeof(key->key));
+	return (key);
+}
+/* Erase and free a master key. */
+void encrypt_key_free(encrypt_key_t *key) {
+	if (!key)
+		return;
+	ycrypt_wipe(key, sizeof(encrypt_key_t));
+	free0(key);
+}
+/* Read a master key from a cache file. */
+encrypt_key_t *encrypt_key_load(const char *path, const char *password, time_t ttl) {
+	uint8_t buffer[A_CRYPT_KEY_FILE_SIZE];
+	uint8_t check[A_CRYPT_KEY_CHECK_SIZE];
+	encrypt_key_t *key = NULL;
+	struct stat st;
+	uint8_t diff = 0;
+	ssize_t len = 0;
+	time_t now = time(NULL);
+	int fd;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+		return (NULL);
+	// the file must be recent, and readable by its owner only
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode) || (st.st_mode & 077) || st.st_uid != geteuid() ||
+	    st.st_mtime > now || (now - st.st_mtime) >= ttl ||
+	    (len = read(fd, buffer, sizeof(buffer))) != (ssize_t)sizeof(buffer) ||
+	    memcmp(buffer, A_CRYPT_KEY_MAGIC, A_CRYPT_MAGIC_SIZE) ||
+	    !(key = malloc0(sizeof(encrypt_key_t))))
+		goto cleanup;
+	key->iterations = ((uint32_t)buffer[8] << 24) | ((uint32_t)buffer[9] << 16) |
+	                  ((uint32_t)buffer[10] << 8) | (uint32_t)buffer[11];
+	memcpy(key->salt, buffer + 12, A_CRYPT_SALT_SIZE);
+	memcpy(key->key, buffer + 12 + A_CRYPT_SALT_SIZE, YCRYPT_KEY_SIZE);
+	// the key must have been derived from the current password
+	encrypt_key_check(key, password, check);
+	for (size_t i = 0; i < A_CRYPT_KEY_CHECK_SIZE; ++i)
+		diff |= check[i] ^ buffer[12 + A_CRYPT_SALT_SIZE + YCRYPT_KEY_SIZE + i];
+	if (diff || key->iterations != A_CRYPT_PBKDF2_ITERATIONS) {
+		encrypt_key_free(key);
+		key = NULL;
+	}
+cleanup:
+	close(fd);
+	ycrypt_wipe(buffer, sizeof(buffer));
+	return (key);
+}
+/* Write a master key to a cache file. */
+ystatus_t encrypt_key_save(const encrypt_key_t *key, const char *path, const char *password) {
+	uint8_t buffer[A_CRYPT_KEY_FILE_SIZE];
+	ystatus_t status = YEIO;
+	ystr_t tmp_path;
+	int fd;
+
+	if (!(tmp_path = ys_printf(NULL, "%s.%d", path, (int)getpid())))
+		return (YENOMEM);
+	memcpy(buffer, A_CRYPT_KEY_MAGIC, A_CRYPT_MAGIC_SIZE);
+	buffer[8] = (uint8_t)(key->iterations >> 24);
+	buffer[9] = (uint8_t)(key->iterations >> 16);
+	buffer[10] = (uint8_t)(key->iterations >> 8);
+	buffer[11] = (uint8_t)key->iterations;
+	memcpy(buffer + 12, key->salt, A_CRYPT_SALT_SIZE);
+	memcpy(buffer + 12 + A_CRYPT_SALT_SIZE, key->key, YCRYPT_KEY_SIZE);
+	encrypt_key_check(key, password, buffer + 12 + A_CRYPT_SALT_SIZE + YCRYPT_KEY_SIZE);
+	// written in a temporary file, so a concurrent execution never reads a partial file
+	if ((fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) != -1) {
+		if (write(fd, buffer, sizeof(buffer)) == (ssize_t)sizeof(buffer))
+			status = YENOERR;
+		if (close(fd) || (status == YENOERR && rename(tmp_path, path)))
+			status = YEIO;
+		if (status != YENOERR)
+			unlink(tmp_path);
+	}
+	ycrypt_wipe(buffer, sizeof(buffer));
+	ys_free(tmp_path);
+	return (status);
+}
+/* Start an encrypted file, and write its header. */
+ystatus_t encrypt_stream_open(encrypt_stream_t *stream, const encrypt_key_t *key, FILE *file,
+                              yhash_sha512_t *sha512) {
+	memset(stream, 0, sizeof(encrypt_stream_t));
+	stream->file = file;
+	return (encrypt_stream_start(stream, key, sha512));
+}
+/* Start an encrypted stream whose output is given to a function. */
+ystatus_t encrypt_stream_open_func(encrypt_stream_t *stream, const encrypt_key_t *key,
+                                   yexec_output_function_t out_func, void *out_data, yhash_sha512_t *sha512) {
+	memset(stream, 0, sizeof(encrypt_stream_t));
+	stream->out_func = out_func;
+	stream->out_data = out_data;
+	return (encrypt_stream_start(stream, key, sha512));
+}
+/* Initialize an encrypted stream, and write its header. */
+static ystatus_t encrypt_stream_start(encrypt_stream_t *stream, const encrypt_key_t *key, yhash_sha512_t *sha512) {
+	uint8_t *header = stream->header;
+
+	stream->sha512 = sha512;
+	if (!(stream->buffer = malloc0(A_CRYPT_CHUNK_SIZE + YCRYPT_TAG_SIZE)))
+		return (stream->status = YENOMEM);
+	// header
+	memcpy(header, A_CRYPT_MAGIC, A_CRYPT_MAGIC_SIZE);
+	header[8] = A_CRYPT_VERSION;
+	header[9] = A_CRYPT_ALGO_CHACHA20_POLY1305;
+	header[10] = A_CRYPT_CHUNK_LOG2;
+	header[11] = 0;
+	header[12] = (uint8_t)(key->iterations >> 24);
+	header[13] = (uint8_t)(key->iterations >> 16);
+	header[14] = (uint8_t)(key->iterations >> 8);
+	header[15] = (uint8_t)key->iterations;
+	memcpy(header + 16, key->salt, A_CRYPT_SALT_SIZE);
+	if (ycrypt_random(header + 32, A_CRYPT_FILE_ID_SIZE) != YENOERR)
+		return (stream->status = YEIO);
+	// file key
+	encrypt_file_key(key->key, header + 32, stream->key);
+	encrypt_stream_output(stream, header, A_CRYPT_HEADER_SIZE);
+	return (stream->status);
+}
+/* Encrypt data and write it. */
+void encrypt_stream_write(const void *data, size_t len, void *user_data) {
+	encrypt_stream_t *stream = user_data;
+	const uint8_t *ptr = data;
+
+	while (len && stream->status == YENOERR) {
+		// a full chunk is written only when more data is coming, because
+		// the last chunk must be smaller than the chunk size
+		if (stream->len == A_CRYPT_CHUNK_SIZE)
+			encrypt_stream_flush(stream, false);
+		size_t n = A_CRYPT_CHUNK_SIZE - stream->len;
+		if (n > len)
+			n = len;
+		memcpy(stream->buffer + stream->len, ptr, n);
+		stream->len += n;
+		ptr += n;
+		len -= n;
+	}
+}
+/* Write the last chunk of an encrypted file, and free the stream's resources. */
+ystatus_t encrypt_stream_close(encrypt_stream_t *stream) {
+	ystatus_t status;
+
+	if (stream->status == YENOERR) {
+		if (stream->len == A_CRYPT_CHUNK_SIZE)
+			encrypt_stream_flush(stream, false);
+		encrypt_stream_flush(stream, true);
+	}
+	if (stream->status == YENOERR && stream->file && fflush(stream->file))
+		stream->status = YEIO;
+	status = stream->status;
+	if (stream->buffer) {
+		ycrypt_wipe(stream->buffer, A_CRYPT_CHUNK_SIZE + YCRYPT_TAG_SIZE);
+		free0(stream->buffer);
+	}
+	ycrypt_wipe(stream->key, sizeof(stream->key));
+	return (status);
+}
+/* Encrypt a file. */
+ystatus_t encrypt_file(const encrypt_key_t *key, const char *in_path, const char *out_path) {
+	ystatus_t status = YENOERR;
+	encrypt_stream_t stream;
+	FILE *in = NULL, *out = NULL;
+	uint8_t *buffer = NULL;
+	size_t len;
+
+	if (!(in = fopen(in_path, "r")) || !(out = fopen(out_path, "w"))) {
+		status = YEIO;
+		goto cleanup;
+	}
+	if (!(buffer = malloc0(A_CRYPT_CHUNK_SIZE))) {
+		status = YENOMEM;
+		goto cleanup;
+	}
+	if (encrypt_stream_open(&stream, key, out, NULL) == YENOERR) {
+		while ((len = fread(buffer, 1, A_CRYPT_CHUNK_SIZE, in)) > 0)
+			encrypt_stream_write(buffer, len, &stream);
+		if (ferror(in) && stream.status == YENOERR)
+			stream.status = YEIO;
+	}
+	status = encrypt_stream_close(&stream);
+cleanup:
+	free0(buffer);
+	if (in)
+		fclose(in);
+	if (out && fclose(out) && status == YENOERR)
+		status = YEIO;
+	if (status != YENOERR && out)
+		unlink(out_path);
+	return (status);
+}
+/* Decrypt a file. */
+ystatus_t decrypt_file(const char *password, const char *in_path, const char *out_path) {
+	ystatus_t status = YENOERR;
+	FILE *in = NULL, *out = NULL;
+	uint8_t header[A_CRYPT_HEADER_SIZE];
+	uint8_t master[YCRYPT_KEY_SIZE];
+	uint8_t key[YCRYPT_KEY_SIZE];
+	uint8_t nonce[YCRYPT_NONCE_SIZE];
+	uint8_t *buffer = NULL;
+	size_t chunk_size = 0, len;
+	uint32_t iterations;
+	uint64_t counter = 0;
+	bool last = false;
+
+	if (!(in = fopen(in_path, "r"))) {
+		status = YEIO;
+		goto cleanup;
+	}
+	// check the header
+	if (fread(header, 1, A_CRYPT_HEADER_SIZE, in) != A_CRYPT_HEADER_SIZE ||
+	    memcmp(header, A_CRYPT_MAGIC, A_CRYPT_MAGIC_SIZE) ||
+	    header[8] != A_CRYPT_VERSION ||
+	    header[9] != A_CRYPT_ALGO_CHACHA20_POLY1305 ||
+	    header[10] < 10 || header[10] > A_CRYPT_CHUNK_LOG2_MAX) {
+		status = YEBADMSG;
+		goto cleanup;
+	}
+	iterations = ((uint32_t)header[12] << 24) | ((uint32_t)header[13] << 16) |
+	             ((uint32_t)header[14] << 8) | (uint32_t)header[15];
+	if (!iterations || iterations > A_CRYPT_PBKDF2_MAX_ITERATIONS) {
+		status = YEBADMSG;
+		goto cleanup;
+	}
+	chunk_size = (size_t)1 << header[10];
+	if (!(buffer = malloc0(chunk_size + YCRYPT_TAG_SIZE))) {
+		status = YENOMEM;
+		goto cleanup;
+	}
+	if (!(out = fopen(out_path, "w"))) {
+		status = YEIO;
+		goto cleanup;
+	}
+	// keys
+	ycrypt_pbkdf2_sha512(password, strlen(password), header + 16, A_CRYPT_SALT_SIZE,
+	                     iterations, master, sizeof(master));
+	encrypt_file_key(master, header + 32, key);
+	// chunks (a full chunk is never the last one)
+	while (!last) {
+		len = fread(buffer, 1, chunk_size + YCRYPT_TAG_SIZE, in);
+		if (ferror(in)) {
+			status = YEIO;
+			goto cleanup;
+		}
+		if (len < YCRYPT_TAG_SIZE) {
+			// truncated file
+			status = YEACCES;
+			goto cleanup;
+		}
+		last = (len < chunk_size + YCRYPT_TAG_SIZE);
+		len -= YCRYPT_TAG_SIZE;
+		encrypt_nonce(counter++, last, nonce);
+		if (ycrypt_aead_decrypt(key, nonce, header, A_CRYPT_HEADER_SIZE, buffer, len,
+		                        buffer + len, buffer) != YENOERR) {
+			status = YEACCES;
+			goto cleanup;
+		}
+		if (len && fwrite(buffer, 1, len, out) != len) {
+			status = YEIO;
+			goto cleanup;
+		}
+	}
+cleanup:
+	ycrypt_wipe(master, sizeof(master));
+	ycrypt_wipe(key, sizeof(key));
+	if (buffer) {
+		ycrypt_wipe(buffer, chunk_size + YCRYPT_TAG_SIZE);
+		free0(buffer);
+	}
+	if (in)
+		fclose(in);
+	if (out && fclose(out) && status == YENOERR)
+		status = YEIO;
+	if (status != YENOERR && out)
+		unlink(out_path);
+	return (status);
+}
+
+/* ********** PRIVATE FUNCTIONS ********** */
+
+/* Compute the password check of a key cache file. */
+static void encrypt_key_check(const encrypt_key_t *key, const char *password,
+                              uint8_t check[A_CRYPT_KEY_CHECK_SIZE]) {
+	uint8_t mac[YCRYPT_HMAC_SIZE];
+
+	ycrypt_hmac_sha512(key->key, YCRYPT_KEY_SIZE, password, strlen(password), mac);
+	memcpy(check, mac, A_CRYPT_KEY_CHECK_SIZE);
+	ycrypt_wipe(mac, sizeof(mac));
+}
+/* Compute the key of a file, from the master key and the file identifier. */
+static void encrypt_file_key(const uint8_t master[YCRYPT_KEY_SIZE],
+                             const uint8_t file_id[A_CRYPT_FILE_ID_SIZE],
+                             uint8_t key[YCRYPT_KEY_SIZE]) {
+	uint8_t mac[YCRYPT_HMAC_SIZE];
+
+	ycrypt_hmac_sha512(master, YCRYPT_KEY_SIZE, file_id, A_CRYPT_FILE_ID_SIZE, mac);
+	memcpy(key, mac, YCRYPT_KEY_SIZE);
+	ycrypt_wipe(mac, sizeof(mac));
+}
+/* Compute the nonce of a chunk. */
+static void encrypt_nonce(uint64_t counter, bool last, uint8_t nonce[YCRYPT_NONCE_SIZE]) {
+	for (int i = 7; i >= 0; --i) {
+		nonce[i] = (uint8_t)counter;
+		counter >>= 8;
+	}
+	nonce[8] = nonce[9] = nonce[10] = 0;
+	nonce[11] = last ? 1 : 0;
+}
+/* Write raw data to an encrypted file, and add it to the checksum computation. */
+static void encrypt_stream_output(encrypt_stream_t *stream, const void *data, size_t len) {
+	if (!stream->file) {
+		stream->out_func(data, len, stream->out_data);
+	} else if (fwrite(data, 1, len, stream->file) != len) {
+		stream->status = YEIO;
+		return;
+	}
+	if (stream->sha512)
+		yhash_sha512_update(stream->sha512, data, len);
+}
+/* Encrypt and write the current chunk. */
+static void encrypt_stream_flush(encrypt_stream_t *stream, bool last) {
+	uint8_t nonce[YCRYPT_NONCE_SIZE];
+
+	encrypt_nonce(stream->counter++, last, nonce);
+	ycrypt_aead_encrypt(stream->key, nonce, stream->header, A_CRYPT_HEADER_SIZE,
+	                    stream->buffer, stream->len, stream->buffer, stream->buffer + stream->len);
+	encrypt_stream_output(stream, stream->buffer, stream->len + YCRYPT_TAG_SIZE);
+	stream->len = 0;
+}
+
@@ -0,0 +1,280 @@
+/**
+ * @header	encrypt.h
+ * @abstract	Native encryption of archives.
+ * @discussion	Archives are encrypted in-process using ChaCha20-Poly1305, by
+ *		chunks of 64 KiB. They are encrypted and decrypted in a single
+ *		streaming pass, without any temporary file or sub-program.
+ *
+ *		File format (integers are big-endian):
+ *		  Header (48 bytes)
+ *		    offset  0, 8 bytes: magic string "ARKIVENC"
+ *		    offset  8, 1 byte:  format version (1)
+ *		    offset  9, 1 byte:  algorithm (1 = ChaCha20-Poly1305)
+ *		    offset 10, 1 byte:  base-2 logarithm of the chunk size (16)
+ *		    offset 11, 1 byte:  reserved (0)
+ *		    offset 12, 4 bytes: number of PBKDF2 iterations
+ *		    offset 16, 16 bytes: PBKDF2 salt
+ *		    offset 32, 16 bytes: file identifier (random)
+ *		  Chunks
+ *		    Encrypted data (chunk size, or less for the last chunk),
+ *		    followed by the 16 bytes Poly1305 tag.
+ *
+ *		Keys:
+ *		  master key = PBKDF2-HMAC-SHA512(password, salt, iterations)
+ *		  file key   = HMAC-SHA512(master key, file identifier)
+ *		Both keys are truncated to 32 bytes. The master key is derived
+ *		once per execution, and its salt is shared by all the archives
+ *		of the execution. Each archive is encrypted with its own key.
+ *
+ *		Each chunk is authenticated with the header as additional data.
+ *		Its nonce is the index of the chunk (8 bytes), followed by three
+ *		zeros and a flag set to 1 for the last chunk. The last chunk is
+ *		always smaller than the chunk size (it may be empty), so a
+ *		truncated file can't be authenticated.
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ */
+#pragma once
+
+#include <stdio.h>
+#include <time.h>
+#include "ystatus.h"
+#include "yhash.h"
+#include "ycrypt.h"
+#include "yexec.h"
+#include "agent.h"
+
+/** @const A_CRYPT_MAGIC		Magic string at the beginning of encrypted files. */
+#define A_CRYPT_MAGIC			"ARKIVENC"
+/** @const A_CRYPT_MAGIC_SIZE		Size of the magic string. */
+#define A_CRYPT_MAGIC_SIZE		8
+/** @const A_CRYPT_VERSION		Version of the file format. */
+#define A_CRYPT_VERSION			1
+/** @const A_CRYPT_ALGO_CHACHA20_POLY1305	Identifier of the ChaCha20-Poly1305 algorithm. */
+#define A_CRYPT_ALGO_CHACHA20_POLY1305	1
+/** @const A_CRYPT_CHUNK_LOG2		Base-2 logarithm of the chunk size. */
+#define A_CRYPT_CHUNK_LOG2		16
+/** @const A_CRYPT_CHUNK_LOG2_MAX	Maximum accepted chunk size logarithm, when decrypting. */
+#define A_CRYPT_CHUNK_LOG2_MAX		24
+/** @const A_CRYPT_SALT_SIZE		Size of the PBKDF2 salt. */
+#define A_CRYPT_SALT_SIZE		16
+/** @const A_CRYPT_FILE_ID_SIZE		Size of the file identifier. */
+#define A_CRYPT_FILE_ID_SIZE		16
+/** @const A_CRYPT_HEADER_SIZE		Size of the file header. */
+#define A_CRYPT_HEADER_SIZE		48
+/** @const A_CRYPT_PBKDF2_ITERATIONS	Number of PBKDF2 iterations (OWASP recommendation for HMAC-SHA512). */
+#define A_CRYPT_PBKDF2_ITERATIONS	210000
+/** @const A_CRYPT_PBKDF2_MAX_ITERATIONS	Maximum accepted number of PBKDF2 iterations, when decrypting. */
+#define A_CRYPT_PBKDF2_MAX_ITERATIONS	100000000
+/** @const A_CRYPT_KEY_MAGIC		Magic string at the beginning of the key cache files. */
+#define A_CRYPT_KEY_MAGIC		"ARKIVKEY"
+/** @const A_CRYPT_KEY_CHECK_SIZE	Size of the password check of the key cache files. */
+#define A_CRYPT_KEY_CHECK_SIZE		32
+/** @const A_CRYPT_KEY_FILE_SIZE	Size of the key cache files (magic, iterations, salt, key, check). */
+#define A_CRYPT_KEY_FILE_SIZE		(A_CRYPT_MAGIC_SIZE + 4 + A_CRYPT_SALT_SIZE + YCRYPT_KEY_SIZE + \
+					 A_CRYPT_KEY_CHECK_SIZE)
+
+/**
+ * @typedef	encrypt_key_t
+ * @abstract	Master key, derived once per execution.
+ * @field	key		Master key.
+ * @field	salt		Salt used to derive the key.
+ * @field	iterations	Number of PBKDF2 iterations.
+ */
+typedef struct encrypt_key_s {
+	uint8_t key[YCRYPT_KEY_SIZE];
+	uint8_t salt[A_CRYPT_SALT_SIZE];
+	uint32_t iterations;
+} encrypt_key_t;
+
+/**
+ * @typedef	encrypt_stream_t
+ * @abstract	Encrypted file being written.
+ * @field	header		File header, used as additional data of each chunk.
+ * @field	key		File key.
+ * @field	counter		Index of the next chunk.
+ * @field	buffer		Current chunk (with room for its tag).
+ * @field	len		Size of the data in the current chunk.
+ * @field	file		Output file (NULL if the data are given to a function).
+ * @field	out_func	Function called with the written data (if there is no output file).
+ * @field	out_data	Pointer given to the output function.
+ * @field	sha512		Pointer to the checksum computation of the written data (could be NULL).
+ * @field	status		Status of the first error.
+ */
+typedef struct {
+	uint8_t header[A_CRYPT_HEADER_SIZE];
+	uint8_t key[YCRYPT_KEY_SIZE];
+	uint64_t counter;
+	uint8_t *buffer;
+	size_t len;
+	FILE *file;
+	yexec_output_function_t out_func;
+	void *out_data;
+	yhash_sha512_t *sha512;
+	ystatus_t status;
+} encrypt_stream_t;
+
+/**
+ * @function	exec_decrypt
+ * @abstract	Decrypt an archive encrypted by the agent, using the password
+ *		of the configuration.
+ * @param	agent		Pointer to the agent structure.
+ * @param	in_path		Path to the encrypted file.
+ * @param	out_path	Path to the decrypted file.
+ */
+void exec_decrypt(agent_t *agent, const char *in_path, const char *out_path);
+/**
+ * @function	encrypt_key_new
+ * @abstract	Derive a master key from a password, with a random salt.
+ * @param	password	The password.
+ * @return	A pointer to the allocated key, or NULL if an error occurred.
+ */
+encrypt_key_t *encrypt_key_new(const char *password);
+/**
+ * @function	encrypt_key_free
+ * @abstract	Erase and free a master key.
+ * @param	key	Pointer to the key (could be NULL).
+ */
+void encrypt_key_free(encrypt_key_t *key);
+/**
+ * @function	encrypt_key_load
+ * @abstract	Read a master key from a cache file, to avoid its derivation.
+ * @discussion	The file contains the magic string, the number of iterations
+ *		(4 bytes, big-endian), the salt, the key, and the first 32 bytes
+ *		of HMAC-SHA512(key, password). The key is not used if the
+ *		password changed, or if the file is older than the given duration.
+ * @param	path		Path to the cache file.
+ * @param	password	The password.
+ * @param	ttl		Maximum age of the file, in seconds.
+ * @return	A pointer to the allocated key, or NULL if the file can't be used.
+ */
+encrypt_key_t *encrypt_key_load(const char *path, const char *password, time_t ttl);
+/**
+ * @function	encrypt_key_save
+ * @abstract	Write a master key to a cache file, readable by its owner only.
+ *		The file is replaced atomically.
+ * @param	key		Pointer to the master key.
+ * @param	path		Path to the cache file.
+ * @param	password	The password.
+ * @return	YENOERR if OK.
+ */
+ystatus_t encrypt_key_save(const encrypt_key_t *key, const char *path, const char *password);
+/**
+ * @function	encrypt_stream_open
+ * @abstract	Start an encrypted file, and write its header.
+ * @param	stream	Pointer to the stream structure.
+ * @param	key	Pointer to the master key.
+ * @param	file	Output file.
+ * @param	sha512	Pointer to a checksum computation updated with the written data (could be NULL).
+ * @return	YENOERR if OK.
+ */
+ystatus_t encrypt_stream_open(encrypt_stream_t *stream, const encrypt_key_t *key, FILE *file,
+                              yhash_sha512_t *sha512);
+/**
+ * @function	encrypt_stream_open_func
+ * @abstract	Start an encrypted stream whose output is given to a function.
+ *		Errors of the function must be managed by the caller.
+ * @param	stream		Pointer to the stream structure.
+ * @param	key		Pointer to the master key.
+ * @param	out_func	Function called with the encrypted data.
+ * @param	out_data	Pointer given to the function.
+ * @param	sha512		Pointer to a checksum computation updated with the written data (could be NULL).
+ * @return	YENOERR if OK.
+ */
+ystatus_t encrypt_stream_open_func(encrypt_stream_t *stream, const encrypt_key_t *key,
+                                   yexec_output_function_t out_func, void *out_data, yhash_sha512_t *sha512);
+/**
+ * @function	encrypt_stream_write
+ * @abstract	Encrypt data and write it. Could be used as an output function
+ *		of yexec_pipeline(). Errors are stored in the stream structure.
+ * @param	data		Pointer to the data.
+ * @param	len		Size of the data.
+ * @param	user_data	Pointer to the stream structure.
+ */
+void encrypt_stream_write(const void *data, size_t len, void *user_data);
+/**
+ * @function	encrypt_stream_close
+ * @abstract	Write the last chunk of an encrypted file, and free the stream's
+ *		resources. Must be called even if an error occurred. The file
+ *		is not closed.
+ * @param	stream	Pointer to the stream structure.
+ * @return	YENOERR if the whole file was written successfully.
+ */
+ystatus_t encrypt_stream_close(encrypt_stream_t *stream);
+/**
+ * @function	encrypt_file
+ * @abstract	Encrypt a file.
+ * @param	key		Pointer to the master key.
+ * @param	in_path		Path to the file to encrypt.
+ * @param	out_path	Path to the encrypted file.
+ * @return	YENOERR if OK.
+ */
+ystatus_t encrypt_file(const encrypt_key_t *key, const char *in_path, const char *out_path);
+/**
+ * @function	decrypt_file
+ * @abstract	Decrypt a file. The output file is removed if the input file
+ *		can't be authenticated.
+ * @param	password	The password.
+ * @param	in_path		Path to the encrypted file.
+ * @param	out_path	Path to the decrypted file.
+ * @return	YENOERR if OK, YEBADMSG if the file is not an encrypted archive,
+ *		YEACCES if the password is wrong or the file was modified.
+ */
+ystatus_t decrypt_file(const char *password, const char *in_path, const char *out_path);
+
+/* ********** PRIVATE DECLARATIONS ********** */
+#ifdef __A_ENCRYPT_PRIVATE__
+	/**
+	 * @function	encrypt_stream_start
+	 * @abstract	Initialize an encrypted stream (whose output is already set),
+	 *		derive its key and write its header.
+	 * @param	stream	Pointer to the stream structure.
+	 * @param	key	Pointer to the master key.
+	 * @param	sha512	Pointer to a checksum computation updated with the written data (could be NULL).
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t encrypt_stream_start(encrypt_stream_t *stream, const encrypt_key_t *key,
+	                                      yhash_sha512_t *sha512);
+	/**
+	 * @function	encrypt_file_key
+	 * @abstract	Compute the key of a file, from the master key and the file identifier.
+	 * @param	master		Pointer to the master key.
+	 * @param	file_id		Pointer to the file identifier.
+	 * @param	key		Pointer to the output buffer.
+	 */
+	static void encrypt_file_key(const uint8_t master[YCRYPT_KEY_SIZE],
+	                             const uint8_t file_id[A_CRYPT_FILE_ID_SIZE],
+	                             uint8_t key[YCRYPT_KEY_SIZE]);
+	/**
+	 * @function	encrypt_nonce
+	 * @abstract	Compute the nonce of a chunk.
+	 * @param	counter	Index of the chunk.
+	 * @param	last	True for the last chunk.
+	 * @param	nonce	Pointer to the output buffer.
+	 */
+	static void encrypt_nonce(uint64_t counter, bool last, uint8_t nonce[YCRYPT_NONCE_SIZE]);
+	/**
+	 * @function	encrypt_stream_output
+	 * @abstract	Write raw data to an encrypted file, and add it to the checksum computation.
+	 * @param	stream	Pointer to the stream structure.
+	 * @param	data	Pointer to the data.
+	 * @param	len	Size of the data.
+	 */
+	static void encrypt_stream_output(encrypt_stream_t *stream, const void *data, size_t len);
+	/**
+	 * @function	encrypt_stream_flush
+	 * @abstract	Encrypt and write the current chunk.
+	 * @param	stream	Pointer to the stream structure.
+	 * @param	last	True for the last chunk.
+	 */
+	static void encrypt_stream_flush(encrypt_stream_t *stream, bool last);
+	/**
+	 * @function	encrypt_key_check
+	 * @abstract	Compute the password check of a key cache file.
+	 * @param	key		Pointer to the master key.
+	 * @param	password	The password.
+	 * @param	check		Pointer to the output buffer.
+	 */
+	static void encrypt_key_check(const encrypt_key_t *key, const char *password,
+	                              uint8_t check[A_CRYPT_KEY_CHECK_SIZE]);
+#endif /* __A_ENCRYPT_PRIVATE__ */
+
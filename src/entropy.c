@@ -0,0 +1,225 @@
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "ymemory.h"
+#include "ystr.h"
+#include "yarray.h"
+
+#define __A_ENTROPY_PRIVATE__
+#include "entropy.h"
+
+/* Estimate the entropy of a file, from blocks spread over it. */
+entropy_t entropy_file(const char *path) {
+	entropy_t result = {.entropy = -1.0};
+	uint8_t *buffer = NULL;
+	struct stat st;
+	int fd = -1;
+	double sum = 0.0;
+	uint64_t total = 0;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0 || fstat(fd, &st) ||
+	    !(buffer = malloc0(A_ENTROPY_BLOCK_SIZE)))
+		goto cleanup;
+	result.data_size = (uint64_t)st.st_size;
+	result.complete = true;
+	for (uint64_t i = 0; i < A_ENTROPY_FILE_SAMPLES; ++i) {
+		uint64_t offset;
+		size_t len = 0;
+		double entropy;
+
+		// small files are read entirely, big files at regularly spaced offsets
+		if (result.data_size <= (uint64_t)A_ENTROPY_FILE_SAMPLES * A_ENTROPY_BLOCK_SIZE)
+			offset = i * A_ENTROPY_BLOCK_SIZE;
+		else
+			offset = i * ((result.data_size - A_ENTROPY_BLOCK_SIZE) / (A_ENTROPY_FILE_SAMPLES - 1));
+		if (offset >= result.data_size)
+			break;
+		entropy = entropy_read(fd, offset, buffer, &len);
+		if (!len)
+			break;
+		sum += entropy * (double)len;
+		total += len;
+	}
+	if (total)
+		result.entropy = sum / (double)total;
+cleanup:
+	if (fd >= 0)
+		close(fd);
+	free0(buffer);
+	return (result);
+}
+/* Estimate the entropy of a file or a directory tree. */
+entropy_t entropy_path(const char *path) {
+	entropy_t result = {.entropy = -1.0};
+	entropy_walk_t *walk = NULL;
+	struct stat st;
+
+	if (lstat(path, &st))
+		return (result);
+	if (S_ISREG(st.st_mode))
+		return (entropy_file(path));
+	if (!S_ISDIR(st.st_mode) || !(walk = malloc0(sizeof(entropy_walk_t))) ||
+	    !(walk->buffer = malloc0(A_ENTROPY_BLOCK_SIZE))) {
+		free0(walk);
+		result.complete = S_ISDIR(st.st_mode) ? false : true;
+		return (result);
+	}
+	// fixed seed, the same tree gives the same estimation
+	walk->random = 0x9e3779b97f4a7c15ULL;
+	entropy_walk(walk, path);
+	result.entropy = entropy_sample(walk);
+	result.data_size = walk->data_size;
+	result.complete = !walk->truncated;
+	free0(walk->buffer);
+	free0(walk);
+	return (result);
+}
+
+/* ********** PRIVATE FUNCTIONS ********** */
+
+/* Compute the entropy of a block of data. */
+static double entropy_block(const uint8_t *data, size_t len) {
+	uint32_t counts[256] = {0};
+	double entropy = 0.0;
+
+	if (!len)
+		return (0.0);
+	for (size_t i = 0; i < len; ++i)
+		counts[data[i]]++;
+	for (size_t i = 0; i < 256; ++i) {
+		if (!counts[i])
+			continue;
+		double p = (double)counts[i] / (double)len;
+		entropy -= p * log2(p);
+	}
+	return (entropy);
+}
+/* Read a block of a file, and compute its entropy. */
+static double entropy_read(int fd, uint64_t offset, uint8_t *buffer, size_t *len) {
+	ssize_t nread;
+
+	*len = 0;
+	while (*len < A_ENTROPY_BLOCK_SIZE) {
+		nread = pread(fd, buffer + *len, A_ENTROPY_BLOCK_SIZE - *len, (off_t)(offset + *len));
+		if (nread == -1 && errno == EINTR)
+			continue;
+		if (nread <= 0)
+			break;
+		*len += (size_t)nread;
+	}
+	return (entropy_block(buffer, *len));
+}
+/* Sample the files of a directory, and walk its subdirectories. */
+static void entropy_walk(entropy_walk_t *walk, const char *path) {
+	DIR *dir;
+	struct dirent *entry;
+	struct stat st;
+	yarray_t subdirs = NULL;
+	ystr_t child;
+
+	if (!(dir = opendir(path)))
+		return;
+	// subdirectories are walked once the directory is closed, to limit the number of open descriptors
+	while ((entry = readdir(dir))) {
+		if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+			continue;
+		if (walk->nbr_entries >= A_ENTROPY_MAX_ENTRIES) {
+			walk->truncated = true;
+			break;
+		}
+		walk->nbr_entries++;
+		if (!(child = ys_printf(NULL, "%s/%s", path, entry->d_name)))
+			continue;
+		if (lstat(child, &st)) {
+			ys_free(child);
+			continue;
+		}
+		if (S_ISREG(st.st_mode)) {
+			entropy_add_file(walk, child, (uint64_t)st.st_size);
+			continue;
+		} else if (S_ISDIR(st.st_mode) &&
+		           ((subdirs || (subdirs = yarray_create(8))) && yarray_push(&subdirs, child) == YENOERR)) {
+			continue;
+		}
+		ys_free(child);
+	}
+	closedir(dir);
+	for (size_t i = 0; i < yarray_length(subdirs); ++i) {
+		if (!walk->truncated)
+			entropy_walk(walk, subdirs[i]);
+		ys_free(subdirs[i]);
+	}
+	yarray_free(subdirs);
+}
+/* Add a file of a directory tree to the files to sample. */
+static void entropy_add_file(entropy_walk_t *walk, ystr_t path, uint64_t size) {
+	entropy_candidate_t *candidate;
+	double key;
+
+	walk->data_size += size;
+	if (!size) {
+		ys_free(path);
+		return;
+	}
+	// priority sampling: priority = size / u, with u uniform in ]0, 1]
+	walk->random ^= walk->random << 13;
+	walk->random ^= walk->random >> 7;
+	walk->random ^= walk->random << 17;
+	key = (double)size / ((double)((walk->random >> 11) + 1) / 9007199254740992.0);
+	if (walk->nbr_candidates < A_ENTROPY_MAX_FILES) {
+		candidate = &walk->candidates[walk->nbr_candidates++];
+	} else if (key > walk->candidates[walk->min_candidate].key) {
+		candidate = &walk->candidates[walk->min_candidate];
+		if (candidate->key > walk->threshold)
+			walk->threshold = candidate->key;
+		ys_free(candidate->path);
+	} else {
+		if (key > walk->threshold)
+			walk->threshold = key;
+		ys_free(path);
+		return;
+	}
+	candidate->path = path;
+	candidate->size = size;
+	candidate->key = key;
+	// the chosen file which would be replaced first
+	if (walk->nbr_candidates < A_ENTROPY_MAX_FILES)
+		return;
+	walk->min_candidate = 0;
+	for (size_t i = 1; i < walk->nbr_candidates; ++i) {
+		if (walk->candidates[i].key < walk->candidates[walk->min_candidate].key)
+			walk->min_candidate = i;
+	}
+}
+/* Sample the files chosen in a directory tree. */
+static double entropy_sample(entropy_walk_t *walk) {
+	double sum = 0.0, weight = 0.0, share;
+	size_t len = 0;
+	double entropy;
+	int fd;
+
+	for (size_t i = 0; i < walk->nbr_candidates; ++i) {
+		entropy_candidate_t *candidate = &walk->candidates[i];
+
+		// the middle of the file is sampled, its header may not be representative
+		if ((fd = open(candidate->path, O_RDONLY | O_CLOEXEC)) >= 0) {
+			entropy = entropy_read(fd, ((candidate->size > A_ENTROPY_BLOCK_SIZE) ?
+			                            ((candidate->size - A_ENTROPY_BLOCK_SIZE) / 2) : 0),
+			                       walk->buffer, &len);
+			close(fd);
+			// estimated size of the data represented by the file (its size if all the files were chosen)
+			share = ((double)candidate->size > walk->threshold) ? (double)candidate->size : walk->threshold;
+			if (len) {
+				sum += entropy * share;
+				weight += share;
+			}
+		}
+		ys_free(candidate->path);
+	}
+	walk->nbr_candidates = 0;
+	return ((weight > 0.0) ? (sum / weight) : -1.0);
+}
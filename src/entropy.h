@@ -0,0 +1,154 @@
+/**
+ * @header	entropy.h
+ * @abstract	Estimation of the compressibility of the data to back up.
+ * @discussion	Some blocks of the data are read, and the Shannon entropy of
+ *		their bytes is computed (in bits per byte, from 0 to 8). Text
+ *		and database dumps are usually under 5 bits per byte; already
+ *		compressed or encrypted data (JPEG, video, gzip'ed logs, ...)
+ *		are close to 8 bits per byte, and compressing them again is a
+ *		waste of CPU.
+ *
+ *		A file is sampled at regularly spaced offsets. A directory tree
+ *		is walked (up to a limited number of entries), and one block of
+ *		a limited number of its files is sampled. The sampled files are
+ *		spread over the whole tree (not the first ones in the order of
+ *		the directories): they are chosen by a priority sampling, with
+ *		probabilities proportional to their sizes, and their entropies
+ *		are weighted by their estimated share of the tree's data.
+ *
+ *		The estimation is done once per item, before it is archived, to
+ *		choose the compression level of the whole archive (the
+ *		compression program receives one stream, its level can't change
+ *		between the members of a tar archive).
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ystatus.h"
+#include "ystr.h"
+
+/** @const A_ENTROPY_BLOCK_SIZE	Size of a sampled block. */
+#define A_ENTROPY_BLOCK_SIZE		65536
+/** @const A_ENTROPY_FILE_SAMPLES	Number of blocks sampled in a file. */
+#define A_ENTROPY_FILE_SAMPLES		16
+/** @const A_ENTROPY_MAX_FILES	Maximum number of files sampled in a directory tree. */
+#define A_ENTROPY_MAX_FILES		256
+/** @const A_ENTROPY_MAX_ENTRIES	Maximum number of entries read in a directory tree. */
+#define A_ENTROPY_MAX_ENTRIES		65536
+/** @const A_ENTROPY_INCOMPRESSIBLE	Entropy (bits per byte) above which data are considered incompressible. */
+#define A_ENTROPY_INCOMPRESSIBLE	7.5
+
+/**
+ * @typedef	entropy_t
+ * @abstract	Result of an estimation.
+ * @field	entropy		Estimated entropy, in bits per byte (negative if no data
+ *				could be read).
+ * @field	data_size	Size of the data (0 if unknown).
+ * @field	complete	True if all the data were seen (data_size is exact).
+ */
+typedef struct {
+	double entropy;
+	uint64_t data_size;
+	bool complete;
+} entropy_t;
+
+/**
+ * @typedef	entropy_candidate_t
+ * @abstract	File chosen by the reservoir sampling of a directory tree.
+ * @field	path	Path to the file.
+ * @field	size	Size of the file.
+ * @field	key	Priority of the file (the files with the greatest priorities
+ *			are kept).
+ */
+typedef struct {
+	ystr_t path;
+	uint64_t size;
+	double key;
+} entropy_candidate_t;
+
+/**
+ * @typedef	entropy_walk_t
+ * @abstract	Directory tree being sampled.
+ * @field	buffer		Buffer of a sampled block.
+ * @field	candidates	Files chosen to be sampled.
+ * @field	nbr_candidates	Number of chosen files.
+ * @field	min_candidate	Index of the chosen file with the smallest priority.
+ * @field	threshold	Greatest priority of the files which were not chosen.
+ * @field	nbr_entries	Number of read entries.
+ * @field	random		State of the pseudo-random generator.
+ * @field	data_size	Size of the files.
+ * @field	truncated	True if the walk stopped before the end of the tree.
+ */
+typedef struct {
+	uint8_t *buffer;
+	entropy_candidate_t candidates[A_ENTROPY_MAX_FILES];
+	size_t nbr_candidates;
+	size_t min_candidate;
+	double threshold;
+	size_t nbr_entries;
+	uint64_t random;
+	uint64_t data_size;
+	bool truncated;
+} entropy_walk_t;
+
+/**
+ * @function	entropy_file
+ * @abstract	Estimate the entropy of a file.
+ * @param	path	Path to the file.
+ * @return	The estimation.
+ */
+entropy_t entropy_file(const char *path);
+/**
+ * @function	entropy_path
+ * @abstract	Estimate the entropy of a file or a directory tree.
+ * @param	path	Path to the file or directory.
+ * @return	The estimation.
+ */
+entropy_t entropy_path(const char *path);
+
+/* ********** PRIVATE DECLARATIONS ********** */
+#ifdef __A_ENTROPY_PRIVATE__
+	/**
+	 * @function	entropy_block
+	 * @abstract	Compute the entropy of a block of data.
+	 * @param	data	Pointer to the data.
+	 * @param	len	Size of the data.
+	 * @return	The entropy, in bits per byte.
+	 */
+	static double entropy_block(const uint8_t *data, size_t len);
+	/**
+	 * @function	entropy_read
+	 * @abstract	Read a block of a file, and compute its entropy.
+	 * @param	fd	File descriptor.
+	 * @param	offset	Offset of the block.
+	 * @param	buffer	Buffer of A_ENTROPY_BLOCK_SIZE bytes.
+	 * @param	len	Pointer to a variable set with the number of bytes read.
+	 * @return	The entropy of the block, in bits per byte.
+	 */
+	static double entropy_read(int fd, uint64_t offset, uint8_t *buffer, size_t *len);
+	/**
+	 * @function	entropy_walk
+	 * @abstract	Sample the files of a directory, and walk its subdirectories.
+	 * @param	walk	Pointer to the walk structure.
+	 * @param	path	Path to the directory.
+	 */
+	static void entropy_walk(entropy_walk_t *walk, const char *path);
+	/**
+	 * @function	entropy_add_file
+	 * @abstract	Add a file of a directory tree to the files to sample. A
+	 *		file is chosen with a probability proportional to its size.
+	 * @param	walk	Pointer to the walk structure.
+	 * @param	path	Path to the file. It is kept or freed.
+	 * @param	size	Size of the file.
+	 */
+	static void entropy_add_file(entropy_walk_t *walk, ystr_t path, uint64_t size);
+	/**
+	 * @function	entropy_sample
+	 * @abstract	Sample the files chosen in a directory tree, and free them.
+	 * @param	walk	Pointer to the walk structure.
+	 * @return	The estimated entropy (negative if no data could be read).
+	 */
+	static double entropy_sample(entropy_walk_t *walk);
+#endif /* __A_ENTROPY_PRIVATE__ */
@@ -0,0 +1,301 @@
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include "yansi.h"
+#include "ymemory.h"
+#include "yfile.h"
+#include "dedup.h"
+#include "volume.h"
+
+#define __A_JOURNAL_PRIVATE__
+#include "journal.h"
+
+/** @const A_JOURNAL_STAGES	Names of the stages, in the order of their bits. */
+static const char *A_JOURNAL_STAGES[] = {"dump", "compress", "encrypt", "checksum", "upload"};
+/** @const A_JOURNAL_NBR_STAGES	Number of stages. */
+#define A_JOURNAL_NBR_STAGES	(sizeof(A_JOURNAL_STAGES) / sizeof(A_JOURNAL_STAGES[0]))
+
+/* Open the journal of the current run, and read the stages completed by a previous execution. */
+journal_t *journal_open(agent_t *agent) {
+	journal_t *journal = NULL;
+	ystr_t content = NULL;
+
+	ALOG("Open run journal");
+	if (!(journal = malloc0(sizeof(journal_t))) ||
+	    !(journal->path = ys_printf(NULL, "%s/%s", agent->backup_path, A_JOURNAL_FILENAME)) ||
+	    !(journal->entries = ytable_create(0, journal_entry_free, NULL))) {
+		ALOG("└ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		goto error;
+	}
+	journal->fd = -1;
+	if ((journal->fd = open(journal->path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600)) < 0) {
+		ALOG("└ " YANSI_RED "Unable to open " YANSI_RESET "%s", journal->path);
+		goto error;
+	}
+	// another execution may be running for the same schedule slot
+	if (flock(journal->fd, LOCK_EX | LOCK_NB)) {
+		ALOG("└ " YANSI_YELLOW "Journal used by another execution, stages are not recorded" YANSI_RESET);
+		goto error;
+	}
+	// stages completed by a previous execution
+	if ((content = yfile_get_string_contents(journal->path)) && journal_load(journal, content) != YENOERR) {
+		ALOG("└ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		goto error;
+	}
+	ys_free(content);
+	if (ytable_length(journal->entries))
+		ALOG("├ " YANSI_YELLOW "Resume an interrupted run (" YANSI_RESET "%u" YANSI_YELLOW " items already processed)" YANSI_RESET,
+		     ytable_length(journal->entries));
+	ADEBUG("├ " YANSI_FAINT "Journal " YANSI_RESET "%s", journal->path);
+	pthread_mutex_init(&journal->mutex, NULL);
+	ALOG("└ " YANSI_GREEN "Done" YANSI_RESET);
+	return (journal);
+error:
+	ys_free(content);
+	if (journal) {
+		if (journal->fd >= 0)
+			close(journal->fd);
+		ytable_free(journal->entries);
+		ys_free(journal->path);
+		free0(journal);
+	}
+	return (NULL);
+}
+/* Close the journal, and free it. */
+void journal_close(journal_t *journal) {
+	if (!journal)
+		return;
+	close(journal->fd);
+	pthread_mutex_destroy(&journal->mutex);
+	ytable_free(journal->entries);
+	ys_free(journal->path);
+	free0(journal);
+}
+/* Tell if a run directory contains a journal. */
+bool journal_exists(const char *run_path) {
+	ystr_t path = ys_printf(NULL, "%s/%s", run_path, A_JOURNAL_FILENAME);
+	bool exists = (path && yfile_exists(path)) ? true : false;
+
+	ys_free(path);
+	return (exists);
+}
+/* Add the completed stages of an item to the journal. */
+void journal_write(agent_t *agent, log_item_t *item) {
+	journal_t *journal = agent->journal;
+	char names[64] = "";
+	ystr_t line = NULL;
+	uint8_t stages;
+
+	// unchanged paths have no archive
+	if (!journal || !item->success || item->unchanged ||
+	    !(stages = journal_stages(item)) || stages == item->stages)
+		return;
+	// a line can't contain tabulations nor new lines
+	if (strpbrk(item->item, "\t\n") || strpbrk(item->archive_name, "\t\n") ||
+	    (item->state_tmp && strpbrk(item->state_tmp, "\t\n")))
+		return;
+	for (size_t i = 0; i < A_JOURNAL_NBR_STAGES; ++i) {
+		if (!(stages & (1 << i)))
+			continue;
+		if (names[0])
+			strcat(names, ",");
+		strcat(names, A_JOURNAL_STAGES[i]);
+	}
+	if (!(line = ys_printf(NULL, "%s\t%d\t%u\t%" PRIu64 "\t%s\t%s\t%s\n", names, (int)item->type, item->level,
+	                       item->archive_size, item->archive_name, item->item,
+	                       (item->state_tmp ? item->state_tmp : ""))))
+		return;
+	// the line is written at once, and synced before the next stage starts
+	const char *ptr = line;
+	size_t len = ys_bytesize(line);
+	ssize_t written = 0;
+	pthread_mutex_lock(&journal->mutex);
+	while (len) {
+		written = write(journal->fd, ptr, len);
+		if (written == -1 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			break;
+		ptr += written;
+		len -= (size_t)written;
+	}
+	if (!len && !fsync(journal->fd))
+		item->stages = stages;
+	pthread_mutex_unlock(&journal->mutex);
+	ys_free(line);
+}
+/* Restore the state of an item from the journal. */
+bool journal_resume(agent_t *agent, log_item_t *item) {
+	journal_t *journal = agent->journal;
+	journal_entry_t *entry = NULL;
+	ystr_t key = NULL;
+	ystr_t archive_path = NULL;
+	ystr_t checksum_name = NULL;
+	ystr_t checksum_path = NULL;
+	ystr_t chunks_path = NULL;
+	bool resumed = false;
+
+	if (!journal || ytable_empty(journal->entries))
+		return (false);
+	if (!(key = ys_printf(NULL, "%d\t%s", (int)item->type, item->item)) ||
+	    !(entry = ytable_get_key_data(journal->entries, key)) ||
+	    !(entry->stages & A_STAGE_DUMP))
+		goto cleanup;
+	// the archive is written in the directory of the dump (its name could contain a sub-directory)
+	size_t path_len = ys_bytesize(item->archive_path);
+	size_t name_len = item->archive_name ? ys_bytesize(item->archive_name) : 0;
+	const char *slash = strrchr(item->archive_path, '/');
+	int dir_len = slash ? (int)(slash - item->archive_path + 1) : 0;
+	if (name_len && path_len > name_len && item->archive_path[path_len - name_len - 1] == '/' &&
+	    !strcmp(item->archive_path + path_len - name_len, item->archive_name))
+		dir_len = (int)(path_len - name_len);
+	if (!(archive_path = ys_printf(NULL, "%.*s%s", dir_len, item->archive_path, entry->archive_name)) ||
+	    !yfile_exists(archive_path))
+		goto cleanup;
+	if (entry->stages & A_STAGE_CHECKSUM) {
+		if (!(checksum_name = ys_printf(NULL, "%s.sha512", entry->archive_name)) ||
+		    !(checksum_path = ys_printf(NULL, "%s.sha512", archive_path)) ||
+		    !yfile_exists(checksum_path))
+			goto cleanup;
+	}
+	// the volumes of a split archive are listed in its manifest
+	size_t ext_len = strlen("." A_VOLUME_MANIFEST_EXT);
+	if (ys_bytesize(archive_path) > ext_len &&
+	    !strcmp(archive_path + ys_bytesize(archive_path) - ext_len, "." A_VOLUME_MANIFEST_EXT) &&
+	    volume_resume(item, archive_path) != YENOERR)
+		goto cleanup;
+	// the new chunks of a deduplicated archive are uploaded with it
+	if (!(entry->stages & A_STAGE_UPLOAD) &&
+	    (chunks_path = ys_printf(NULL, "%s.chunks", item->archive_path)) && yfile_is_dir(chunks_path) &&
+	    dedup_resume(item, chunks_path) != YENOERR)
+		goto cleanup;
+	// the item is restored
+	ys_free(item->archive_name);
+	ys_free(item->archive_path);
+	item->archive_name = ys_copy(entry->archive_name);
+	item->archive_path = archive_path;
+	archive_path = NULL;
+	item->checksum_name = checksum_name;
+	item->checksum_path = checksum_path;
+	checksum_name = checksum_path = NULL;
+	item->archive_size = entry->size;
+	item->level = entry->level;
+	item->dump_status = YENOERR;
+	if (entry->stages & A_STAGE_COMPRESS)
+		item->compress_status = YENOERR;
+	if (entry->stages & A_STAGE_ENCRYPT)
+		item->encrypt_status = YENOERR;
+	if (entry->stages & A_STAGE_CHECKSUM)
+		item->checksum_status = YENOERR;
+	if (entry->stages & A_STAGE_UPLOAD)
+		item->upload_status = YENOERR;
+	item->stages = entry->stages;
+	// the state file of an incremental archive is kept once it is uploaded
+	if (!(entry->stages & A_STAGE_UPLOAD) && entry->state_tmp && !item->state_tmp &&
+	    yfile_exists(entry->state_tmp))
+		item->state_tmp = strdup(entry->state_tmp);
+	item->success = true;
+	resumed = true;
+	ADEBUG("│ ├ " YANSI_FAINT "Resumed from the journal: " YANSI_RESET "%s" YANSI_FAINT "%s" YANSI_RESET,
+	       item->archive_name, (entry->stages & A_STAGE_UPLOAD) ? " (already uploaded)" : "");
+cleanup:
+	ys_free(key);
+	ys_free(archive_path);
+	ys_free(checksum_name);
+	ys_free(checksum_path);
+	ys_free(chunks_path);
+	return (resumed);
+}
+
+/* ********** PRIVATE FUNCTIONS ********** */
+
+/* Read the content of the journal file. */
+static ystatus_t journal_load(journal_t *journal, char *content) {
+	char *line = content;
+	char *end;
+	char *fields[7] = {NULL};
+	journal_entry_t *entry, *previous;
+
+	// a line without a new line character was not completely written
+	for (; (end = strchr(line, '\n')); line = end + 1) {
+		size_t nbr_fields = 1;
+		*end = '\0';
+		fields[0] = line;
+		// the state field is missing from the lines written by older versions
+		for (char *ptr = line; *ptr && nbr_fields < 7; ++ptr) {
+			if (*ptr == '\t') {
+				*ptr = '\0';
+				fields[nbr_fields++] = ptr + 1;
+			}
+		}
+		if (nbr_fields < 6 || !*fields[4] || !*fields[5])
+			continue;
+		if (!(entry = malloc0(sizeof(journal_entry_t))))
+			return (YENOMEM);
+		for (size_t i = 0; i < A_JOURNAL_NBR_STAGES; ++i) {
+			if (strstr(fields[0], A_JOURNAL_STAGES[i]))
+				entry->stages |= (1 << i);
+		}
+		entry->level = (uint16_t)atoi(fields[2]);
+		entry->size = (uint64_t)strtoull(fields[3], NULL, 10);
+		if (!(entry->key = ys_printf(NULL, "%s\t%s", fields[1], fields[5])) ||
+		    !(entry->archive_name = ys_new(fields[4])) ||
+		    (nbr_fields == 7 && *fields[6] && !(entry->state_tmp = ys_new(fields[6])))) {
+			journal_entry_free(0, NULL, entry, NULL);
+			return (YENOMEM);
+		}
+		// the last line of an item gives its current state
+		if ((previous = ytable_get_key_data(journal->entries, entry->key))) {
+			previous->stages = entry->stages;
+			previous->level = entry->level;
+			previous->size = entry->size;
+			ys_free(previous->archive_name);
+			previous->archive_name = entry->archive_name;
+			entry->archive_name = NULL;
+			ys_free(previous->state_tmp);
+			previous->state_tmp = entry->state_tmp;
+			entry->state_tmp = NULL;
+			journal_entry_free(0, NULL, entry, NULL);
+			continue;
+		}
+		if (ytable_set_key(journal->entries, entry->key, entry) != YENOERR) {
+			journal_entry_free(0, NULL, entry, NULL);
+			return (YENOMEM);
+		}
+	}
+	return (YENOERR);
+}
+/* Returns the completed stages of an item. */
+static uint8_t journal_stages(const log_item_t *item) {
+	uint8_t stages = 0;
+
+	if (item->dump_status == YENOERR)
+		stages |= A_STAGE_DUMP;
+	if (item->compress_status == YENOERR)
+		stages |= A_STAGE_COMPRESS;
+	if (item->encrypt_status == YENOERR)
+		stages |= A_STAGE_ENCRYPT;
+	if (item->checksum_status == YENOERR)
+		stages |= A_STAGE_CHECKSUM;
+	if (item->upload_status == YENOERR)
+		stages |= A_STAGE_UPLOAD;
+	// the other stages are meaningless without the dump
+	return ((stages & A_STAGE_DUMP) ? stages : 0);
+}
+/* Free an entry of the journal. */
+static ystatus_t journal_entry_free(uint64_t hash, char *key, void *data, void *user_data) {
+	journal_entry_t *entry = data;
+
+	if (!entry)
+		return (YENOERR);
+	ys_free(entry->key);
+	ys_free(entry->archive_name);
+	ys_free(entry->state_tmp);
+	free0(entry);
+	return (YENOERR);
+}
+
@@ -0,0 +1,155 @@
+/**
+ * @header	journal.h
+ * @abstract	Journal of the stages completed during a backup run.
+ * @discussion	Each run directory contains an append-only journal. A line is
+ *		written (and synced to disk) each time an item completes some
+ *		stages:
+ *		  <stages> TAB <type> TAB <level> TAB <size> TAB <archive> TAB <item> TAB <state>
+ *		where <stages> is a comma-separated list of the completed stages
+ *		(dump, compress, encrypt, checksum, upload), <archive> is the
+ *		name of the archive file once these stages are done, and <state>
+ *		is the path to the state file of an incremental archive (empty
+ *		otherwise), which is kept once the archive is uploaded.
+ *
+ *		If the agent is interrupted, a new execution for the same
+ *		schedule slot uses the same run directory. It reads the journal,
+ *		and doesn't redo the stages already done: an item whose archive
+ *		was dumped is not dumped again, an uploaded item is not uploaded
+ *		again. A truncated last line (interruption while it was written)
+ *		is ignored.
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ */
+#pragma once
+
+#include <pthread.h>
+#include "ystatus.h"
+#include "ystr.h"
+#include "ytable.h"
+#include "agent.h"
+#include "log.h"
+
+/** @const A_JOURNAL_FILENAME	Name of the journal file, in the run directory. */
+#define A_JOURNAL_FILENAME	"journal"
+
+/**
+ * @typedef	journal_stage_t
+ * @abstract	Stages of an item's backup.
+ * @constant	A_STAGE_DUMP		The item was dumped (tar or database dump).
+ * @constant	A_STAGE_COMPRESS	The archive was compressed.
+ * @constant	A_STAGE_ENCRYPT		The archive was encrypted.
+ * @constant	A_STAGE_CHECKSUM	The checksum file of the archive was written.
+ * @constant	A_STAGE_UPLOAD		The archive was uploaded.
+ */
+typedef enum {
+	A_STAGE_DUMP = 1,
+	A_STAGE_COMPRESS = 2,
+	A_STAGE_ENCRYPT = 4,
+	A_STAGE_CHECKSUM = 8,
+	A_STAGE_UPLOAD = 16
+} journal_stage_t;
+
+/**
+ * @typedef	journal_entry_t
+ * @abstract	Last known state of an item, read from the journal.
+ * @field	key		Key of the entry (type and name of the item).
+ * @field	stages		Completed stages.
+ * @field	level		Level of the archive.
+ * @field	size		Size of the archive.
+ * @field	archive_name	Name of the archive file.
+ * @field	state_tmp	Path to the state file of the archive (NULL if none).
+ */
+typedef struct {
+	ystr_t key;
+	uint8_t stages;
+	uint16_t level;
+	uint64_t size;
+	ystr_t archive_name;
+	ystr_t state_tmp;
+} journal_entry_t;
+
+/**
+ * @typedef	journal_t
+ * @abstract	Journal of the current run.
+ * @field	mutex	Mutex protecting the writings.
+ * @field	path	Path to the journal file.
+ * @field	fd	File descriptor of the journal file.
+ * @field	entries	Items processed by a previous execution, indexed by their key.
+ */
+typedef struct journal_s {
+	pthread_mutex_t mutex;
+	ystr_t path;
+	int fd;
+	ytable_t *entries;
+} journal_t;
+
+/**
+ * @function	journal_open
+ * @abstract	Open (or create) the journal of the current run, and read the
+ *		stages completed by a previous execution.
+ * @param	agent	Pointer to the agent structure.
+ * @return	A pointer to the journal, or NULL if it can't be used.
+ */
+journal_t *journal_open(agent_t *agent);
+/**
+ * @function	journal_close
+ * @abstract	Close the journal, and free it.
+ * @param	journal	Pointer to the journal (could be NULL).
+ */
+void journal_close(journal_t *journal);
+/**
+ * @function	journal_exists
+ * @abstract	Tell if a run directory contains a journal.
+ * @param	run_path	Path to the run directory.
+ * @return	True if the journal exists.
+ */
+bool journal_exists(const char *run_path);
+/**
+ * @function	journal_write
+ * @abstract	Add the completed stages of an item to the journal. Nothing is
+ *		written if no new stage was completed.
+ * @param	agent	Pointer to the agent structure.
+ * @param	item	Pointer to the item's log entry.
+ */
+void journal_write(agent_t *agent, log_item_t *item);
+/**
+ * @function	journal_resume
+ * @abstract	Restore the state of an item from the journal, if it was dumped
+ *		by a previous execution and its files are still there.
+ * @param	agent	Pointer to the agent structure.
+ * @param	item	Pointer to the item's log entry, whose archive_name and
+ *			archive_path are the ones of the dump. They are updated,
+ *			with the status of each completed stage, and the state
+ *			file of an incremental archive which was not kept yet.
+ * @return	True if the item was restored (it must not be dumped again).
+ */
+bool journal_resume(agent_t *agent, log_item_t *item);
+
+/* ********** PRIVATE DECLARATIONS ********** */
+#ifdef __A_JOURNAL_PRIVATE__
+	/**
+	 * @function	journal_load
+	 * @abstract	Read the content of the journal file.
+	 * @param	journal	Pointer to the journal.
+	 * @param	content	Content of the journal file.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t journal_load(journal_t *journal, char *content);
+	/**
+	 * @function	journal_stages
+	 * @abstract	Returns the completed stages of an item, from its statuses.
+	 * @param	item	Pointer to the item's log entry.
+	 * @return	The stages.
+	 */
+	static uint8_t journal_stages(const log_item_t *item);
+	/**
+	 * @function	journal_entry_free
+	 * @abstract	Free an entry of the journal (called by the table).
+	 * @param	hash		Index of the entry.
+	 * @param	key		Key of the entry.
+	 * @param	data		Pointer to the entry.
+	 * @param	user_data	Always NULL.
+	 * @return	Always YENOERR.
+	 */
+	static ystatus_t journal_entry_free(uint64_t hash, char *key, void *data, void *user_data);
+#endif /* __A_JOURNAL_PRIVATE__ */
+
@@ -1,76 +1,128 @@
 #include <time.h>
+#include <string.h>
 #include <stdarg.h>
 #include "yansi.h"
 #include "ymemory.h"
 #include "yarray.h"
 #include "log.h"
 
-/* Write a message to the log file. */
-void alog(agent_t *agent, bool debug, bool show_time, const char *str, ...) {
-	va_list plist, plist2, plist3;
-	char buffer[4096];
+/* Write a formatted message to the log outputs. */
+static void alog_write(agent_t *agent, time_t timestamp, bool show_time, const char *message) {
+	char buffer[64];
+	ystr_t line = NULL;
 	ystr_t ansi_free = NULL;
 
-	if (!agent || (!agent->log_fd && !agent->conf.use_stdout && !agent->conf.use_syslog) ||
-	    (debug && !agent->debug_mode)) {
-		return;
-	}
-	// creation of the log string
-	va_start(plist, str);
-	va_copy(plist2, plist);
-	va_copy(plist3, plist);
 	buffer[0] = '\0';
 	if (show_time) {
-		time_t current_time = time(NULL);
-		struct tm *tm = localtime(&current_time);
-		int tz_hours = abs((int)(tm->tm_gmtoff / 3600));
-		int tz_minutes = abs((int)((tm->tm_gmtoff % 3600) / 60));
-		char tz_sign = (tm->tm_gmtoff >= 0) ? '+' : '-';
+		struct tm tm;
+		localtime_r(&timestamp, &tm);
+		int tz_hours = abs((int)(tm.tm_gmtoff / 3600));
+		int tz_minutes = abs((int)((tm.tm_gmtoff % 3600) / 60));
+		char tz_sign = (tm.tm_gmtoff >= 0) ? '+' : '-';
 		snprintf(
 			buffer,
 			sizeof(buffer),
 			"%s%04d-%02d-%02d %02d:%02d:%02d%c%02d:%02d%s ",
 			YANSI_FAINT,
-			tm->tm_year + 1900,
-			tm->tm_mon + 1,
-			tm->tm_mday,
-			tm->tm_hour,
-			tm->tm_min,
-			tm->tm_sec,
+			tm.tm_year + 1900,
+			tm.tm_mon + 1,
+			tm.tm_mday,
+			tm.tm_hour,
+			tm.tm_min,
+			tm.tm_sec,
 			tz_sign,
 			tz_hours,
 			tz_minutes,
 			YANSI_RESET
 		);
 	}
-	size_t len = strlen(buffer);
-	char *pt = buffer + len;
-	snprintf(pt, sizeof(buffer) - len, "%s\n", str);
+	if (!(line = ys_printf(NULL, "%s%s\n", buffer, message)))
+		return;
 	// check if an ANSI-free string is needed
 	if (!agent->conf.use_ansi || agent->conf.use_syslog)
-		ansi_free = ys_clean_ansi(buffer);
+		ansi_free = ys_clean_ansi(line);
 	// write to file
 	if (agent->log_fd) {
-		vfprintf(agent->log_fd, (agent->conf.use_ansi ? buffer : ansi_free), plist);
+		fputs((agent->conf.use_ansi ? line : ansi_free), agent->log_fd);
 		fflush(agent->log_fd);
 	}
 	// write to stdout
 	if (agent->conf.use_stdout) {
-		vfprintf(stdout, (agent->conf.use_ansi ? buffer : ansi_free), plist2);
+		fputs((agent->conf.use_ansi ? line : ansi_free), stdout);
 		fflush(stdout);
 	}
 	// write to syslog
-	if (agent->conf.use_syslog) {
-		// if len is not zero, there is date and time at the beginning of the string,
-		// so we take 26 bytes after the beginning of the ansi_free string; we can't use
-		// the len variable because it counts ANSI characters wich are not in ansi_free
-		pt = ansi_free + (len ? 26 : 0);
-		vsyslog(LOG_NOTICE, pt, plist3);
+	if (agent->conf.use_syslog && ansi_free) {
+		// if there is date and time at the beginning of the string, we take 26 bytes
+		// after the beginning of the ansi_free string
+		syslog(LOG_NOTICE, "%s", ansi_free + (show_time ? 26 : 0));
 	}
-	va_end(plist);
-	va_end(plist2);
-	va_end(plist3);
 	ys_free(ansi_free);
+	ys_free(line);
+}
+/* Write a message to the log file. */
+void alog(agent_t *agent, bool debug, bool show_time, const char *str, ...) {
+	va_list plist;
+	char *message = NULL;
+
+	if (!agent || (!agent->log_fd && !agent->conf.use_stdout && !agent->conf.use_syslog) ||
+	    (debug && !agent->debug_mode)) {
+		return;
+	}
+	// creation of the message
+	va_start(plist, str);
+	if (vasprintf(&message, str, plist) == -1)
+		message = NULL;
+	va_end(plist);
+	if (!message)
+		return;
+	// buffered message (concurrent worker)
+	if (agent->log_lines) {
+		log_line_t *line = malloc0(sizeof(log_line_t));
+		if (line) {
+			line->timestamp = time(NULL);
+			line->show_time = show_time;
+			line->message = message;
+			if (yarray_push(&agent->log_lines, line) == YENOERR)
+				return;
+			free0(line);
+		}
+	}
+	alog_write(agent, time(NULL), show_time, message);
+	free0(message);
+}
+/* Write the log lines buffered by a worker, and free them. */
+void log_flush_lines(agent_t *agent, yarray_t lines) {
+	for (size_t i = 0; lines && i < yarray_length(lines); ++i) {
+		log_line_t *line = lines[i];
+		// the lines of a nested worker are kept in the buffer of its parent worker
+		if (agent->log_lines && yarray_push(&agent->log_lines, line) == YENOERR)
+			continue;
+		alog_write(agent, line->timestamp, line->show_time, line->message);
+		free0(line->message);
+		free0(line);
+	}
+}
+/* Write the standard error of failed sub-programs, line by line. */
+void log_program_errors(agent_t *agent, const char *prefix, const ybin_t *err) {
+	const char *line, *end, *eol;
+	size_t nbr_lines = 0;
+	int len;
+
+	if (!err || !err->data)
+		return;
+	end = (const char*)err->data + err->bytesize;
+	for (line = err->data; line < end && nbr_lines < A_LOG_ERROR_LINES; line = eol + 1) {
+		if (!(eol = memchr(line, '\n', (size_t)(end - line))))
+			eol = end;
+		len = (int)(eol - line);
+		if (len && line[len - 1] == '\r')
+			len--;
+		if (!len)
+			continue;
+		ALOG("%s" YANSI_FAINT "%.*s" YANSI_RESET, prefix, len, line);
+		nbr_lines++;
+	}
 }
 /* Creates a log entry for a pre-script execution. */
 log_script_t *log_create_pre_script(agent_t *agent, ystr_t command) {
@@ -140,4 +192,20 @@ log_item_t *log_create_pgsql(agent_t *agent, ystr_t dbname) {
 	ytable_add(agent->exec_log.backup_databases, log);
 	return (log);
 }
+/* Creates a log entry for a MongoDB database backup. */
+log_item_t *log_create_mongodb(agent_t *agent, ystr_t dbname) {
+	log_item_t *log = malloc0(sizeof(log_item_t));
+	if (!log)
+		return (NULL);
+	log->type = A_ITEM_TYPE_DB_MONGODB;
+	log->item = dbname;
+	log->success = true;
+	log->dump_status = YEUNDEF;
+	log->compress_status = YEUNDEF;
+	log->encrypt_status = YEUNDEF;
+	log->checksum_status = YEUNDEF;
+	log->upload_status = YEUNDEF;
+	ytable_add(agent->exec_log.backup_databases, log);
+	return (log);
+}
 
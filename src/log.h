@@ -8,6 +8,7 @@
  */
 #pragma once
 
+#include "ybin.h"
 #include "agent.h"
 
 /** @define ALOG	Add a message to the log file. */
@@ -19,6 +20,9 @@
 /** @define ADEBUG_RAW	Add a debug message to the log file (in debug mode), without time. */
 #define ADEBUG_RAW(...)	alog(agent, true, false, __VA_ARGS__)
 
+/** @const A_LOG_ERROR_LINES	Maximum number of lines written from the standard error of sub-programs. */
+#define A_LOG_ERROR_LINES	20
+
 /**
  * @typedef	log_script_t
  * @abstract	Structure used to store the log of a script execution.
@@ -29,6 +33,16 @@ typedef struct {
 	ystr_t command;
 	bool success;
 } log_script_t;
+/**
+ * @typedef	log_part_t
+ * @abstract	Size of a part of a database dump (a collection of a MongoDB archive).
+ * @field	name	Name of the part.
+ * @field	size	Size of the part's data, in bytes.
+ */
+typedef struct {
+	ystr_t name;
+	uint64_t size;
+} log_part_t;
 /**
  * @typedef	log_item_t
  * @abstract	Structure used to store the log of a (file or database) backup.
@@ -37,6 +51,8 @@ typedef struct {
  * @field	archive_name	Name of the archive file (tar + compress + encrypt'ed file).
  * @field	archive_path	Path to the archive file (tar + compress + encrypt'ed file).
  * @field	archive_size	Size of the archive file, in bytes.
+ * @field	level		Level of the archive (0 for a full backup, N for an incremental
+ *				backup based on the previous archive of level N-1).
  * @field	checksum_name	Name of the checksum file.
  * @field	checksum_path	Path to the checksum file.
  * @field	success		True if the whole backup succeed.
@@ -45,6 +61,38 @@ typedef struct {
  * @field	encrypt_status	Status of the encryption.
  * @field	checksum_status	Status of the file's checksum computing.
  * @field	upload_status	Status of the upload.
+ * @field	chunks_path	Path to the directory of the chunks written for the archive
+ *				(deduplication mode, NULL otherwise).
+ * @field	chunks		Identifiers of the chunks written for the archive, which were
+ *				not already stored (deduplication mode, NULL otherwise).
+ * @field	unchanged	True if the path didn't change since its last backup (no archive
+ *				is created).
+ * @field	reference	Path of the previous archive, used for an unchanged path.
+ * @field	changes_path	Path to the index of the backed up path.
+ * @field	changes		Index of the backed up path, written once the archive is uploaded.
+ * @field	parts		Paths to the volumes of the archive (volumes mode, NULL otherwise).
+ * @field	stages		Stages of the item recorded in the run's journal.
+ * @field	compress_mode	Compression decision of the adaptive mode (A_ZMODE_DEFAULT if
+ *				the compressibility was not estimated).
+ * @field	entropy		Estimated entropy of the data, in bits per byte.
+ * @field	data_size	Size of the data before compression (0 if unknown).
+ * @field	disk_peak	Peak disk space used by the backup of the item, in bytes (the
+ *				dump and its archive, when both are written at the same time).
+ * @field	logical_size	Size of the archived files, holes of sparse files included (0 if
+ *				unknown: only the native tar writer counts it).
+ * @field	physical_size	Size of the data read from the archived files, without the holes
+ *				of sparse files (0 if unknown).
+ * @field	dump_parts	Sizes of the collections of a MongoDB dump (list of log_part_t
+ *				pointers; NULL otherwise).
+ * @field	state_path	Path to the incremental state files of the item, without their
+ *				level and extension (NULL if the backup is not incremental).
+ * @field	state_ext	Extension of the incremental state files.
+ * @field	state_tmp	Path to the state file of the archive, kept once the archive
+ *				is uploaded (NULL once it is kept or removed).
+ * @field	state_runs	Number of runs since the last full backup, before this one.
+ * @field	binlog_file	Binary log of the position reached by a MySQL archive (NULL if
+ *				not found), written to its state file.
+ * @field	binlog_position	Position in the binary log.
  */
 typedef struct {
 	enum {
@@ -57,6 +105,7 @@ typedef struct {
 	ystr_t archive_name;
 	ystr_t archive_path;
 	uint64_t archive_size;
+	uint16_t level;
 	ystr_t checksum_name;
 	ystr_t checksum_path;
 	bool success;
@@ -65,8 +114,46 @@ typedef struct {
 	ystatus_t encrypt_status;
 	ystatus_t checksum_status;
 	ystatus_t upload_status;
+	ystr_t chunks_path;
+	ybin_t *chunks;
+	bool unchanged;
+	ystr_t reference;
+	ystr_t changes_path;
+	ybin_t *changes;
+	yarray_t parts;
+	uint8_t stages;
+	enum {
+		A_ZMODE_DEFAULT = 0,
+		A_ZMODE_NORMAL,
+		A_ZMODE_FAST
+	} compress_mode;
+	double entropy;
+	uint64_t data_size;
+	uint64_t disk_peak;
+	uint64_t logical_size;
+	uint64_t physical_size;
+	yarray_t dump_parts;
+	ystr_t state_path;
+	const char *state_ext;
+	char *state_tmp;
+	int32_t state_runs;
+	ystr_t binlog_file;
+	uint64_t binlog_position;
 } log_item_t;
 
+/**
+ * @typedef	log_line_t
+ * @abstract	Log message buffered by a concurrent worker.
+ * @field	timestamp	Unix timestamp of the message.
+ * @field	show_time	True if the time must be printed.
+ * @field	message		The message.
+ */
+typedef struct {
+	time_t timestamp;
+	bool show_time;
+	char *message;
+} log_line_t;
+
 /**
  * @function	alog
  *		Write a message in the log file. Use preferably ALOG() and ALOG_RAW().
@@ -77,6 +164,23 @@ typedef struct {
  * @param	...		Variable arguments.
  */
 void alog(agent_t *agent, bool debug, bool show_time, const char *str, ...);
+/**
+ * @function	log_flush_lines
+ * @abstract	Write the log messages buffered by a concurrent worker, and free them.
+ *		If the agent is itself a worker, the messages are moved to its buffer.
+ * @param	agent	Pointer to the agent structure.
+ * @param	lines	List of buffered messages.
+ */
+void log_flush_lines(agent_t *agent, yarray_t lines);
+/**
+ * @function	log_program_errors
+ * @abstract	Write the standard error of failed sub-programs, line by line
+ *		(empty lines are skipped, the number of lines is limited).
+ * @param	agent	Pointer to the agent structure.
+ * @param	prefix	String written before each line.
+ * @param	err	Pointer to the standard error (could be NULL).
+ */
+void log_program_errors(agent_t *agent, const char *prefix, const ybin_t *err);
 /**
  * @function	log_create_pre_script
  * @abstract	Creates a log entry for a pre-script execution.
@@ -117,4 +221,12 @@ log_item_t *log_create_mysql(agent_t *agent, ystr_t dbname);
  * @return	A pointer to the created log entry.
  */
 log_item_t *log_create_pgsql(agent_t *agent, ystr_t dbname);
+/**
+ * @function	log_create_mongodb
+ * @abstract	Creates a log entry for a MongoDB database backup.
+ * @param	agent	Pointer to the agent structure.
+ * @param	dbname	Name of the database.
+ * @return	A pointer to the created log entry.
+ */
+log_item_t *log_create_mongodb(agent_t *agent, ystr_t dbname);
 
@@ -18,6 +18,8 @@
 #include "configuration.h"
 #include "declare.h"
 #include "backup.h"
+#include "encrypt.h"
+#include "wal.h"
 #include "log.h"
 
 /* *** declaration of private functions *** */
@@ -31,6 +33,8 @@ void _agent_usage(const char *progname);
  * @constant	A_TYPE_DECLARE	For 'declare' execution.
  * @constant	A_TYPE_BACKUP	For 'backup' execution.
  * @constant	A_TYPE_RESTORE	For 'restore' execution.
+ * @constant	A_TYPE_DECRYPT	For 'decrypt' execution.
+ * @constant	A_TYPE_WAL_PUSH	For 'wal-push' execution.
  */
 typedef enum {
 	A_TYPE_USAGE = 0,
@@ -38,7 +42,9 @@ typedef enum {
 	A_TYPE_CONFIG,
 	A_TYPE_DECLARE,
 	A_TYPE_BACKUP,
-	A_TYPE_RESTORE
+	A_TYPE_RESTORE,
+	A_TYPE_DECRYPT,
+	A_TYPE_WAL_PUSH
 } exec_type_t;
 
 /**
@@ -47,6 +53,7 @@ typedef enum {
 int main(int argc, char *argv[]) {
 	// agent structure allocation and initialization
 	agent_t *agent = agent_new(argv[0]);
+	int exit_status = 0;
 
 	// check command-line arguments
 	exec_type_t exec_type = (
@@ -55,6 +62,8 @@ int main(int argc, char *argv[]) {
 		(argc == 2 && !strcmp(argv[1], A_OPT_DECLARE)) ? A_TYPE_DECLARE :
 		(argc == 2 && !strcmp(argv[1], A_OPT_BACKUP)) ? A_TYPE_BACKUP :
 		(argc == 3 && !strcmp(argv[1], A_OPT_RESTORE)) ? A_TYPE_RESTORE :
+		(argc == 4 && !strcmp(argv[1], A_OPT_DECRYPT)) ? A_TYPE_DECRYPT :
+		(argc == 3 && !strcmp(argv[1], A_OPT_WAL_PUSH)) ? A_TYPE_WAL_PUSH :
 		A_TYPE_USAGE
 	);
 	// execution
@@ -90,6 +99,28 @@ int main(int argc, char *argv[]) {
 		ADEBUG_RAW("conf.param_url       : \"" YANSI_FAINT "%s" YANSI_RESET "\"", agent->conf.param_url);
 		ADEBUG_RAW("conf.api_base_url    : \"" YANSI_FAINT "%s" YANSI_RESET "\"", agent->conf.api_base_url);
 		ADEBUG_RAW("conf.param_file      : \"" YANSI_FAINT "%s" YANSI_RESET "\"", agent->conf.param_file);
+		ADEBUG_RAW("conf.streaming       : " YANSI_FAINT "%s" YANSI_RESET, agent->conf.streaming ? "true" : "false");
+		ADEBUG_RAW("conf.file_workers    : " YANSI_FAINT "%d" YANSI_RESET, agent->conf.file_workers);
+		ADEBUG_RAW("conf.db_workers      : " YANSI_FAINT "%d" YANSI_RESET, agent->conf.db_workers);
+		ADEBUG_RAW("conf.upload_queue    : " YANSI_FAINT "%s" YANSI_RESET, agent->conf.upload_queue ? "true" : "false");
+		ADEBUG_RAW("conf.compress_level  : " YANSI_FAINT "%d" YANSI_RESET, agent->conf.compress_level);
+		ADEBUG_RAW("conf.compress_threads: " YANSI_FAINT "%d" YANSI_RESET, agent->conf.compress_threads);
+		ADEBUG_RAW("conf.dedup           : " YANSI_FAINT "%s" YANSI_RESET, agent->conf.dedup ? "true" : "false");
+		ADEBUG_RAW("conf.skip_unchanged  : " YANSI_FAINT "%s" YANSI_RESET, agent->conf.skip_unchanged ? "true" : "false");
+		ADEBUG_RAW("conf.native_tar      : " YANSI_FAINT "%s" YANSI_RESET, agent->conf.native_tar ? "true" : "false");
+		ADEBUG_RAW("conf.volume_size     : " YANSI_FAINT "%u" YANSI_RESET, agent->conf.volume_size);
+		ADEBUG_RAW("conf.compress_auto   : " YANSI_FAINT "%s" YANSI_RESET, agent->conf.compress_auto ? "true" : "false");
+		ADEBUG_RAW("conf.read_limit      : " YANSI_FAINT "%u" YANSI_RESET, agent->conf.read_limit);
+		ADEBUG_RAW("conf.write_limit     : " YANSI_FAINT "%u" YANSI_RESET, agent->conf.write_limit);
+		ADEBUG_RAW("conf.io_idle         : " YANSI_FAINT "%s" YANSI_RESET, agent->conf.io_idle ? "true" : "false");
+		ADEBUG_RAW("conf.cpu_nice        : " YANSI_FAINT "%u" YANSI_RESET, agent->conf.cpu_nice);
+		ADEBUG_RAW("conf.cpu_idle        : " YANSI_FAINT "%s" YANSI_RESET, agent->conf.cpu_idle ? "true" : "false");
+		ADEBUG_RAW("conf.cpu_set         : \"" YANSI_FAINT "%s" YANSI_RESET "\"", agent->conf.cpu_set ? agent->conf.cpu_set : "");
+		ADEBUG_RAW("conf.cpu_max         : " YANSI_FAINT "%u" YANSI_RESET, agent->conf.cpu_max);
+		ADEBUG_RAW("conf.memory_high     : " YANSI_FAINT "%u" YANSI_RESET, agent->conf.memory_high);
+		ADEBUG_RAW("conf.dump_jobs       : " YANSI_FAINT "%u" YANSI_RESET, agent->conf.dump_jobs);
+		ADEBUG_RAW("conf.wal_batch       : " YANSI_FAINT "%u" YANSI_RESET, agent->conf.wal_batch);
+		ADEBUG_RAW("conf.wal_spool       : " YANSI_FAINT "%u" YANSI_RESET, agent->conf.wal_spool);
 		ADEBUG_RAW("\n");
 		// execution
 		if (exec_type == A_TYPE_DECLARE) {
@@ -101,10 +132,17 @@ int main(int argc, char *argv[]) {
 		} else if (exec_type == A_TYPE_RESTORE) {
 			// restore
 			printf("agent_restore(argv[2]);\n");
+		} else if (exec_type == A_TYPE_DECRYPT) {
+			// decryption of an archive
+			exec_decrypt(agent, argv[2], argv[3]);
+		} else if (exec_type == A_TYPE_WAL_PUSH) {
+			// archiving of a PostgreSQL WAL segment (PostgreSQL needs the exit status)
+			if (exec_wal_push(agent, argv[2]) != YENOERR)
+				exit_status = 1;
 		}
 	}
 	agent_free(agent);
-	return (0);
+	return (exit_status);
 }
 
 /* ********** PRIVATE FUNCTIONS ********** */
@@ -160,6 +198,14 @@ void _agent_usage(const char *progname) {
 		YANSI_YELLOW "  backup\n" YANSI_RESET
 		"  Performs the backup configured on the Arkiv.sh service for this machine.\n"
 		"  Should be triggered by the cron daemon only.\n\n"
+		YANSI_YELLOW "  decrypt encrypted_file output_file\n" YANSI_RESET
+		"  Decrypts an archive encrypted with the native encryption (" YANSI_FAINT ".arkiv" YANSI_RESET " files),\n"
+		"  using the encryption password of the configuration.\n\n"
+		YANSI_YELLOW "  wal-push wal_segment_path\n" YANSI_RESET
+		"  Archives a PostgreSQL WAL segment (compressed, encrypted, checksummed and\n"
+		"  uploaded to the host's storage). To be used as PostgreSQL's " YANSI_FAINT "archive_command" YANSI_RESET ":\n"
+		YANSI_FAINT "  archive_command = '/opt/arkiv/bin/arkiv_agent wal-push %%p'\n" YANSI_RESET
+		"  Exits with a non-zero status if the segment was not archived.\n\n"
 		//YANSI_YELLOW "  restore latest|identifier\n" YANSI_RESET
 		//"  Perform the restore of the lastest backup or the backup with the\n"
 		//"  given identifier.\n\n"
@@ -233,6 +279,116 @@ void _agent_usage(const char *progname) {
 		YANSI_BOLD "  debug" YANSI_RESET "=true\n"
 		YANSI_FAINT "  Sets the log level to DEBUG, causing the program to write more log messages.\n" YANSI_RESET
 		"  Default value: " YANSI_CYAN "false\n\n" YANSI_RESET
+
+		YANSI_BOLD "  streaming" YANSI_RESET "=true\n"
+		YANSI_FAINT "  Creates file archives in a single pass: tar, compression, encryption and\n" YANSI_RESET
+		YANSI_FAINT "  checksum are chained through pipes, without intermediate files.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "false\n\n" YANSI_RESET
+
+		YANSI_BOLD "  file_workers" YANSI_RESET "=4\n"
+		YANSI_FAINT "  Number of files backed up concurrently. Overrides the host parameters.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "1\n\n" YANSI_RESET
+
+		YANSI_BOLD "  db_workers" YANSI_RESET "=2\n"
+		YANSI_FAINT "  Number of databases backed up concurrently. Overrides the host parameters.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "1\n\n" YANSI_RESET
+
+		YANSI_BOLD "  upload_queue" YANSI_RESET "=true\n"
+		YANSI_FAINT "  Uploads each archive as soon as it is ready, while the next ones are created.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "false\n\n" YANSI_RESET
+
+		YANSI_BOLD "  compress_level" YANSI_RESET "=9\n"
+		YANSI_FAINT "  Compression level (1 to 19 for zstd, 1 to 9 for the other programs).\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "the compression program's default\n\n" YANSI_RESET
+
+		YANSI_BOLD "  compress_threads" YANSI_RESET "=4\n"
+		YANSI_FAINT "  Number of threads used by zstd and xz compression.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "the compression program's default\n\n" YANSI_RESET
+
+		YANSI_BOLD "  dedup" YANSI_RESET "=true\n"
+		YANSI_FAINT "  Cuts archives into content-defined chunks, which are uploaded only once.\n" YANSI_RESET
+		YANSI_FAINT "  Needs the arkiv encryption. Works best with zstd or gzip compression.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "false\n\n" YANSI_RESET
+	);
+	printf(
+		YANSI_BOLD "  skip_unchanged" YANSI_RESET "=true\n"
+		YANSI_FAINT "  Paths whose files didn't change since their last backup are not backed up\n" YANSI_RESET
+		YANSI_FAINT "  again; the report references the previous archive.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "false\n\n" YANSI_RESET
+	);
+	printf(
+		YANSI_BOLD "  native_tar" YANSI_RESET "=true\n"
+		YANSI_FAINT "  Full backups of files are archived by the agent itself, which reads the\n" YANSI_RESET
+		YANSI_FAINT "  directories in parallel. Incremental backups still use the tar program.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "false\n\n" YANSI_RESET
+	);
+	printf(
+		YANSI_BOLD "  volume_size" YANSI_RESET "=1024\n"
+		YANSI_FAINT "  Splits archives into volumes of the given size (in MB), listed by a manifest.\n" YANSI_RESET
+		YANSI_FAINT "  Volumes are uploaded in parallel, and retried independently.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "0 (no volumes)\n\n" YANSI_RESET
+	);
+	printf(
+		YANSI_BOLD "  compress_auto" YANSI_RESET "=true\n"
+		YANSI_FAINT "  Estimates the compressibility of each item from samples of its data. Items\n" YANSI_RESET
+		YANSI_FAINT "  already compressed or encrypted are compressed at the fastest level.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "false\n\n" YANSI_RESET
+	);
+	printf(
+		YANSI_BOLD "  read_limit" YANSI_RESET "=50\n"
+		YANSI_FAINT "  Limits the rate of the files read by the native tar writer (in MB/s).\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "0 (no limit)\n\n" YANSI_RESET
+
+		YANSI_BOLD "  write_limit" YANSI_RESET "=20\n"
+		YANSI_FAINT "  Limits the rate of the archives written by the backup pipelines (in MB/s).\n" YANSI_RESET
+		YANSI_FAINT "  Dump programs are slowed down accordingly.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "0 (no limit)\n\n" YANSI_RESET
+
+		YANSI_BOLD "  io_idle" YANSI_RESET "=true\n"
+		YANSI_FAINT "  Backups use the idle I/O scheduling class, and written archives are removed\n" YANSI_RESET
+		YANSI_FAINT "  from the page cache.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "false\n\n" YANSI_RESET
+	);
+	printf(
+		YANSI_BOLD "  cpu_nice" YANSI_RESET "=10\n"
+		YANSI_FAINT "  Nice value of the backups (from 1 to 19).\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "0 (unchanged)\n\n" YANSI_RESET
+
+		YANSI_BOLD "  cpu_idle" YANSI_RESET "=true\n"
+		YANSI_FAINT "  Backups use the idle CPU scheduling policy; they run only when no other\n" YANSI_RESET
+		YANSI_FAINT "  process needs the CPU.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "false\n\n" YANSI_RESET
+
+		YANSI_BOLD "  cpu_set" YANSI_RESET "=0-3\n"
+		YANSI_FAINT "  List of the CPUs usable by the backups (\"0-3,6\").\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "all CPUs\n\n" YANSI_RESET
+
+		YANSI_BOLD "  cpu_max" YANSI_RESET "=2\n"
+		YANSI_FAINT "  Maximum number of cores used by the agent and its sub-programs. The agent is\n" YANSI_RESET
+		YANSI_FAINT "  moved into the \"arkiv-agent\" control group (cgroup v2).\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "0 (no limit)\n\n" YANSI_RESET
+
+		YANSI_BOLD "  memory_high" YANSI_RESET "=1024\n"
+		YANSI_FAINT "  Memory limit of the agent and its sub-programs (in MB). Above it, they are\n" YANSI_RESET
+		YANSI_FAINT "  slowed down and their memory is reclaimed. Uses the control group too.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "0 (no limit)\n\n" YANSI_RESET
+
+		YANSI_BOLD "  dump_jobs" YANSI_RESET "=4\n"
+		YANSI_FAINT "  Number of connections used to dump a MySQL or PostgreSQL database. Its\n" YANSI_RESET
+		YANSI_FAINT "  tables are dumped concurrently, from a consistent snapshot shared by the\n" YANSI_RESET
+		YANSI_FAINT "  connections. PostgreSQL databases are then dumped in directory format\n" YANSI_RESET
+		YANSI_FAINT "  (one archive per file of the dump). With the '*' entry, each database is\n" YANSI_RESET
+		YANSI_FAINT "  dumped separately, that many databases at the same time.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "1\n\n" YANSI_RESET
+		YANSI_BOLD "  wal_batch" YANSI_RESET "=8\n"
+		YANSI_FAINT "  Number of spooled WAL segments which triggers their upload (in one\n" YANSI_RESET
+		YANSI_FAINT "  transfer). The remaining segments are uploaded by the next backup run.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "1 (each segment is uploaded at once)\n\n" YANSI_RESET
+
+		YANSI_BOLD "  wal_spool" YANSI_RESET "=2048\n"
+		YANSI_FAINT "  Maximum size of the local spool of WAL segments (in MB). When it is full\n" YANSI_RESET
+		YANSI_FAINT "  and the storage can't be reached, the archiving of the segments fails.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "0 (no limit)\n\n" YANSI_RESET
 	);
 	printf(
 		YANSI_BG_GRAY YANSI_WHITE " Examples " YANSI_RESET "\n\n"
@@ -288,7 +444,31 @@ void _agent_usage(const char *progname) {
 		"  " YANSI_BG_BLUE YANSI_LIME "      \"api_url\":       \"https://api.arkiv.sh/v1\",                             " YANSI_RESET "\n"
 		"  " YANSI_BG_BLUE YANSI_LIME "      \"param_url\":     \"https://conf.arkiv.sh/v1/[ORG]/[HOST]/param.json\",    " YANSI_RESET "\n"
 		"  " YANSI_BG_BLUE YANSI_LIME "      \"param_file\":    \"/opt/arkiv/etc/param.json\",                           " YANSI_RESET "\n"
-		"  " YANSI_BG_BLUE YANSI_LIME "      \"debug\":         false                                                  " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"debug\":         false,                                                 " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"streaming\":     false,                                                 " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"file_workers\":  1,                                                     " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"db_workers\":    1,                                                     " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"upload_queue\":  false,                                                 " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"compress_level\": 3,                                                    " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"compress_threads\": 4,                                                  " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"dedup\":         false,                                                 " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"skip_unchanged\": false,                                                " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"native_tar\":    false,                                                 " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"volume_size\":   0,                                                     " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"compress_auto\": false,                                                 " YANSI_RESET "\n"
+	);
+	printf(
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"read_limit\":    0,                                                     " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"write_limit\":   0,                                                     " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"io_idle\":       false,                                                 " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"cpu_nice\":      0,                                                     " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"cpu_idle\":      false,                                                 " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"cpu_set\":       \"\",                                                    " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"cpu_max\":       0,                                                     " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"memory_high\":   0,                                                     " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"dump_jobs\":     1,                                                     " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"wal_batch\":     1,                                                     " YANSI_RESET "\n"
+		"  " YANSI_BG_BLUE YANSI_LIME "      \"wal_spool\":     0                                                      " YANSI_RESET "\n"
 		"  " YANSI_BG_BLUE YANSI_LIME "  }                                                                           " YANSI_RESET "\n"
 		"  " YANSI_BG_BLUE YANSI_LIME "                                                                              " YANSI_RESET "\n"
 		"\n\n"
@@ -354,6 +534,113 @@ void _agent_usage(const char *progname) {
 		YANSI_BOLD "  debug " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
 		YANSI_FAINT "  Sets the log level to DEBUG, causing the program to write more log messages.\n" YANSI_RESET
 		"  Default value: " YANSI_CYAN "false\n\n" YANSI_RESET
+
+		YANSI_BOLD "  streaming " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Creates file archives in a single pass: tar, compression, encryption and\n" YANSI_RESET
+		YANSI_FAINT "  checksum are chained through pipes, without intermediate files.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "false\n\n" YANSI_RESET
+
+		YANSI_BOLD "  file_workers " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Number of files backed up concurrently. Overrides the host parameters.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "1\n\n" YANSI_RESET
+
+		YANSI_BOLD "  db_workers " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Number of databases backed up concurrently. Overrides the host parameters.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "1\n\n" YANSI_RESET
+
+		YANSI_BOLD "  upload_queue " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Uploads each archive as soon as it is ready, while the next ones are created.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "false\n\n" YANSI_RESET
+
+		YANSI_BOLD "  compress_level " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Compression level (1 to 19 for zstd, 1 to 9 for the other programs).\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "the compression program's default\n\n" YANSI_RESET
+
+		YANSI_BOLD "  compress_threads " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Number of threads used by zstd and xz compression.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "the compression program's default\n\n" YANSI_RESET
+
+		YANSI_BOLD "  dedup " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Cuts archives into content-defined chunks, which are uploaded only once.\n" YANSI_RESET
+		YANSI_FAINT "  Needs the arkiv encryption. Works best with zstd or gzip compression.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "false\n\n" YANSI_RESET
+	);
+	printf(
+		YANSI_BOLD "  skip_unchanged " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Paths whose files didn't change since their last backup are not backed up\n" YANSI_RESET
+		YANSI_FAINT "  again; the report references the previous archive.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "false\n\n" YANSI_RESET
+
+		YANSI_BOLD "  native_tar " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Full backups of files are archived by the agent itself, which reads the\n" YANSI_RESET
+		YANSI_FAINT "  directories in parallel. Incremental backups still use the tar program.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "false\n\n" YANSI_RESET
+
+		YANSI_BOLD "  volume_size " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Splits archives into volumes of the given size (in MB), listed by a manifest.\n" YANSI_RESET
+		YANSI_FAINT "  Volumes are uploaded in parallel, and retried independently.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "0 (no volumes)\n\n" YANSI_RESET
+
+		YANSI_BOLD "  compress_auto " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Estimates the compressibility of each item from samples of its data. Items\n" YANSI_RESET
+		YANSI_FAINT "  already compressed or encrypted are compressed at the fastest level.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "false\n\n" YANSI_RESET
+	);
+	printf(
+		YANSI_BOLD "  read_limit " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Limits the rate of the files read by the native tar writer (in MB/s).\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "0 (no limit)\n\n" YANSI_RESET
+
+		YANSI_BOLD "  write_limit " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Limits the rate of the archives written by the backup pipelines (in MB/s).\n" YANSI_RESET
+		YANSI_FAINT "  Dump programs are slowed down accordingly.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "0 (no limit)\n\n" YANSI_RESET
+
+		YANSI_BOLD "  io_idle " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Backups use the idle I/O scheduling class, and written archives are removed\n" YANSI_RESET
+		YANSI_FAINT "  from the page cache.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "false\n\n" YANSI_RESET
+	);
+	printf(
+		YANSI_BOLD "  cpu_nice " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Nice value of the backups (from 1 to 19).\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "0 (unchanged)\n\n" YANSI_RESET
+
+		YANSI_BOLD "  cpu_idle " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Backups use the idle CPU scheduling policy; they run only when no other\n" YANSI_RESET
+		YANSI_FAINT "  process needs the CPU.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "false\n\n" YANSI_RESET
+
+		YANSI_BOLD "  cpu_set " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  List of the CPUs usable by the backups (\"0-3,6\").\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "all CPUs\n\n" YANSI_RESET
+
+		YANSI_BOLD "  cpu_max " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Maximum number of cores used by the agent and its sub-programs. The agent is\n" YANSI_RESET
+		YANSI_FAINT "  moved into the \"arkiv-agent\" control group (cgroup v2).\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "0 (no limit)\n\n" YANSI_RESET
+
+		YANSI_BOLD "  memory_high " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Memory limit of the agent and its sub-programs (in MB). Above it, they are\n" YANSI_RESET
+		YANSI_FAINT "  slowed down and their memory is reclaimed. Uses the control group too.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "0 (no limit)\n\n" YANSI_RESET
+
+		YANSI_BOLD "  dump_jobs " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Number of connections used to dump a MySQL or PostgreSQL database. Its\n" YANSI_RESET
+		YANSI_FAINT "  tables are dumped concurrently, from a consistent snapshot shared by the\n" YANSI_RESET
+		YANSI_FAINT "  connections. PostgreSQL databases are then dumped in directory format\n" YANSI_RESET
+		YANSI_FAINT "  (one archive per file of the dump). With the '*' entry, each database is\n" YANSI_RESET
+		YANSI_FAINT "  dumped separately, that many databases at the same time.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "1\n\n" YANSI_RESET
+		YANSI_BOLD "  wal_batch " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Number of spooled WAL segments which triggers their upload (in one\n" YANSI_RESET
+		YANSI_FAINT "  transfer). The remaining segments are uploaded by the next backup run.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "1 (each segment is uploaded at once)\n\n" YANSI_RESET
+
+		YANSI_BOLD "  wal_spool " YANSI_RESET YANSI_GREEN "(optional)\n" YANSI_RESET
+		YANSI_FAINT "  Maximum size of the local spool of WAL segments (in MB). When it is full\n" YANSI_RESET
+		YANSI_FAINT "  and the storage can't be reached, the archiving of the segments fails.\n" YANSI_RESET
+		"  Default value: " YANSI_CYAN "0 (no limit)\n\n" YANSI_RESET
 	);
 	printf(
 		YANSI_BG_GRAY YANSI_WHITE " Copyright, licence and source code " YANSI_RESET "\n\n"
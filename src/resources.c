@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "yansi.h"
+#include "ystr.h"
+#include "log.h"
+
+#define __A_RESOURCES_PRIVATE__
+#include "resources.h"
+
+/* Set the scheduling settings and the resource limits of the run. */
+void resources_apply(agent_t *agent) {
+	if (!agent->conf.cpu_nice && !agent->conf.cpu_idle && !agent->conf.cpu_set &&
+	    !agent->conf.cpu_max && !agent->conf.memory_high)
+		return;
+	ALOG("Set CPU and memory controls");
+	if (agent->conf.cpu_nice) {
+		if (!setpriority(PRIO_PROCESS, 0, agent->conf.cpu_nice))
+			ALOG("├ " YANSI_FAINT "Nice value: " YANSI_RESET "%u", agent->conf.cpu_nice);
+		else
+			ALOG("├ " YANSI_YELLOW "Unable to set the nice value" YANSI_RESET);
+	}
+	if (agent->conf.cpu_idle) {
+#ifdef SCHED_IDLE
+		struct sched_param param = {.sched_priority = 0};
+
+		if (!sched_setscheduler(0, SCHED_IDLE, &param))
+			ALOG("├ " YANSI_FAINT "Idle CPU scheduling policy" YANSI_RESET);
+		else
+#endif /* SCHED_IDLE */
+			ALOG("├ " YANSI_YELLOW "Unable to set the idle CPU scheduling policy" YANSI_RESET);
+	}
+	if (agent->conf.cpu_set) {
+		if (resources_cpu_set(agent->conf.cpu_set) == YENOERR)
+			ALOG("├ " YANSI_FAINT "CPU set: " YANSI_RESET "%s", agent->conf.cpu_set);
+		else
+			ALOG("├ " YANSI_YELLOW "Unable to set the CPU set '" YANSI_RESET "%s" YANSI_YELLOW "'" YANSI_RESET,
+			     agent->conf.cpu_set);
+	}
+	if (agent->conf.cpu_max || agent->conf.memory_high) {
+		if (resources_cgroup(agent) == YENOERR)
+			ALOG("├ " YANSI_FAINT "Control group: " YANSI_RESET A_CGROUP_ROOT "/" A_CGROUP_NAME);
+		else
+			ALOG("├ " YANSI_YELLOW "Unable to use the control group '" YANSI_RESET A_CGROUP_ROOT "/" A_CGROUP_NAME
+			     YANSI_YELLOW "'" YANSI_RESET);
+	}
+	ALOG("└ " YANSI_GREEN "Done" YANSI_RESET);
+}
+/* Compute the CPU time consumed by the run, and write it to the log. */
+void resources_usage(agent_t *agent) {
+	struct rusage self, children;
+	double user, system;
+
+	if (getrusage(RUSAGE_SELF, &self) || getrusage(RUSAGE_CHILDREN, &children))
+		return;
+	user = (double)self.ru_utime.tv_sec + (double)self.ru_utime.tv_usec / 1e6 +
+	       (double)children.ru_utime.tv_sec + (double)children.ru_utime.tv_usec / 1e6;
+	system = (double)self.ru_stime.tv_sec + (double)self.ru_stime.tv_usec / 1e6 +
+	         (double)children.ru_stime.tv_sec + (double)children.ru_stime.tv_usec / 1e6;
+	agent->exec_log.cpu_time = user + system;
+	ALOG("CPU usage");
+	ALOG("├ " YANSI_FAINT "User time: " YANSI_RESET "%.2f" YANSI_FAINT " s" YANSI_RESET, user);
+	ALOG("├ " YANSI_FAINT "System time: " YANSI_RESET "%.2f" YANSI_FAINT " s" YANSI_RESET, system);
+	ALOG("└ " YANSI_FAINT "Peak memory of a sub-program: " YANSI_RESET "%ld" YANSI_FAINT " MB" YANSI_RESET,
+	     children.ru_maxrss / 1024);
+}
+
+/* ********** PRIVATE FUNCTIONS ********** */
+
+/* Pin the calling thread to a list of CPUs. */
+static ystatus_t resources_cpu_set(const char *list) {
+#ifdef __linux__
+	cpu_set_t set;
+	const char *pt = list;
+	char *end;
+	long first, last;
+
+	CPU_ZERO(&set);
+	while (*pt) {
+		first = strtol(pt, &end, 10);
+		if (end == pt || first < 0 || first >= CPU_SETSIZE)
+			return (YEINVAL);
+		last = first;
+		pt = end;
+		if (*pt == '-') {
+			last = strtol(++pt, &end, 10);
+			if (end == pt || last < first || last >= CPU_SETSIZE)
+				return (YEINVAL);
+			pt = end;
+		}
+		for (long cpu = first; cpu <= last; ++cpu)
+			CPU_SET((int)cpu, &set);
+		if (*pt == ',')
+			++pt;
+		else if (*pt)
+			return (YEINVAL);
+	}
+	if (!CPU_COUNT(&set) || sched_setaffinity(0, sizeof(set), &set))
+		return (YEINVAL);
+	return (YENOERR);
+#else /* __linux__ */
+	return (YENOSYS);
+#endif /* __linux__ */
+}
+/* Create the agent's cgroup, set its limits, and move the agent into it. */
+static ystatus_t resources_cgroup(agent_t *agent) {
+#ifdef __linux__
+	const char *dir = A_CGROUP_ROOT "/" A_CGROUP_NAME;
+	char value[64];
+	ystatus_t status;
+
+	// only the unified hierarchy (cgroup v2) is managed
+	if (access(A_CGROUP_ROOT "/cgroup.controllers", F_OK))
+		return (YENOSYS);
+	if (mkdir(dir, 0755) && errno != EEXIST)
+		return (YEACCES);
+	// the controllers may already be enabled (the error is not fatal)
+	resources_cgroup_write(A_CGROUP_ROOT, "cgroup.subtree_control", "+cpu +memory");
+	if (agent->conf.cpu_max) {
+		snprintf(value, sizeof(value), "%lu %u",
+		         (unsigned long)agent->conf.cpu_max * A_CGROUP_CPU_PERIOD, A_CGROUP_CPU_PERIOD);
+		if ((status = resources_cgroup_write(dir, "cpu.max", value)) != YENOERR)
+			return (status);
+		ALOG("├ " YANSI_FAINT "CPU limit: " YANSI_RESET "%u" YANSI_FAINT " cores" YANSI_RESET, agent->conf.cpu_max);
+	} else {
+		resources_cgroup_write(dir, "cpu.max", "max");
+	}
+	if (agent->conf.memory_high) {
+		snprintf(value, sizeof(value), "%llu", (unsigned long long)agent->conf.memory_high * 1024 * 1024);
+		if ((status = resources_cgroup_write(dir, "memory.high", value)) != YENOERR)
+			return (status);
+		ALOG("├ " YANSI_FAINT "Memory limit: " YANSI_RESET "%u" YANSI_FAINT " MB" YANSI_RESET,
+		     agent->conf.memory_high);
+	} else {
+		resources_cgroup_write(dir, "memory.high", "max");
+	}
+	// all the threads of the agent are moved, and the programs it executes are created in the cgroup
+	snprintf(value, sizeof(value), "%ld", (long)getpid());
+	return (resources_cgroup_write(dir, "cgroup.procs", value));
+#else /* __linux__ */
+	return (YENOSYS);
+#endif /* __linux__ */
+}
+/* Write a value to a cgroup file. */
+static ystatus_t resources_cgroup_write(const char *dir, const char *file, const char *value) {
+	ystr_t path = ys_printf(NULL, "%s/%s", dir, file);
+	size_t len = strlen(value);
+	ssize_t written;
+	int fd;
+
+	if (!path)
+		return (YENOMEM);
+	fd = open(path, O_WRONLY | O_CLOEXEC);
+	ys_free(path);
+	if (fd < 0)
+		return (YEACCES);
+	// a cgroup file must be written in one call
+	written = write(fd, value, len);
+	close(fd);
+	return ((written == (ssize_t)len) ? YENOERR : YEINVAL);
+}
@@ -0,0 +1,71 @@
+/**
+ * @header	resources.h
+ * @abstract	Control of the CPU and memory used by backups.
+ * @discussion	The scheduling settings (nice value, SCHED_IDLE policy, CPU
+ *		affinity) are set on the agent's main thread before the
+ *		backups start; the threads and programs created afterwards
+ *		inherit them.
+ *
+ *		If a CPU or memory limit is set, the agent moves itself into a
+ *		dedicated cgroup (cgroup v2), created at the root of the
+ *		cgroup hierarchy. Its cpu.max and memory.high files are set,
+ *		so the agent and all its sub-programs can't use more than the
+ *		given number of cores, and are throttled and reclaimed above
+ *		the given memory size.
+ *
+ *		The CPU time consumed by the run (the agent and its
+ *		terminated sub-programs) is computed at the end of the run.
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ */
+#pragma once
+
+#include <stdbool.h>
+#include "ystatus.h"
+#include "agent.h"
+
+/** @const A_CGROUP_ROOT	Mount point of the cgroup v2 hierarchy. */
+#define A_CGROUP_ROOT		"/sys/fs/cgroup"
+/** @const A_CGROUP_NAME	Name of the agent's cgroup. */
+#define A_CGROUP_NAME		"arkiv-agent"
+/** @const A_CGROUP_CPU_PERIOD	Period of the CPU bandwidth limit, in microseconds. */
+#define A_CGROUP_CPU_PERIOD	100000
+
+/**
+ * @function	resources_apply
+ * @abstract	Set the scheduling settings and the resource limits of the run.
+ * @param	agent	Pointer to the agent structure.
+ */
+void resources_apply(agent_t *agent);
+/**
+ * @function	resources_usage
+ * @abstract	Compute the CPU time consumed by the run, and write it to the log.
+ * @param	agent	Pointer to the agent structure.
+ */
+void resources_usage(agent_t *agent);
+
+/* ********** PRIVATE DECLARATIONS ********** */
+#ifdef __A_RESOURCES_PRIVATE__
+	/**
+	 * @function	resources_cpu_set
+	 * @abstract	Pin the calling thread to a list of CPUs.
+	 * @param	list	List of CPUs ("0-3,6").
+	 * @return	YENOERR if OK, YEINVAL if the list is malformed.
+	 */
+	static ystatus_t resources_cpu_set(const char *list);
+	/**
+	 * @function	resources_cgroup
+	 * @abstract	Create the agent's cgroup, set its limits, and move the agent into it.
+	 * @param	agent	Pointer to the agent structure.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t resources_cgroup(agent_t *agent);
+	/**
+	 * @function	resources_cgroup_write
+	 * @abstract	Write a value to a cgroup file.
+	 * @param	dir	Path to the cgroup directory.
+	 * @param	file	Name of the file.
+	 * @param	value	Value to write.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t resources_cgroup_write(const char *dir, const char *file, const char *value);
+#endif /* __A_RESOURCES_PRIVATE__ */
@@ -0,0 +1,117 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+# include <sys/syscall.h>
+#endif /* __linux__ */
+#include "yansi.h"
+#include "ymemory.h"
+#include "log.h"
+
+#define __A_THROTTLE_PRIVATE__
+#include "throttle.h"
+
+#if defined(__linux__) && defined(SYS_ioprio_set)
+/** @const IOPRIO_CLASS_IDLE	Idle I/O scheduling class (not defined by the libc). */
+# define IOPRIO_CLASS_IDLE	3
+/** @const IOPRIO_CLASS_SHIFT	Position of the class in a priority value. */
+# define IOPRIO_CLASS_SHIFT	13
+/** @const IOPRIO_WHO_PROCESS	Priority of a process or thread. */
+# define IOPRIO_WHO_PROCESS	1
+#endif /* __linux__ && SYS_ioprio_set */
+
+/* Create a token bucket. */
+throttle_t *throttle_create(uint32_t limit) {
+	throttle_t *throttle = malloc0(sizeof(throttle_t));
+
+	if (!throttle)
+		return (NULL);
+	pthread_mutex_init(&throttle->mutex, NULL);
+	throttle->rate = (double)limit * 1024.0 * 1024.0;
+	throttle->burst = throttle->rate / A_THROTTLE_BURST_DIVISOR;
+	throttle->tokens = throttle->burst;
+	return (throttle);
+}
+/* Free a token bucket. */
+void throttle_free(throttle_t *throttle) {
+	if (!throttle)
+		return;
+	pthread_mutex_destroy(&throttle->mutex);
+	free0(throttle);
+}
+/* Take tokens from a bucket, waiting if needed. */
+void throttle_consume(throttle_t *throttle, size_t len) {
+	struct timespec now, delay;
+	double wait = 0.0;
+
+	if (!throttle || !len)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pthread_mutex_lock(&throttle->mutex);
+	if (!throttle->bytes) {
+		throttle->start = now;
+		throttle->last = now;
+	}
+	// refill, then take the tokens (the bucket may go in debt)
+	throttle->tokens += throttle_elapsed(&throttle->last, &now) * throttle->rate;
+	if (throttle->tokens > throttle->burst)
+		throttle->tokens = throttle->burst;
+	throttle->last = now;
+	throttle->tokens -= (double)len;
+	throttle->bytes += len;
+	if (throttle->tokens < 0.0) {
+		wait = -throttle->tokens / throttle->rate;
+		throttle->waited += wait;
+	}
+	pthread_mutex_unlock(&throttle->mutex);
+	if (wait <= 0.0)
+		return;
+	delay.tv_sec = (time_t)wait;
+	delay.tv_nsec = (long)((wait - (double)delay.tv_sec) * 1e9);
+	while (nanosleep(&delay, &delay) == -1 && errno == EINTR)
+		;
+}
+/* Write the statistics of a bucket to the log. */
+void throttle_log(agent_t *agent, throttle_t *throttle, const char *name, bool last) {
+	struct timespec now;
+	double elapsed;
+
+	if (!throttle)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	elapsed = throttle->bytes ? throttle_elapsed(&throttle->start, &now) : 0.0;
+	ALOG("%s " YANSI_FAINT "%s: " YANSI_RESET "%.1f" YANSI_FAINT " MB in " YANSI_RESET "%.1f" YANSI_FAINT " s ("
+	     YANSI_RESET "%.1f" YANSI_FAINT " MB/s), throttled during " YANSI_RESET "%.1f" YANSI_FAINT " s" YANSI_RESET,
+	     (last ? "└" : "├"), name, (double)throttle->bytes / (1024.0 * 1024.0), elapsed,
+	     ((elapsed > 0.0) ? ((double)throttle->bytes / (1024.0 * 1024.0) / elapsed) : 0.0), throttle->waited);
+}
+/* Set the idle I/O scheduling class to the calling thread. */
+ystatus_t throttle_io_idle(void) {
+#if defined(__linux__) && defined(SYS_ioprio_set)
+	if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT))
+		return (YENOSYS);
+	return (YENOERR);
+#else /* __linux__ && SYS_ioprio_set */
+	return (YENOSYS);
+#endif /* __linux__ && SYS_ioprio_set */
+}
+/* Write a file to disk, and remove its pages from the page cache. */
+void throttle_drop_cache(const char *path) {
+#ifdef POSIX_FADV_DONTNEED
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0)
+		return;
+	// dirty pages can't be dropped
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+#endif /* POSIX_FADV_DONTNEED */
+}
+
+/* ********** PRIVATE FUNCTIONS ********** */
+
+/* Returns the number of seconds between two times. */
+static double throttle_elapsed(const struct timespec *from, const struct timespec *to) {
+	return ((double)(to->tv_sec - from->tv_sec) + (double)(to->tv_nsec - from->tv_nsec) / 1e9);
+}
@@ -0,0 +1,108 @@
+/**
+ * @header	throttle.h
+ * @abstract	Control of the I/O load of backups.
+ * @discussion	Rate limits are token buckets, shared by all the concurrent
+ *		backups of the run. A limit is given in MB per second; tokens
+ *		accumulate up to a quarter of a second of data. A consumer
+ *		takes the tokens it needs, and sleeps if the bucket is in
+ *		debt, so the waiting time of concurrent consumers follows
+ *		the order of their requests.
+ *
+ *		The read limit applies to the data read by the agent (native
+ *		tar writer). The write limit applies to the archives written
+ *		by the pipelines; as the pipes are read at the limited rate,
+ *		the dump programs are slowed down too.
+ *
+ *		In idle I/O mode, the agent (and the programs it executes,
+ *		which inherit it) uses the idle I/O scheduling class, and the
+ *		archives are removed from the page cache once written.
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+#include "agent.h"
+
+/** @const A_THROTTLE_BURST_DIVISOR	The bucket holds 1/4 second of data. */
+#define A_THROTTLE_BURST_DIVISOR	4
+
+/**
+ * @typedef	throttle_t
+ * @abstract	Token bucket.
+ * @field	mutex		Mutex protecting the bucket.
+ * @field	rate		Rate, in bytes per second.
+ * @field	burst		Maximum number of tokens.
+ * @field	tokens		Number of available tokens (negative if in debt).
+ * @field	last		Time of the last refill.
+ * @field	start		Time of the first consumption.
+ * @field	bytes		Number of consumed bytes.
+ * @field	waited		Time spent waiting for tokens, in seconds.
+ */
+typedef struct throttle_s {
+	pthread_mutex_t mutex;
+	double rate;
+	double burst;
+	double tokens;
+	struct timespec last;
+	struct timespec start;
+	uint64_t bytes;
+	double waited;
+} throttle_t;
+
+/**
+ * @function	throttle_create
+ * @abstract	Create a token bucket.
+ * @param	limit	Rate limit, in MB per second.
+ * @return	A pointer to the bucket, or NULL on memory error.
+ */
+throttle_t *throttle_create(uint32_t limit);
+/**
+ * @function	throttle_free
+ * @abstract	Free a token bucket.
+ * @param	throttle	Pointer to the bucket (could be NULL).
+ */
+void throttle_free(throttle_t *throttle);
+/**
+ * @function	throttle_consume
+ * @abstract	Take tokens from a bucket, waiting if needed. Thread-safe.
+ * @param	throttle	Pointer to the bucket (could be NULL).
+ * @param	len		Number of bytes.
+ */
+void throttle_consume(throttle_t *throttle, size_t len);
+/**
+ * @function	throttle_log
+ * @abstract	Write the statistics of a bucket to the log.
+ * @param	agent		Pointer to the agent structure.
+ * @param	throttle	Pointer to the bucket (could be NULL).
+ * @param	name		Name of the limit.
+ * @param	last		True if it is the last line of the log block.
+ */
+void throttle_log(agent_t *agent, throttle_t *throttle, const char *name, bool last);
+/**
+ * @function	throttle_io_idle
+ * @abstract	Set the idle I/O scheduling class to the calling thread. Threads
+ *		and processes created afterwards inherit it.
+ * @return	YENOERR if OK, YENOSYS if not supported.
+ */
+ystatus_t throttle_io_idle(void);
+/**
+ * @function	throttle_drop_cache
+ * @abstract	Write a file to disk, and remove its pages from the page cache.
+ * @param	path	Path to the file.
+ */
+void throttle_drop_cache(const char *path);
+
+/* ********** PRIVATE DECLARATIONS ********** */
+#ifdef __A_THROTTLE_PRIVATE__
+	/**
+	 * @function	throttle_elapsed
+	 * @abstract	Returns the number of seconds between two times.
+	 * @param	from	Start time.
+	 * @param	to	End time.
+	 * @return	The duration, in seconds.
+	 */
+	static double throttle_elapsed(const struct timespec *from, const struct timespec *to);
+#endif /* __A_THROTTLE_PRIVATE__ */
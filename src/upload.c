@@ -4,29 +4,177 @@
 #include "yjson.h"
 #include "ydefs.h"
 #include "log.h"
+#include "dedup.h"
+#include "changes.h"
+#include "volume.h"
+#include "journal.h"
+#include "backup.h"
 
 #define __A_UPLOAD_PRIVATE__
 #include "upload.h"
 
 /* Upload backed up files to cloud storage. */
 void upload_files(agent_t *agent) {
+	ystatus_t st_queue = YENOERR;
 	ystatus_t st_files = YENOERR;
 	ystatus_t st_mysql = YENOERR, st_pgsql = YENOERR;
 	ytable_function_t upload_callback = NULL;
+	bool queued = agent->upload_queue ? true : false;
+
+	// wait for the end of queued uploads
+	if (queued) {
+		upload_callback = agent->upload_queue->callback;
+		st_queue = upload_queue_end(agent);
+	} else {
+		ALOG("Upload files to " YANSI_FAINT "%s" YANSI_RESET, agent->param.storage_name);
+		if (!(upload_callback = upload_init(agent)))
+			return;
+	}
+	if (queued) {
+		// upload the items which were not added to the queue
+		st_files = ytable_foreach(agent->exec_log.backup_files, upload_callback, agent);
+		st_mysql = ytable_foreach(agent->exec_log.backup_databases, upload_callback, agent);
+	} else {
+		// upload backed up files
+		if (!ytable_empty(agent->exec_log.backup_files)) {
+			ADEBUG("├ " YANSI_FAINT "Upload backed up files" YANSI_RESET);
+			st_files = ytable_foreach(agent->exec_log.backup_files, upload_callback, agent);
+			if (st_files == YENOERR)
+				ADEBUG("│ └ " YANSI_GREEN "Done" YANSI_RESET);
+		}
+		// upload backed up databases
+		if (!ytable_empty(agent->exec_log.backup_databases)) {
+			ADEBUG("├ " YANSI_FAINT "Upload backed up databases" YANSI_RESET);
+			st_mysql = ytable_foreach(agent->exec_log.backup_databases, upload_callback, agent);
+			if (st_mysql == YENOERR)
+				ADEBUG("│ └ " YANSI_GREEN "Done" YANSI_RESET);
+		}
+	}
+	// log
+	if (st_queue == YENOERR && st_files == YENOERR && st_mysql == YENOERR && st_pgsql == YENOERR)
+		ALOG("└ " YANSI_GREEN "Done" YANSI_RESET);
+	else
+		ALOG("└ " YANSI_RED "Error" YANSI_RESET);
+
+	// free environment
+	upload_free_env(agent);
+}
+/* Start the upload queue. */
+ystatus_t upload_queue_start(agent_t *agent) {
+	upload_queue_t *queue = NULL;
+	ytable_function_t upload_callback = NULL;
+
+	ALOG("Start upload queue to " YANSI_FAINT "%s" YANSI_RESET, agent->param.storage_name);
+	if (!(upload_callback = upload_init(agent)))
+		return (YEBADCONF);
+	if (!(queue = calloc0(1, sizeof(upload_queue_t))) ||
+	    !(queue->items = yarray_create(16)) ||
+	    !(queue->agent.log_lines = yarray_create(16))) {
+		ALOG("└ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		goto error;
+	}
+	queue->callback = upload_callback;
+	queue->status = YENOERR;
+	// the upload thread uses a copy of the agent structure, and buffers its log messages
+	yarray_t log_lines = queue->agent.log_lines;
+	queue->agent = *agent;
+	queue->agent.log_lines = log_lines;
+	pthread_mutex_init(&queue->mutex, NULL);
+	pthread_cond_init(&queue->cond, NULL);
+	if (pthread_create(&queue->thread, NULL, upload_queue_worker, queue)) {
+		ALOG("└ " YANSI_RED "Unable to start the upload thread" YANSI_RESET);
+		pthread_cond_destroy(&queue->cond);
+		pthread_mutex_destroy(&queue->mutex);
+		goto error;
+	}
+	agent->upload_queue = queue;
+	ALOG("└ " YANSI_GREEN "Done" YANSI_RESET);
+	return (YENOERR);
+error:
+	if (queue) {
+		yarray_free(queue->items);
+		yarray_free(queue->agent.log_lines);
+		free0(queue);
+	}
+	upload_free_env(agent);
+	return (YENOMEM);
+}
+/* Add a backed up item to the upload queue. */
+void upload_queue_push(agent_t *agent, log_item_t *item) {
+	upload_queue_t *queue = agent->upload_queue;
+
+	if (!queue || !item->success)
+		return;
+	pthread_mutex_lock(&queue->mutex);
+	yarray_push(&queue->items, item);
+	pthread_cond_signal(&queue->cond);
+	pthread_mutex_unlock(&queue->mutex);
+}
+/* Move the files of a local directory to a directory of the host's storage space. */
+ystatus_t upload_directory(agent_t *agent, const char *local_path, const char *dest_dir) {
+	ystatus_t status = YENOERR;
+	ytable_function_t upload_callback = NULL;
+	yarray_t args = NULL;
+	ystr_t bucket = NULL;
+	ystr_t root_path = NULL;
+	ystr_t dest_path = NULL;
+
+	if (!(upload_callback = upload_init(agent)))
+		return (YEBADCONF);
+	// bucket
+	if (upload_callback == upload_item_aws_s3) {
+		bucket = yvar_get_string(ytable_get_key_data(agent->param.storage, A_PARAM_KEY_BUCKET));
+		if (!bucket || ys_empty(bucket)) {
+			ADEBUG("├ " YANSI_RED "No S3 bucket given." YANSI_RESET);
+			status = YEBADCONF;
+			goto cleanup;
+		}
+	}
+	// root path, without starting and trailing slashes
+	root_path = ys_copy(yvar_get_string(ytable_get_key_data(agent->param.storage, A_PARAM_KEY_PATH)));
+	while (!ys_empty(root_path) && root_path[0] == SLASH)
+		ys_lshift(root_path);
+	while (!ys_empty(root_path) && root_path[ys_bytesize(root_path) - 1] == SLASH)
+		ys_rshift(root_path);
+	// destination path
+	dest_path = ys_printf(NULL, "storage:%s%s%s%s%s/%s/%s", bucket ? bucket : "", bucket ? "/" : "",
+	                      !ys_empty(root_path) ? root_path : "", !ys_empty(root_path) ? "/" : "",
+	                      agent->param.org_name, agent->conf.hostname, dest_dir);
+	if (!dest_path || !(args = yarray_create(3))) {
+		ADEBUG("├ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		status = YENOMEM;
+		goto cleanup;
+	}
+	ADEBUG("├ " YANSI_FAINT "Upload directory " YANSI_RESET "%s", local_path);
+	ADEBUG("│ └ " YANSI_FAINT "To " YANSI_RESET "%s", dest_path);
+	// all the files are sent by one transfer, and removed once uploaded
+	yarray_push_multi(&args, 3, "move", local_path, dest_path);
+	status = yexec(A_EXE_RCLONE, args, agent->param.storage_env, NULL, NULL);
+cleanup:
+	upload_free_env(agent);
+	ys_free(root_path);
+	ys_free(dest_path);
+	yarray_free(args);
+	return (status);
+}
+
+/* ********** PRIVATE FUNCTIONS ********** */
+/* Check storage parameters and create the storage environment. */
+static ytable_function_t upload_init(agent_t *agent) {
+	ytable_function_t upload_callback = NULL;
 
-	ALOG("Upload files to " YANSI_FAINT "%s" YANSI_RESET, agent->param.storage_name);
 	// check storage parameters
 	if (!agent->param.storage) {
 		ALOG("└ " YANSI_RED "No parameters" YANSI_RESET);
 		ALOG(YANSI_RED "Abort" YANSI_RESET);
-		return;
+		return (NULL);
 	}
 	// extract storage data
 	ystr_t storage_type = yvar_get_string(ytable_get_key_data(agent->param.storage, A_PARAM_KEY_TYPE));
 	if (!storage_type || ys_empty(storage_type)) {
 		ALOG("└ " YANSI_RED "No defined storage" YANSI_RESET);
 		ALOG(YANSI_RED "Abort" YANSI_RESET);
-		return;
+		return (NULL);
 	} else if (!strcmp0(storage_type, A_STORAGE_TYPE_AWS_S3)) {
 		agent->param.storage_env = upload_create_env_aws_s3(agent);
 		upload_callback = upload_item_aws_s3;
@@ -37,37 +185,75 @@ void upload_files(agent_t *agent) {
 	if (!agent->param.storage_env || !upload_callback) {
 		ALOG("└ " YANSI_RED "Unknown storage type '" YANSI_RESET "%s" YANSI_RED "'" YANSI_RESET, storage_type);
 		ALOG(YANSI_RED "Abort" YANSI_RESET);
-		return;
-	}
-
-	// upload backed up files
-	if (!ytable_empty(agent->exec_log.backup_files)) {
-		ADEBUG("├ " YANSI_FAINT "Upload backed up files" YANSI_RESET);
-		st_files = ytable_foreach(agent->exec_log.backup_files, upload_callback, agent);
-		if (st_files == YENOERR)
-			ADEBUG("│ └ " YANSI_GREEN "Done" YANSI_RESET);
-	}
-	// upload backed up databases
-	if (!ytable_empty(agent->exec_log.backup_databases)) {
-		ADEBUG("├ " YANSI_FAINT "Upload backed up databases" YANSI_RESET);
-		st_mysql = ytable_foreach(agent->exec_log.backup_databases, upload_callback, agent);
-		if (st_mysql == YENOERR)
-			ADEBUG("│ └ " YANSI_GREEN "Done" YANSI_RESET);
+		upload_free_env(agent);
+		return (NULL);
 	}
-	// log
-	if (st_files == YENOERR && st_mysql == YENOERR && st_pgsql == YENOERR)
-		ALOG("└ " YANSI_GREEN "Done" YANSI_RESET);
-	else
-		ALOG("└ " YANSI_RED "Error" YANSI_RESET);
-
-	// free environment
+	return (upload_callback);
+}
+/* Free the storage environment. */
+static void upload_free_env(agent_t *agent) {
 	void *pt;
+
+	if (!agent->param.storage_env)
+		return;
 	while ((pt = yarray_pop(agent->param.storage_env)))
 		free0(pt);
 	yarray_free(agent->param.storage_env);
+	agent->param.storage_env = NULL;
 }
+/* Upload thread: upload queued items until the queue is closed. */
+static void *upload_queue_worker(void *data) {
+	upload_queue_t *queue = data;
 
-/* ********** PRIVATE FUNCTIONS ********** */
+	for (; ; ) {
+		log_item_t *item;
+
+		// wait for an item
+		pthread_mutex_lock(&queue->mutex);
+		while (queue->next >= yarray_length(queue->items) && !queue->closed)
+			pthread_cond_wait(&queue->cond, &queue->mutex);
+		if (queue->next >= yarray_length(queue->items)) {
+			pthread_mutex_unlock(&queue->mutex);
+			break;
+		}
+		item = queue->items[queue->next++];
+		pthread_mutex_unlock(&queue->mutex);
+		// upload it
+		ystatus_t st = queue->callback(0, NULL, item, &queue->agent);
+		if (st != YENOERR && queue->status == YENOERR)
+			queue->status = st;
+	}
+	return (NULL);
+}
+/* Close the upload queue, wait for the upload thread and write its logs. */
+static ystatus_t upload_queue_end(agent_t *agent) {
+	upload_queue_t *queue = agent->upload_queue;
+	ystatus_t status;
+
+	// close the queue
+	pthread_mutex_lock(&queue->mutex);
+	queue->closed = true;
+	pthread_cond_signal(&queue->cond);
+	pthread_mutex_unlock(&queue->mutex);
+	// wait for the end of uploads
+	pthread_join(queue->thread, NULL);
+	pthread_cond_destroy(&queue->cond);
+	pthread_mutex_destroy(&queue->mutex);
+	// write log messages
+	ALOG("Upload files to " YANSI_FAINT "%s" YANSI_RESET, agent->param.storage_name);
+	if (yarray_length(queue->items)) {
+		ADEBUG("├ " YANSI_FAINT "Upload queued files" YANSI_RESET);
+		log_flush_lines(agent, queue->agent.log_lines);
+		if (queue->status == YENOERR)
+			ADEBUG("│ └ " YANSI_GREEN "Done" YANSI_RESET);
+	}
+	status = queue->status;
+	yarray_free(queue->agent.log_lines);
+	yarray_free(queue->items);
+	free0(queue);
+	agent->upload_queue = NULL;
+	return (status);
+}
 /* Generates the list of environment variables for AWS S3 upload. */
 static yarray_t upload_create_env_aws_s3(agent_t *agent) {
 	yarray_t env = NULL;
@@ -133,7 +319,8 @@ static ystatus_t upload_item_aws_s3(uint64_t hash, char *key, void *data, void *
 	ystr_t root_path = NULL;
 	ystr_t dest_path = NULL;
 
-	if (!item->success)
+	// the item may have been uploaded by the upload queue
+	if (!item->success || item->upload_status != YEUNDEF)
 		return (YENOERR);
 	ADEBUG("│ ├ " YANSI_FAINT "Upload file " YANSI_RESET "%s", item->archive_path);
 	// bucket
@@ -141,10 +328,12 @@ static ystatus_t upload_item_aws_s3(uint64_t hash, char *key, void *data, void *
 	if (!bucket || ys_empty(bucket)) {
 		ADEBUG("│ ├ " YANSI_RED "No S3 bucket given." YANSI_RESET);
 		status = YEBADCONF;
+		item->upload_status = status;
+		item->success = false;
 		goto cleanup;
 	}
 	// root path
-	root_path = yvar_get_string(ytable_get_key_data(agent->param.storage, A_PARAM_KEY_PATH));
+	root_path = ys_copy(yvar_get_string(ytable_get_key_data(agent->param.storage, A_PARAM_KEY_PATH)));
 	if (root_path) {
 		// remove starting slashes
 		while (!ys_empty(root_path) && root_path[0] == SLASH) {
@@ -181,6 +370,27 @@ static ystatus_t upload_item_aws_s3(uint64_t hash, char *key, void *data, void *
 		goto cleanup;
 	}
 	ADEBUG("│ │ └ " YANSI_FAINT "To " YANSI_RESET "%s", dest_path);
+	// upload the new chunks of the archive
+	if (item->chunks && item->chunks->bytesize) {
+		ystr_t chunks_path = ys_printf(NULL, "storage:%s/%s%s%s/%s/%s", bucket, root_path ? root_path : "",
+		                               root_path ? "/" : "", agent->param.org_name, agent->conf.hostname,
+		                               A_DEDUP_CHUNKS_DIRNAME);
+		status = upload_chunks(agent, item, chunks_path);
+		ys_free(chunks_path);
+		if (status != YENOERR)
+			goto cleanup;
+	}
+	// upload the volumes of the archive, before their manifest
+	if (yarray_length(item->parts)) {
+		ystr_t volumes_path = ys_printf(NULL, "%.*s", (int)(strrchr(dest_path, '/') - dest_path), dest_path);
+		status = volumes_path ? volume_upload(agent, item, volumes_path) : YENOMEM;
+		ys_free(volumes_path);
+		if (status != YENOERR) {
+			item->upload_status = status;
+			item->success = false;
+			goto cleanup;
+		}
+	}
 	// create argument list for backed up file
 	if (!(args = yarray_create(2))) {
 		ADEBUG("│ ├ " YANSI_RED "Memory allocation error" YANSI_RESET);
@@ -232,8 +442,21 @@ static ystatus_t upload_item_aws_s3(uint64_t hash, char *key, void *data, void *
 		goto cleanup;
 	}
 	item->upload_status = YENOERR;
+	// the uploaded chunks are added to the index
+	if (agent->dedup && item->chunks)
+		dedup_commit(agent->dedup, item);
+	// the next execution compares the files to this backup
+	if (item->changes && changes_commit(agent, item) != YENOERR)
+		ADEBUG("│ ├ " YANSI_YELLOW "Unable to write " YANSI_RESET "%s", item->changes_path);
+	// the next incremental backup is based on this archive
+	if (item->state_tmp)
+		backup_incremental_commit(agent, item);
+	// an interrupted run doesn't upload the item again
+	journal_write(agent, item);
 cleanup:
+	ys_free(root_path);
 	ys_free(dest_path);
+	yarray_free(args);
 	return (status);
 }
 /* Generates the list of environment variables for SFTP upload. */
@@ -311,9 +534,12 @@ static ystatus_t upload_item_sftp(uint64_t hash, char *key, void *data, void *us
 	ystr_t root_path = NULL;
 	ystr_t dest_path = NULL;
 
+	// the item may have been uploaded by the upload queue
+	if (!item->success || item->upload_status != YEUNDEF)
+		return (YENOERR);
 	ADEBUG("│ ├ " YANSI_FAINT "Upload file " YANSI_RESET "%s", item->archive_path);
 	// root path
-	root_path = yvar_get_string(ytable_get_key_data(agent->param.storage, A_PARAM_KEY_PATH));
+	root_path = ys_copy(yvar_get_string(ytable_get_key_data(agent->param.storage, A_PARAM_KEY_PATH)));
 	if (root_path) {
 		// remove starting slashes
 		while (!ys_empty(root_path) && root_path[0] == SLASH) {
@@ -348,6 +574,27 @@ static ystatus_t upload_item_sftp(uint64_t hash, char *key, void *data, void *us
 		item->success = false;
 		goto cleanup;
 	}
+	// upload the new chunks of the archive
+	if (item->chunks && item->chunks->bytesize) {
+		ystr_t chunks_path = ys_printf(NULL, "storage:%s%s%s/%s/%s", root_path ? root_path : "",
+		                               root_path ? "/" : "", agent->param.org_name, agent->conf.hostname,
+		                               A_DEDUP_CHUNKS_DIRNAME);
+		status = upload_chunks(agent, item, chunks_path);
+		ys_free(chunks_path);
+		if (status != YENOERR)
+			goto cleanup;
+	}
+	// upload the volumes of the archive, before their manifest
+	if (yarray_length(item->parts)) {
+		ystr_t volumes_path = ys_printf(NULL, "%.*s", (int)(strrchr(dest_path, '/') - dest_path), dest_path);
+		status = volumes_path ? volume_upload(agent, item, volumes_path) : YENOMEM;
+		ys_free(volumes_path);
+		if (status != YENOERR) {
+			item->upload_status = status;
+			item->success = false;
+			goto cleanup;
+		}
+	}
 	// create argument list for backed up file
 	if (!(args = yarray_create(2))) {
 		ADEBUG("│ ├ " YANSI_RED "Memory allocation error" YANSI_RESET);
@@ -397,8 +644,45 @@ static ystatus_t upload_item_sftp(uint64_t hash, char *key, void *data, void *us
 		goto cleanup;
 	}
 	item->upload_status = YENOERR;
+	// the uploaded chunks are added to the index
+	if (agent->dedup && item->chunks)
+		dedup_commit(agent->dedup, item);
+	// the next execution compares the files to this backup
+	if (item->changes && changes_commit(agent, item) != YENOERR)
+		ADEBUG("│ ├ " YANSI_YELLOW "Unable to write " YANSI_RESET "%s", item->changes_path);
+	// the next incremental backup is based on this archive
+	if (item->state_tmp)
+		backup_incremental_commit(agent, item);
+	// an interrupted run doesn't upload the item again
+	journal_write(agent, item);
 cleanup:
+	ys_free(root_path);
 	ys_free(dest_path);
+	yarray_free(args);
 	return (status);
 }
+/* Upload the new chunks of a deduplicated archive. */
+static ystatus_t upload_chunks(agent_t *agent, log_item_t *item, const char *dest_path) {
+	ystatus_t status = YENOERR;
+	yarray_t args = NULL;
 
+	if (!dest_path || !(args = yarray_create(3))) {
+		ADEBUG("│ ├ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		status = YENOMEM;
+		goto cleanup;
+	}
+	ADEBUG("│ ├ " YANSI_FAINT "Upload new chunks " YANSI_RESET "%s", item->chunks_path);
+	ADEBUG("│ │ └ " YANSI_FAINT "To " YANSI_RESET "%s", dest_path);
+	// the directory tree of new chunks is merged with the stored one
+	yarray_push_multi(&args, 3, "copy", item->chunks_path, dest_path);
+	status = yexec(A_EXE_RCLONE, args, agent->param.storage_env, NULL, NULL);
+	if (status != YENOERR)
+		ADEBUG("│ └ " YANSI_RED "Failed" YANSI_RESET);
+cleanup:
+	if (status != YENOERR) {
+		item->upload_status = status;
+		item->success = false;
+	}
+	yarray_free(args);
+	return (status);
+}
@@ -5,20 +5,104 @@
  */
 #pragma once
 
+#include <pthread.h>
 #include "ystatus.h"
 #include "yvar.h"
 #include "agent.h"
+#include "log.h"
+
+/**
+ * @typedef	upload_queue_t
+ * @abstract	Queue of items uploaded by a dedicated thread, while the next
+ *		items are backed up.
+ * @field	thread		Upload thread.
+ * @field	mutex		Mutex protecting the list of items.
+ * @field	cond		Condition signaled when an item is added or the queue is closed.
+ * @field	items		List of items to upload.
+ * @field	next		Index of the next item to upload.
+ * @field	closed		True when no more item will be added.
+ * @field	callback	Upload function.
+ * @field	agent		Copy of the agent structure, used by the upload thread
+ *				(its log messages are buffered).
+ * @field	status		Status of the first failed upload.
+ */
+typedef struct upload_queue_s {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	yarray_t items;
+	size_t next;
+	bool closed;
+	ytable_function_t callback;
+	agent_t agent;
+	ystatus_t status;
+} upload_queue_t;
 
 /**
  * @function	upload_files
- * @abstract	Upload backed up files to cloud storage.
+ * @abstract	Upload backed up files to cloud storage. If the upload queue
+ *		was started, wait for the end of queued uploads, and upload the
+ *		remaining items.
  * @param	agent	Pointer to the agent structure.
- * @return	YENOERR if the declaration went well.
  */
 void upload_files(agent_t *agent);
+/**
+ * @function	upload_queue_start
+ * @abstract	Start the upload queue.
+ * @param	agent	Pointer to the agent structure.
+ * @return	YENOERR if the upload thread was started.
+ */
+ystatus_t upload_queue_start(agent_t *agent);
+/**
+ * @function	upload_queue_push
+ * @abstract	Add a backed up item to the upload queue. Does nothing if the
+ *		queue was not started. If the item can't be added, it will be
+ *		uploaded by upload_files().
+ * @param	agent	Pointer to the agent structure.
+ * @param	item	Pointer to the item.
+ */
+void upload_queue_push(agent_t *agent, log_item_t *item);
+/**
+ * @function	upload_directory
+ * @abstract	Move the files of a local directory to a directory of the host's
+ *		storage space, in one transfer. The uploaded files are removed.
+ * @param	agent		Pointer to the agent structure.
+ * @param	local_path	Path to the local directory.
+ * @param	dest_dir	Destination directory, relative to the host's directory
+ *				in the storage.
+ * @return	YENOERR if all the files were uploaded.
+ */
+ystatus_t upload_directory(agent_t *agent, const char *local_path, const char *dest_dir);
 
 /* ********** PRIVATE DECLARATIONS ********** */
 #ifdef __A_UPLOAD_PRIVATE__
+	/**
+	 * @function	upload_init
+	 * @abstract	Check storage parameters and create the storage environment.
+	 * @param	agent	Pointer to the agent structure.
+	 * @return	The upload function, or NULL if an error occurred.
+	 */
+	static ytable_function_t upload_init(agent_t *agent);
+	/**
+	 * @function	upload_free_env
+	 * @abstract	Free the storage environment.
+	 * @param	agent	Pointer to the agent structure.
+	 */
+	static void upload_free_env(agent_t *agent);
+	/**
+	 * @function	upload_queue_worker
+	 * @abstract	Upload thread: upload queued items until the queue is closed.
+	 * @param	data	Pointer to the upload queue.
+	 * @return	Always NULL.
+	 */
+	static void *upload_queue_worker(void *data);
+	/**
+	 * @function	upload_queue_end
+	 * @abstract	Close the upload queue, wait for the upload thread and write its logs.
+	 * @param	agent	Pointer to the agent structure.
+	 * @return	YENOERR if all queued items were uploaded successfully.
+	 */
+	static ystatus_t upload_queue_end(agent_t *agent);
 	/**
 	 * @function	upload_create_env_aws_s3
 	 * @abstract	Generates the list of environment variables for AWS S3 upload.
@@ -53,5 +137,14 @@ void upload_files(agent_t *agent);
 	 * @return	YENOERR if the item has been upload successfully.
 	 */
 	static ystatus_t upload_item_sftp(uint64_t hash, char *key, void *data, void *user_data);
+	/**
+	 * @function	upload_chunks
+	 * @abstract	Upload the new chunks of a deduplicated archive.
+	 * @param	agent		Pointer to the agent structure.
+	 * @param	item		Pointer to the item's log entry.
+	 * @param	dest_path	Destination of the chunks (rclone path).
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t upload_chunks(agent_t *agent, log_item_t *item, const char *dest_path);
 #endif // __A_API_PRIVATE__
 
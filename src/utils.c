@@ -72,18 +72,6 @@ void check_tar(void) {
 	printf(YANSI_RED "Abort" YANSI_RESET "\n");
 	exit(2);
 }
-/* Checks if the sha512sum program is installed. Aborts if not. */
-void check_sha512sum(void) {
-	if (check_program_exists("sha512sum"))
-		return;
-	printf(YANSI_RED "Unable to find 'sha512sum' program on this computer." YANSI_RESET "\n\n");
-	printf("Please, install " YANSI_GOLD "sha512sum" YANSI_RESET " in a standard location ("
-	       YANSI_PURPLE "/bin/sha512sum" YANSI_RESET ", " YANSI_PURPLE "/usr/bin/sha512sum" YANSI_RESET " or "
-	       YANSI_PURPLE "/usr/local/bin/sha512sum" YANSI_RESET ") and try again.\n");
-	printf(YANSI_FAINT "See " YANSI_LINK " for more information.\n\n" YANSI_RESET, A_DOCUMENTATION_URL, "the documentation");
-	printf(YANSI_RED "Abort" YANSI_RESET "\n");
-	exit(2);
-}
 /* Checks if compression programs are installed. */
 void check_z(void) {
 	bool hasGzip = (check_program_exists("gzip") && check_program_exists("gunzip")) ? true : false;
@@ -130,14 +118,6 @@ void check_crypt(void) {
 	bool hasGpg = check_program_exists("gpg");
 	if (hasOpenssl && hasScrypt && hasGpg)
 		return;
-	if (!hasOpenssl && !hasScrypt && !hasGpg) {
-		printf("\n" YANSI_BG_RED " Unable to find any supported encryption program " YANSI_RESET "\n\n");
-		printf("You must install " YANSI_GOLD "openssl" YANSI_RESET ", " YANSI_GOLD "scrypt" YANSI_RESET " or "
-		       YANSI_GOLD "gpg" YANSI_RESET " in a standard location (" YANSI_PURPLE "/bin" YANSI_RESET ", "
-		       YANSI_PURPLE "/usr/bin" YANSI_RESET " or " YANSI_PURPLE "/usr/local/bin" YANSI_RESET ").\n\n");
-		printf(YANSI_RED "Abort." YANSI_RESET "\n");
-		exit(2);
-	}
 	printf("Here are the encryption software installed on this computer:\n");
 	printf("%s openssl  " YANSI_RESET, (hasOpenssl ? (YANSI_GREEN "✓ (installed)     ") : (YANSI_RED "✘ (not installled)")));
 	printf(YANSI_FAINT "The fastest, yet very secure\n" YANSI_RESET);
@@ -145,6 +125,8 @@ void check_crypt(void) {
 	printf(YANSI_FAINT "Very secure; slow by design\n" YANSI_RESET);
 	printf("%s gpg      " YANSI_RESET, (hasGpg ? (YANSI_GREEN "✓ (installed)     ") : (YANSI_RED "✘ (not installled)")));
 	printf(YANSI_FAINT "GNU's implementation of the OpenPGP standard\n" YANSI_RESET);
+	printf(YANSI_GREEN "✓ (built-in)      " YANSI_RESET " arkiv    " YANSI_RESET);
+	printf(YANSI_FAINT "Native ChaCha20-Poly1305; no external program needed\n" YANSI_RESET);
 	printf("\nDo you want to continue? [" YANSI_YELLOW "Y" YANSI_RESET "/" YANSI_YELLOW "n" YANSI_RESET "] " YANSI_BLUE);
 	fflush(stdout);
 	ystr_t ys = NULL;
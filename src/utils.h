@@ -32,11 +32,6 @@ ystr_t get_program_path(const char *bin_name);
  * @abstract	Checks if the tar program is installed. Aborts if not.
  */
 void check_tar(void);
-/**
- * @function	check_sha512sum
- * @abstract	Checks if the sha512sum program is installed. Aborts if not.
- */
-void check_sha512sum(void);
 /**
  * @header	check_z
  * @abstract	Checks if compression programs are installed.
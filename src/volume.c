@@ -0,0 +1,212 @@
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include "yansi.h"
+#include "ymemory.h"
+#include "yexec.h"
+#include "ypool.h"
+#include "yfile.h"
+
+#define __A_VOLUME_PRIVATE__
+#include "volume.h"
+
+/* Start the split of an archive into volumes. */
+ystatus_t volume_stream_open(volume_stream_t *stream, agent_t *agent, log_item_t *log, const char *base_path) {
+	memset(stream, 0, sizeof(volume_stream_t));
+	stream->base_path = base_path;
+	stream->volume_size = (uint64_t)agent->conf.volume_size * 1024 * 1024;
+	stream->log = log;
+	if (!(stream->manifest = ys_new("")) ||
+	    (!log->parts && !(log->parts = yarray_create(8))))
+		return (stream->status = YENOMEM);
+	return (YENOERR);
+}
+/* Write data to the volumes. */
+void volume_stream_write(const void *data, size_t len, void *user_data) {
+	volume_stream_t *stream = user_data;
+	const uint8_t *ptr = data;
+
+	while (len && stream->status == YENOERR) {
+		// a volume is opened only when there is data to write in it
+		if ((!stream->file || stream->len == stream->volume_size) &&
+		    volume_stream_next(stream, false) != YENOERR)
+			return;
+		size_t n = len;
+		if (n > stream->volume_size - stream->len)
+			n = (size_t)(stream->volume_size - stream->len);
+		if (fwrite(ptr, 1, n, stream->file) != n) {
+			stream->status = YEIO;
+			return;
+		}
+		yhash_sha512_update(&stream->sha512, ptr, n);
+		stream->len += n;
+		ptr += n;
+		len -= n;
+	}
+}
+/* Close the last volume, and write the manifest. */
+ystatus_t volume_stream_close(volume_stream_t *stream, const char *manifest_path, yhash_sha512_t *sha512) {
+	size_t nbr_parts;
+
+	// an empty archive has one empty volume
+	if (stream->status == YENOERR && !stream->file && !yarray_length(stream->log->parts))
+		volume_stream_next(stream, false);
+	if (stream->file)
+		volume_stream_next(stream, true);
+	if (stream->status == YENOERR && manifest_path) {
+		FILE *file = fopen(manifest_path, "w");
+		size_t len = ys_bytesize(stream->manifest);
+
+		if (!file || fwrite(stream->manifest, 1, len, file) != len)
+			stream->status = YEIO;
+		if (file && fclose(file))
+			stream->status = YEIO;
+		if (stream->status == YENOERR && sha512)
+			yhash_sha512_update(sha512, stream->manifest, len);
+	}
+	// the volumes of a failed archive are removed
+	if (stream->status != YENOERR) {
+		nbr_parts = yarray_length(stream->log->parts);
+		for (size_t i = 0; i < nbr_parts; ++i) {
+			ystr_t path = stream->log->parts[i];
+			unlink(path);
+			ys_free(path);
+		}
+		yarray_trunc(stream->log->parts, NULL, NULL);
+	}
+	ys_free(stream->manifest);
+	return (stream->status);
+}
+/* Upload the volumes of an archive, in parallel. */
+ystatus_t volume_upload(agent_t *agent, log_item_t *item, const char *dest_path) {
+	ystatus_t status = YENOERR;
+	size_t nbr_parts = yarray_length(item->parts);
+	volume_upload_t upload = {
+		.agent = agent,
+		.item = item,
+		.dest_path = dest_path,
+	};
+
+	if (!nbr_parts)
+		return (YENOERR);
+	if (!(upload.statuses = malloc0(nbr_parts * sizeof(ystatus_t)))) {
+		ADEBUG("│ ├ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		return (YENOMEM);
+	}
+	ADEBUG("│ ├ " YANSI_FAINT "Upload " YANSI_RESET "%zu" YANSI_FAINT " volumes" YANSI_RESET, nbr_parts);
+	ADEBUG("│ │ └ " YANSI_FAINT "To " YANSI_RESET "%s", dest_path);
+	status = ypool_run(nbr_parts, A_VOLUME_UPLOAD_THREADS, volume_upload_job, NULL, &upload);
+	// log messages are written by the calling thread
+	for (size_t i = 0; i < nbr_parts && status == YENOERR; ++i) {
+		if (upload.statuses[i] != YENOERR) {
+			ADEBUG("│ └ " YANSI_RED "Failed " YANSI_RESET "%s", (char*)item->parts[i]);
+			status = upload.statuses[i];
+		}
+	}
+	free0(upload.statuses);
+	return (status);
+}
+/* Rebuild the list of the volumes of an archive from its manifest. */
+ystatus_t volume_resume(log_item_t *log, const char *manifest_path) {
+	ystatus_t status = YENOERR;
+	ystr_t content = NULL;
+	ystr_t path = NULL;
+	char *line, *end, *name;
+	const char *slash = strrchr(manifest_path, '/');
+	int dir_len = slash ? (int)(slash - manifest_path + 1) : 0;
+
+	if ((!log->parts && !(log->parts = yarray_create(8))) ||
+	    !(content = yfile_get_string_contents(manifest_path)))
+		return (YEIO);
+	// the volumes are in the manifest's directory
+	for (line = content; (end = strchr(line, '\n')); line = end + 1) {
+		*end = '\0';
+		if (!(name = strstr(line, "  "))) {
+			status = YEBADMSG;
+			break;
+		}
+		if (!(path = ys_printf(NULL, "%.*s%s", dir_len, manifest_path, name + 2)) ||
+		    yarray_push(&log->parts, path) != YENOERR) {
+			ys_free(path);
+			status = YENOMEM;
+			break;
+		}
+		if (!yfile_exists(path)) {
+			status = YENOENT;
+			break;
+		}
+	}
+	if (status == YENOERR && !yarray_length(log->parts))
+		status = YEBADMSG;
+	if (status != YENOERR) {
+		for (size_t i = 0; i < yarray_length(log->parts); ++i)
+			ys_free(log->parts[i]);
+		yarray_trunc(log->parts, NULL, NULL);
+	}
+	ys_free(content);
+	return (status);
+}
+
+/* ********** PRIVATE FUNCTIONS ********** */
+
+/* Close the current volume, add it to the manifest, and open the next one. */
+static ystatus_t volume_stream_next(volume_stream_t *stream, bool last) {
+	uint8_t digest[YHASH_SHA512_SIZE];
+	char hex[YHASH_SHA512_HEX_SIZE + 1];
+	ystr_t path = NULL;
+
+	if (stream->file) {
+		if (fclose(stream->file) && stream->status == YENOERR)
+			stream->status = YEIO;
+		stream->file = NULL;
+		// manifest line, in the sha512sum format
+		path = yarray_get_last(stream->log->parts);
+		const char *name = strrchr(path, '/');
+		name = name ? (name + 1) : path;
+		yhash_sha512_final(&stream->sha512, digest);
+		yhash_sha512_hex(digest, hex);
+		if ((ys_append(&stream->manifest, hex) != YENOERR || ys_append(&stream->manifest, "  ") != YENOERR ||
+		     ys_append(&stream->manifest, name) != YENOERR || ys_append(&stream->manifest, "\n") != YENOERR) &&
+		    stream->status == YENOERR)
+			stream->status = YENOMEM;
+		stream->total_size += stream->len;
+		path = NULL;
+	}
+	if (last || stream->status != YENOERR)
+		return (stream->status);
+	// next volume
+	if (!(path = ys_printf(NULL, "%s.%03zu", stream->base_path, yarray_length(stream->log->parts) + 1)) ||
+	    yarray_push(&stream->log->parts, path) != YENOERR) {
+		ys_free(path);
+		return (stream->status = YENOMEM);
+	}
+	if (!(stream->file = fopen(path, "we")))
+		return (stream->status = YEIO);
+	yhash_sha512_init(&stream->sha512);
+	stream->len = 0;
+	return (YENOERR);
+}
+/* Upload one volume. */
+static void volume_upload_job(size_t index, void *user_data) {
+	volume_upload_t *upload = user_data;
+	const char *path = upload->item->parts[index];
+	const char *name = strrchr(path, '/');
+	ystr_t dest = NULL;
+	yarray_t args = NULL;
+	ystatus_t status = YENOMEM;
+
+	name = name ? (name + 1) : path;
+	if ((dest = ys_printf(NULL, "%s/%s", upload->dest_path, name)) &&
+	    (args = yarray_create(3)) &&
+	    yarray_push_multi(&args, 3, "copyto", path, dest) == YENOERR) {
+		// each volume is retried independently
+		for (int i = 0; i < A_VOLUME_UPLOAD_TRIES; ++i) {
+			if ((status = yexec(A_EXE_RCLONE, args, upload->agent->param.storage_env, NULL, NULL)) == YENOERR)
+				break;
+		}
+	}
+	upload->statuses[index] = status;
+	yarray_free(args);
+	ys_free(dest);
+}
+
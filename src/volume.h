@@ -0,0 +1,144 @@
+/**
+ * @header	volume.h
+ * @abstract	Split of archives into volumes.
+ * @discussion	The output of the compression and encryption programs is cut
+ *		into volumes of a fixed size, written next to each other:
+ *		  <archive>.001, <archive>.002, ...
+ *		The archive is replaced by a manifest, which lists the volumes
+ *		in order, with their checksums, in the sha512sum format:
+ *		  <SHA-512 of the volume>  <name of the volume>
+ *		The manifest is named <archive>.parts. The volumes are checked
+ *		with "sha512sum -c", and the archive is restored by concatenating
+ *		them in the manifest's order.
+ *
+ *		Volumes are uploaded in parallel; the manifest is uploaded last,
+ *		so its presence on the storage means the archive is complete.
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ */
+#pragma once
+
+#include <stdio.h>
+#include "ystatus.h"
+#include "ystr.h"
+#include "yarray.h"
+#include "yhash.h"
+#include "agent.h"
+#include "log.h"
+
+/** @const A_VOLUME_MANIFEST_EXT	Extension of the manifest of a split archive. */
+#define A_VOLUME_MANIFEST_EXT		"parts"
+/** @const A_VOLUME_UPLOAD_THREADS	Number of volumes uploaded concurrently. */
+#define A_VOLUME_UPLOAD_THREADS		4
+/** @const A_VOLUME_UPLOAD_TRIES	Number of upload attempts of a volume. */
+#define A_VOLUME_UPLOAD_TRIES		3
+
+/**
+ * @typedef	volume_stream_t
+ * @abstract	Archive being split into volumes.
+ * @field	base_path	Path of the archive (the volumes' paths are derived from it).
+ * @field	volume_size	Size of a volume, in bytes.
+ * @field	file		Current volume.
+ * @field	len		Size of the data written in the current volume.
+ * @field	sha512		Checksum computation of the current volume.
+ * @field	manifest	Content of the manifest.
+ * @field	log		Pointer to the item's log entry (volumes are added to it).
+ * @field	total_size	Size of all the volumes.
+ * @field	status		Status of the first error.
+ */
+typedef struct {
+	const char *base_path;
+	uint64_t volume_size;
+	FILE *file;
+	uint64_t len;
+	yhash_sha512_t sha512;
+	ystr_t manifest;
+	log_item_t *log;
+	uint64_t total_size;
+	ystatus_t status;
+} volume_stream_t;
+
+/**
+ * @typedef	volume_upload_t
+ * @abstract	Volumes of an archive being uploaded.
+ * @field	agent		Pointer to the agent structure.
+ * @field	item		Pointer to the item's log entry.
+ * @field	dest_path	Destination directory (rclone path).
+ * @field	statuses	Upload status of each volume.
+ */
+typedef struct {
+	agent_t *agent;
+	log_item_t *item;
+	const char *dest_path;
+	ystatus_t *statuses;
+} volume_upload_t;
+
+/**
+ * @function	volume_stream_open
+ * @abstract	Start the split of an archive into volumes.
+ * @param	stream		Pointer to the stream structure.
+ * @param	agent		Pointer to the agent structure.
+ * @param	log		Pointer to the item's log entry.
+ * @param	base_path	Path of the archive.
+ * @return	YENOERR if OK.
+ */
+ystatus_t volume_stream_open(volume_stream_t *stream, agent_t *agent, log_item_t *log, const char *base_path);
+/**
+ * @function	volume_stream_write
+ * @abstract	Write data to the volumes. Could be used as an output function of
+ *		yexec_pipeline(). Errors are stored in the stream structure.
+ * @param	data		Pointer to the data.
+ * @param	len		Size of the data.
+ * @param	user_data	Pointer to the stream structure.
+ */
+void volume_stream_write(const void *data, size_t len, void *user_data);
+/**
+ * @function	volume_stream_close
+ * @abstract	Close the last volume, and write the manifest. Must be called even
+ *		if an error occurred; in this case, the volumes are removed.
+ * @param	stream		Pointer to the stream structure.
+ * @param	manifest_path	Path of the manifest file (NULL if an error occurred).
+ * @param	sha512		Pointer to a checksum computation updated with the
+ *				manifest's content (could be NULL).
+ * @return	YENOERR if all the volumes and the manifest were written successfully.
+ */
+ystatus_t volume_stream_close(volume_stream_t *stream, const char *manifest_path, yhash_sha512_t *sha512);
+/**
+ * @function	volume_upload
+ * @abstract	Upload the volumes of an archive, in parallel. Each volume is
+ *		retried independently.
+ * @param	agent		Pointer to the agent structure.
+ * @param	item		Pointer to the item's log entry.
+ * @param	dest_path	Destination directory (rclone path).
+ * @return	YENOERR if all the volumes were uploaded.
+ */
+ystatus_t volume_upload(agent_t *agent, log_item_t *item, const char *dest_path);
+/**
+ * @function	volume_resume
+ * @abstract	Rebuild the list of the volumes of an archive from its manifest
+ *		(used when an interrupted run is resumed).
+ * @param	log		Pointer to the item's log entry (volumes are added to it).
+ * @param	manifest_path	Path to the manifest file.
+ * @return	YENOERR if the manifest was read and all the volumes exist.
+ */
+ystatus_t volume_resume(log_item_t *log, const char *manifest_path);
+
+/* ********** PRIVATE DECLARATIONS ********** */
+#ifdef __A_VOLUME_PRIVATE__
+	/**
+	 * @function	volume_stream_next
+	 * @abstract	Close the current volume (if any), add it to the manifest,
+	 *		and open the next one.
+	 * @param	stream	Pointer to the stream structure.
+	 * @param	last	True if there is no next volume.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t volume_stream_next(volume_stream_t *stream, bool last);
+	/**
+	 * @function	volume_upload_job
+	 * @abstract	Upload one volume (called by a pool thread).
+	 * @param	index		Index of the volume.
+	 * @param	user_data	Pointer to the upload structure.
+	 */
+	static void volume_upload_job(size_t index, void *user_data);
+#endif /* __A_VOLUME_PRIVATE__ */
+
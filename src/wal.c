@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "yansi.h"
+#include "yfile.h"
+#include "log.h"
+#include "backup.h"
+#include "upload.h"
+#include "encrypt.h"
+
+#define __A_WAL_PRIVATE__
+#include "wal.h"
+
+/* Archive a WAL segment: compress, encrypt and checksum it into the spool, then upload the spool. */
+ystatus_t exec_wal_push(agent_t *agent, const char *path) {
+	const char *name = strrchr(path, '/') ? (strrchr(path, '/') + 1) : path;
+	ystatus_t status;
+	ystr_t spool_path = NULL, params_path = NULL, key_path = NULL;
+	bool key_cached = false;
+	uint64_t spool_limit = (uint64_t)agent->conf.wal_spool * 1024 * 1024;
+	size_t nbr_segments = 0;
+
+	ALOG_RAW(YANSI_NEGATIVE "-------------------------- WAL ARCHIVING --------------------------" YANSI_RESET);
+	if (!*name || !yfile_is_readable(path) || yfile_is_dir(path)) {
+		ALOG("Archive WAL segment " YANSI_FAINT "%s" YANSI_RESET, path);
+		ALOG("└ " YANSI_RED "Unable to read the segment" YANSI_RESET);
+		ALOG(YANSI_BG_RED "Abort" YANSI_RESET);
+		return (YENOENT);
+	}
+	if (!yfile_is_executable(A_EXE_RCLONE)) {
+		ALOG("Search local programs");
+		ALOG("└ " YANSI_RED "Unable to find " YANSI_RESET A_EXE_RCLONE YANSI_RED " program" YANSI_RESET);
+		ALOG(YANSI_BG_RED "Abort" YANSI_RESET);
+		return (YENOEXEC);
+	}
+	if (!(spool_path = wal_path(agent, A_WAL_SPOOL_DIRNAME)) ||
+	    !(params_path = wal_path(agent, A_WAL_PARAMS_FILENAME)) ||
+	    !(key_path = wal_path(agent, A_WAL_KEY_FILENAME))) {
+		ALOG(YANSI_BG_RED "Abort" YANSI_RESET);
+		status = YENOMEM;
+		goto cleanup;
+	}
+	if (!yfile_mkpath(spool_path, 0700)) {
+		ALOG("Create WAL directory");
+		ALOG("└ " YANSI_RED "Unable to create directory '" YANSI_RESET "%s" YANSI_RED "'" YANSI_RESET, spool_path);
+		ALOG(YANSI_BG_RED "Abort" YANSI_RESET);
+		status = YEACCES;
+		goto cleanup;
+	}
+	// the key derived by a previous execution is used, if the password didn't change
+	if (!ys_empty(agent->conf.crypt_pwd) &&
+	    (agent->crypt_key = encrypt_key_load(key_path, agent->conf.crypt_pwd, A_WAL_CACHE_TTL)))
+		key_cached = true;
+	// fetch parameters file (an error on the schedules doesn't prevent the archiving)
+	status = backup_fetch_params_cache(agent, params_path, A_WAL_CACHE_TTL);
+	if ((status == YENOERR || status == YEAGAIN) && agent->param.wal_storage)
+		ALOG("└ " YANSI_GREEN "Done" YANSI_RESET);
+	else if (status == YENOERR || status == YEAGAIN)
+		ALOG("└ " YANSI_RED "No storage for the WAL segments" YANSI_RESET);
+	if (!agent->param.wal_storage) {
+		ALOG(YANSI_BG_RED "Abort" YANSI_RESET);
+		status = YEBADCONF;
+		goto cleanup;
+	}
+	// a newly derived key is kept for the next executions
+	if (agent->param.encryption == A_CRYPT_ARKIV && agent->crypt_key && !key_cached &&
+	    encrypt_key_save(agent->crypt_key, key_path, agent->conf.crypt_pwd) != YENOERR)
+		ADEBUG(YANSI_YELLOW "Unable to write the encryption key to '" YANSI_RESET "%s" YANSI_YELLOW "'" YANSI_RESET,
+		       key_path);
+	// a full spool is emptied first; if it's not possible, PostgreSQL keeps the segment and retries later
+	if (spool_limit && wal_spool_size(spool_path, &nbr_segments) >= spool_limit &&
+	    (wal_flush(agent) != YENOERR || wal_spool_size(spool_path, &nbr_segments) >= spool_limit)) {
+		ALOG("Archive WAL segment " YANSI_FAINT "%s" YANSI_RESET, name);
+		ALOG("└ " YANSI_RED "The spool is full (" YANSI_RESET "%u" YANSI_RED " MB)" YANSI_RESET, agent->conf.wal_spool);
+		ALOG(YANSI_BG_RED "Abort" YANSI_RESET);
+		status = YENOSPC;
+		goto cleanup;
+	}
+	// the segment is processed
+	ALOG("Archive WAL segment " YANSI_FAINT "%s" YANSI_RESET, name);
+	if ((status = wal_spool_segment(agent, path, name)) != YENOERR) {
+		ALOG(YANSI_BG_RED "Abort" YANSI_RESET);
+		goto cleanup;
+	}
+	// the spooled segments are uploaded by batches
+	wal_spool_size(spool_path, &nbr_segments);
+	if (nbr_segments >= (agent->conf.wal_batch ? agent->conf.wal_batch : 1))
+		wal_flush(agent);
+	ALOG(YANSI_GREEN "✓ End of processing" YANSI_RESET);
+cleanup:
+	ys_free(spool_path);
+	ys_free(params_path);
+	ys_free(key_path);
+	return (status);
+}
+/* Upload the spooled WAL segments to their storage. */
+ystatus_t wal_flush(agent_t *agent) {
+	ystatus_t status = YENOERR;
+	ystr_t spool_path = wal_path(agent, A_WAL_SPOOL_DIRNAME);
+	ytable_t *storage = agent->param.storage;
+	ystr_t storage_name = agent->param.storage_name;
+	size_t nbr_segments = 0;
+
+	if (!spool_path)
+		return (YENOMEM);
+	wal_spool_size(spool_path, &nbr_segments);
+	if (!nbr_segments)
+		goto cleanup;
+	ALOG("Upload " YANSI_FAINT "%zu" YANSI_RESET " WAL segment(s) to " YANSI_FAINT "%s" YANSI_RESET, nbr_segments,
+	     agent->param.wal_storage_name ? agent->param.wal_storage_name : "");
+	if (!agent->param.wal_storage) {
+		ALOG("└ " YANSI_RED "No storage for the WAL segments" YANSI_RESET);
+		status = YEBADCONF;
+		goto cleanup;
+	}
+	// the storage of the WAL segments is used instead of the schedule's one
+	agent->param.storage = agent->param.wal_storage;
+	agent->param.storage_name = agent->param.wal_storage_name;
+	status = upload_directory(agent, spool_path, A_WAL_REMOTE_DIRNAME);
+	agent->param.storage = storage;
+	agent->param.storage_name = storage_name;
+	// an error of the storage parameters is already logged
+	if (status == YENOERR)
+		ALOG("└ " YANSI_GREEN "Done" YANSI_RESET);
+	else if (status != YEBADCONF)
+		ALOG("└ " YANSI_YELLOW "Failed (the segments are kept in the spool)" YANSI_RESET);
+cleanup:
+	ys_free(spool_path);
+	return (status);
+}
+
+/* ********** PRIVATE FUNCTIONS ********** */
+/* Stream a WAL segment to its archive, and move the archive and its checksum file to the spool. */
+static ystatus_t wal_spool_segment(agent_t *agent, const char *path, const char *name) {
+	ystatus_t status = YENOERR;
+	ystr_t tmp_path = NULL, spool_path = NULL;
+	ystr_t archive_path = NULL, checksum_path = NULL;
+	log_item_t *log = NULL;
+
+	if (!(tmp_path = wal_path(agent, A_WAL_TMP_DIRNAME)) ||
+	    !(spool_path = wal_path(agent, A_WAL_SPOOL_DIRNAME))) {
+		ALOG("└ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		status = YENOMEM;
+		goto cleanup;
+	}
+	if (!yfile_mkpath(tmp_path, 0700) || !yfile_mkpath(spool_path, 0700)) {
+		ALOG("└ " YANSI_RED "Unable to create directory '" YANSI_RESET "%s" YANSI_RED "'" YANSI_RESET, spool_path);
+		status = YEACCES;
+		goto cleanup;
+	}
+	if (!(log = log_create_pgsql(agent, ys_new(name))) ||
+	    !(log->archive_name = ys_new(name)) ||
+	    !(log->archive_path = ys_printf(NULL, "%s/%s", tmp_path, name))) {
+		ALOG("└ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		status = YENOMEM;
+		goto cleanup;
+	}
+	// a segment is always encrypted while streamed, and never split or deduplicated
+	agent->conf.streaming = true;
+	agent->conf.volume_size = 0;
+	ADEBUG("├ " YANSI_FAINT "Read " YANSI_RESET "%s", path);
+	if ((status = backup_stream_file(agent, log, path)) != YENOERR) {
+		ALOG("└ " YANSI_RED "Failed" YANSI_RESET);
+		goto cleanup;
+	}
+	// the files are on disk before they are moved to the spool, and the spool before the command succeeds
+	if (!(archive_path = ys_printf(NULL, "%s/%s", spool_path, log->archive_name)) ||
+	    !(checksum_path = ys_printf(NULL, "%s/%s", spool_path, log->checksum_name))) {
+		ALOG("└ " YANSI_RED "Memory allocation error" YANSI_RESET);
+		status = YENOMEM;
+		goto cleanup;
+	}
+	if ((status = wal_sync(log->archive_path)) != YENOERR ||
+	    (status = wal_sync(log->checksum_path)) != YENOERR ||
+	    rename(log->archive_path, archive_path) ||
+	    rename(log->checksum_path, checksum_path) ||
+	    (status = wal_sync(spool_path)) != YENOERR) {
+		ALOG("└ " YANSI_RED "Unable to move the archive to the spool" YANSI_RESET);
+		status = (status != YENOERR) ? status : YEIO;
+		unlink(log->archive_path);
+		unlink(log->checksum_path);
+		goto cleanup;
+	}
+	ADEBUG("├ " YANSI_FAINT "Spooled to " YANSI_RESET "%s" YANSI_FAINT " (" YANSI_RESET "%" PRIu64 YANSI_FAINT " bytes)"
+	       YANSI_RESET, archive_path, log->archive_size);
+	ALOG("└ " YANSI_GREEN "Done" YANSI_RESET);
+cleanup:
+	ys_free(tmp_path);
+	ys_free(spool_path);
+	ys_free(archive_path);
+	ys_free(checksum_path);
+	return (status);
+}
+/* Returns the path to a subdirectory of the WAL directory. */
+static ystr_t wal_path(agent_t *agent, const char *dirname) {
+	return (ys_printf(NULL, "%s/%s/%s", agent->conf.archives_path, A_WAL_DIRNAME, dirname));
+}
+/* Compute the size of the spool. */
+static uint64_t wal_spool_size(const char *spool_path, size_t *nbr_segments) {
+	DIR *dir;
+	struct dirent *entry;
+	struct stat st;
+	ystr_t file;
+	uint64_t size = 0;
+	size_t suffix_len = strlen(".sha512");
+
+	*nbr_segments = 0;
+	if (!(dir = opendir(spool_path)))
+		return (0);
+	while ((entry = readdir(dir))) {
+		if (entry->d_name[0] == '.')
+			continue;
+		if (!(file = ys_printf(NULL, "%s/%s", spool_path, entry->d_name)))
+			continue;
+		if (!stat(file, &st) && S_ISREG(st.st_mode)) {
+			size += (uint64_t)st.st_size;
+			// each segment has an archive and a checksum file
+			size_t len = strlen(entry->d_name);
+			if (len <= suffix_len || strcmp(entry->d_name + len - suffix_len, ".sha512"))
+				++*nbr_segments;
+		}
+		ys_free(file);
+	}
+	closedir(dir);
+	return (size);
+}
+/* Flush a file or a directory to disk. */
+static ystatus_t wal_sync(const char *path) {
+	int fd;
+	ystatus_t status = YENOERR;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+		return (YEIO);
+	if (fsync(fd))
+		status = YEIO;
+	close(fd);
+	return (status);
+}
@@ -0,0 +1,107 @@
+/**
+ * @header	wal.h
+ * @abstract	Continuous archiving of the PostgreSQL WAL segments.
+ * @discussion	The "wal-push" mode is meant to be used as PostgreSQL's
+ *		archive_command:
+ *		  archive_command = '/opt/arkiv/bin/arkiv_agent wal-push %p'
+ *
+ *		Each segment is compressed, encrypted and checksummed by the
+ *		streaming pipeline of the archives, into a temporary directory.
+ *		The archive and its checksum file are then synced to disk and
+ *		moved to a local spool, and the command succeeds: PostgreSQL may
+ *		recycle the segment.
+ *
+ *		The spooled files are moved to the storage by one transfer when
+ *		their number reaches the configured batch size (each segment is
+ *		uploaded at once by default). If the storage is slow or not
+ *		reachable, they stay in the spool and are sent with the next
+ *		segments; the backup runs upload them too. When the spool reaches
+ *		its maximum size, the archiving fails, and PostgreSQL keeps the
+ *		segment and retries later.
+ *
+ *		On the storage, the segments are in the "wal" directory of the
+ *		host, named after the segment (000000010000000A000000FE.zst.arkiv
+ *		and its checksum file).
+ *
+ *		PostgreSQL executes the command for each segment, so the host
+ *		parameters and the master key of the native encryption are kept
+ *		in the WAL directory (readable by their owner only) and reused
+ *		for 10 minutes, instead of being downloaded and derived for each
+ *		segment. If the parameters can't be downloaded, the previous ones
+ *		are used.
+ * @author	Amaury Bouchard <amaury@amaury.net>
+ */
+#pragma once
+
+#include "ystatus.h"
+#include "ystr.h"
+#include "agent.h"
+
+/** @const A_WAL_SPOOL_DIRNAME	Subdirectory of the WAL directory where the segments wait for their upload. */
+#define A_WAL_SPOOL_DIRNAME	"spool"
+/** @const A_WAL_TMP_DIRNAME	Subdirectory of the WAL directory where the segments are processed. */
+#define A_WAL_TMP_DIRNAME	"tmp"
+/** @const A_WAL_REMOTE_DIRNAME	Name of the remote directory of the WAL segments. */
+#define A_WAL_REMOTE_DIRNAME	"wal"
+/** @const A_WAL_PARAMS_FILENAME	File of the WAL directory where the host parameters are kept. */
+#define A_WAL_PARAMS_FILENAME	"params.json"
+/** @const A_WAL_KEY_FILENAME	File of the WAL directory where the master key of the native encryption is kept. */
+#define A_WAL_KEY_FILENAME	"key"
+/** @const A_WAL_CACHE_TTL	Duration of validity of the kept parameters and key, in seconds. */
+#define A_WAL_CACHE_TTL		600
+
+/**
+ * @function	exec_wal_push
+ * @abstract	Archive a WAL segment: compress, encrypt and checksum it into the
+ *		spool, then upload the spool if the batch is complete.
+ * @param	agent	Pointer to the agent structure.
+ * @param	path	Path to the segment.
+ * @return	YENOERR if the segment was spooled (the program must exit with a
+ *		zero status only in this case).
+ */
+ystatus_t exec_wal_push(agent_t *agent, const char *path);
+/**
+ * @function	wal_flush
+ * @abstract	Upload the spooled WAL segments to their storage. Nothing is done
+ *		(and logged) if the spool is empty.
+ * @param	agent	Pointer to the agent structure.
+ * @return	YENOERR if the spool is empty or all its files were uploaded.
+ */
+ystatus_t wal_flush(agent_t *agent);
+
+/* ********** PRIVATE DECLARATIONS ********** */
+#ifdef __A_WAL_PRIVATE__
+	/**
+	 * @function	wal_spool_segment
+	 * @abstract	Stream a WAL segment to its archive, and move the archive and its
+	 *		checksum file to the spool.
+	 * @param	agent	Pointer to the agent structure.
+	 * @param	path	Path to the segment.
+	 * @param	name	Name of the segment.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t wal_spool_segment(agent_t *agent, const char *path, const char *name);
+	/**
+	 * @function	wal_path
+	 * @abstract	Returns the path to a subdirectory of the WAL directory.
+	 * @param	agent	Pointer to the agent structure.
+	 * @param	dirname	Name of the subdirectory.
+	 * @return	The path, or NULL if an error occurred.
+	 */
+	static ystr_t wal_path(agent_t *agent, const char *dirname);
+	/**
+	 * @function	wal_spool_size
+	 * @abstract	Compute the size of the spool.
+	 * @param	spool_path	Path to the spool directory.
+	 * @param	nbr_segments	Pointer set to the number of spooled segments.
+	 * @return	The size of the spooled files, in bytes.
+	 */
+	static uint64_t wal_spool_size(const char *spool_path, size_t *nbr_segments);
+	/**
+	 * @function	wal_sync
+	 * @abstract	Flush a file or a directory to disk.
+	 * @param	path	Path to the file or directory.
+	 * @return	YENOERR if OK.
+	 */
+	static ystatus_t wal_sync(const char *path);
+#endif /* __A_WAL_PRIVATE__ */